@@ -81,6 +81,8 @@ enum GLSLRules
 	GSR_EXTDrawBuffers = 1UL << 20,
 	GSR_OESStandardDerivatives = 1UL << 21,
 	GSR_EXTFragDepth = 1UL << 22,
+	GSR_RemoveDeadCode = 1UL << 23,		// Set means removing instructions whose results are never read.
+	GSR_CompactTemps = 1UL << 24,		// Set means renumbering the used temps, so no unused ones are declared.
 	GSR_ForceUInt32 = 0xFFFFFFFF
 };
 
@@ -95,8 +97,8 @@ struct RegisterDesc
 struct HSForkPhase
 {
 	uint32_t fork_instance_count;
-	std::vector<KlayGE::shared_ptr<ShaderDecl>> dcls;
-	std::vector<KlayGE::shared_ptr<ShaderInstruction> > insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 	
 	HSForkPhase()
 		:fork_instance_count(0){}
@@ -104,8 +106,8 @@ struct HSForkPhase
 
 struct HSControlPointPhase
 {
-	std::vector<KlayGE::shared_ptr<ShaderDecl>> dcls;
-	std::vector<KlayGE::shared_ptr<ShaderInstruction> > insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 };
 
 class GLSLGen
@@ -182,7 +184,7 @@ private:
 	bool has_gs_;
 	std::vector<DclIndexRangeInfo> idx_range_info_;
 	std::vector<TextureSamplerInfo> textures_;
-	std::vector<KlayGE::shared_ptr<ShaderDecl> > temp_dcls_;
+	std::vector<ShaderDecl*> temp_dcls_;
 	std::map<int64_t, bool> cb_index_mode_;
 	std::vector<HSForkPhase> hs_fork_phases_;
 	std::vector<HSControlPointPhase> hs_control_point_phase_;
@@ -284,7 +284,7 @@ struct ShaderOperand
 	struct
 	{
 		int64_t disp;
-		KlayGE::shared_ptr<ShaderOperand> reg;
+		ShaderOperand* reg;
 	} indices[3];
 
 	bool IsIndexSimple(uint32_t i) const
@@ -305,6 +305,7 @@ struct ShaderOperand
 		memset(swizzle, 0, sizeof(swizzle));
 		memset(imm_values, 0, sizeof(imm_values));
 		indices[0].disp = indices[1].disp = indices[2].disp = 0;
+		indices[0].reg = indices[1].reg = indices[2].reg = nullptr;
 	}
 };
 
@@ -319,19 +320,20 @@ struct ShaderInstruction : public TokenizedShaderInstruction
 
 	uint32_t num;
 	uint32_t num_ops;
-	KlayGE::shared_ptr<ShaderOperand> ops[SM_MAX_OPS];
+	ShaderOperand* ops[SM_MAX_OPS];
 
 	ShaderInstruction()
 		: resource_target(0), num(0), num_ops(0)
 	{
 		memset(sample_offset, 0, sizeof(sample_offset));
 		memset(resource_return_type, 0, sizeof(resource_return_type));
+		memset(ops, 0, sizeof(ops));
 	}
 };
 
 struct ShaderDecl : public TokenizedShaderInstruction
 {
-	KlayGE::shared_ptr<ShaderOperand> op;
+	ShaderOperand* op;
 	union
 	{
 		uint32_t num;
@@ -361,6 +363,7 @@ struct ShaderDecl : public TokenizedShaderInstruction
 	std::vector<uint8_t> data;
 
 	ShaderDecl()
+		: op(nullptr)
 	{
 		memset(&intf, 0, sizeof(intf));
 	}
@@ -372,11 +375,14 @@ struct LabelInfo
 	uint32_t end_num; // the last insn in label etc. ret
 };
 
-struct ShaderProgram
+struct ShaderProgram : boost::noncopyable
 {
+	// Owns all the declarations, instructions and operands below
+	Arena arena;
+
 	TokenizedShaderVersion version;//program version
-	std::vector<KlayGE::shared_ptr<ShaderDecl> > dcls;//declarations
-	std::vector<KlayGE::shared_ptr<ShaderInstruction> > insns;//instructions
+	std::vector<ShaderDecl*> dcls;//declarations
+	std::vector<ShaderInstruction*> insns;//instructions
 
 	std::vector<DXBCSignatureParamDesc> params_in; //input signature
 	std::vector<DXBCSignatureParamDesc> params_out;//output signature
@@ -410,6 +416,12 @@ struct ShaderProgram
 
 KlayGE::shared_ptr<ShaderProgram> ShaderParse(DXBCContainer const & dxbc);
 
+// IR clean-ups before code generation. Hull shaders are left alone.
+// Removes pure instructions whose results are never read, and returns how many were removed.
+uint32_t RemoveDeadCode(ShaderProgram& program);
+// Renumbers the temps that are still used to 0..N-1, so fewer of them are declared.
+void CompactTemps(ShaderProgram& program);
+
 // Return the opcode's input type
 inline ShaderImmType GetOpInType(uint32_t opcode)
 {
@@ -34,9 +34,16 @@
 #pragma once
 
 #include <KFL/KFL.hpp>
+#include <vector>
+#include <string>
+#include <streambuf>
+#include <new>
 
 #define BOOST_ENABLE_ASSERT_HANDLER
 #include <boost/assert.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
 
 using KlayGE::int8_t;
 using KlayGE::int32_t;
@@ -48,4 +55,57 @@ using KlayGE::uint64_t;
 
 bool ValidFloat(float f);
 
+// Bump allocator for the shader IR. Objects live until the arena is destroyed, so a whole program
+// is freed at once instead of node by node.
+class Arena : boost::noncopyable
+{
+public:
+	Arena();
+	~Arena();
+
+	template <typename T>
+	T* New()
+	{
+		T* ret = new (this->Allocate(sizeof(T), boost::alignment_of<T>::value)) T;
+		if (!boost::has_trivial_destructor<T>::value)
+		{
+			dtors_.push_back(std::make_pair(static_cast<void*>(ret), &Arena::Destroy<T>));
+		}
+		return ret;
+	}
+
+	void* Allocate(size_t size, size_t alignment);
+
+private:
+	template <typename T>
+	static void Destroy(void* p)
+	{
+		static_cast<T*>(p)->~T();
+	}
+
+private:
+	std::vector<uint8_t*> blocks_;
+	uint8_t* cur_;
+	size_t remaining_;
+	std::vector<std::pair<void*, void (*)(void*)> > dtors_;
+};
+
+// Output stream buffer that appends to a string through a small buffer. The code is generated in place,
+// instead of through a stringstream and copied out at the end.
+class StringOutputStreamBuf : public std::streambuf, boost::noncopyable
+{
+public:
+	explicit StringOutputStreamBuf(std::string& str);
+	~StringOutputStreamBuf();
+
+protected:
+	virtual int_type overflow(int_type ch) KLAYGE_OVERRIDE;
+	virtual std::streamsize xsputn(char_type const * s, std::streamsize count) KLAYGE_OVERRIDE;
+	virtual int sync() KLAYGE_OVERRIDE;
+
+private:
+	std::string& str_;
+	char_type buff_[1024];
+};
+
 #endif		// _DXBC2GLSL_UTILS_HPP_
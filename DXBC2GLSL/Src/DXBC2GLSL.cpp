@@ -31,7 +31,7 @@
 #include <DXBC2GLSL/DXBC2GLSL.hpp>
 #include <DXBC2GLSL/DXBC.hpp>
 #include <DXBC2GLSL/GLSLGen.hpp>
-#include <sstream>
+#include <ostream>
 
 namespace DXBC2GLSL
 {
@@ -54,13 +54,15 @@ namespace DXBC2GLSL
 			{
 				shader_ = ShaderParse(*dxbc_);
 
-				std::stringstream ss;
-
 				GLSLGen converter;
 				converter.FeedDXBC(shader_, has_gs, version, glsl_rules);
-				converter.ToGLSL(ss);
 
-				glsl_ = ss.str();
+				glsl_.clear();
+				{
+					StringOutputStreamBuf buf(glsl_);
+					std::ostream os(&buf);
+					converter.ToGLSL(os);
+				}
 			}
 		}
 	}
@@ -109,7 +109,7 @@ namespace
 
 uint32_t GLSLGen::DefaultRules(GLSLVersion version)
 {
-	uint32_t rules = GSR_VersionDecl;
+	uint32_t rules = GSR_VersionDecl | GSR_RemoveDeadCode | GSR_CompactTemps;
 	if (version < GSV_100_ES)
 	{
 		if (version >= GSV_110)
@@ -214,6 +214,16 @@ void GLSLGen::FeedDXBC(KlayGE::shared_ptr<ShaderProgram> const & program, bool h
 		glsl_rules_ &= ~GSR_GlobalUniformsInUBO;
 	}
 
+	// Before anything records instruction numbers
+	if (glsl_rules_ & GSR_RemoveDeadCode)
+	{
+		RemoveDeadCode(*program_);
+	}
+	if (glsl_rules_ & GSR_CompactTemps)
+	{
+		CompactTemps(*program_);
+	}
+
 	this->LinkCFInsns();
 	this->FindLabels();
 	this->FindEndOfProgram();
@@ -412,7 +422,7 @@ void GLSLGen::ToGLSL(std::ostream& out)
 		this->ToCopyToInterShaderPatchConstantRegisters(out);
 	}
 
-	for (std::vector<KlayGE::shared_ptr<ShaderDecl> >::const_iterator iter = temp_dcls_.begin();
+	for (std::vector<ShaderDecl*>::const_iterator iter = temp_dcls_.begin();
 		iter != temp_dcls_.end(); ++ iter)
 	{
 		this->ToTemps(out, **iter);
@@ -7526,8 +7536,8 @@ void GLSLGen::ToComponentSelector(std::ostream& out, uint32_t comps, uint32_t of
 
 void GLSLGen::FindHSForkPhases()
 {
-	std::vector<KlayGE::shared_ptr<ShaderDecl> >::const_iterator itr_dcl = program_->dcls.begin();
-	std::vector<KlayGE::shared_ptr<ShaderInstruction> >::const_iterator itr_insn = program_->insns.begin();
+	std::vector<ShaderDecl*>::const_iterator itr_dcl = program_->dcls.begin();
+	std::vector<ShaderInstruction*>::const_iterator itr_insn = program_->insns.begin();
 	for (;;)
 	{
 		// find iterator to next hs_fork_phase.
@@ -7551,7 +7561,7 @@ void GLSLGen::FindHSForkPhases()
 				break;
 			}
 		}
-		std::vector<KlayGE::shared_ptr<ShaderDecl> >::const_iterator itr_dcl1 = itr_dcl + 1;
+		std::vector<ShaderDecl*>::const_iterator itr_dcl1 = itr_dcl + 1;
 		for (; itr_dcl1 != program_->dcls.end(); ++ itr_dcl1)
 		{
 			if (SO_HS_FORK_PHASE == (*itr_dcl1)->opcode)
@@ -7568,7 +7578,7 @@ void GLSLGen::FindHSForkPhases()
 				phase.dcls.push_back(*itr_dcl1);
 			}
 		}
-		std::vector<KlayGE::shared_ptr<ShaderInstruction> >::const_iterator itr_insn1 = itr_insn + 1;
+		std::vector<ShaderInstruction*>::const_iterator itr_insn1 = itr_insn + 1;
 		for (; itr_insn1 != program_->insns.end(); ++ itr_insn1)
 		{
 			if (SO_HS_FORK_PHASE == (*itr_insn1)->opcode)
@@ -7585,8 +7595,8 @@ void GLSLGen::FindHSForkPhases()
 
 void GLSLGen::FindHSControlPointPhase()
 {
-	std::vector<KlayGE::shared_ptr<ShaderDecl> >::const_iterator itr_dcl = program_->dcls.begin();
-	std::vector<KlayGE::shared_ptr<ShaderInstruction> >::const_iterator itr_insn = program_->insns.begin();
+	std::vector<ShaderDecl*>::const_iterator itr_dcl = program_->dcls.begin();
+	std::vector<ShaderInstruction*>::const_iterator itr_insn = program_->insns.begin();
 	for (; itr_dcl != program_->dcls.end(); ++ itr_dcl)
 	{
 		if (SO_HS_CONTROL_POINT_PHASE == (*itr_dcl)->opcode)
@@ -7597,12 +7607,12 @@ void GLSLGen::FindHSControlPointPhase()
 	if (itr_dcl != program_->dcls.end())
 	{
 		HSControlPointPhase phase;
-		std::vector<KlayGE::shared_ptr<ShaderDecl> >::const_iterator itr_dcl1 = itr_dcl;
+		std::vector<ShaderDecl*>::const_iterator itr_dcl1 = itr_dcl;
 		for (; ((*itr_dcl1)->opcode != SO_HS_FORK_PHASE) && (itr_dcl1 != program_->dcls.end()); ++ itr_dcl1)
 		{
 			phase.dcls.push_back(*itr_dcl1);
 		}
-		std::vector<KlayGE::shared_ptr<ShaderInstruction> >::const_iterator itr_insn1 = itr_insn;
+		std::vector<ShaderInstruction*>::const_iterator itr_insn1 = itr_insn;
 		for (; static_cast<uint32_t>(itr_insn1 - program_->insns.begin()) != end_of_program_; ++ itr_insn1)
 		{
 			phase.insns.push_back(*itr_insn1);
@@ -0,0 +1,299 @@
+/**
+ * @file ShaderOptimize.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <DXBC2GLSL/Shader.hpp>
+#include <DXBC2GLSL/Utils.hpp>
+
+namespace
+{
+	// Instructions without side effects, which write only their first operand
+	bool IsPureInstruction(ShaderOpcode opcode)
+	{
+		switch (opcode)
+		{
+		case SO_ADD:
+		case SO_AND:
+		case SO_DERIV_RTX:
+		case SO_DERIV_RTY:
+		case SO_DERIV_RTX_COARSE:
+		case SO_DERIV_RTX_FINE:
+		case SO_DERIV_RTY_COARSE:
+		case SO_DERIV_RTY_FINE:
+		case SO_DIV:
+		case SO_DP2:
+		case SO_DP3:
+		case SO_DP4:
+		case SO_EQ:
+		case SO_EXP:
+		case SO_FRC:
+		case SO_FTOI:
+		case SO_FTOU:
+		case SO_GE:
+		case SO_IADD:
+		case SO_IEQ:
+		case SO_IGE:
+		case SO_ILT:
+		case SO_IMAD:
+		case SO_IMAX:
+		case SO_IMIN:
+		case SO_INE:
+		case SO_INEG:
+		case SO_ISHL:
+		case SO_ISHR:
+		case SO_ITOF:
+		case SO_LD:
+		case SO_LD_MS:
+		case SO_LOG:
+		case SO_LT:
+		case SO_MAD:
+		case SO_MIN:
+		case SO_MAX:
+		case SO_MOV:
+		case SO_MOVC:
+		case SO_MUL:
+		case SO_NE:
+		case SO_NOT:
+		case SO_OR:
+		case SO_ROUND_NE:
+		case SO_ROUND_NI:
+		case SO_ROUND_PI:
+		case SO_ROUND_Z:
+		case SO_RSQ:
+		case SO_SAMPLE:
+		case SO_SAMPLE_C:
+		case SO_SAMPLE_C_LZ:
+		case SO_SAMPLE_L:
+		case SO_SAMPLE_D:
+		case SO_SAMPLE_B:
+		case SO_SQRT:
+		case SO_ULT:
+		case SO_UGE:
+		case SO_UMAD:
+		case SO_UMAX:
+		case SO_UMIN:
+		case SO_USHR:
+		case SO_UTOF:
+		case SO_XOR:
+		case SO_LOD:
+		case SO_GATHER4:
+		case SO_RESINFO:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	bool IsSimpleTemp(ShaderOperand const & op)
+	{
+		return (SOT_TEMP == op.type) && op.HasSimpleIndex();
+	}
+
+	// Components of a temp the operand may touch. Anything unusual counts as all of them.
+	uint32_t TempComponents(ShaderOperand const & op)
+	{
+		uint32_t ret = 0xF;
+		if (4 == op.comps)
+		{
+			switch (op.mode)
+			{
+			case SOSM_MASK:
+				ret = op.mask;
+				break;
+
+			case SOSM_SWIZZLE:
+				ret = (1UL << op.swizzle[0]) | (1UL << op.swizzle[1]) | (1UL << op.swizzle[2]) | (1UL << op.swizzle[3]);
+				break;
+
+			case SOSM_SCALAR:
+				ret = 1UL << op.swizzle[0];
+				break;
+
+			default:
+				break;
+			}
+		}
+		return ret;
+	}
+
+	void MarkTempReads(ShaderOperand const & op, std::vector<uint8_t>& read_masks)
+	{
+		if (SOT_TEMP == op.type)
+		{
+			size_t const reg = static_cast<size_t>(op.indices[0].disp);
+			if (reg >= read_masks.size())
+			{
+				read_masks.resize(reg + 1, 0);
+			}
+			read_masks[reg] |= static_cast<uint8_t>(TempComponents(op));
+		}
+		for (uint32_t i = 0; i < op.num_indices; ++ i)
+		{
+			if (op.indices[i].reg)
+			{
+				MarkTempReads(*op.indices[i].reg, read_masks);
+			}
+		}
+	}
+
+	bool IsRemovable(ShaderInstruction const & insn)
+	{
+		return IsPureInstruction(insn.opcode) && (insn.num_ops > 0)
+			&& IsSimpleTemp(*insn.ops[0]) && (4 == insn.ops[0]->comps) && (SOSM_MASK == insn.ops[0]->mode);
+	}
+
+	void RemapTemps(ShaderOperand& op, std::vector<int64_t> const & remap)
+	{
+		if (SOT_TEMP == op.type)
+		{
+			op.indices[0].disp = remap[static_cast<size_t>(op.indices[0].disp)];
+		}
+		for (uint32_t i = 0; i < op.num_indices; ++ i)
+		{
+			if (op.indices[i].reg)
+			{
+				RemapTemps(*op.indices[i].reg, remap);
+			}
+		}
+	}
+}
+
+uint32_t RemoveDeadCode(ShaderProgram& program)
+{
+	// Temps of hull shaders are per phase
+	if (ST_HS == program.version.type)
+	{
+		return 0;
+	}
+
+	// A write is dead when no instruction anywhere reads those components. That holds whatever the flow control is,
+	// and removing it can make more writes dead, so repeat until nothing changes.
+	uint32_t num_removed = 0;
+	std::vector<uint8_t> read_masks;
+	for (;;)
+	{
+		read_masks.assign(read_masks.size(), 0);
+		for (size_t i = 0; i < program.insns.size(); ++ i)
+		{
+			ShaderInstruction const & insn = *program.insns[i];
+			for (uint32_t j = IsRemovable(insn) ? 1 : 0; j < insn.num_ops; ++ j)
+			{
+				MarkTempReads(*insn.ops[j], read_masks);
+			}
+		}
+
+		size_t const old_size = program.insns.size();
+		std::vector<ShaderInstruction*>::iterator end = program.insns.begin();
+		for (size_t i = 0; i < program.insns.size(); ++ i)
+		{
+			ShaderInstruction* insn = program.insns[i];
+			bool dead = false;
+			if (IsRemovable(*insn))
+			{
+				size_t const reg = static_cast<size_t>(insn->ops[0]->indices[0].disp);
+				dead = (reg >= read_masks.size()) || (0 == (insn->ops[0]->mask & read_masks[reg]));
+			}
+			if (!dead)
+			{
+				*end = insn;
+				++ end;
+			}
+		}
+		program.insns.erase(end, program.insns.end());
+
+		if (program.insns.size() == old_size)
+		{
+			break;
+		}
+		num_removed += static_cast<uint32_t>(old_size - program.insns.size());
+	}
+
+	return num_removed;
+}
+
+void CompactTemps(ShaderProgram& program)
+{
+	if (ST_HS == program.version.type)
+	{
+		return;
+	}
+
+	ShaderDecl* dcl_temps = nullptr;
+	for (size_t i = 0; i < program.dcls.size(); ++ i)
+	{
+		if (SO_DCL_TEMPS == program.dcls[i]->opcode)
+		{
+			if (dcl_temps)
+			{
+				return;
+			}
+			dcl_temps = program.dcls[i];
+		}
+	}
+	if (!dcl_temps)
+	{
+		return;
+	}
+
+	std::vector<uint8_t> used(dcl_temps->num, 0);
+	for (size_t i = 0; i < program.insns.size(); ++ i)
+	{
+		ShaderInstruction const & insn = *program.insns[i];
+		for (uint32_t j = 0; j < insn.num_ops; ++ j)
+		{
+			MarkTempReads(*insn.ops[j], used);
+		}
+	}
+
+	// Register numbers are renamed one to one, so the per-register type tracking in code generation is unaffected
+	std::vector<int64_t> remap(used.size(), 0);
+	uint32_t num_temps = 0;
+	for (size_t i = 0; i < used.size(); ++ i)
+	{
+		if (used[i])
+		{
+			remap[i] = num_temps;
+			++ num_temps;
+		}
+	}
+
+	if (num_temps < used.size())
+	{
+		for (size_t i = 0; i < program.insns.size(); ++ i)
+		{
+			ShaderInstruction& insn = *program.insns[i];
+			for (uint32_t j = 0; j < insn.num_ops; ++ j)
+			{
+				RemapTemps(*insn.ops[j], remap);
+			}
+		}
+		dcl_temps->num = num_temps;
+	}
+}
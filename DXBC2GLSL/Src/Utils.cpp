@@ -32,6 +32,8 @@
 #include <exception>
 #include <sstream>
 #include <limits>
+#include <algorithm>
+#include <cstring>
 
 namespace
 {
@@ -73,6 +75,90 @@ namespace boost
 	}
 }
 
+namespace
+{
+	size_t const ARENA_BLOCK_SIZE = 16 * 1024;
+}
+
+Arena::Arena()
+	: cur_(nullptr), remaining_(0)
+{
+}
+
+Arena::~Arena()
+{
+	for (size_t i = dtors_.size(); i > 0; -- i)
+	{
+		dtors_[i - 1].second(dtors_[i - 1].first);
+	}
+	for (size_t i = 0; i < blocks_.size(); ++ i)
+	{
+		delete[] blocks_[i];
+	}
+}
+
+void* Arena::Allocate(size_t size, size_t alignment)
+{
+	size_t padding = (alignment - (reinterpret_cast<size_t>(cur_) & (alignment - 1))) & (alignment - 1);
+	if (padding + size > remaining_)
+	{
+		size_t const block_size = std::max(size + alignment, ARENA_BLOCK_SIZE);
+		blocks_.push_back(new uint8_t[block_size]);
+		cur_ = blocks_.back();
+		remaining_ = block_size;
+		padding = (alignment - (reinterpret_cast<size_t>(cur_) & (alignment - 1))) & (alignment - 1);
+	}
+
+	void* ret = cur_ + padding;
+	cur_ += padding + size;
+	remaining_ -= padding + size;
+	return ret;
+}
+
+StringOutputStreamBuf::StringOutputStreamBuf(std::string& str)
+	: str_(str)
+{
+	this->setp(buff_, buff_ + sizeof(buff_) / sizeof(buff_[0]));
+}
+
+StringOutputStreamBuf::~StringOutputStreamBuf()
+{
+	this->sync();
+}
+
+StringOutputStreamBuf::int_type StringOutputStreamBuf::overflow(int_type ch)
+{
+	this->sync();
+	if (!traits_type::eq_int_type(ch, traits_type::eof()))
+	{
+		*this->pptr() = traits_type::to_char_type(ch);
+		this->pbump(1);
+	}
+	return traits_type::not_eof(ch);
+}
+
+std::streamsize StringOutputStreamBuf::xsputn(char_type const * s, std::streamsize count)
+{
+	if (count > this->epptr() - this->pptr())
+	{
+		this->sync();
+		str_.append(s, static_cast<size_t>(count));
+	}
+	else
+	{
+		memcpy(this->pptr(), s, static_cast<size_t>(count));
+		this->pbump(static_cast<int>(count));
+	}
+	return count;
+}
+
+int StringOutputStreamBuf::sync()
+{
+	str_.append(this->pbase(), this->pptr());
+	this->setp(buff_, buff_ + sizeof(buff_) / sizeof(buff_[0]));
+	return 0;
+}
+
 bool ValidFloat(float f)
 {
 	union FNUI
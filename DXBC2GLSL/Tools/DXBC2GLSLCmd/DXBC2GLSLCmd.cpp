@@ -29,9 +29,12 @@
  */
 
 #include <DXBC2GLSL/DXBC2GLSL.hpp>
+#include <KFL/Timer.hpp>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <string>
+#include <vector>
 
 void usage()
 {
@@ -41,9 +44,93 @@ void usage()
 	std::cerr << "Latest version available from http://www.klayge.org/\n";
 	std::cerr << "\n";
 	std::cerr << "Usage: DXBC2GLSLCmd FILE [OUTPUT]\n";
+	std::cerr << "       DXBC2GLSLCmd -b FILE...\n";
+	std::cerr << "\n";
+	std::cerr << "In batch mode, every FILE is converted to FILE.glsl, and the time spent on each one is reported.\n";
 	std::cerr << std::endl;
 }
 
+bool ReadDXBC(char const * file_name, std::vector<char>& data)
+{
+	std::ifstream in(file_name, std::ios_base::in | std::ios_base::binary);
+	if (!in)
+	{
+		return false;
+	}
+
+	in.seekg(0, std::ios_base::end);
+	data.resize(static_cast<size_t>(in.tellg()));
+	in.seekg(0, std::ios_base::beg);
+	if (!data.empty())
+	{
+		in.read(&data[0], data.size());
+	}
+	return !data.empty() && !in.fail();
+}
+
+int BatchConvert(int num_files, char** files)
+{
+	uint32_t num_failed = 0;
+	uint64_t total_dxbc_size = 0;
+	uint64_t total_glsl_size = 0;
+	double total_time = 0;
+
+	std::cout << std::left << std::setw(48) << "File" << std::right
+		<< std::setw(12) << "DXBC" << std::setw(12) << "GLSL" << std::setw(12) << "Time (ms)" << std::endl;
+
+	KlayGE::Timer timer;
+	std::vector<char> data;
+	for (int i = 0; i < num_files; ++ i)
+	{
+		if (!ReadDXBC(files[i], data))
+		{
+			std::cout << std::left << std::setw(48) << files[i] << std::right << "  Can't read the file" << std::endl;
+			++ num_failed;
+			continue;
+		}
+
+		try
+		{
+			timer.restart();
+
+			DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+			dxbc2glsl.FeedDXBC(&data[0], true, GSV_430);
+			std::string const & glsl = dxbc2glsl.GLSLString();
+
+			double const time = timer.elapsed();
+
+			std::ofstream out((std::string(files[i]) + ".glsl").c_str());
+			out << glsl;
+
+			std::cout << std::left << std::setw(48) << files[i] << std::right
+				<< std::setw(12) << data.size() << std::setw(12) << glsl.size()
+				<< std::setw(12) << std::fixed << std::setprecision(3) << time * 1000 << std::endl;
+
+			total_dxbc_size += data.size();
+			total_glsl_size += glsl.size();
+			total_time += time;
+		}
+		catch (std::exception& ex)
+		{
+			std::cout << std::left << std::setw(48) << files[i] << std::right << "  " << ex.what() << std::endl;
+			++ num_failed;
+		}
+	}
+
+	uint32_t const num_converted = num_files - num_failed;
+	std::cout << std::endl;
+	std::cout << num_converted << " converted, " << num_failed << " failed" << std::endl;
+	std::cout << "Total: " << total_dxbc_size << " bytes of DXBC to " << total_glsl_size << " bytes of GLSL in "
+		<< std::fixed << std::setprecision(3) << total_time * 1000 << " ms";
+	if (num_converted > 0)
+	{
+		std::cout << ", " << total_time * 1000 / num_converted << " ms per shader";
+	}
+	std::cout << std::endl;
+
+	return (num_failed > 0) ? 1 : 0;
+}
+
 int main(int argc, char** argv)
 {
 	if (argc < 2)
@@ -52,6 +139,16 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	if (std::string("-b") == argv[1])
+	{
+		if (argc < 3)
+		{
+			usage();
+			return 1;
+		}
+		return BatchConvert(argc - 2, argv + 2);
+	}
+
 	std::vector<char> data;
 	std::ifstream in(argv[1], std::ios_base::in | std::ios_base::binary);
 	std::ofstream out;
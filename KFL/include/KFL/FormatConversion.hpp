@@ -0,0 +1,60 @@
+/**
+ * @file FormatConversion.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_FORMATCONVERSION_HPP
+#define _KFL_FORMATCONVERSION_HPP
+
+#pragma once
+
+#include <KFL/Half.hpp>
+
+namespace KlayGE
+{
+	// Converts arrays between float and the storage formats of textures and vertices, with SIMD kernels picked for the running CPU.
+	// The normalized ones give the same results as the per-element code,
+	// e.g. FloatToUNorm8 is clamp(static_cast<int>(f * 255 + 0.5f), 0, 255).
+
+	// Rounds to nearest even, the same as F16C does
+	void FloatToHalf(half* dst, float const * src, size_t num);
+	void HalfToFloat(float* dst, half const * src, size_t num);
+
+	void FloatToUNorm8(uint8_t* dst, float const * src, size_t num);
+	void UNorm8ToFloat(float* dst, uint8_t const * src, size_t num);
+	void FloatToSNorm8(int8_t* dst, float const * src, size_t num);
+	void SNorm8ToFloat(float* dst, int8_t const * src, size_t num);
+	void FloatToUNorm16(uint16_t* dst, float const * src, size_t num);
+	void UNorm16ToFloat(float* dst, uint16_t const * src, size_t num);
+
+	// Same as MathLib::linear_to_srgb and MathLib::srgb_to_linear on 8-bit values, through lookup tables
+	void LinearToSRGB8(uint8_t* dst, float const * src, size_t num);
+	void SRGB8ToLinear(float* dst, uint8_t const * src, size_t num);
+}
+
+#endif		// _KFL_FORMATCONVERSION_HPP
@@ -33,11 +33,67 @@
 
 #pragma once
 
+#include <KFL/Config.hpp>
+#include <KFL/Types.hpp>
+
+// Messages below this level are compiled out. 0: info, 1: warn, 2: error, 3: none
+#ifndef KLAYGE_LOG_MIN_LEVEL
+	#define KLAYGE_LOG_MIN_LEVEL 0
+#endif
+
 namespace KlayGE
 {
+	enum LogLevel
+	{
+		LL_Info = 0,
+		LL_Warn,
+		LL_Error
+	};
+
+	enum LogCategory
+	{
+		LC_General = 1UL << 0,
+		LC_Render = 1UL << 1,
+		LC_Audio = 1UL << 2,
+		LC_Input = 1UL << 3,
+		LC_Resource = 1UL << 4,
+		LC_Script = 1UL << 5,
+
+		LC_All = 0xFFFFFFFF
+	};
+
+	// Messages are formatted on the calling thread into a lock-free queue, and written out by a background thread.
+	// Errors are written out before the call returns.
+	void LogMessage(LogLevel level, uint32_t category, char const * fmt, ...);
+
+#if KLAYGE_LOG_MIN_LEVEL <= 0
 	void LogInfo(char const * fmt, ...);
+#else
+	inline void LogInfo(char const * /*fmt*/, ...)
+	{
+	}
+#endif
+#if KLAYGE_LOG_MIN_LEVEL <= 1
 	void LogWarn(char const * fmt, ...);
+#else
+	inline void LogWarn(char const * /*fmt*/, ...)
+	{
+	}
+#endif
+#if KLAYGE_LOG_MIN_LEVEL <= 2
 	void LogError(char const * fmt, ...);
+#else
+	inline void LogError(char const * /*fmt*/, ...)
+	{
+	}
+#endif
+
+	// Runtime filtering, on top of KLAYGE_LOG_MIN_LEVEL
+	void SetLogFilter(LogLevel min_level, uint32_t category_mask);
+	// At most max_per_sec messages a second from each format string. 0 means no limit.
+	void SetLogRateLimit(uint32_t max_per_sec);
+	// Blocks until all queued messages are written
+	void LogFlush();
 }
 
 #endif		// _KFL_LOG_HPP
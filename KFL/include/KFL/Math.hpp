@@ -866,6 +866,23 @@ namespace KlayGE
 		template <typename T>
 		std::pair<Quaternion_T<T>, Quaternion_T<T> > sclerp(Quaternion_T<T> const & lhs_real, Quaternion_T<T> const & lhs_dual,
 			Quaternion_T<T> const & rhs_real, Quaternion_T<T> const & rhs_dual, T s);
+
+
+		// Batch
+		///////////////////////////////////////////////////////////////////////////////
+		// Same results as calling the single versions num times, but uses SIMD when it's available.
+		// dst can be the same array as the source.
+		void transform_coord(float3* dst, float3 const * src, size_t num, float4x4 const & mat);
+		void transform_normal(float3* dst, float3 const * src, size_t num, float4x4 const & mat);
+		void transform_aabb(AABBox* dst, AABBox const * src, size_t num, float4x4 const & mat);
+		// Each box with its own matrix, as in the world bounds of a scene hierarchy
+		void transform_aabb(AABBox* dst, AABBox const * src, float4x4 const * mats, size_t num);
+		void mul(float4x4* dst, float4x4 const * lhs, float4x4 const * rhs, size_t num);
+
+		// Linear blending of num unit dual quaternions, as in dual quaternion skinning.
+		// Each one is flipped to the hemisphere of the first before weighting, and the result is normalized.
+		std::pair<Quaternion, Quaternion> udq_blend(Quaternion const * reals, Quaternion const * duals,
+			float const * weights, size_t num);
 	}
 }
 
@@ -512,6 +512,11 @@ namespace KlayGE
 				return threads_;
 			}
 
+			std::vector<thread_id>& busy_threads()
+			{
+				return busy_threads_;
+			}
+
 			size_t num_min_cached_threads() const
 			{
 				return num_min_cached_threads_;
@@ -534,6 +539,7 @@ namespace KlayGE
 			mutex						mut_;
 			bool						general_cleanup_;
 			thread_info_queue_t			threads_;
+			std::vector<thread_id>		busy_threads_;
 			threader					threader_;
 		};
 
@@ -563,6 +569,7 @@ namespace KlayGE
 				th_info = data->threads().front();
 				joiner_impl_base<result_type>::id_ = th_info->get_thread_id();
 				data->threads().erase(data->threads().begin());
+				data->busy_threads().push_back(th_info->get_thread_id());
 				th_info->wake_up(func, thread_pool_join_info_);
 			}
 
@@ -631,6 +638,9 @@ namespace KlayGE
 			data_->num_max_cached_threads(num);
 		}
 
+		// Whether the calling thread is running a function launched from this pool
+		bool in_pool_thread() const;
+
 	private:
 		shared_ptr<thread_pool_common_data_t> data_;
 	};
@@ -29,6 +29,8 @@
  */
 
 #include <KFL/KFL.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
 
 #include <cstdarg>
 #include <cstdio>
@@ -42,74 +44,438 @@
 
 #include <KFL/Log.hpp>
 
-#ifdef KLAYGE_DEBUG
-#ifndef KLAYGE_PLATFORM_ANDROID
 namespace
 {
-	std::ofstream log_file("KlayGE.log");
-}
-#endif
-#endif
+	using namespace KlayGE;
 
-namespace KlayGE
-{
-	void LogInfo(char const * fmt, ...)
+	uint32_t const LOG_QUEUE_SIZE = 512;
+	uint32_t const LOG_MSG_SIZE = 512;
+	uint32_t const RATE_SLOTS = 64;
+
+	// A bounded multi-producer queue. Each slot carries a sequence number telling whether it's free for
+	//  the producer of that position, or filled for the consumer.
+	struct LogSlot
 	{
-		va_list args;
-		va_start(args, fmt);
+		atomic<uint32_t> seq;
+		LogLevel level;
+		char msg[LOG_MSG_SIZE];
+	};
+
+	struct RateSlot
+	{
+		atomic<char const *> fmt;
+		atomic<uint32_t> window;
+		atomic<uint32_t> count;
+	};
+
+	class LogWriter
+	{
+	public:
+		LogWriter()
+			: min_level_(LL_Info), category_mask_(LC_All), rate_limit_(0),
+				head_(0), tail_(0), suppressed_(0), writer_sleeping_(false), num_waiting_(0)
+#if defined(KLAYGE_DEBUG) && !defined(KLAYGE_PLATFORM_ANDROID)
+				, log_file_("KlayGE.log")
+#endif
+		{
+			for (uint32_t i = 0; i < LOG_QUEUE_SIZE; ++ i)
+			{
+				slots_[i].seq = i;
+			}
+			for (uint32_t i = 0; i < RATE_SLOTS; ++ i)
+			{
+				rate_slots_[i].fmt = nullptr;
+				rate_slots_[i].window = 0;
+				rate_slots_[i].count = 0;
+			}
+
+			state_ = WS_Stopped;
+		}
+
+		~LogWriter()
+		{
+			if (WS_Running == state_)
+			{
+				{
+					unique_lock<mutex> lock(wake_mutex_);
+					state_ = WS_Quitting;
+				}
+				wake_cond_.notify_one();
+				space_cond_.notify_all();
+				thread_.join();
+			}
+			state_ = WS_Closed;
+			this->Drain();
+		}
+
+		bool Accept(LogLevel level, uint32_t category, char const * fmt)
+		{
+			// The filters are still zero during static init, before the constructor runs
+			if (WS_Closed == state_)
+			{
+				return true;
+			}
+
+			if ((level < min_level_) || !(category & category_mask_))
+			{
+				return false;
+			}
+
+			uint32_t const limit = rate_limit_;
+			if (limit > 0)
+			{
+				uint32_t const window = static_cast<uint32_t>(timer_.current_time()) + 1;
+				RateSlot& rs = rate_slots_[(reinterpret_cast<size_t>(fmt) >> 3) % RATE_SLOTS];
+				if ((rs.fmt != fmt) || (rs.window != window))
+				{
+					rs.fmt = fmt;
+					rs.window = window;
+					rs.count = 0;
+				}
+				if (++ rs.count > limit)
+				{
+					++ suppressed_;
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void Push(LogLevel level, char const * fmt, va_list args)
+		{
+			uint32_t const state = state_;
+			if (WS_Stopped == state)
+			{
+				this->Start();
+			}
+			else if (WS_Closed == state)
+			{
+				this->WriteNow(level, fmt, args);
+				return;
+			}
+
+			LogSlot* slot;
+			uint32_t pos = head_;
+			for (;;)
+			{
+				slot = &slots_[pos % LOG_QUEUE_SIZE];
+				uint32_t const seq = slot->seq;
+				int32_t const diff = static_cast<int32_t>(seq - pos);
+				if (0 == diff)
+				{
+					if (head_.compare_exchange_weak(pos, pos + 1))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					// Full. Wait for the writer, or write it here if there is no writer.
+					if (state_ != WS_Running)
+					{
+						this->WriteNow(level, fmt, args);
+						return;
+					}
+					this->WaitForSpace(*slot, pos);
+					pos = head_;
+				}
+				else
+				{
+					pos = head_;
+				}
+			}
 
+			slot->level = level;
+			vsnprintf(slot->msg, sizeof(slot->msg), fmt, args);
+			slot->msg[sizeof(slot->msg) - 1] = 0;
+			slot->seq = pos + 1;
+
+			// The writer publishes that it's going to sleep before it checks the queue a last time,
+			// so either it sees this message, or this sees it sleeping. Producers only lock then.
+			if (writer_sleeping_)
+			{
+				unique_lock<mutex> lock(wake_mutex_);
+				wake_cond_.notify_one();
+			}
+
+			// An error may come right before a crash, so it's out before returning
+			if (LL_Error == level)
+			{
+				this->Flush();
+			}
+		}
+
+		void Flush()
+		{
+			uint32_t const target = head_;
+			if (state_ != WS_Running)
+			{
+				this->Drain();
+				return;
+			}
+
+			unique_lock<mutex> lock(wake_mutex_);
+			++ num_waiting_;
+			wake_cond_.notify_one();
+			while ((static_cast<int32_t>(tail_ - target) < 0) && (WS_Running == state_))
+			{
+				space_cond_.wait(lock);
+			}
+			-- num_waiting_;
+		}
+
+		void Filter(LogLevel min_level, uint32_t category_mask)
+		{
+			min_level_ = min_level;
+			category_mask_ = category_mask;
+		}
+
+		void RateLimit(uint32_t max_per_sec)
+		{
+			rate_limit_ = max_per_sec;
+		}
+
+	private:
+		// Zero, before the constructor runs in static initialization, is closed
+		enum WriterState
+		{
+			WS_Closed = 0,
+			WS_Stopped,
+			WS_Starting,
+			WS_Running,
+			WS_Quitting
+		};
+
+		void Start()
+		{
+			uint32_t expected = WS_Stopped;
+			if (state_.compare_exchange_strong(expected, WS_Starting))
+			{
+				thread_ = thread(bind(&LogWriter::Run, this));
+				state_ = WS_Running;
+			}
+		}
+
+		void Run()
+		{
+			while (state_ != WS_Quitting)
+			{
+				if (this->Drain() > 0)
+				{
+					if (num_waiting_ > 0)
+					{
+						unique_lock<mutex> lock(wake_mutex_);
+						space_cond_.notify_all();
+					}
+				}
+				else
+				{
+					unique_lock<mutex> lock(wake_mutex_);
+					writer_sleeping_ = true;
+					while ((state_ != WS_Quitting) && !this->Pending())
+					{
+						wake_cond_.wait(lock);
+					}
+					writer_sleeping_ = false;
+				}
+			}
+		}
+
+		bool Pending() const
+		{
+			uint32_t const pos = tail_;
+			return (slots_[pos % LOG_QUEUE_SIZE].seq == pos + 1) || (suppressed_ > 0);
+		}
+
+		// Producer side, when the queue is full. Registers as waiting before checking the slot again,
+		// so the writer either frees the slot first, or sees the waiter and notifies after draining.
+		void WaitForSpace(LogSlot const & slot, uint32_t pos)
+		{
+			unique_lock<mutex> lock(wake_mutex_);
+			++ num_waiting_;
+			wake_cond_.notify_one();
+			while ((static_cast<int32_t>(slot.seq - pos) < 0) && (WS_Running == state_))
+			{
+				space_cond_.wait(lock);
+			}
+			-- num_waiting_;
+		}
+
+		// Consumer side, only one thread at a time
+		uint32_t Drain()
+		{
+			unique_lock<mutex> lock(output_mutex_);
+
+			uint32_t n = 0;
+			uint32_t pos = tail_;
+			for (;;)
+			{
+				LogSlot& slot = slots_[pos % LOG_QUEUE_SIZE];
+				if (slot.seq != pos + 1)
+				{
+					break;
+				}
+
+				this->Output(slot.level, slot.msg);
+
+				slot.seq = pos + LOG_QUEUE_SIZE;
+				++ pos;
+				tail_ = pos;
+				++ n;
+			}
+
+			uint32_t const suppressed = suppressed_.exchange(0);
+			if (suppressed > 0)
+			{
+				char buffer[64];
+				sprintf(buffer, "%u messages suppressed by the rate limit", suppressed);
+				this->Output(LL_Warn, buffer);
+			}
+
+			return n;
+		}
+
+		// Bypasses the queue and the log file. When closed, the writer is not constructed yet or already destroyed,
+		//  so output_mutex_ can't be used. Logging is single threaded by then, during static init or teardown.
+		void WriteNow(LogLevel level, char const * fmt, va_list args)
+		{
+			char buffer[LOG_MSG_SIZE];
+			vsnprintf(buffer, sizeof(buffer), fmt, args);
+			buffer[sizeof(buffer) - 1] = 0;
+
+			if (WS_Closed == state_)
+			{
+				this->WriteToConsole(level, buffer);
+			}
+			else
+			{
+				unique_lock<mutex> lock(output_mutex_);
+				this->WriteToConsole(level, buffer);
+			}
+		}
+
+		void WriteToConsole(LogLevel level, char const * msg)
+		{
 #ifdef KLAYGE_PLATFORM_ANDROID
-		__android_log_vprint(ANDROID_LOG_INFO, "KlayGE", fmt, args);
+			static int const priorities[] = { ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+			__android_log_write(priorities[level], "KlayGE", msg);
 #else
-		char buffer[1024];
-		vsprintf(buffer, fmt, args);
+			static char const * const prefixes[] = { "(INFO) KlayGE: ", "(WARN) KlayGE: ", "(ERROR) KlayGE: " };
+			std::clog << prefixes[level] << msg << std::endl;
+#endif
+		}
 
-		std::clog << "(INFO) KlayGE: " << buffer << std::endl;
+		void Output(LogLevel level, char const * msg)
+		{
+#ifdef KLAYGE_PLATFORM_ANDROID
+			static int const priorities[] = { ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+			__android_log_write(priorities[level], "KlayGE", msg);
+#else
+			static char const * const prefixes[] = { "(INFO) KlayGE: ", "(WARN) KlayGE: ", "(ERROR) KlayGE: " };
+			std::clog << prefixes[level] << msg << std::endl;
 #ifdef KLAYGE_DEBUG
-		log_file << "(INFO) KlayGE: " << buffer << std::endl;
+			log_file_ << prefixes[level] << msg << std::endl;
 #endif
 #endif
+		}
 
-		va_end(args);
+	private:
+		LogSlot slots_[LOG_QUEUE_SIZE];
+		RateSlot rate_slots_[RATE_SLOTS];
+
+		atomic<LogLevel> min_level_;
+		atomic<uint32_t> category_mask_;
+		atomic<uint32_t> rate_limit_;
+		Timer timer_;
+
+		atomic<uint32_t> head_;
+		atomic<uint32_t> tail_;
+		atomic<uint32_t> suppressed_;
+
+		atomic<uint32_t> state_;
+		thread thread_;
+		mutex output_mutex_;
+
+		// The writer sleeps on wake_cond_ while the queue is empty, and producers of a full queue and
+		//  LogFlush sleep on space_cond_ until it drains.
+		mutex wake_mutex_;
+		condition_variable wake_cond_;
+		condition_variable space_cond_;
+		atomic<bool> writer_sleeping_;
+		atomic<uint32_t> num_waiting_;
+
+#if defined(KLAYGE_DEBUG) && !defined(KLAYGE_PLATFORM_ANDROID)
+		std::ofstream log_file_;
+#endif
+	};
+
+	LogWriter log_writer;
+
+	void VLog(LogLevel level, uint32_t category, char const * fmt, va_list args)
+	{
+		if (log_writer.Accept(level, category, fmt))
+		{
+			log_writer.Push(level, fmt, args);
+		}
 	}
+}
 
-	void LogWarn(char const * fmt, ...)
+namespace KlayGE
+{
+	void LogMessage(LogLevel level, uint32_t category, char const * fmt, ...)
+	{
+		if (static_cast<int>(level) >= KLAYGE_LOG_MIN_LEVEL)
+		{
+			va_list args;
+			va_start(args, fmt);
+			VLog(level, category, fmt, args);
+			va_end(args);
+		}
+	}
+
+#if KLAYGE_LOG_MIN_LEVEL <= 0
+	void LogInfo(char const * fmt, ...)
 	{
 		va_list args;
 		va_start(args, fmt);
-
-#ifdef KLAYGE_PLATFORM_ANDROID
-		__android_log_vprint(ANDROID_LOG_WARN, "KlayGE", fmt, args);
-#else
-		char buffer[1024];
-		vsprintf(buffer, fmt, args);
-
-		std::clog << "(WARN) KlayGE: " << buffer << std::endl;
-#ifdef KLAYGE_DEBUG
-		log_file << "(WARN) KlayGE: " << buffer << std::endl;
-#endif
+		VLog(LL_Info, LC_General, fmt, args);
+		va_end(args);
+	}
 #endif
 
+#if KLAYGE_LOG_MIN_LEVEL <= 1
+	void LogWarn(char const * fmt, ...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		VLog(LL_Warn, LC_General, fmt, args);
 		va_end(args);
 	}
+#endif
 
+#if KLAYGE_LOG_MIN_LEVEL <= 2
 	void LogError(char const * fmt, ...)
 	{
 		va_list args;
 		va_start(args, fmt);
+		VLog(LL_Error, LC_General, fmt, args);
+		va_end(args);
+	}
+#endif
 
-#ifdef KLAYGE_PLATFORM_ANDROID
-		__android_log_vprint(ANDROID_LOG_ERROR, "KlayGE", fmt, args);
-#else
-		char buffer[1024];
-		vsprintf(buffer, fmt, args);
+	void SetLogFilter(LogLevel min_level, uint32_t category_mask)
+	{
+		log_writer.Filter(min_level, category_mask);
+	}
 
-		std::clog << "(ERROR) KlayGE: " << buffer << std::endl;
-#ifdef KLAYGE_DEBUG
-		log_file << "(ERROR) KlayGE: " << buffer << std::endl;
-#endif
-#endif
+	void SetLogRateLimit(uint32_t max_per_sec)
+	{
+		log_writer.RateLimit(max_per_sec);
+	}
 
-		va_end(args);
+	void LogFlush()
+	{
+		log_writer.Flush();
 	}
 }
@@ -0,0 +1,157 @@
+/**
+ * @file MappedFile.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+
+#include <limits>
+
+#ifdef KLAYGE_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <KFL/MappedFile.hpp>
+
+namespace KlayGE
+{
+	MappedFile::MappedFile()
+		: data_(nullptr), size_(0),
+			file_handle_(nullptr), mapping_handle_(nullptr)
+	{
+	}
+
+	MappedFile::~MappedFile()
+	{
+		this->Unmap();
+	}
+
+	bool MappedFile::Map(std::string const & file_name)
+	{
+		this->Unmap();
+
+#ifdef KLAYGE_PLATFORM_WINDOWS
+#ifdef KLAYGE_PLATFORM_WINDOWS_DESKTOP
+		HANDLE file = ::CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (INVALID_HANDLE_VALUE == file)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER file_size;
+		if (!::GetFileSizeEx(file, &file_size) || (0 == file_size.QuadPart)
+			|| (static_cast<uint64_t>(file_size.QuadPart) > std::numeric_limits<size_t>::max()))
+		{
+			::CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (nullptr == mapping)
+		{
+			::CloseHandle(file);
+			return false;
+		}
+
+		void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (nullptr == data)
+		{
+			::CloseHandle(mapping);
+			::CloseHandle(file);
+			return false;
+		}
+
+		file_handle_ = file;
+		mapping_handle_ = mapping;
+		data_ = static_cast<uint8_t const *>(data);
+		size_ = static_cast<uint64_t>(file_size.QuadPart);
+
+		return true;
+#else
+		// Store apps only get at their files through streams
+		UNREF_PARAM(file_name);
+		return false;
+#endif
+#else
+		int fd = ::open(file_name.c_str(), O_RDONLY);
+		if (-1 == fd)
+		{
+			return false;
+		}
+
+		struct stat file_stat;
+		// A file larger than the address space, e.g. 4GB or more on a 32-bit target, can't be mapped whole.
+		// Returning false sends the callers to stream I/O instead of a truncated mapping.
+		if ((::fstat(fd, &file_stat) != 0) || (0 == file_stat.st_size)
+			|| (static_cast<uint64_t>(file_stat.st_size) > std::numeric_limits<size_t>::max()))
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* data = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		// The mapping holds its own reference to the file
+		::close(fd);
+		if (MAP_FAILED == data)
+		{
+			return false;
+		}
+
+		data_ = static_cast<uint8_t const *>(data);
+		size_ = static_cast<uint64_t>(file_stat.st_size);
+
+		return true;
+#endif
+	}
+
+	void MappedFile::Unmap()
+	{
+		if (data_)
+		{
+#ifdef KLAYGE_PLATFORM_WINDOWS
+			::UnmapViewOfFile(data_);
+			::CloseHandle(static_cast<HANDLE>(mapping_handle_));
+			::CloseHandle(static_cast<HANDLE>(file_handle_));
+#else
+			::munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+#endif
+
+			data_ = nullptr;
+			size_ = 0;
+			file_handle_ = nullptr;
+			mapping_handle_ = nullptr;
+		}
+	}
+}
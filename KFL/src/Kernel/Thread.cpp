@@ -32,6 +32,8 @@
 
 #include <KFL/Thread.hpp>
 
+#include <algorithm>
+
 namespace KlayGE
 {
 	thread_pool::thread_pool_join_info::thread_pool_join_info()
@@ -129,6 +131,19 @@ namespace KlayGE
 			// Execute requested functor
 			info_->func_();
 
+			{
+				shared_ptr<thread_pool_common_data_t> data = info_->data_.lock();
+				if (data)
+				{
+					unique_lock<mutex> lock(data->mut_);
+					KLAYGE_AUTO(iter, std::find(data->busy_threads_.begin(), data->busy_threads_.end(), info_->get_thread_id()));
+					if (iter != data->busy_threads_.end())
+					{
+						data->busy_threads_.erase(iter);
+					}
+				}
+			}
+
 			// Reset execution functor
 			info_->func_ = function<void()>();
 
@@ -248,4 +263,11 @@ namespace KlayGE
 	{
 		data_->kill_all();
 	}
+
+	bool thread_pool::in_pool_thread() const
+	{
+		unique_lock<mutex> lock(data_->mut());
+		std::vector<thread_id> const & busy = data_->busy_threads();
+		return std::find(busy.begin(), busy.end(), threadof(0)) != busy.end();
+	}
 }
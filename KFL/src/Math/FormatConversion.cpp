@@ -0,0 +1,569 @@
+/**
+ * @file FormatConversion.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/CpuInfo.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef KLAYGE_SSE2_SUPPORT
+	#include <emmintrin.h>
+
+	// F16C kernels are compiled for their own target, and only called if the CPU has F16C
+	#if defined(KLAYGE_COMPILER_MSVC)
+		#define KLAYGE_F16C_KERNEL
+		#define KLAYGE_TARGET_F16C
+	#elif (defined(KLAYGE_COMPILER_GCC) && (KLAYGE_COMPILER_VERSION >= 49)) || defined(__F16C__)
+		#define KLAYGE_F16C_KERNEL
+		#define KLAYGE_TARGET_F16C __attribute__((target("avx,f16c")))
+	#endif
+	#ifdef KLAYGE_F16C_KERNEL
+		#include <immintrin.h>
+	#endif
+#endif
+
+#include <KFL/FormatConversion.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t FloatBits(float f)
+	{
+		uint32_t u;
+		std::memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	float BitsFloat(uint32_t u)
+	{
+		float f;
+		std::memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	// Round to nearest even. Only uses normalized float math, so it isn't affected by flush-to-zero modes.
+	uint16_t FloatToHalfScalar(float f)
+	{
+		uint32_t const F32_INF = 255UL << 23;
+		uint32_t const F16_MAX = (127UL + 16) << 23;
+		uint32_t const DENORM_MAGIC = ((127UL - 15) + (23 - 10) + 1) << 23;
+
+		uint32_t u = FloatBits(f);
+		uint32_t const sign = u & 0x80000000UL;
+		u ^= sign;
+
+		uint32_t ret;
+		if (u >= F16_MAX)
+		{
+			// Inf or NaN
+			ret = (u > F32_INF) ? 0x7E00 : 0x7C00;
+		}
+		else if (u < (113UL << 23))
+		{
+			// Denormalized or zero. Adding the magic number lines up the 10 mantissa bits at the bottom.
+			ret = FloatBits(BitsFloat(u) + BitsFloat(DENORM_MAGIC)) - DENORM_MAGIC;
+		}
+		else
+		{
+			uint32_t const mant_odd = (u >> 13) & 1;
+			u += ((15UL - 127) << 23) + 0xFFF;
+			u += mant_odd;
+			ret = u >> 13;
+		}
+
+		return static_cast<uint16_t>(ret | (sign >> 16));
+	}
+
+	float HalfToFloatScalar(uint16_t h)
+	{
+		uint32_t const SHIFTED_EXP = 0x7C00UL << 13;
+
+		uint32_t u = (h & 0x7FFFUL) << 13;
+		uint32_t const exp = SHIFTED_EXP & u;
+		u += (127UL - 15) << 23;
+		if (SHIFTED_EXP == exp)
+		{
+			// Inf or NaN
+			u += (128UL - 16) << 23;
+		}
+		else if (0 == exp)
+		{
+			// Denormalized or zero, renormalize it
+			u += 1UL << 23;
+			u = FloatBits(BitsFloat(u) - BitsFloat(113UL << 23));
+		}
+
+		return BitsFloat(u | ((h & 0x8000UL) << 16));
+	}
+
+	void FloatToHalfCPU(uint16_t* dst, float const * src, size_t num, size_t begin)
+	{
+		for (size_t i = begin; i < num; ++ i)
+		{
+			dst[i] = FloatToHalfScalar(src[i]);
+		}
+	}
+
+	void HalfToFloatCPU(float* dst, uint16_t const * src, size_t num, size_t begin)
+	{
+		for (size_t i = begin; i < num; ++ i)
+		{
+			dst[i] = HalfToFloatScalar(src[i]);
+		}
+	}
+
+#ifdef KLAYGE_SSE2_SUPPORT
+	__m128i Select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	// The same steps as FloatToHalfScalar, 4 at a time. The results are sign extended 16-bit values, ready for _mm_packs_epi32.
+	__m128i FloatToHalf4SSE2(__m128 f)
+	{
+		__m128i const sign_mask = _mm_set1_epi32(static_cast<int>(0x80000000U));
+		__m128i const f32_inf = _mm_set1_epi32(255 << 23);
+		__m128i const f16_max_minus_one = _mm_set1_epi32(((127 + 16) << 23) - 1);
+		__m128i const denorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		__m128i const min_normal = _mm_set1_epi32(113 << 23);
+		// ((15 - 127) << 23) + 0xFFF, written as its bit pattern. Shifting the negative value is undefined.
+		__m128i const bias = _mm_set1_epi32(static_cast<int>(0xC8000FFFU));
+		__m128i const one = _mm_set1_epi32(1);
+
+		__m128i u = _mm_castps_si128(f);
+		__m128i const sign = _mm_and_si128(u, sign_mask);
+		u = _mm_xor_si128(u, sign);
+
+		// Signed compares are fine, the sign bits are cleared
+		__m128i const inf_nan_mask = _mm_cmpgt_epi32(u, f16_max_minus_one);
+		__m128i const nan_mask = _mm_cmpgt_epi32(u, f32_inf);
+		__m128i const inf_nan = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(nan_mask, _mm_set1_epi32(0x0200)));
+
+		__m128i const denorm_mask = _mm_cmplt_epi32(u, min_normal);
+		__m128i const denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(u), _mm_castsi128_ps(denorm_magic))),
+			denorm_magic);
+
+		__m128i const mant_odd = _mm_and_si128(_mm_srli_epi32(u, 13), one);
+		__m128i const normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(u, bias), mant_odd), 13);
+
+		__m128i ret = Select(denorm_mask, denorm, normal);
+		ret = Select(inf_nan_mask, inf_nan, ret);
+		ret = _mm_or_si128(ret, _mm_srli_epi32(sign, 16));
+		return _mm_srai_epi32(_mm_slli_epi32(ret, 16), 16);
+	}
+
+	// h holds one half in the low 16 bits of each lane
+	__m128 HalfToFloat4SSE2(__m128i h)
+	{
+		__m128i const shifted_exp = _mm_set1_epi32(0x7C00 << 13);
+		__m128 const magic = _mm_castsi128_ps(_mm_set1_epi32(113 << 23));
+
+		__m128i u = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+		__m128i const exp = _mm_and_si128(u, shifted_exp);
+		u = _mm_add_epi32(u, _mm_set1_epi32((127 - 15) << 23));
+
+		__m128i const inf_nan_mask = _mm_cmpeq_epi32(exp, shifted_exp);
+		__m128i const denorm_mask = _mm_cmpeq_epi32(exp, _mm_setzero_si128());
+
+		__m128i const inf_nan = _mm_add_epi32(u, _mm_set1_epi32((128 - 16) << 23));
+		__m128i const denorm = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(u, _mm_set1_epi32(1 << 23))), magic));
+
+		u = Select(inf_nan_mask, inf_nan, u);
+		u = Select(denorm_mask, denorm, u);
+		u = _mm_or_si128(u, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+		return _mm_castsi128_ps(u);
+	}
+
+	void FloatToHalfSSE2(uint16_t* dst, float const * src, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
+		{
+			__m128i const lo = FloatToHalf4SSE2(_mm_loadu_ps(src + i + 0));
+			__m128i const hi = FloatToHalf4SSE2(_mm_loadu_ps(src + i + 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+		}
+		FloatToHalfCPU(dst, src, num, i);
+	}
+
+	void HalfToFloatSSE2(float* dst, uint16_t const * src, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
+		{
+			__m128i const h = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			_mm_storeu_ps(dst + i + 0, HalfToFloat4SSE2(_mm_unpacklo_epi16(h, _mm_setzero_si128())));
+			_mm_storeu_ps(dst + i + 4, HalfToFloat4SSE2(_mm_unpackhi_epi16(h, _mm_setzero_si128())));
+		}
+		HalfToFloatCPU(dst, src, num, i);
+	}
+
+	// Converts floats to ints with the same clamping and rounding as clamp(static_cast<int>(f * scale + 0.5f), min_v, max_v).
+	// Clamping before truncating gives the same result, and keeps the conversion in range.
+	__m128i FloatToNorm4SSE2(__m128 f, __m128 scale, __m128 min_v, __m128 max_v)
+	{
+		f = _mm_add_ps(_mm_mul_ps(f, scale), _mm_set1_ps(0.5f));
+		f = _mm_min_ps(_mm_max_ps(f, min_v), max_v);
+		return _mm_cvttps_epi32(f);
+	}
+#endif
+
+#ifdef KLAYGE_F16C_KERNEL
+	KLAYGE_TARGET_F16C void FloatToHalfF16C(uint16_t* dst, float const * src, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), 0));
+		}
+		_mm256_zeroupper();
+		FloatToHalfCPU(dst, src, num, i);
+	}
+
+	KLAYGE_TARGET_F16C void HalfToFloatF16C(float* dst, uint16_t const * src, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
+		{
+			_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i))));
+		}
+		_mm256_zeroupper();
+		HalfToFloatCPU(dst, src, num, i);
+	}
+#endif
+
+#ifndef KLAYGE_SSE2_SUPPORT
+	void FloatToHalfGeneric(uint16_t* dst, float const * src, size_t num)
+	{
+		FloatToHalfCPU(dst, src, num, 0);
+	}
+
+	void HalfToFloatGeneric(float* dst, uint16_t const * src, size_t num)
+	{
+		HalfToFloatCPU(dst, src, num, 0);
+	}
+#endif
+
+	class HalfKernels
+	{
+	public:
+		typedef void (*FloatToHalfFunc)(uint16_t* dst, float const * src, size_t num);
+		typedef void (*HalfToFloatFunc)(float* dst, uint16_t const * src, size_t num);
+
+	public:
+		static HalfKernels const & Instance()
+		{
+			static HalfKernels kernels;
+			return kernels;
+		}
+
+		FloatToHalfFunc float_to_half;
+		HalfToFloatFunc half_to_float;
+
+	private:
+		HalfKernels()
+		{
+#if defined(KLAYGE_F16C_KERNEL)
+			CPUInfo cpu;
+			if (cpu.IsFeatureSupport(CPUInfo::CF_AVX) && cpu.IsFeatureSupport(CPUInfo::CF_F16C))
+			{
+				float_to_half = FloatToHalfF16C;
+				half_to_float = HalfToFloatF16C;
+			}
+			else
+			{
+				float_to_half = FloatToHalfSSE2;
+				half_to_float = HalfToFloatSSE2;
+			}
+#elif defined(KLAYGE_SSE2_SUPPORT)
+			float_to_half = FloatToHalfSSE2;
+			half_to_float = HalfToFloatSSE2;
+#else
+			float_to_half = FloatToHalfGeneric;
+			half_to_float = HalfToFloatGeneric;
+#endif
+		}
+	};
+
+	// linear_to_srgb is a pow per value. Instead, find the smallest float that encodes to each 8-bit value once,
+	// and look up a bucket of floats by its exponent and high mantissa bits. A bucket is much smaller than the
+	// distance between two thresholds, so it's at most one step from the right value.
+	class SRGBTables
+	{
+		static uint32_t const MIN_BITS = 114UL << 23;	// 2^-13, everything smaller encodes to 0
+		static uint32_t const BUCKET_SHIFT = 15;
+		static uint32_t const NUM_BUCKETS = ((127UL << 23) - MIN_BITS) >> BUCKET_SHIFT;
+
+	public:
+		static SRGBTables const & Instance()
+		{
+			static SRGBTables tables;
+			return tables;
+		}
+
+		uint8_t Encode(float linear) const
+		{
+			if (!(linear >= BitsFloat(MIN_BITS)))
+			{
+				return 0;
+			}
+			if (linear >= 1)
+			{
+				return 255;
+			}
+
+			uint32_t ret = bucket_lut_[(FloatBits(linear) - MIN_BITS) >> BUCKET_SHIFT];
+			while ((ret < 255) && (linear >= thresholds_[ret + 1]))
+			{
+				++ ret;
+			}
+			return static_cast<uint8_t>(ret);
+		}
+
+		float Decode(uint8_t srgb) const
+		{
+			return decode_lut_[srgb];
+		}
+
+	private:
+		SRGBTables()
+		{
+			for (uint32_t i = 0; i < 256; ++ i)
+			{
+				decode_lut_[i] = MathLib::srgb_to_linear(i / 255.0f);
+			}
+
+			// Binary search on the bits of positive floats, which are ordered the same as the floats
+			thresholds_[0] = 0;
+			for (uint32_t k = 1; k < 256; ++ k)
+			{
+				uint32_t lo = 0;
+				uint32_t hi = FloatBits(1.0f);
+				while (lo < hi)
+				{
+					uint32_t const mid = lo + (hi - lo) / 2;
+					if (EncodeCPU(BitsFloat(mid)) >= k)
+					{
+						hi = mid;
+					}
+					else
+					{
+						lo = mid + 1;
+					}
+				}
+				thresholds_[k] = BitsFloat(lo);
+			}
+
+			for (uint32_t i = 0; i < NUM_BUCKETS; ++ i)
+			{
+				float const bucket_start = BitsFloat(MIN_BITS + (i << BUCKET_SHIFT));
+				bucket_lut_[i] = static_cast<uint8_t>(std::upper_bound(thresholds_, thresholds_ + 256, bucket_start) - thresholds_ - 1);
+			}
+		}
+
+		static uint32_t EncodeCPU(float linear)
+		{
+			return MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(linear) * 255.0f + 0.5f), 0, 255);
+		}
+
+	private:
+		float decode_lut_[256];
+		float thresholds_[256];
+		uint8_t bucket_lut_[NUM_BUCKETS];
+	};
+}
+
+namespace KlayGE
+{
+	void FloatToHalf(half* dst, float const * src, size_t num)
+	{
+		HalfKernels::Instance().float_to_half(reinterpret_cast<uint16_t*>(dst), src, num);
+	}
+
+	void HalfToFloat(float* dst, half const * src, size_t num)
+	{
+		HalfKernels::Instance().half_to_float(dst, reinterpret_cast<uint16_t const *>(src), num);
+	}
+
+	void FloatToUNorm8(uint8_t* dst, float const * src, size_t num)
+	{
+		size_t i = 0;
+#ifdef KLAYGE_SSE2_SUPPORT
+		__m128 const scale = _mm_set1_ps(255.0f);
+		__m128 const min_v = _mm_setzero_ps();
+		__m128 const max_v = _mm_set1_ps(255.0f);
+		for (; i + 16 <= num; i += 16)
+		{
+			__m128i const a = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 0), scale, min_v, max_v);
+			__m128i const b = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 4), scale, min_v, max_v);
+			__m128i const c = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 8), scale, min_v, max_v);
+			__m128i const d = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 12), scale, min_v, max_v);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+				_mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+		}
+#endif
+		for (; i < num; ++ i)
+		{
+			dst[i] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(src[i] * 255.0f + 0.5f), 0, 255));
+		}
+	}
+
+	void UNorm8ToFloat(float* dst, uint8_t const * src, size_t num)
+	{
+		size_t i = 0;
+#ifdef KLAYGE_SSE2_SUPPORT
+		__m128 const scale = _mm_set1_ps(255.0f);
+		__m128i const zero = _mm_setzero_si128();
+		for (; i + 16 <= num; i += 16)
+		{
+			__m128i const v8 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			__m128i const lo16 = _mm_unpacklo_epi8(v8, zero);
+			__m128i const hi16 = _mm_unpackhi_epi8(v8, zero);
+			_mm_storeu_ps(dst + i + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo16, zero)), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo16, zero)), scale));
+			_mm_storeu_ps(dst + i + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi16, zero)), scale));
+			_mm_storeu_ps(dst + i + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi16, zero)), scale));
+		}
+#endif
+		for (; i < num; ++ i)
+		{
+			dst[i] = src[i] / 255.0f;
+		}
+	}
+
+	void FloatToSNorm8(int8_t* dst, float const * src, size_t num)
+	{
+		size_t i = 0;
+#ifdef KLAYGE_SSE2_SUPPORT
+		__m128 const scale = _mm_set1_ps(127.0f);
+		__m128 const min_v = _mm_set1_ps(-127.0f);
+		__m128 const max_v = _mm_set1_ps(127.0f);
+		for (; i + 16 <= num; i += 16)
+		{
+			__m128i const a = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 0), scale, min_v, max_v);
+			__m128i const b = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 4), scale, min_v, max_v);
+			__m128i const c = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 8), scale, min_v, max_v);
+			__m128i const d = FloatToNorm4SSE2(_mm_loadu_ps(src + i + 12), scale, min_v, max_v);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+				_mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+		}
+#endif
+		for (; i < num; ++ i)
+		{
+			dst[i] = static_cast<int8_t>(MathLib::clamp(static_cast<int>(src[i] * 127.0f + 0.5f), -127, 127));
+		}
+	}
+
+	void SNorm8ToFloat(float* dst, int8_t const * src, size_t num)
+	{
+		size_t i = 0;
+#ifdef KLAYGE_SSE2_SUPPORT
+		__m128 const scale = _mm_set1_ps(127.0f);
+		for (; i + 16 <= num; i += 16)
+		{
+			__m128i const v8 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			// Sign extends by putting the values in the high parts, and shifting them down
+			__m128i const lo16 = _mm_srai_epi16(_mm_unpacklo_epi8(v8, v8), 8);
+			__m128i const hi16 = _mm_srai_epi16(_mm_unpackhi_epi8(v8, v8), 8);
+			_mm_storeu_ps(dst + i + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo16, lo16), 16)), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo16, lo16), 16)), scale));
+			_mm_storeu_ps(dst + i + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi16, hi16), 16)), scale));
+			_mm_storeu_ps(dst + i + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi16, hi16), 16)), scale));
+		}
+#endif
+		for (; i < num; ++ i)
+		{
+			dst[i] = src[i] / 127.0f;
+		}
+	}
+
+	void FloatToUNorm16(uint16_t* dst, float const * src, size_t num)
+	{
+		size_t i = 0;
+#ifdef KLAYGE_SSE2_SUPPORT
+		__m128 const scale = _mm_set1_ps(65535.0f);
+		__m128 const min_v = _mm_setzero_ps();
+		__m128 const max_v = _mm_set1_ps(65535.0f);
+		__m128i const bias = _mm_set1_epi32(32768);
+		__m128i const bias16 = _mm_set1_epi16(-32768);
+		for (; i + 8 <= num; i += 8)
+		{
+			// SSE2 only has a signed saturating pack, so move the values to the signed range and back
+			__m128i const a = _mm_sub_epi32(FloatToNorm4SSE2(_mm_loadu_ps(src + i + 0), scale, min_v, max_v), bias);
+			__m128i const b = _mm_sub_epi32(FloatToNorm4SSE2(_mm_loadu_ps(src + i + 4), scale, min_v, max_v), bias);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(_mm_packs_epi32(a, b), bias16));
+		}
+#endif
+		for (; i < num; ++ i)
+		{
+			dst[i] = static_cast<uint16_t>(MathLib::clamp(static_cast<int>(src[i] * 65535.0f + 0.5f), 0, 65535));
+		}
+	}
+
+	void UNorm16ToFloat(float* dst, uint16_t const * src, size_t num)
+	{
+		size_t i = 0;
+#ifdef KLAYGE_SSE2_SUPPORT
+		__m128 const scale = _mm_set1_ps(65535.0f);
+		__m128i const zero = _mm_setzero_si128();
+		for (; i + 8 <= num; i += 8)
+		{
+			__m128i const v16 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			_mm_storeu_ps(dst + i + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v16, zero)), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v16, zero)), scale));
+		}
+#endif
+		for (; i < num; ++ i)
+		{
+			dst[i] = src[i] / 65535.0f;
+		}
+	}
+
+	void LinearToSRGB8(uint8_t* dst, float const * src, size_t num)
+	{
+		SRGBTables const & tables = SRGBTables::Instance();
+		for (size_t i = 0; i < num; ++ i)
+		{
+			dst[i] = tables.Encode(src[i]);
+		}
+	}
+
+	void SRGB8ToLinear(float* dst, uint8_t const * src, size_t num)
+	{
+		SRGBTables const & tables = SRGBTables::Instance();
+		for (size_t i = 0; i < num; ++ i)
+		{
+			dst[i] = tables.Decode(src[i]);
+		}
+	}
+}
@@ -112,22 +112,25 @@ namespace KlayGE
 
 				e += 1;
 				m &= ~0x00000400;
+
+				e += 127 - 15;
 			}
+			// else Zero -- keep the exponent 0
 		}
 		else
 		{
 			if (31 == e)
 			{
-				if (m != 0)
-				{
-					// Nan -- preserve sign and significand bits
-					e = 0xFF - (127 - 15);
-				}
+				// Inf or Nan -- preserve sign and significand bits
+				e = 0xFF;
+			}
+			else
+			{
+				// Normalized number
+				e += 127 - 15;
 			}
 		}
 
-		// Normalized number
-		e += 127 - 15;
 		m <<= 13;
 
 		ret = s | (e << 23) | m;
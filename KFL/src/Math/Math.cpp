@@ -33,6 +33,10 @@
 
 #include <KFL/Math.hpp>
 
+#ifdef KLAYGE_SSE_SUPPORT
+	#include <xmmintrin.h>
+#endif
+
 namespace KlayGE
 {
 	namespace MathLib
@@ -2302,11 +2306,20 @@ namespace KlayGE
 		template <typename T>
 		AABBox_T<T> transform_aabb(AABBox_T<T> const & aabb, Matrix4_T<T> const & mat)
 		{
-			Vector_T<T, 3> scale, trans;
-			Quaternion_T<T> rot;
-			decompose(scale, rot, trans, mat);
+			// Transforms the center, and projects the half size onto each axis, instead of transforming 8 corners.
+			// Gives the same box for affine matrices.
+			Vector_T<T, 3> const center = aabb.Center();
+			Vector_T<T, 3> const half_size = aabb.HalfSize();
 
-			return transform_aabb(aabb, scale, rot, trans);
+			Vector_T<T, 3> new_center, new_half_size;
+			for (int i = 0; i < 3; ++ i)
+			{
+				new_center[i] = center.x() * mat(0, i) + center.y() * mat(1, i) + center.z() * mat(2, i) + mat(3, i);
+				new_half_size[i] = half_size.x() * abs(mat(0, i)) + half_size.y() * abs(mat(1, i))
+					+ half_size.z() * abs(mat(2, i));
+			}
+
+			return AABBox_T<T>(new_center - new_half_size, new_center + new_half_size);
 		}
 
 		template AABBox transform_aabb(AABBox const & aabb, float3 const & scale, Quaternion const & rot, float3 const & trans);
@@ -3257,5 +3270,270 @@ namespace KlayGE
 
 			return dif_dq;
 		}
+
+
+		// Batch
+		///////////////////////////////////////////////////////////////////////////////
+#ifdef KLAYGE_SSE_SUPPORT
+		namespace
+		{
+			// Column c of the matrix, each element broadcast, for SoA
+			void BroadcastColumns(__m128* cols, float4x4 const & mat)
+			{
+				for (int c = 0; c < 4; ++ c)
+				{
+					for (int r = 0; r < 4; ++ r)
+					{
+						cols[c * 4 + r] = _mm_set1_ps(mat(r, c));
+					}
+				}
+			}
+
+			__m128 Dot3SoA(__m128 x, __m128 y, __m128 z, __m128 const * col)
+			{
+				return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, col[0]), _mm_mul_ps(y, col[1])), _mm_mul_ps(z, col[2]));
+			}
+
+			// The 4 float3s at src, each in a register, with garbage in w. Reads one float past the last one.
+			void LoadFloat3SoA(__m128& x, __m128& y, __m128& z, float3 const * src)
+			{
+				x = _mm_loadu_ps(&src[0].x());
+				y = _mm_loadu_ps(&src[1].x());
+				z = _mm_loadu_ps(&src[2].x());
+				__m128 w = _mm_loadu_ps(&src[3].x());
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+			}
+
+			void StoreFloat3SoA(float3* dst, __m128 x, __m128 y, __m128 z)
+			{
+				__m128 w = _mm_setzero_ps();
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+				// Each store spills into the next float3, which is written after it
+				_mm_storeu_ps(&dst[0].x(), x);
+				_mm_storeu_ps(&dst[1].x(), y);
+				_mm_storeu_ps(&dst[2].x(), z);
+				_mm_storel_pi(reinterpret_cast<__m64*>(&dst[3].x()), w);
+				_mm_store_ss(&dst[3].z(), _mm_movehl_ps(w, w));
+			}
+		}
+#endif
+
+		void transform_coord(float3* dst, float3 const * src, size_t num, float4x4 const & mat)
+		{
+			size_t i = 0;
+
+#ifdef KLAYGE_SSE_SUPPORT
+			KLAYGE_STATIC_ASSERT(sizeof(float3) == 3 * sizeof(float));
+
+			__m128 cols[16];
+			BroadcastColumns(cols, mat);
+			__m128 const sign_mask = _mm_set1_ps(-0.0f);
+			__m128 const epsilon = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+
+			// The last point goes to the scalar loop, since its 4-float load would be out of the array
+			for (; i + 4 < num; i += 4)
+			{
+				__m128 x, y, z;
+				LoadFloat3SoA(x, y, z, src + i);
+
+				__m128 const rx = _mm_add_ps(Dot3SoA(x, y, z, &cols[0]), cols[3]);
+				__m128 const ry = _mm_add_ps(Dot3SoA(x, y, z, &cols[4]), cols[7]);
+				__m128 const rz = _mm_add_ps(Dot3SoA(x, y, z, &cols[8]), cols[11]);
+				__m128 const rw = _mm_add_ps(Dot3SoA(x, y, z, &cols[12]), cols[15]);
+
+				// Zero where equal(w, 0)
+				__m128 const valid = _mm_cmpgt_ps(_mm_andnot_ps(sign_mask, rw), epsilon);
+				StoreFloat3SoA(dst + i, _mm_and_ps(_mm_div_ps(rx, rw), valid), _mm_and_ps(_mm_div_ps(ry, rw), valid),
+					_mm_and_ps(_mm_div_ps(rz, rw), valid));
+			}
+#endif
+
+			for (; i < num; ++ i)
+			{
+				dst[i] = transform_coord(src[i], mat);
+			}
+		}
+
+		void transform_normal(float3* dst, float3 const * src, size_t num, float4x4 const & mat)
+		{
+			size_t i = 0;
+
+#ifdef KLAYGE_SSE_SUPPORT
+			__m128 cols[16];
+			BroadcastColumns(cols, mat);
+
+			for (; i + 4 < num; i += 4)
+			{
+				__m128 x, y, z;
+				LoadFloat3SoA(x, y, z, src + i);
+				StoreFloat3SoA(dst + i, Dot3SoA(x, y, z, &cols[0]), Dot3SoA(x, y, z, &cols[4]), Dot3SoA(x, y, z, &cols[8]));
+			}
+#endif
+
+			for (; i < num; ++ i)
+			{
+				dst[i] = transform_normal(src[i], mat);
+			}
+		}
+
+		void transform_aabb(AABBox* dst, AABBox const * src, size_t num, float4x4 const & mat)
+		{
+			size_t i = 0;
+
+#ifdef KLAYGE_SSE_SUPPORT
+			__m128 cols[16];
+			BroadcastColumns(cols, mat);
+			__m128 abs_cols[16];
+			__m128 const sign_mask = _mm_set1_ps(-0.0f);
+			for (int j = 0; j < 16; ++ j)
+			{
+				abs_cols[j] = _mm_andnot_ps(sign_mask, cols[j]);
+			}
+			__m128 const half = _mm_set1_ps(0.5f);
+
+			// 4 boxes at a time, the same center and half size projection as the single version
+			for (; i + 4 <= num; i += 4)
+			{
+				AABBox const * s = src + i;
+				__m128 const min_x = _mm_setr_ps(s[0].Min().x(), s[1].Min().x(), s[2].Min().x(), s[3].Min().x());
+				__m128 const min_y = _mm_setr_ps(s[0].Min().y(), s[1].Min().y(), s[2].Min().y(), s[3].Min().y());
+				__m128 const min_z = _mm_setr_ps(s[0].Min().z(), s[1].Min().z(), s[2].Min().z(), s[3].Min().z());
+				__m128 const max_x = _mm_setr_ps(s[0].Max().x(), s[1].Max().x(), s[2].Max().x(), s[3].Max().x());
+				__m128 const max_y = _mm_setr_ps(s[0].Max().y(), s[1].Max().y(), s[2].Max().y(), s[3].Max().y());
+				__m128 const max_z = _mm_setr_ps(s[0].Max().z(), s[1].Max().z(), s[2].Max().z(), s[3].Max().z());
+
+				__m128 const cx = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+				__m128 const cy = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+				__m128 const cz = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+				__m128 const hx = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+				__m128 const hy = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+				__m128 const hz = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+				float out[6][4];
+				for (int c = 0; c < 3; ++ c)
+				{
+					__m128 const new_center = _mm_add_ps(Dot3SoA(cx, cy, cz, &cols[c * 4]), cols[c * 4 + 3]);
+					__m128 const new_half_size = Dot3SoA(hx, hy, hz, &abs_cols[c * 4]);
+					_mm_storeu_ps(out[c], _mm_sub_ps(new_center, new_half_size));
+					_mm_storeu_ps(out[c + 3], _mm_add_ps(new_center, new_half_size));
+				}
+
+				for (int j = 0; j < 4; ++ j)
+				{
+					dst[i + j] = AABBox(float3(out[0][j], out[1][j], out[2][j]), float3(out[3][j], out[4][j], out[5][j]));
+				}
+			}
+#endif
+
+			for (; i < num; ++ i)
+			{
+				dst[i] = transform_aabb(src[i], mat);
+			}
+		}
+
+		void transform_aabb(AABBox* dst, AABBox const * src, float4x4 const * mats, size_t num)
+		{
+#ifdef KLAYGE_SSE_SUPPORT
+			__m128 const sign_mask = _mm_set1_ps(-0.0f);
+
+			// One box at a time, the 3 axes of the center and half size projection in one register
+			for (size_t i = 0; i < num; ++ i)
+			{
+				float4x4 const & mat = mats[i];
+				__m128 const r0 = _mm_loadu_ps(&mat(0, 0));
+				__m128 const r1 = _mm_loadu_ps(&mat(1, 0));
+				__m128 const r2 = _mm_loadu_ps(&mat(2, 0));
+				__m128 const r3 = _mm_loadu_ps(&mat(3, 0));
+
+				float3 const center = src[i].Center();
+				float3 const half_size = src[i].HalfSize();
+				__m128 const new_center = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(center.x()), r0),
+					_mm_mul_ps(_mm_set1_ps(center.y()), r1)), _mm_mul_ps(_mm_set1_ps(center.z()), r2)), r3);
+				__m128 const new_half_size = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(half_size.x()), _mm_andnot_ps(sign_mask, r0)),
+					_mm_mul_ps(_mm_set1_ps(half_size.y()), _mm_andnot_ps(sign_mask, r1))),
+					_mm_mul_ps(_mm_set1_ps(half_size.z()), _mm_andnot_ps(sign_mask, r2)));
+
+				float out_min[4];
+				float out_max[4];
+				_mm_storeu_ps(out_min, _mm_sub_ps(new_center, new_half_size));
+				_mm_storeu_ps(out_max, _mm_add_ps(new_center, new_half_size));
+				dst[i] = AABBox(float3(out_min[0], out_min[1], out_min[2]), float3(out_max[0], out_max[1], out_max[2]));
+			}
+#else
+			for (size_t i = 0; i < num; ++ i)
+			{
+				dst[i] = transform_aabb(src[i], mats[i]);
+			}
+#endif
+		}
+
+		void mul(float4x4* dst, float4x4 const * lhs, float4x4 const * rhs, size_t num)
+		{
+#ifdef KLAYGE_SSE_SUPPORT
+			KLAYGE_STATIC_ASSERT(sizeof(float4x4) == 16 * sizeof(float));
+
+			for (size_t i = 0; i < num; ++ i)
+			{
+				__m128 const r0 = _mm_loadu_ps(&rhs[i](0, 0));
+				__m128 const r1 = _mm_loadu_ps(&rhs[i](1, 0));
+				__m128 const r2 = _mm_loadu_ps(&rhs[i](2, 0));
+				__m128 const r3 = _mm_loadu_ps(&rhs[i](3, 0));
+
+				// Row j of the result is lhs(j, 0) * r0 + ... + lhs(j, 3) * r3. All rows are done before
+				// storing, so dst can be lhs or rhs.
+				__m128 rows[4];
+				for (int j = 0; j < 4; ++ j)
+				{
+					float4x4 const & l = lhs[i];
+					rows[j] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(l(j, 0)), r0),
+						_mm_mul_ps(_mm_set1_ps(l(j, 1)), r1)), _mm_mul_ps(_mm_set1_ps(l(j, 2)), r2)),
+						_mm_mul_ps(_mm_set1_ps(l(j, 3)), r3));
+				}
+				for (int j = 0; j < 4; ++ j)
+				{
+					_mm_storeu_ps(&dst[i](j, 0), rows[j]);
+				}
+			}
+#else
+			for (size_t i = 0; i < num; ++ i)
+			{
+				dst[i] = mul(lhs[i], rhs[i]);
+			}
+#endif
+		}
+
+		std::pair<Quaternion, Quaternion> udq_blend(Quaternion const * reals, Quaternion const * duals,
+			float const * weights, size_t num)
+		{
+			BOOST_ASSERT(num > 0);
+
+#ifdef KLAYGE_SSE_SUPPORT
+			__m128 sum_real = _mm_setzero_ps();
+			__m128 sum_dual = _mm_setzero_ps();
+			for (size_t i = 0; i < num; ++ i)
+			{
+				float const w = (dot(reals[0], reals[i]) < 0) ? -weights[i] : weights[i];
+				__m128 const vw = _mm_set1_ps(w);
+				sum_real = _mm_add_ps(sum_real, _mm_mul_ps(_mm_loadu_ps(&reals[i].x()), vw));
+				sum_dual = _mm_add_ps(sum_dual, _mm_mul_ps(_mm_loadu_ps(&duals[i].x()), vw));
+			}
+
+			Quaternion real, dual;
+			_mm_storeu_ps(&real.x(), sum_real);
+			_mm_storeu_ps(&dual.x(), sum_dual);
+#else
+			Quaternion real(0, 0, 0, 0);
+			Quaternion dual(0, 0, 0, 0);
+			for (size_t i = 0; i < num; ++ i)
+			{
+				float const w = (dot(reals[0], reals[i]) < 0) ? -weights[i] : weights[i];
+				real += reals[i] * w;
+				dual += duals[i] * w;
+			}
+#endif
+
+			float const inv_len = 1 / length(real);
+			return std::make_pair(real * inv_len, dual * inv_len);
+		}
 	}
 }
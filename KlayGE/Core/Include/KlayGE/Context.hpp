@@ -57,6 +57,11 @@ namespace KlayGE
 
 		bool perf_profiler;
 		bool location_sensor;
+
+		std::string shader_cache_path;
+		uint32_t shader_cache_size;		// In MB. 0 disables the shader cache
+
+		bool pipelined_update;			// Update the next frame's scene while the current one is submitted
 	};
 
 	class KLAYGE_CORE_API Context
@@ -343,7 +343,13 @@ namespace KlayGE
 		void UpdateLightIndexedLightingDirectional(PerViewport const & pvp, uint32_t g_buffer_index,
 			std::vector<uint32_t>::const_iterator iter_beg, std::vector<uint32_t>::const_iterator iter_end);
 		void UpdateLightIndexedLightingPointSpotArea(PerViewport const & pvp, uint32_t g_buffer_index,
-			std::vector<uint32_t>::const_iterator iter_beg, std::vector<uint32_t>::const_iterator iter_end);
+			std::vector<uint32_t>::const_iterator iter_beg, std::vector<uint32_t>::const_iterator iter_end,
+			int4 const & tile_rect);
+		void UpdateLightIndexedLightingTiled(PerViewport const & pvp, uint32_t g_buffer_index,
+			std::vector<uint32_t> const & light_indices);
+		void CalcLightTileRects(PerViewport const & pvp, std::vector<uint32_t> const & light_indices,
+			std::vector<int4>& tile_rects, uint32_t begin, uint32_t end);
+		void UpdateTileQuad(RenderLayoutPtr const & rl, float4 const & tc_rect);
 		void CreateDepthMinMaxMap(PerViewport const & pvp);
 
 		void UpdateTileBasedLighting(PerViewport const & pvp, uint32_t g_buffer_index);
@@ -361,6 +367,9 @@ namespace KlayGE
 #if DEFAULT_DEFERRED == LIGHT_INDEXED_DEFERRED
 		uint32_t light_batch_;
 		bool cs_tbdr_;
+		// Quads covering only the tiles that a light batch touches
+		RenderLayoutPtr rl_light_index_quad_;
+		RenderLayoutPtr rl_light_shading_quad_;
 #endif
 
 		array<PerViewport, 8> viewports_;
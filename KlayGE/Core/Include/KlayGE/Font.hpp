@@ -77,6 +77,8 @@ namespace KlayGE
 		Font(shared_ptr<FontRenderable> const & fr, uint32_t flags);
 
 		Size_T<float> CalcSize(std::wstring const & text, float font_size);
+		// Decodes the glyphs of text on the thread pool, so drawing it later doesn't stall on decompression
+		void Prefetch(std::wstring const & text);
 		void RenderText(float x, float y, Color const & clr,
 			std::wstring const & text, float font_size);
 		void RenderText(float x, float y, float z, float xScale, float yScale, Color const & clr,
@@ -85,9 +87,14 @@ namespace KlayGE
 			std::wstring const & text, float font_size, uint32_t align);
 		void RenderText(float4x4 const & mvp, Color const & clr, std::wstring const & text, float font_size);
 
+	private:
+		void BeginText();
+
 	private:
 		shared_ptr<FontRenderable> font_renderable_;
+		SceneObjectPtr	font_obj_;
 		uint32_t		fso_attrib_;
+		uint32_t		font_obj_frame_;
 	};
 
 	KLAYGE_CORE_API FontPtr SyncLoadFont(std::string const & font_name, uint32_t flags = 0);
@@ -119,6 +119,10 @@ namespace KlayGE
 
 		virtual void CopyToBuffer(GraphicsBuffer& rhs) = 0;
 
+		// Writes a range of the buffer and keeps the rest. Only for buffers without EAH_CPU_Write. Those are
+		// written by mapping, which discards the whole content on some APIs.
+		virtual void UpdateSubresource(uint32_t offset, uint32_t size, void const * data) = 0;
+
 	private:
 		virtual void DoResize() = 0;
 
@@ -59,6 +59,7 @@
 #include <vector>
 #include <string>
 #include <bitset>
+#include <iosfwd>
 
 namespace KlayGE
 {
@@ -354,11 +355,8 @@ namespace KlayGE
 		uint16_t Action(uint16_t key) const;
 
 	private:
-#ifdef KLAYGE_DONT_USE_BOOST_FLAT_MAP
-		std::map<uint16_t, uint16_t> actionMap_;
-#else
-		boost::container::flat_map<uint16_t, uint16_t> actionMap_;
-#endif
+		// Indexed by the key semantic, 0xFFFF means no action
+		std::vector<uint16_t> actionMap_;
 	};
 
 	typedef boost::signals2::signal<void(InputEngine const & sender, InputAction const & action)> input_signal;
@@ -405,18 +403,35 @@ namespace KlayGE
 		size_t NumDevices() const;
 		InputDevicePtr Device(size_t index) const;
 
+		// Record the dispatched actions to a file, or play a recording back instead of the devices.
+		// A replay advances one recorded update per Update call, so runs are deterministic regardless of the frame rate.
+		void StartRecording(std::string const & file_name);
+		void StopRecording();
+		bool Recording() const;
+		void StartReplaying(std::string const & res_name);
+		void StopReplaying();
+		bool Replaying() const;
+
 	private:
-		virtual void DoSuspend() = 0;
+		virtual void DoSuspend() = 0;
 		virtual void DoResume() = 0;
 
+		void ReplayActions();
+
 	protected:
 		typedef std::vector<InputDevicePtr>	InputDevicesType;
 		InputDevicesType	devices_;
 
 		action_handlers_t action_handlers_;
+		InputActionsType actions_;
 
 		Timer timer_;
 		float elapsed_time_;
+
+		shared_ptr<std::ostream> record_stream_;
+		std::vector<std::pair<uint32_t, InputAction> > record_actions_;
+		ResIdentifierPtr replay_stream_;
+		array<InputActionParamPtr, 5> replay_params_;
 	};
 
 	class KLAYGE_CORE_API InputDevice
@@ -428,7 +443,7 @@ namespace KlayGE
 		virtual InputEngine::InputDeviceType Type() const = 0;
 
 		virtual void UpdateInputs() = 0;
-		virtual InputActionsType UpdateActionMap(uint32_t id) = 0;
+		virtual void UpdateActionMap(uint32_t id, InputActionsType& actions) = 0;
 
 		virtual void ActionMap(uint32_t id, InputActionMap const & actionMap) = 0;
 
@@ -454,7 +469,7 @@ namespace KlayGE
 		bool KeyDown(size_t n) const;
 		bool KeyUp(size_t n) const;
 
-		virtual InputActionsType UpdateActionMap(uint32_t id) KLAYGE_OVERRIDE;
+		virtual void UpdateActionMap(uint32_t id, InputActionsType& actions) KLAYGE_OVERRIDE;
 		virtual void ActionMap(uint32_t id, InputActionMap const & actionMap) KLAYGE_OVERRIDE;
 
 	protected:
@@ -491,7 +506,7 @@ namespace KlayGE
 		bool ButtonDown(size_t n) const;
 		bool ButtonUp(size_t n) const;
 
-		virtual InputActionsType UpdateActionMap(uint32_t id) KLAYGE_OVERRIDE;
+		virtual void UpdateActionMap(uint32_t id, InputActionsType& actions) KLAYGE_OVERRIDE;
 		virtual void ActionMap(uint32_t id, InputActionMap const & actionMap) KLAYGE_OVERRIDE;
 
 	protected:
@@ -534,7 +549,7 @@ namespace KlayGE
 		bool ButtonDown(size_t n) const;
 		bool ButtonUp(size_t n) const;
 
-		virtual InputActionsType UpdateActionMap(uint32_t id) KLAYGE_OVERRIDE;
+		virtual void UpdateActionMap(uint32_t id, InputActionsType& actions) KLAYGE_OVERRIDE;
 		virtual void ActionMap(uint32_t id, InputActionMap const & actionMap) KLAYGE_OVERRIDE;
 
 	protected:
@@ -563,7 +578,7 @@ namespace KlayGE
 
 		TouchSemantic Gesture() const;
 		
-		virtual InputActionsType UpdateActionMap(uint32_t id) KLAYGE_OVERRIDE;
+		virtual void UpdateActionMap(uint32_t id, InputActionsType& actions) KLAYGE_OVERRIDE;
 		virtual void ActionMap(uint32_t id, InputActionMap const & actionMap) KLAYGE_OVERRIDE;
 
 	protected:
@@ -638,7 +653,7 @@ namespace KlayGE
 		Quaternion const & OrientationQuat() const;
 		int32_t MagnetometerAccuracy() const;
 
-		virtual InputActionsType UpdateActionMap(uint32_t id) KLAYGE_OVERRIDE;
+		virtual void UpdateActionMap(uint32_t id, InputActionsType& actions) KLAYGE_OVERRIDE;
 		virtual void ActionMap(uint32_t id, InputActionMap const & actionMap) KLAYGE_OVERRIDE;
 
 	protected:
@@ -21,7 +21,10 @@
 
 #include <vector>
 #include <deque>
+#include <list>
 
+#include <KFL/Thread.hpp>
+#include <KFL/MappedFile.hpp>
 #include <KlayGE/LZMACodec.hpp>
 
 namespace KlayGE
@@ -62,6 +65,7 @@ namespace KlayGE
 
 	public:
 		JudaTexture(uint32_t num_tiles, uint32_t tile_size, ElementFormat format);
+		~JudaTexture();
 
 		uint32_t EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const;
 		void DecodeTileID(uint32_t& level, uint32_t& tile_x, uint32_t& tile_y, uint32_t tile_id) const;
@@ -86,12 +90,44 @@ namespace KlayGE
 
 		void SetParams(RenderTechniquePtr const tech);
 
+		// Makes all the tiles resident before returning. Decoding is spread over the thread pool.
 		void UpdateCache(std::vector<uint32_t> const & tile_ids);
+		// Queues the missing tiles for decoding on the thread pool, and uploads up to max_uploads tiles that finished
+		//  since the last call. Coarser tiles and tiles requested more often are decoded first. Until a tile is
+		//  uploaded, its indirect entry keeps what it had.
+		void StreamCache(std::vector<uint32_t> const & tile_ids, uint32_t max_uploads);
+
+		// Memory used by decoded data blocks, in bytes
+		void DecodedCacheBudget(uint64_t bytes);
+		uint64_t DecodedCacheBudget() const;
 
 	private:
+		// Tiles going into the cache together, with the neighbors they need for borders
+		struct TileBatch
+		{
+			std::vector<uint32_t> all_neighbor_ids;
+			std::vector<bool> in_same_image;
+			std::vector<uint32_t> tile_attrs;
+			unordered_map<uint32_t, uint32_t> neighbor_id_map;
+			std::vector<uint32_t> neighbor_ids;
+			std::vector<std::vector<uint8_t> > neighbor_data;
+
+			std::vector<joiner<void> > decoders;
+			atomic<uint32_t> remaining;
+			size_t num_uploaded;
+		};
+		typedef shared_ptr<TileBatch> TileBatchPtr;
+
+		void PrepareTiles(TileBatch& batch, std::vector<uint32_t> const & tile_ids);
+		void DecodeBatch(TileBatchPtr const & batch);
+		void DecodeBatchRange(TileBatchPtr const & batch, size_t begin, size_t end);
+		void UploadTiles(TileBatch& batch, size_t begin, size_t end);
+		void FinishPendingBatches();
+
+		void DecodeTileMips(std::vector<uint8_t>* data, uint32_t tile_id, uint32_t mipmaps);
 		void DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps);
 		uint32_t DecodeAAttr(uint32_t shuff);
-		uint8_t* RetriveATile(uint32_t data_index);
+		uint8_t const * RetriveATile(shared_ptr<std::vector<uint8_t> >& holder, uint32_t data_index);
 
 		uint32_t NumNonEmptySubNodes(quadtree_node_ptr const & node) const;
 		quadtree_node_ptr const & GetNode(uint32_t shuff);
@@ -165,21 +201,30 @@ namespace KlayGE
 
 	private:
 		// Input only
+		// Tiles are read from the mapping when the file can be mapped, otherwise from the stream under decode_mutex_
+		MappedFile mapped_file_;
 		ResIdentifierPtr input_file_;
 		uint32_t data_blocks_offset_;
 		LZMACodec lzma_dec_;
 		struct DecodedBlockInfo
 		{
 			shared_ptr<std::vector<uint8_t> > data;
-			uint64_t tick;
+			std::list<uint32_t>::iterator lru_iter;
 
-			DecodedBlockInfo(shared_ptr<std::vector<uint8_t> > const & d, uint64_t t)
-				: data(d), tick(t)
+			DecodedBlockInfo(shared_ptr<std::vector<uint8_t> > const & d, std::list<uint32_t>::iterator iter)
+				: data(d), lru_iter(iter)
 			{
 			}
 		};
+		// Shared by the decoding threads
 		unordered_map<uint32_t, DecodedBlockInfo> decoded_block_cache_;
-		uint64_t decode_tick_;
+		std::list<uint32_t> decoded_block_lru_;
+		uint64_t decoded_cache_size_;
+		uint64_t decoded_cache_budget_;
+		mutex decode_mutex_;
+
+		std::deque<TileBatchPtr> pending_batches_;
+		unordered_set<uint32_t> pending_tiles_;
 
 	private:
 		// Cache
@@ -226,7 +226,8 @@ namespace KlayGE
 	class KLAYGE_CORE_API ParticleSystem : public SceneObjectHelper
 	{
 	public:
-		explicit ParticleSystem(uint32_t max_num_particles);
+		// A simulation only system has no renderable, and doesn't need a render device. It's for tools and benchmarks.
+		explicit ParticleSystem(uint32_t max_num_particles, bool simulation_only = false);
 
 		virtual ParticleSystemPtr Clone();
 
@@ -286,6 +287,11 @@ namespace KlayGE
 
 		virtual void SubThreadUpdate(float app_time, float elapsed_time) KLAYGE_OVERRIDE;
 		virtual bool MainThreadUpdate(float app_time, float elapsed_time) KLAYGE_OVERRIDE;
+		// Emits, updates, and sorts the particles back to front in the view. Only touches the particle system's
+		// own state, so it can run beside rendering. MainThreadUpdate hands the result to the renderable.
+		void UpdateParticles(float elapsed_time, float4x4 const & view_mat);
+		// Bound of the active particles from the last update
+		AABBox ParticlesBound();
 
 		uint32_t NumParticles() const
 		{
@@ -340,6 +346,7 @@ namespace KlayGE
 
 		std::vector<Particle> particles_;
 		std::vector<std::pair<uint32_t, float> > active_particles_;
+		AABBox particles_bound_;
 
 		float gravity_;
 		float3 force_;
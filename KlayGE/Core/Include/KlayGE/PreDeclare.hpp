@@ -126,6 +126,7 @@ namespace KlayGE
 	typedef shared_ptr<SamplerStateObject> SamplerStateObjectPtr;
 	class ShaderObject;
 	typedef shared_ptr<ShaderObject> ShaderObjectPtr;
+	class ShaderCache;
 	class Texture;
 	typedef shared_ptr<Texture> TexturePtr;
 	class TexCompression;
@@ -665,6 +665,7 @@ namespace KlayGE
 		void RecursiveIncludeNode(XMLNodePtr const & root, std::vector<std::string>& include_names) const;
 		void InsertIncludeNodes(XMLDocument& target_doc, XMLNodePtr const & target_root,
 			XMLNodePtr const & target_place, XMLNodePtr const & include_root) const;
+		void CreateHwShaders();
 
 	private:
 		shared_ptr<std::string> res_name_;
@@ -691,6 +692,7 @@ namespace KlayGE
 		}
 
 		void Load(XMLNodePtr const & node, uint32_t tech_index);
+		void UpdateShaderStates();
 
 		bool StreamIn(ResIdentifierPtr const & res, uint32_t tech_index);
 		void StreamOut(std::ostream& os, uint32_t tech_index);
@@ -794,6 +796,8 @@ namespace KlayGE
 
 		void Load(XMLNodePtr const & node, uint32_t tech_index, uint32_t pass_index, RenderPassPtr const & inherit_pass);
 		void Load(uint32_t tech_index, uint32_t pass_index, RenderPassPtr const & inherit_pass);
+		void CompileShaders(uint32_t tech_index, uint32_t pass_index);
+		void CreateHwShaders(uint32_t tech_index, uint32_t pass_index);
 
 		bool StreamIn(ResIdentifierPtr const & res, uint32_t tech_index, uint32_t pass_index);
 		void StreamOut(std::ostream& os, uint32_t tech_index, uint32_t pass_index);
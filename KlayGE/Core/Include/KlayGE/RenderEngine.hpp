@@ -113,6 +113,8 @@ namespace KlayGE
 		uint32_t NumVerticesJustRendered();
 		uint32_t NumDrawsJustCalled();
 		uint32_t NumDispatchesJustCalled();
+		uint32_t NumStateChangesJustAvoided();
+		uint32_t NumShaderBindsJustAvoided();
 
 		void CreateRenderWindow(std::string const & name, RenderSettings& settings);
 		void DestroyRenderWindow();
@@ -189,6 +191,12 @@ namespace KlayGE
 			return motion_frames_;
 		}
 
+		// Increased by EndFrame. Used to tell whether per-frame data is already up to date.
+		uint32_t FrameIndex() const
+		{
+			return frame_index_;
+		}
+
 		RasterizerStateObjectPtr const & CurRSObj() const
 		{
 			return cur_rs_obj_;
@@ -300,6 +308,9 @@ namespace KlayGE
 		uint32_t num_vertices_just_rendered_;
 		uint32_t num_draws_just_called_;
 		uint32_t num_dispatches_just_called_;
+		uint32_t num_state_changes_just_avoided_;
+		uint32_t num_shader_binds_just_avoided_;
+		uint32_t frame_index_;
 
 		RenderDeviceCaps caps_;
 
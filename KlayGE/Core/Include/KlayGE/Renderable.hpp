@@ -174,13 +174,31 @@ namespace KlayGE
 
 		virtual void Render();
 
+		// The instance list is marked as changed only if it differs from the previous one,
+		// so the passes of a frame can reuse the instance stream
 		template <typename Iterator>
 		void AssignInstances(Iterator begin, Iterator end)
 		{
-			instances_.resize(0);
-			for (Iterator iter = begin; iter != end; ++ iter)
+			size_t num = 0;
+			for (Iterator iter = begin; iter != end; ++ iter, ++ num)
 			{
-				this->AddInstance(*iter);
+				if (num < instances_.size())
+				{
+					if (instances_[num].owner_before(*iter) || iter->owner_before(instances_[num]))
+					{
+						instances_[num] = *iter;
+						instances_changed_ = true;
+					}
+				}
+				else
+				{
+					this->AddInstance(*iter);
+				}
+			}
+			if (num != instances_.size())
+			{
+				instances_.resize(num);
+				instances_changed_ = true;
 			}
 		}
 		void AddInstance(SceneObjectPtr const & obj);
@@ -194,6 +212,16 @@ namespace KlayGE
 			return instances_[index].lock();
 		}
 
+		// When enabled, the instance data of objects without SOA_Moveable is uploaded once, and never checked for changes again
+		void StaticInstancesResident(bool resident)
+		{
+			static_instances_resident_ = resident;
+		}
+		bool StaticInstancesResident() const
+		{
+			return static_instances_resident_;
+		}
+
 		virtual void ModelMatrix(float4x4 const & mat);
 
 		template <typename ForwardIterator>
@@ -261,6 +289,16 @@ namespace KlayGE
 	protected:
 		std::vector<weak_ptr<SceneObject> > instances_;
 
+		// The instances locked once per frame, so that the passes don't lock them again
+		std::vector<SceneObject*> instance_ptrs_;
+		bool instances_changed_;
+
+		// CPU copy of the instance stream, and the objects it was filled from
+		std::vector<weak_ptr<SceneObject> > uploaded_instances_;
+		std::vector<uint8_t> uploaded_instance_data_;
+		uint32_t instance_update_frame_;
+		bool static_instances_resident_;
+
 		RenderTechniquePtr technique_;
 
 		// For select mode
@@ -49,7 +49,10 @@ namespace KlayGE
 
 		void SmallObjectThreshold(float area);
 		void SceneUpdateElapse(float elapse);
-		virtual void ClipScene();
+		void ClipScene();
+		virtual void ClipScene(Camera const & camera);
+		// Fills the render queue with the visible objects, without submitting it
+		void BuildRenderQueue(Camera const & camera, uint32_t urt);
 
 		void AddCamera(CameraPtr const & camera);
 		void DelCamera(CameraPtr const & camera);
@@ -70,6 +73,8 @@ namespace KlayGE
 		void DelSceneObject(SceneObjectPtr const & obj);
 		void DelSceneObjectLocked(SceneObjectPtr const & obj);
 		void AddRenderable(RenderablePtr const & obj);
+		// Called by SceneObject::Parent. The transform order is rebuilt before the next culling.
+		void SceneObjectParentChanged();
 
 		uint32_t NumSceneObjects() const;
 		SceneObjectPtr& GetSceneObject(uint32_t index);
@@ -92,6 +97,12 @@ namespace KlayGE
 		uint32_t NumVerticesRendered() const;
 		uint32_t NumDrawCalls() const;
 		uint32_t NumDispatchCalls() const;
+		uint32_t NumStateChangesAvoided() const;
+		uint32_t NumShaderBindsAvoided() const;
+
+		// The active camera's view matrix as of the last Update. SubThreadUpdate reads this instead of the camera,
+		// which is only updated on the main thread.
+		float4x4 const & UpdateViewMatrix() const;
 
 	protected:
 		void Flush(uint32_t urt);
@@ -107,6 +118,12 @@ namespace KlayGE
 
 		void UpdateThreadFunc();
 
+		// Pipelined update, split around the submission of the current frame. Update drives it
+		// when ContextCfg::pipelined_update is set.
+		void PipelinedMode(bool pipelined);
+		shared_ptr<joiner<void> > BeginPipelinedUpdate(float app_time, float frame_time);
+		void EndPipelinedUpdate(joiner<void>& update, float app_time, float frame_time);
+
 		BoundOverlap VisibleTestFromParent(SceneObjectPtr const & obj,
 			float3 const & eye_pos, float4x4 const & view_proj);
 
@@ -124,6 +141,9 @@ namespace KlayGE
 
 	private:
 		void FlushScene();
+		void DoFlush(uint32_t urt);
+		void PipelinedUpdateFunc(float app_time, float frame_time);
+		void UpdateTransforms();
 
 	private:
 		uint32_t urt_;
@@ -136,12 +156,41 @@ namespace KlayGE
 		uint32_t num_vertices_rendered_;
 		uint32_t num_draw_calls_;
 		uint32_t num_dispatch_calls_;
+		uint32_t num_state_changes_avoided_;
+		uint32_t num_shader_binds_avoided_;
 
 		mutex update_mutex_;
 		shared_ptr<joiner<void> > update_thread_;
 		bool quit_;
 
+		// In pipelined mode, SubThreadUpdate of the next frame runs on the thread pool while FlushScene
+		// submits the current one. Objects added or removed by the update are applied after it joins.
+		// SubThreadUpdate may only write state its object owns; what rendering reads, such as renderable
+		// bounds and vertex data, is published in MainThreadUpdate or taken by SnapshotRenderState.
+		// The update walks its own copy of the objects, so update_mutex_ is only held to take it.
+		atomic<bool> pipelined_;
+		atomic<bool> in_pipelined_update_;
+		thread_id pipelined_update_thread_;
+		SceneObjsType pipelined_update_objs_;
+		SceneObjsType pending_added_scene_objs_;
+		SceneObjsType pending_deleted_scene_objs_;
+
 		bool deferred_mode_;
+
+		float4x4 update_view_;
+
+		// Moving or reparented objects and their ancestors, by depth in the hierarchy. Rebuilt when objects are
+		// added, removed or reparented. The objects of a depth are independent, and updated as one batch.
+		std::vector<SceneObject*> transform_objs_;
+		std::vector<int32_t> transform_parents_;
+		std::vector<uint8_t> transform_changed_;
+		std::vector<uint32_t> transform_depth_begins_;
+		atomic<bool> transform_objs_dirty_;
+
+		std::vector<uint32_t> transform_batch_;
+		std::vector<float4x4> transform_models_;
+		std::vector<float4x4> transform_parent_abs_;
+		std::vector<AABBox> transform_bounds_;
 	};
 }
 
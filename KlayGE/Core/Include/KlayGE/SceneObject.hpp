@@ -53,6 +53,15 @@ namespace KlayGE
 		virtual float4x4 const & AbsModelMatrix() const;
 		virtual AABBoxPtr const & PosBoundWS() const;
 		void UpdateAbsModelMatrix();
+		// Updates the world matrix and bound only if the local matrix or the bound changed since the last update,
+		// or if parent_changed. Returns whether they were updated, for the children.
+		bool UpdateAbsModelMatrix(bool parent_changed);
+		// The two halves of UpdateAbsModelMatrix(bool), for the batched sweep of the scene manager. Begin returns false
+		// if nothing changed, otherwise it gives the local matrix and bound to transform. End takes the results.
+		bool BeginAbsModelMatrixUpdate(bool parent_changed, float4x4& model, AABBox& pos_bound);
+		void EndAbsModelMatrixUpdate(float4x4 const & abs_model, AABBox const & pos_bound_ws);
+		// False after reparenting, until the world matrix and bound are updated again
+		bool AbsModelMatrixValid() const;
 		void VisibleMark(BoundOverlap vm);
 		BoundOverlap VisibleMark() const;
 
@@ -76,6 +85,13 @@ namespace KlayGE
 		vertex_elements_type const & InstanceFormat() const;
 		virtual void const * InstanceData() const;
 
+		// For pipelined update. Rendering reads a copy of the state taken between two updates,
+		// so the next frame can be updated while the current one is submitted.
+		void SnapshotRenderState();
+		void DiscardRenderState();
+		float4x4 const & RenderModelMatrix() const;
+		void const * RenderInstanceData() const;
+
 		// For select mode
 		virtual void ObjectID(uint32_t id);
 		virtual void SelectMode(bool select_mode);
@@ -102,8 +118,16 @@ namespace KlayGE
 		float4x4 model_;
 		float4x4 abs_model_;
 		AABBoxPtr pos_aabb_ws_;
+		// What abs_model_ and pos_aabb_ws_ were computed from
+		bool abs_model_valid_;
+		float4x4 updated_model_;
+		AABBox updated_pos_bound_;
 		BoundOverlap visible_mark_;
 
+		bool has_render_state_;
+		float4x4 render_model_;
+		std::vector<uint8_t> render_instance_data_;
+
 		function<void(SceneObject&, float, float)> sub_thread_update_func_;
 		function<void(SceneObject&, float, float)> main_thread_update_func_;
 	};
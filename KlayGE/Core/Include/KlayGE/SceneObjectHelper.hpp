@@ -88,7 +88,7 @@ namespace KlayGE
 		SceneObjectCameraProxy(CameraPtr const & camera,
 			function<StaticMeshPtr(RenderModelPtr const &, std::wstring const &)> CreateMeshFactoryFunc);
 
-		virtual void SubThreadUpdate(float app_time, float elapsed_time) KLAYGE_OVERRIDE;
+		virtual bool MainThreadUpdate(float app_time, float elapsed_time) KLAYGE_OVERRIDE;
 
 		void Scaling(float x, float y, float z);
 		void Scaling(float3 const & s);
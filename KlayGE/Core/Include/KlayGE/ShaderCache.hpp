@@ -0,0 +1,97 @@
+/**
+* @file ShaderCache.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_SHADERCACHE_HPP
+#define _KLAYGE_SHADERCACHE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Thread.hpp>
+
+#include <string>
+#include <vector>
+
+namespace KlayGE
+{
+	// A global on-disk cache of compiled shader code, shared by all effects and all runs.
+	// Entries are keyed by a hash of everything that goes into the compiler, and the least
+	// recently used ones are removed when the cache grows over its size limit.
+	class KLAYGE_CORE_API ShaderCache
+	{
+		struct Entry
+		{
+			uint64_t size;
+			uint64_t last_use;
+		};
+
+	public:
+		ShaderCache();
+		~ShaderCache();
+
+		static ShaderCache& Instance();
+		static void Destroy();
+
+		void Suspend();
+		void Resume();
+
+		// 64-bit FNV-1a. Feed the shader text, macros, entry point, profile, flags and backend through it to get a key.
+		static uint64_t HashCombine(uint64_t seed, void const * data, size_t size);
+		static uint64_t HashCombine(uint64_t seed, std::string const & str);
+		static uint64_t HashSeed();
+
+		bool Enabled() const;
+
+		bool Load(uint64_t key, std::vector<uint8_t>& code);
+		void Store(uint64_t key, std::vector<uint8_t> const & code);
+		// For entries the caller can't use any more, e.g. a program binary the driver rejects
+		void Remove(uint64_t key);
+
+	private:
+		std::string EntryPath(uint64_t key) const;
+		void LoadIndex();
+		void SaveIndex();
+		void Shrink();
+
+	private:
+		static shared_ptr<ShaderCache> shader_cache_instance_;
+
+		std::string cache_dir_;
+		uint64_t max_size_;
+
+		mutex cache_mutex_;
+		unordered_map<uint64_t, Entry> entries_;
+		uint64_t total_size_;
+		uint64_t use_tick_;
+		bool index_dirty_;
+	};
+}
+
+#endif			// _KLAYGE_SHADERCACHE_HPP
@@ -105,6 +105,10 @@ namespace KlayGE
 			std::vector<uint32_t> const & shader_desc_ids) = 0;
 		virtual void StreamOut(std::ostream& os, ShaderType type) = 0;
 
+		// Does the API independent part of AttachShader. Could be called from worker threads, as long as
+		// each shader object is used by only one thread at a time. AttachShader picks up the result.
+		virtual void CompileShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids);
 		virtual void AttachShader(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids) = 0;
 		virtual void AttachShader(ShaderType type, RenderEffect const & effect,
@@ -132,6 +132,12 @@ namespace KlayGE
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) KLAYGE_OVERRIDE;
 		virtual void DecodeBlock(void* output, void const * input) KLAYGE_OVERRIDE;
 
+		// Rows of blocks are encoded on all hardware threads, each with a codec of its own
+		virtual void EncodeMem(uint32_t width, uint32_t height,
+			void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
+			void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
+			TexCompressionMethod method) KLAYGE_OVERRIDE;
+
 		uint64_t EncodeETC1BlockInternal(ETC1Block& output, ARGBColor32 const * argb, TexCompressionMethod method);
 		void DecodeETCIndividualModeInternal(ARGBColor32* argb, ETC1Block const & etc1) const;
 		void DecodeETCDifferentialModeInternal(ARGBColor32* argb, ETC1Block const & etc1, bool alpha) const;
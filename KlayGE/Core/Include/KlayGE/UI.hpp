@@ -433,6 +433,8 @@ namespace KlayGE
 		void Init();
 		void InputHandler(InputEngine const & sender, InputAction const & action);
 
+		RenderablePtr const & RectRenderable(TexturePtr const & texture);
+
 	private:
 		static UIManagerPtr ui_mgr_instance_;
 
@@ -446,7 +448,8 @@ namespace KlayGE
 
 		array<std::vector<IRect >, UICT_Num_Control_Types> elem_texture_rcs_;
 
-		std::map<TexturePtr, RenderablePtr> rects_;
+		// Kept across frames, so unchanged UI doesn't reallocate or re-upload its geometry
+		std::map<TexturePtr, SceneObjectPtr> rects_;
 
 		struct string_cache
 		{
@@ -16,13 +16,26 @@
 
 #include <KlayGE/Input.hpp>
 
+namespace
+{
+	uint16_t const NO_ACTION = 0xFFFF;
+}
+
 namespace KlayGE
 {
 	// Ӷ
 	//////////////////////////////////////////////////////////////////////////////////
 	void InputActionMap::AddAction(InputActionDefine const & action_define)
 	{
-		actionMap_.insert(std::make_pair(action_define.second, action_define.first));
+		uint16_t const key = action_define.second;
+		if (key >= actionMap_.size())
+		{
+			actionMap_.resize(key + 1, NO_ACTION);
+		}
+		if (NO_ACTION == actionMap_[key])
+		{
+			actionMap_[key] = action_define.first;
+		}
 	}
 
 	// 붯
@@ -31,7 +44,7 @@ namespace KlayGE
 	{
 		if (this->HasAction(key))
 		{
-			actions.push_back(std::make_pair(this->Action(key), param));
+			actions.push_back(std::make_pair(actionMap_[key], param));
 		}
 	}
 
@@ -39,13 +52,15 @@ namespace KlayGE
 	//////////////////////////////////////////////////////////////////////////////////
 	bool InputActionMap::HasAction(uint16_t key) const
 	{
-		return (actionMap_.find(key) != actionMap_.end());
+		return (key < actionMap_.size()) && (actionMap_[key] != NO_ACTION);
 	}
 
 	// keyȡ
 	//////////////////////////////////////////////////////////////////////////////////
 	uint16_t InputActionMap::Action(uint16_t key) const
 	{
-		return actionMap_.find(key)->second;
+		BOOST_ASSERT(this->HasAction(key));
+
+		return actionMap_[key];
 	}
 }
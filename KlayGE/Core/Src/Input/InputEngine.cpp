@@ -18,13 +18,254 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Util.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KlayGE/ResLoader.hpp>
 
 #include <vector>
+#include <fstream>
 
 #include <boost/assert.hpp>
 
 #include <KlayGE/Input.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const INPUT_RECORD_VERSION = 1;
+
+	template <typename T>
+	void WriteValue(std::ostream& os, T value)
+	{
+		value = Native2LE(value);
+		os.write(reinterpret_cast<char const *>(&value), sizeof(value));
+	}
+
+	template <typename T, int N>
+	void WriteValue(std::ostream& os, Vector_T<T, N> const & value)
+	{
+		for (int i = 0; i < N; ++ i)
+		{
+			WriteValue(os, value[i]);
+		}
+	}
+
+	void WriteValue(std::ostream& os, Quaternion const & value)
+	{
+		for (int i = 0; i < 4; ++ i)
+		{
+			WriteValue(os, value[i]);
+		}
+	}
+
+	void WriteValue(std::ostream& os, std::bitset<256> const & value)
+	{
+		array<uint8_t, 32> bytes;
+		bytes.fill(0);
+		for (size_t i = 0; i < value.size(); ++ i)
+		{
+			bytes[i / 8] |= (value[i] ? (1U << (i & 7)) : 0);
+		}
+		os.write(reinterpret_cast<char const *>(&bytes[0]), bytes.size());
+	}
+
+	template <typename T>
+	void ReadValue(ResIdentifier& is, T& value)
+	{
+		is.read(&value, sizeof(value));
+		value = LE2Native(value);
+	}
+
+	template <typename T, int N>
+	void ReadValue(ResIdentifier& is, Vector_T<T, N>& value)
+	{
+		for (int i = 0; i < N; ++ i)
+		{
+			ReadValue(is, value[i]);
+		}
+	}
+
+	void ReadValue(ResIdentifier& is, Quaternion& value)
+	{
+		for (int i = 0; i < 4; ++ i)
+		{
+			ReadValue(is, value[i]);
+		}
+	}
+
+	void ReadValue(ResIdentifier& is, std::bitset<256>& value)
+	{
+		array<uint8_t, 32> bytes;
+		is.read(&bytes[0], bytes.size());
+		for (size_t i = 0; i < value.size(); ++ i)
+		{
+			value[i] = (bytes[i / 8] & (1U << (i & 7))) != 0;
+		}
+	}
+
+	void WriteParam(std::ostream& os, InputActionParam const & param)
+	{
+		switch (param.type)
+		{
+		case InputEngine::IDT_Keyboard:
+			{
+				InputKeyboardActionParam const & p = static_cast<InputKeyboardActionParam const &>(param);
+				WriteValue(os, p.buttons_state);
+				WriteValue(os, p.buttons_down);
+				WriteValue(os, p.buttons_up);
+			}
+			break;
+
+		case InputEngine::IDT_Mouse:
+			{
+				InputMouseActionParam const & p = static_cast<InputMouseActionParam const &>(param);
+				WriteValue(os, p.move_vec);
+				WriteValue(os, p.wheel_delta);
+				WriteValue(os, p.abs_coord);
+				WriteValue(os, p.buttons_state);
+				WriteValue(os, p.buttons_down);
+				WriteValue(os, p.buttons_up);
+			}
+			break;
+
+		case InputEngine::IDT_Joystick:
+			{
+				InputJoystickActionParam const & p = static_cast<InputJoystickActionParam const &>(param);
+				WriteValue(os, p.pos);
+				WriteValue(os, p.rot);
+				WriteValue(os, p.slider);
+				WriteValue(os, p.buttons_state);
+				WriteValue(os, p.buttons_down);
+				WriteValue(os, p.buttons_up);
+			}
+			break;
+
+		case InputEngine::IDT_Touch:
+			{
+				InputTouchActionParam const & p = static_cast<InputTouchActionParam const &>(param);
+				WriteValue(os, static_cast<uint16_t>(p.gesture));
+				WriteValue(os, p.center);
+				WriteValue(os, p.move_vec);
+				WriteValue(os, p.zoom);
+				WriteValue(os, p.rotate_angle);
+				WriteValue(os, p.wheel_delta);
+				for (size_t i = 0; i < p.touches_coord.size(); ++ i)
+				{
+					WriteValue(os, p.touches_coord[i]);
+				}
+				WriteValue(os, p.touches_state);
+				WriteValue(os, p.touches_down);
+				WriteValue(os, p.touches_up);
+			}
+			break;
+
+		case InputEngine::IDT_Sensor:
+			{
+				InputSensorActionParam const & p = static_cast<InputSensorActionParam const &>(param);
+				WriteValue(os, p.latitude);
+				WriteValue(os, p.longitude);
+				WriteValue(os, p.altitude);
+				WriteValue(os, p.location_error_radius);
+				WriteValue(os, p.location_altitude_error);
+				WriteValue(os, p.speed);
+				WriteValue(os, p.accel);
+				WriteValue(os, p.angular_velocity);
+				WriteValue(os, p.tilt);
+				WriteValue(os, p.magnetic_heading_north);
+				WriteValue(os, p.orientation_quat);
+				WriteValue(os, p.magnetometer_accuracy);
+			}
+			break;
+
+		default:
+			BOOST_ASSERT(false);
+			break;
+		}
+	}
+
+	void ReadParam(ResIdentifier& is, InputActionParam& param)
+	{
+		switch (param.type)
+		{
+		case InputEngine::IDT_Keyboard:
+			{
+				InputKeyboardActionParam& p = static_cast<InputKeyboardActionParam&>(param);
+				ReadValue(is, p.buttons_state);
+				ReadValue(is, p.buttons_down);
+				ReadValue(is, p.buttons_up);
+			}
+			break;
+
+		case InputEngine::IDT_Mouse:
+			{
+				InputMouseActionParam& p = static_cast<InputMouseActionParam&>(param);
+				ReadValue(is, p.move_vec);
+				ReadValue(is, p.wheel_delta);
+				ReadValue(is, p.abs_coord);
+				ReadValue(is, p.buttons_state);
+				ReadValue(is, p.buttons_down);
+				ReadValue(is, p.buttons_up);
+			}
+			break;
+
+		case InputEngine::IDT_Joystick:
+			{
+				InputJoystickActionParam& p = static_cast<InputJoystickActionParam&>(param);
+				ReadValue(is, p.pos);
+				ReadValue(is, p.rot);
+				ReadValue(is, p.slider);
+				ReadValue(is, p.buttons_state);
+				ReadValue(is, p.buttons_down);
+				ReadValue(is, p.buttons_up);
+			}
+			break;
+
+		case InputEngine::IDT_Touch:
+			{
+				InputTouchActionParam& p = static_cast<InputTouchActionParam&>(param);
+				uint16_t gesture;
+				ReadValue(is, gesture);
+				p.gesture = static_cast<TouchSemantic>(gesture);
+				ReadValue(is, p.center);
+				ReadValue(is, p.move_vec);
+				ReadValue(is, p.zoom);
+				ReadValue(is, p.rotate_angle);
+				ReadValue(is, p.wheel_delta);
+				for (size_t i = 0; i < p.touches_coord.size(); ++ i)
+				{
+					ReadValue(is, p.touches_coord[i]);
+				}
+				ReadValue(is, p.touches_state);
+				ReadValue(is, p.touches_down);
+				ReadValue(is, p.touches_up);
+			}
+			break;
+
+		case InputEngine::IDT_Sensor:
+			{
+				InputSensorActionParam& p = static_cast<InputSensorActionParam&>(param);
+				ReadValue(is, p.latitude);
+				ReadValue(is, p.longitude);
+				ReadValue(is, p.altitude);
+				ReadValue(is, p.location_error_radius);
+				ReadValue(is, p.location_altitude_error);
+				ReadValue(is, p.speed);
+				ReadValue(is, p.accel);
+				ReadValue(is, p.angular_velocity);
+				ReadValue(is, p.tilt);
+				ReadValue(is, p.magnetic_heading_north);
+				ReadValue(is, p.orientation_quat);
+				ReadValue(is, p.magnetometer_accuracy);
+			}
+			break;
+
+		default:
+			BOOST_ASSERT(false);
+			break;
+		}
+	}
+}
+
 namespace KlayGE
 {
 	class NullInputEngine : public InputEngine
@@ -97,6 +338,12 @@ namespace KlayGE
 	//////////////////////////////////////////////////////////////////////////////////
 	void InputEngine::Update()
 	{
+		if (replay_stream_)
+		{
+			this->ReplayActions();
+			return;
+		}
+
 		elapsed_time_ = static_cast<float>(timer_.elapsed());
 		if (elapsed_time_ > 0.01f)
 		{
@@ -108,37 +355,169 @@ namespace KlayGE
 				device->UpdateInputs();
 			}
 
+			record_actions_.clear();
 			for (uint32_t id = 0; id < action_handlers_.size(); ++ id)
 			{
-#ifdef KLAYGE_DONT_USE_BOOST_FLAT_MAP
-				std::map<uint16_t, InputActionParamPtr> actions;
-#else
-				boost::container::flat_map<uint16_t, InputActionParamPtr> actions;
-#endif
-
 				// 豸
+				actions_.clear();
 				typedef KLAYGE_DECLTYPE(devices_) DevicesType;
 				KLAYGE_FOREACH(DevicesType::reference device, devices_)
 				{
-					InputActionsType const theAction(device->UpdateActionMap(id));
+					device->UpdateActionMap(id, actions_);
+				}
+
+				for (size_t i = 0; i < actions_.size(); ++ i)
+				{
+					InputAction const & act = actions_[i];
 
 					// ȥظĶ
-					typedef KLAYGE_DECLTYPE(theAction) ActionType;
-					KLAYGE_FOREACH(ActionType::const_reference act, theAction)
+					bool duplicated = false;
+					for (size_t j = 0; j < i; ++ j)
 					{
-						if (actions.find(act.first) == actions.end())
+						if (actions_[j].first == act.first)
 						{
-							actions.insert(act);
+							duplicated = true;
+							break;
+						}
+					}
 
-							// 
-							(*action_handlers_[id].second)(*this, act);
+					if (!duplicated)
+					{
+						if (record_stream_)
+						{
+							record_actions_.push_back(std::make_pair(id, act));
 						}
+
+						// 
+						(*action_handlers_[id].second)(*this, act);
 					}
 				}
 			}
+
+			if (record_stream_)
+			{
+				WriteValue(*record_stream_, elapsed_time_);
+				WriteValue(*record_stream_, static_cast<uint32_t>(record_actions_.size()));
+				for (size_t i = 0; i < record_actions_.size(); ++ i)
+				{
+					InputAction const & act = record_actions_[i].second;
+					WriteValue(*record_stream_, record_actions_[i].first);
+					WriteValue(*record_stream_, act.first);
+					WriteValue(*record_stream_, static_cast<uint16_t>(act.second->type));
+					WriteParam(*record_stream_, *act.second);
+				}
+			}
+		}
+	}
+
+	void InputEngine::ReplayActions()
+	{
+		float elapsed_time;
+		uint32_t num_actions;
+		ReadValue(*replay_stream_, elapsed_time);
+		ReadValue(*replay_stream_, num_actions);
+		if (!*replay_stream_)
+		{
+			// The end of the recording, go back to the devices
+			this->StopReplaying();
+			return;
+		}
+
+		elapsed_time_ = elapsed_time;
+		for (uint32_t i = 0; i < num_actions; ++ i)
+		{
+			uint32_t id;
+			uint16_t action;
+			uint16_t type;
+			ReadValue(*replay_stream_, id);
+			ReadValue(*replay_stream_, action);
+			ReadValue(*replay_stream_, type);
+			if (type >= replay_params_.size())
+			{
+				this->StopReplaying();
+				return;
+			}
+
+			InputActionParamPtr const & param = replay_params_[type];
+			ReadParam(*replay_stream_, *param);
+			if (id < action_handlers_.size())
+			{
+				(*action_handlers_[id].second)(*this, InputAction(action, param));
+			}
+		}
+	}
+
+	void InputEngine::StartRecording(std::string const & file_name)
+	{
+		this->StopRecording();
+
+		record_stream_ = MakeSharedPtr<std::ofstream>(file_name.c_str(), std::ios_base::binary | std::ios_base::out);
+		if (*record_stream_)
+		{
+			WriteValue(*record_stream_, MakeFourCC<'K', 'I', 'R', ' '>::value);
+			WriteValue(*record_stream_, INPUT_RECORD_VERSION);
+		}
+		else
+		{
+			record_stream_.reset();
+		}
+	}
+
+	void InputEngine::StopRecording()
+	{
+		record_stream_.reset();
+		record_actions_.clear();
+	}
+
+	bool InputEngine::Recording() const
+	{
+		return !!record_stream_;
+	}
+
+	void InputEngine::StartReplaying(std::string const & res_name)
+	{
+		this->StopReplaying();
+
+		replay_stream_ = ResLoader::Instance().Open(res_name);
+		if (replay_stream_)
+		{
+			uint32_t fourcc;
+			uint32_t ver;
+			ReadValue(*replay_stream_, fourcc);
+			ReadValue(*replay_stream_, ver);
+			if ((MakeFourCC<'K', 'I', 'R', ' '>::value == fourcc) && (INPUT_RECORD_VERSION == ver))
+			{
+				replay_params_[IDT_Keyboard] = MakeSharedPtr<InputKeyboardActionParam>();
+				replay_params_[IDT_Mouse] = MakeSharedPtr<InputMouseActionParam>();
+				replay_params_[IDT_Joystick] = MakeSharedPtr<InputJoystickActionParam>();
+				replay_params_[IDT_Touch] = MakeSharedPtr<InputTouchActionParam>();
+				replay_params_[IDT_Sensor] = MakeSharedPtr<InputSensorActionParam>();
+				for (uint32_t i = 0; i < replay_params_.size(); ++ i)
+				{
+					replay_params_[i]->type = static_cast<InputDeviceType>(i);
+				}
+			}
+			else
+			{
+				replay_stream_.reset();
+			}
 		}
 	}
 
+	void InputEngine::StopReplaying()
+	{
+		if (replay_stream_)
+		{
+			replay_stream_.reset();
+			timer_.restart();
+		}
+	}
+
+	bool InputEngine::Replaying() const
+	{
+		return !!replay_stream_;
+	}
+
 	// ȡˢʱ
 	//////////////////////////////////////////////////////////////////////////////////
 	float InputEngine::ElapsedTime() const
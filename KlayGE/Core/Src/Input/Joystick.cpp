@@ -142,10 +142,8 @@ namespace KlayGE
 
 	// Ϸ˶
 	/////////////////////////////////////////////////////////////////////////////////
-	InputActionsType InputJoystick::UpdateActionMap(uint32_t id)
+	void InputJoystick::UpdateActionMap(uint32_t id, InputActionsType& actions)
 	{
-		InputActionsType ret;
-
 		InputActionMap& iam = actionMaps_[id];
 
 		action_param_->pos = pos_;
@@ -161,31 +159,29 @@ namespace KlayGE
 			action_param_->buttons_up |= (this->ButtonUp(i)? (1UL << i) : 0);
 		}
 
-		actionMaps_[id].UpdateInputActions(ret, JS_XPos, action_param_);
-		actionMaps_[id].UpdateInputActions(ret, JS_YPos, action_param_);
-		actionMaps_[id].UpdateInputActions(ret, JS_ZPos, action_param_);
-		actionMaps_[id].UpdateInputActions(ret, JS_XRot, action_param_);
-		actionMaps_[id].UpdateInputActions(ret, JS_YRot, action_param_);
-		actionMaps_[id].UpdateInputActions(ret, JS_ZRot, action_param_);
+		actionMaps_[id].UpdateInputActions(actions, JS_XPos, action_param_);
+		actionMaps_[id].UpdateInputActions(actions, JS_YPos, action_param_);
+		actionMaps_[id].UpdateInputActions(actions, JS_ZPos, action_param_);
+		actionMaps_[id].UpdateInputActions(actions, JS_XRot, action_param_);
+		actionMaps_[id].UpdateInputActions(actions, JS_YRot, action_param_);
+		actionMaps_[id].UpdateInputActions(actions, JS_ZRot, action_param_);
 
 		for (uint16_t i = 0; i < slider_.size(); ++ i)
 		{
-			iam.UpdateInputActions(ret, static_cast<uint16_t>(JS_Slider0 + i), action_param_);
+			iam.UpdateInputActions(actions, static_cast<uint16_t>(JS_Slider0 + i), action_param_);
 		}
 		bool any_button = false;
 		for (uint16_t i = 0; i < this->NumButtons(); ++ i)
 		{
 			if (buttons_[index_][i] || buttons_[!index_][i])
 			{
-				iam.UpdateInputActions(ret, static_cast<uint16_t>(JS_Button0 + i), action_param_);
+				iam.UpdateInputActions(actions, static_cast<uint16_t>(JS_Button0 + i), action_param_);
 				any_button = true;
 			}
 		}
 		if (any_button)
 		{
-			iam.UpdateInputActions(ret, JS_AnyButton, action_param_);
+			iam.UpdateInputActions(actions, JS_AnyButton, action_param_);
 		}
-
-		return ret;
 	}
 }
@@ -87,10 +87,8 @@ namespace KlayGE
 
 	// ¼̶
 	//////////////////////////////////////////////////////////////////////////////////
-	InputActionsType InputKeyboard::UpdateActionMap(uint32_t id)
+	void InputKeyboard::UpdateActionMap(uint32_t id, InputActionsType& actions)
 	{
-		InputActionsType ret;
-
 		InputActionMap& iam = actionMaps_[id];
 
 		for (uint16_t i = 0; i < this->NumKeys(); ++ i)
@@ -105,15 +103,13 @@ namespace KlayGE
 		{
 			if (keys_[index_][i] || keys_[!index_][i])
 			{
-				iam.UpdateInputActions(ret, i, action_param_);
+				iam.UpdateInputActions(actions, i, action_param_);
 				any_key = true;
 			}
 		}
 		if (any_key)
 		{
-			iam.UpdateInputActions(ret, KS_AnyKey, action_param_);
+			iam.UpdateInputActions(actions, KS_AnyKey, action_param_);
 		}
-
-		return ret;
 	}
 }
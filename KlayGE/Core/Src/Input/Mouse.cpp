@@ -140,10 +140,8 @@ namespace KlayGE
 
 	// 궯
 	//////////////////////////////////////////////////////////////////////////////////
-	InputActionsType InputMouse::UpdateActionMap(uint32_t id)
+	void InputMouse::UpdateActionMap(uint32_t id, InputActionsType& actions)
 	{
-		InputActionsType ret;
-
 		InputActionMap& iam = actionMaps_[id];
 
 		action_param_->move_vec = int2(offset_.x(), offset_.y());
@@ -161,30 +159,28 @@ namespace KlayGE
 
 		if (offset_.x() != 0)
 		{
-			iam.UpdateInputActions(ret, MS_X, action_param_);
+			iam.UpdateInputActions(actions, MS_X, action_param_);
 		}
 		if (offset_.y() != 0)
 		{
-			iam.UpdateInputActions(ret, MS_Y, action_param_);
+			iam.UpdateInputActions(actions, MS_Y, action_param_);
 		}
 		if (offset_.z() != 0)
 		{
-			iam.UpdateInputActions(ret, MS_Z, action_param_);
+			iam.UpdateInputActions(actions, MS_Z, action_param_);
 		}
 		bool any_button = false;
 		for (uint16_t i = 0; i < this->NumButtons(); ++ i)
 		{
 			if (buttons_[index_][i] || buttons_[!index_][i])
 			{
-				iam.UpdateInputActions(ret, static_cast<uint16_t>(MS_Button0 + i), action_param_);
+				iam.UpdateInputActions(actions, static_cast<uint16_t>(MS_Button0 + i), action_param_);
 				any_button = true;
 			}
 		}
 		if (any_button)
 		{
-			iam.UpdateInputActions(ret, MS_AnyButton, action_param_);
+			iam.UpdateInputActions(actions, MS_AnyButton, action_param_);
 		}
-
-		return ret;
 	}
 }
@@ -114,10 +114,8 @@ namespace KlayGE
 		}
 	}
 
-	InputActionsType InputSensor::UpdateActionMap(uint32_t id)
+	void InputSensor::UpdateActionMap(uint32_t id, InputActionsType& actions)
 	{
-		InputActionsType ret;
-
 		InputActionMap& iam = actionMaps_[id];
 
 		action_param_->latitude = latitude_;
@@ -136,71 +134,69 @@ namespace KlayGE
 		bool any_sensing = false;
 		if ((latitude_ <= 90) && (latitude_ >= -90))
 		{
-			iam.UpdateInputActions(ret, SS_Latitude, action_param_);
+			iam.UpdateInputActions(actions, SS_Latitude, action_param_);
 			any_sensing = true;
 		}
 		if ((longitude_ <= 180) && (longitude_ > -180))
 		{
-			iam.UpdateInputActions(ret, SS_Longitude, action_param_);
+			iam.UpdateInputActions(actions, SS_Longitude, action_param_);
 			any_sensing = true;
 		}
 		if (altitude_ >= 0)
 		{
-			iam.UpdateInputActions(ret, SS_Altitude, action_param_);
+			iam.UpdateInputActions(actions, SS_Altitude, action_param_);
 			any_sensing = true;
 		}
 		if (location_error_radius_ >= 0)
 		{
-			iam.UpdateInputActions(ret, SS_LocationErrorRadius, action_param_);
+			iam.UpdateInputActions(actions, SS_LocationErrorRadius, action_param_);
 			any_sensing = true;
 		}
 		if (location_altitude_error_ >= 0)
 		{
-			iam.UpdateInputActions(ret, SS_LocationAltitudeError, action_param_);
+			iam.UpdateInputActions(actions, SS_LocationAltitudeError, action_param_);
 			any_sensing = true;
 		}
 		if (speed_ >= 0)
 		{
-			iam.UpdateInputActions(ret, SS_Speed, action_param_);
+			iam.UpdateInputActions(actions, SS_Speed, action_param_);
 			any_sensing = true;
 		}
 		if ((accel_.x() != 0) || (accel_.y() != 0) || (accel_.z() != 0))
 		{
-			iam.UpdateInputActions(ret, SS_Accel, action_param_);
+			iam.UpdateInputActions(actions, SS_Accel, action_param_);
 			any_sensing = true;
 		}
 		if ((angular_velocity_.x() != 0) || (angular_velocity_.y() != 0) || (angular_velocity_.z() != 0))
 		{
-			iam.UpdateInputActions(ret, SS_AngularVelocity, action_param_);
+			iam.UpdateInputActions(actions, SS_AngularVelocity, action_param_);
 			any_sensing = true;
 		}
 		if ((tilt_.x() != 0) || (tilt_.y() != 0) || (tilt_.z() != 0))
 		{
-			iam.UpdateInputActions(ret, SS_Tilt, action_param_);
+			iam.UpdateInputActions(actions, SS_Tilt, action_param_);
 			any_sensing = true;
 		}
 		if (magnetic_heading_north_ >= 0)
 		{
-			iam.UpdateInputActions(ret, SS_MagneticHeadingNorth, action_param_);
+			iam.UpdateInputActions(actions, SS_MagneticHeadingNorth, action_param_);
 			any_sensing = true;
 		}
 		if ((orientation_quat_.x() != 0) || (orientation_quat_.y() != 0) || (orientation_quat_.z() != 0)
 			|| (orientation_quat_.w() != 0))
 		{
-			iam.UpdateInputActions(ret, SS_OrientationQuat, action_param_);
+			iam.UpdateInputActions(actions, SS_OrientationQuat, action_param_);
 			any_sensing = true;
 		}
 		if (magnetometer_accuracy_ > 0)
 		{
-			iam.UpdateInputActions(ret, SS_MagnetometerAccuracy, action_param_);
+			iam.UpdateInputActions(actions, SS_MagnetometerAccuracy, action_param_);
 			any_sensing = true;
 		}
 
 		if (any_sensing)
 		{
-			iam.UpdateInputActions(ret, SS_AnySensing, action_param_);
+			iam.UpdateInputActions(actions, SS_AnySensing, action_param_);
 		}
-
-		return ret;
 	}
 }
@@ -89,10 +89,8 @@ namespace KlayGE
 		}
 	}
 
-	InputActionsType InputTouch::UpdateActionMap(uint32_t id)
+	void InputTouch::UpdateActionMap(uint32_t id, InputActionsType& actions)
 	{
-		InputActionsType ret;
-
 		InputActionMap& iam = actionMaps_[id];
 
 		action_param_->gesture = gesture_;
@@ -114,27 +112,25 @@ namespace KlayGE
 			action_param_->move_vec = int2(0, 0);
 			action_param_->zoom = 1;
 			action_param_->rotate_angle = 0;
-			iam.UpdateInputActions(ret, TS_Wheel, action_param_);
+			iam.UpdateInputActions(actions, TS_Wheel, action_param_);
 		}
 		if (gesture_ != TS_None)
 		{
-			iam.UpdateInputActions(ret, static_cast<uint16_t>(gesture_), action_param_);
+			iam.UpdateInputActions(actions, static_cast<uint16_t>(gesture_), action_param_);
 		}
 		bool any_touch = false;
 		for (uint16_t i = 0; i < touch_coords_[index_].size(); ++ i)
 		{
 			if (touch_downs_[index_][i] || touch_downs_[!index_][i])
 			{
-				iam.UpdateInputActions(ret, static_cast<uint16_t>(TS_Touch0 + i), action_param_);
+				iam.UpdateInputActions(actions, static_cast<uint16_t>(TS_Touch0 + i), action_param_);
 				any_touch = true;
 			}
 		}
 		if (any_touch)
 		{
-			iam.UpdateInputActions(ret, TS_AnyTouch, action_param_);
+			iam.UpdateInputActions(actions, TS_AnyTouch, action_param_);
 		}
-
-		return ret;
 	}
 
 	void InputTouch::CurrState(GestureState state)
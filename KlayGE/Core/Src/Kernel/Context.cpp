@@ -35,6 +35,7 @@
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KFL/Thread.hpp>
 #include <KlayGE/PerfProfiler.hpp>
+#include <KlayGE/ShaderCache.hpp>
 #include <KlayGE/UI.hpp>
 
 #include <fstream>
@@ -102,6 +103,7 @@ namespace KlayGE
 
 		ResLoader::Destroy();
 		PerfProfiler::Destroy();
+		ShaderCache::Destroy();
 		UIManager::Destroy();
 
 		deferred_rendering_layer_.reset();
@@ -147,6 +149,7 @@ namespace KlayGE
 
 		ResLoader::Instance().Suspend();
 		PerfProfiler::Instance().Suspend();
+		ShaderCache::Instance().Suspend();
 		UIManager::Instance().Suspend();
 
 		if (deferred_rendering_layer_)
@@ -188,6 +191,7 @@ namespace KlayGE
 
 		ResLoader::Instance().Resume();
 		PerfProfiler::Instance().Resume();
+		ShaderCache::Instance().Resume();
 		UIManager::Instance().Resume();
 
 		if (deferred_rendering_layer_)
@@ -240,6 +244,9 @@ namespace KlayGE
 		std::string graphics_options;
 		bool perf_profiler = false;
 		bool location_sensor = false;
+		std::string shader_cache_path = "ShaderCache";
+		int shader_cache_size = 64;
+		bool pipelined_update = false;
 
 		std::string rf_name = "D3D11";
 		std::string af_name = "OpenAL";
@@ -312,6 +319,27 @@ namespace KlayGE
 				location_sensor = location_sensor_node->Attrib("enabled")->ValueInt() ? true : false;
 			}
 
+			XMLNodePtr shader_cache_node = context_node->FirstNode("shader_cache");
+			if (shader_cache_node)
+			{
+				XMLAttributePtr path_attr = shader_cache_node->Attrib("path");
+				if (path_attr)
+				{
+					shader_cache_path = path_attr->ValueString();
+				}
+				XMLAttributePtr size_attr = shader_cache_node->Attrib("size");
+				if (size_attr)
+				{
+					shader_cache_size = size_attr->ValueInt();
+				}
+			}
+
+			XMLNodePtr pipelined_update_node = context_node->FirstNode("pipelined_update");
+			if (pipelined_update_node)
+			{
+				pipelined_update = pipelined_update_node->Attrib("enabled")->ValueInt() ? true : false;
+			}
+
 			XMLNodePtr frame_node = graphics_node->FirstNode("frame");
 			XMLAttributePtr attr;
 			attr = frame_node->Attrib("width");
@@ -608,6 +636,9 @@ namespace KlayGE
 		cfg_.deferred_rendering = false;
 		cfg_.perf_profiler = perf_profiler;
 		cfg_.location_sensor = location_sensor;
+		cfg_.shader_cache_path = shader_cache_path;
+		cfg_.shader_cache_size = std::max(shader_cache_size, 0);
+		cfg_.pipelined_update = pipelined_update;
 	}
 
 	void Context::SaveCfg(std::string const & cfg_file)
@@ -653,6 +684,15 @@ namespace KlayGE
 			XMLNodePtr location_sensor_node = cfg_doc.AllocNode(XNT_Element, "location_sensor");
 			location_sensor_node->AppendAttrib(cfg_doc.AllocAttribInt("enabled", cfg_.location_sensor));
 			context_node->AppendNode(location_sensor_node);
+
+			XMLNodePtr shader_cache_node = cfg_doc.AllocNode(XNT_Element, "shader_cache");
+			shader_cache_node->AppendAttrib(cfg_doc.AllocAttribString("path", cfg_.shader_cache_path));
+			shader_cache_node->AppendAttrib(cfg_doc.AllocAttribInt("size", cfg_.shader_cache_size));
+			context_node->AppendNode(shader_cache_node);
+
+			XMLNodePtr pipelined_update_node = cfg_doc.AllocNode(XNT_Element, "pipelined_update");
+			pipelined_update_node->AppendAttrib(cfg_doc.AllocAttribInt("enabled", cfg_.pipelined_update));
+			context_node->AppendNode(pipelined_update_node);
 		}
 		root->AppendNode(context_node);
 
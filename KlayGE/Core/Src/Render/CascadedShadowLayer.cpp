@@ -66,10 +66,7 @@ namespace KlayGE
 		corners[6] = float3(-far_x, -far_y, far_z);
 		corners[7] = float3(+far_x, -far_y, far_z);
 
-		for (uint32_t i = 0; i < 8; ++ i)
-		{
-			corners[i] = MathLib::transform_coord(corners[i], view_to_light_proj);
-		}
+		MathLib::transform_coord(corners, corners, 8, view_to_light_proj);
 
 		return MathLib::compute_aabbox(corners, corners + 8);
 	}
@@ -57,6 +57,8 @@ namespace KlayGE
 
 #if DEFAULT_DEFERRED == LIGHT_INDEXED_DEFERRED
 	uint32_t const TILE_SIZE = 32;
+	// Lights are binned to tiles on the thread pool in chunks of this size
+	uint32_t const LIGHT_BINNING_CHUNK = 256;
 #endif
 
 	template <typename T>
@@ -486,6 +488,21 @@ namespace KlayGE
 			init_data.data = &pos[0];
 			rl_quad_->BindVertexStream(rf.MakeVertexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable, &init_data),
 				make_tuple(vertex_element(VEU_Position, 0, EF_BGR32F)));
+
+#if DEFAULT_DEFERRED == LIGHT_INDEXED_DEFERRED
+			if (!cs_tbdr_)
+			{
+				rl_light_index_quad_ = rf.MakeRenderLayout();
+				rl_light_index_quad_->TopologyType(RenderLayout::TT_TriangleStrip);
+				rl_light_index_quad_->BindVertexStream(rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, &init_data),
+					make_tuple(vertex_element(VEU_Position, 0, EF_BGR32F)));
+
+				rl_light_shading_quad_ = rf.MakeRenderLayout();
+				rl_light_shading_quad_->TopologyType(RenderLayout::TT_TriangleStrip);
+				rl_light_shading_quad_->BindVertexStream(rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, &init_data),
+					make_tuple(vertex_element(VEU_Position, 0, EF_BGR32F)));
+			}
+#endif
 		}
 
 		light_volume_rl_[LightSource::LT_Ambient] = rl_quad_;
@@ -3060,6 +3077,9 @@ namespace KlayGE
 			}
 		}
 
+		int4 const all_tiles(0, 0, static_cast<int32_t>(pvp.light_index_tex->Width(0)) - 1,
+			static_cast<int32_t>(pvp.light_index_tex->Height(0)) - 1);
+
 		{
 			uint32_t li = 0;
 			while (li < directional_lights.size())
@@ -3071,17 +3091,7 @@ namespace KlayGE
 				li += nl;
 			}
 		}
-		{
-			uint32_t li = 0;
-			while (li < point_lights_no_shadow.size())
-			{
-				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(point_lights_no_shadow.size() - li));
-				std::vector<uint32_t>::iterator iter_beg = point_lights_no_shadow.begin() + li;
-				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
-				li += nl;
-			}
-		}
+		this->UpdateLightIndexedLightingTiled(pvp, g_buffer_index, point_lights_no_shadow);
 		{
 			uint32_t li = 0;
 			while (li < point_lights_shadow.size())
@@ -3089,21 +3099,11 @@ namespace KlayGE
 				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(point_lights_shadow.size() - li));
 				std::vector<uint32_t>::iterator iter_beg = point_lights_shadow.begin() + li;
 				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
-				li += nl;
-			}
-		}
-		{
-			uint32_t li = 0;
-			while (li < spot_lights_no_shadow.size())
-			{
-				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(spot_lights_no_shadow.size() - li));
-				std::vector<uint32_t>::iterator iter_beg = spot_lights_no_shadow.begin() + li;
-				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
+				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end, all_tiles);
 				li += nl;
 			}
 		}
+		this->UpdateLightIndexedLightingTiled(pvp, g_buffer_index, spot_lights_no_shadow);
 		{
 			uint32_t li = 0;
 			while (li < spot_lights_shadow.size())
@@ -3111,21 +3111,11 @@ namespace KlayGE
 				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(spot_lights_shadow.size() - li));
 				std::vector<uint32_t>::iterator iter_beg = spot_lights_shadow.begin() + li;
 				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
-				li += nl;
-			}
-		}
-		{
-			uint32_t li = 0;
-			while (li < sphere_area_lights_no_shadow.size())
-			{
-				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(sphere_area_lights_no_shadow.size() - li));
-				std::vector<uint32_t>::iterator iter_beg = sphere_area_lights_no_shadow.begin() + li;
-				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
+				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end, all_tiles);
 				li += nl;
 			}
 		}
+		this->UpdateLightIndexedLightingTiled(pvp, g_buffer_index, sphere_area_lights_no_shadow);
 		{
 			uint32_t li = 0;
 			while (li < sphere_area_lights_shadow.size())
@@ -3133,21 +3123,11 @@ namespace KlayGE
 				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(sphere_area_lights_shadow.size() - li));
 				std::vector<uint32_t>::iterator iter_beg = sphere_area_lights_shadow.begin() + li;
 				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
-				li += nl;
-			}
-		}
-		{
-			uint32_t li = 0;
-			while (li < tube_area_lights_no_shadow.size())
-			{
-				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(tube_area_lights_no_shadow.size() - li));
-				std::vector<uint32_t>::iterator iter_beg = tube_area_lights_no_shadow.begin() + li;
-				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
+				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end, all_tiles);
 				li += nl;
 			}
 		}
+		this->UpdateLightIndexedLightingTiled(pvp, g_buffer_index, tube_area_lights_no_shadow);
 		{
 			uint32_t li = 0;
 			while (li < tube_area_lights_shadow.size())
@@ -3155,7 +3135,7 @@ namespace KlayGE
 				uint32_t nl = std::min(light_batch_, static_cast<uint32_t>(tube_area_lights_shadow.size() - li));
 				std::vector<uint32_t>::iterator iter_beg = tube_area_lights_shadow.begin() + li;
 				std::vector<uint32_t>::iterator iter_end = iter_beg + nl;
-				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end);
+				this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, iter_beg, iter_end, all_tiles);
 				li += nl;
 			}
 		}
@@ -3290,10 +3270,33 @@ namespace KlayGE
 	}
 
 	void DeferredRenderingLayer::UpdateLightIndexedLightingPointSpotArea(PerViewport const & pvp, uint32_t g_buffer_index,
-		std::vector<uint32_t>::const_iterator iter_beg, std::vector<uint32_t>::const_iterator iter_end)
+		std::vector<uint32_t>::const_iterator iter_beg, std::vector<uint32_t>::const_iterator iter_end,
+		int4 const & tile_rect)
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
+		// Both passes only cover the tiles that the batch can touch. The index pass works on the tile grid,
+		// and the shading pass on the pixels of those tiles.
+		uint32_t const tiles_x = pvp.light_index_tex->Width(0);
+		uint32_t const tiles_y = pvp.light_index_tex->Height(0);
+		RenderLayoutPtr light_index_rl = rl_quad_;
+		RenderLayoutPtr light_shading_rl = rl_quad_;
+		if ((tile_rect.x() > 0) || (tile_rect.y() > 0)
+			|| (tile_rect.z() + 1 < static_cast<int32_t>(tiles_x)) || (tile_rect.w() + 1 < static_cast<int32_t>(tiles_y)))
+		{
+			this->UpdateTileQuad(rl_light_index_quad_, float4(static_cast<float>(tile_rect.x()) / tiles_x,
+				static_cast<float>(tile_rect.y()) / tiles_y,
+				static_cast<float>(tile_rect.z() + 1) / tiles_x, static_cast<float>(tile_rect.w() + 1) / tiles_y));
+			light_index_rl = rl_light_index_quad_;
+
+			float const width = static_cast<float>(pvp.g_buffer_depth_tex->Width(0));
+			float const height = static_cast<float>(pvp.g_buffer_depth_tex->Height(0));
+			this->UpdateTileQuad(rl_light_shading_quad_, float4(tile_rect.x() * TILE_SIZE / width,
+				tile_rect.y() * TILE_SIZE / height,
+				std::min((tile_rect.z() + 1) * TILE_SIZE / width, 1.0f), std::min((tile_rect.w() + 1) * TILE_SIZE / height, 1.0f)));
+			light_shading_rl = rl_light_shading_quad_;
+		}
+
 		re.BindFrameBuffer(pvp.light_index_fb);
 		pvp.light_index_fb->Attached(FrameBuffer::ATT_Color0)->ClearColor(Color(0, 0, 0, 0));
 
@@ -3412,7 +3415,7 @@ namespace KlayGE
 		{
 			tech = technique_draw_light_index_spot_;
 		}
-		re.Render(*tech, *rl_quad_);
+		re.Render(*tech, *light_index_rl);
 
 		*light_index_tex_param_ = pvp.light_index_tex;
 		*g_buffer_tex_param_ = pvp.g_buffer_rt0_tex;
@@ -3478,7 +3481,158 @@ namespace KlayGE
 			BOOST_ASSERT(false);
 			break;
 		}
-		re.Render(*tech, *rl_quad_);
+		re.Render(*tech, *light_shading_rl);
+	}
+
+	// Lights of one type are binned to the tile grid on the CPU, and batched in the order of their position
+	// on screen, so each batch only needs to index and shade the tiles around it.
+	void DeferredRenderingLayer::UpdateLightIndexedLightingTiled(PerViewport const & pvp, uint32_t g_buffer_index,
+		std::vector<uint32_t> const & light_indices)
+	{
+		uint32_t const num_lights = static_cast<uint32_t>(light_indices.size());
+		if (0 == num_lights)
+		{
+			return;
+		}
+
+		std::vector<int4> tile_rects(num_lights);
+		{
+			std::vector<joiner<void> > joiners;
+			for (uint32_t begin = LIGHT_BINNING_CHUNK; begin < num_lights; begin += LIGHT_BINNING_CHUNK)
+			{
+				joiners.push_back(Context::Instance().ThreadPool()(bind(&DeferredRenderingLayer::CalcLightTileRects, this,
+					cref(pvp), cref(light_indices), ref(tile_rects), begin, std::min(begin + LIGHT_BINNING_CHUNK, num_lights))));
+			}
+			this->CalcLightTileRects(pvp, light_indices, tile_rects, 0, std::min(LIGHT_BINNING_CHUNK, num_lights));
+			for (size_t i = 0; i < joiners.size(); ++ i)
+			{
+				joiners[i]();
+			}
+		}
+
+		// Sort by the Morton code of the tile in the middle of each light's footprint
+		std::vector<std::pair<uint32_t, uint32_t> > sorted_lights;
+		sorted_lights.reserve(num_lights);
+		for (uint32_t i = 0; i < num_lights; ++ i)
+		{
+			int4 const & rect = tile_rects[i];
+			if ((rect.x() <= rect.z()) && (rect.y() <= rect.w()))
+			{
+				uint32_t x = static_cast<uint32_t>(rect.x() + rect.z()) / 2;
+				uint32_t y = static_cast<uint32_t>(rect.y() + rect.w()) / 2;
+				uint32_t code = 0;
+				for (uint32_t bit = 0; bit < 16; ++ bit)
+				{
+					code |= ((x >> bit) & 1) << (bit * 2 + 0);
+					code |= ((y >> bit) & 1) << (bit * 2 + 1);
+				}
+				sorted_lights.push_back(std::make_pair(code, i));
+			}
+		}
+		std::sort(sorted_lights.begin(), sorted_lights.end());
+
+		std::vector<uint32_t> batch;
+		batch.reserve(light_batch_);
+		for (size_t i = 0; i < sorted_lights.size(); i += light_batch_)
+		{
+			size_t const batch_end = std::min(i + light_batch_, sorted_lights.size());
+
+			batch.clear();
+			int4 batch_rect = tile_rects[sorted_lights[i].second];
+			for (size_t j = i; j < batch_end; ++ j)
+			{
+				uint32_t const index = sorted_lights[j].second;
+				batch.push_back(light_indices[index]);
+
+				int4 const & rect = tile_rects[index];
+				batch_rect = int4(std::min(batch_rect.x(), rect.x()), std::min(batch_rect.y(), rect.y()),
+					std::max(batch_rect.z(), rect.z()), std::max(batch_rect.w(), rect.w()));
+			}
+
+			this->UpdateLightIndexedLightingPointSpotArea(pvp, g_buffer_index, batch.begin(), batch.end(), batch_rect);
+		}
+	}
+
+	// Conservative rectangles of tiles, inclusive, that lights can touch. Empty rectangles have x > z.
+	// The light volumes are the same as the ones the DrawLightIndex techniques test against.
+	void DeferredRenderingLayer::CalcLightTileRects(PerViewport const & pvp, std::vector<uint32_t> const & light_indices,
+		std::vector<int4>& tile_rects, uint32_t begin, uint32_t end)
+	{
+		int32_t const tiles_x = static_cast<int32_t>(pvp.light_index_tex->Width(0));
+		int32_t const tiles_y = static_cast<int32_t>(pvp.light_index_tex->Height(0));
+		float const near_plane = -pvp.proj(3, 2) / pvp.proj(2, 2);
+
+		for (uint32_t i = begin; i < end; ++ i)
+		{
+			LightSourcePtr const & light = lights_[light_indices[i]];
+			float const range = light->Range() * light_scale_;
+
+			AABBox aabb_es(float3(0, 0, 0), float3(0, 0, 0));
+			if (LightSource::LT_Spot == light->Type())
+			{
+				float4x4 light_to_view = light->SMCamera(0)->InverseViewMatrix() * pvp.view;
+				float const scale = light->CosOuterInner().w();
+				float4x4 light_model = MathLib::scaling(range * 0.01f * float3(scale, scale, 1));
+				aabb_es = MathLib::transform_aabb(cone_aabb_, light_model * light_to_view);
+			}
+			else
+			{
+				float3 const pos_es = MathLib::transform_coord(light->Position(), pvp.view);
+				float3 const extent(range, range, range);
+				aabb_es = AABBox(pos_es - extent, pos_es + extent);
+			}
+
+			int4& rect = tile_rects[i];
+			if (aabb_es.Min().z() <= near_plane)
+			{
+				rect = int4(0, 0, tiles_x - 1, tiles_y - 1);
+			}
+			else
+			{
+				float2 ndc_min(+1e10f, +1e10f);
+				float2 ndc_max(-1e10f, -1e10f);
+				for (int j = 0; j < 8; ++ j)
+				{
+					float3 const ndc = MathLib::transform_coord(aabb_es.Corner(j), pvp.proj);
+					ndc_min = MathLib::minimize(ndc_min, float2(ndc.x(), ndc.y()));
+					ndc_max = MathLib::maximize(ndc_max, float2(ndc.x(), ndc.y()));
+				}
+
+				if ((ndc_max.x() < -1) || (ndc_min.x() > 1) || (ndc_max.y() < -1) || (ndc_min.y() > 1))
+				{
+					rect = int4(0, 0, -1, -1);
+				}
+				else
+				{
+					// Tile rows go downwards, the same as texture coordinates
+					rect = int4(MathLib::clamp(static_cast<int32_t>((ndc_min.x() * 0.5f + 0.5f) * tiles_x), 0, tiles_x - 1),
+						MathLib::clamp(static_cast<int32_t>((0.5f - ndc_max.y() * 0.5f) * tiles_y), 0, tiles_y - 1),
+						MathLib::clamp(static_cast<int32_t>((ndc_max.x() * 0.5f + 0.5f) * tiles_x), 0, tiles_x - 1),
+						MathLib::clamp(static_cast<int32_t>((0.5f - ndc_min.y() * 0.5f) * tiles_y), 0, tiles_y - 1));
+				}
+			}
+		}
+	}
+
+	// tc_rect is (left, top, right, bottom) in texture coordinates
+	void DeferredRenderingLayer::UpdateTileQuad(RenderLayoutPtr const & rl, float4 const & tc_rect)
+	{
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		float const flipping = re.RequiresFlipping() ? -1.0f : +1.0f;
+
+		float const left = tc_rect.x() * 2 - 1;
+		float const right = tc_rect.z() * 2 - 1;
+		float const y0 = (tc_rect.y() - 0.5f) * 2 * flipping;
+		float const y1 = (tc_rect.w() - 0.5f) * 2 * flipping;
+		float const top = std::max(y0, y1);
+		float const bottom = std::min(y0, y1);
+
+		GraphicsBuffer::Mapper mapper(*rl->GetVertexStream(0), BA_Write_Only);
+		float3* pos = mapper.Pointer<float3>();
+		pos[0] = float3(right, top, 1);
+		pos[1] = float3(left, top, 1);
+		pos[2] = float3(right, bottom, 1);
+		pos[3] = float3(left, bottom, 1);
 	}
 
 	void DeferredRenderingLayer::CreateDepthMinMaxMap(PerViewport const & pvp)
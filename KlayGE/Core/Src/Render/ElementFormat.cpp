@@ -36,6 +36,76 @@
 
 #include <KFL/Math.hpp>
 #include <KFL/Half.hpp>
+#include <KFL/FormatConversion.hpp>
+
+#include <algorithm>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Formats with all 4 channels in RGBA order are converted with the bulk functions straight from/to the colors
+	KLAYGE_STATIC_ASSERT(sizeof(Color) == sizeof(float) * 4);
+
+	float* ColorChannels(Color* color)
+	{
+		return &color->r();
+	}
+
+	float const * ColorChannels(Color const * color)
+	{
+		return &color->r();
+	}
+
+	// Swaps R and B of 4-byte pixels in place, for ARGB8 formats
+	void SwapRB8(uint8_t* p, uint32_t num_elems)
+	{
+		for (uint32_t i = 0; i < num_elems; ++ i, p += 4)
+		{
+			std::swap(p[0], p[2]);
+		}
+	}
+
+	uint32_t const HALF_CHUNK_SIZE = 256;
+
+	// Half formats with fewer channels go through a small buffer, so that they're converted in bulk too
+	void HalfToABGR32F(half const * input, uint32_t num_channels, uint32_t num_elems, Color* output)
+	{
+		float buf[HALF_CHUNK_SIZE * 4];
+		for (uint32_t base = 0; base < num_elems; base += HALF_CHUNK_SIZE)
+		{
+			uint32_t const n = std::min(HALF_CHUNK_SIZE, num_elems - base);
+			HalfToFloat(buf, input + base * num_channels, n * num_channels);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				Color& color = output[base + i];
+				color = Color(0, 0, 0, 1);
+				for (uint32_t ch = 0; ch < num_channels; ++ ch)
+				{
+					color[ch] = buf[i * num_channels + ch];
+				}
+			}
+		}
+	}
+
+	void ABGR32FToHalf(Color const * input, uint32_t num_channels, uint32_t num_elems, half* output)
+	{
+		float buf[HALF_CHUNK_SIZE * 4];
+		for (uint32_t base = 0; base < num_elems; base += HALF_CHUNK_SIZE)
+		{
+			uint32_t const n = std::min(HALF_CHUNK_SIZE, num_elems - base);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				Color const & color = input[base + i];
+				for (uint32_t ch = 0; ch < num_channels; ++ ch)
+				{
+					buf[i * num_channels + ch] = color[ch];
+				}
+			}
+			FloatToHalf(output + base * num_channels, buf, n * num_channels);
+		}
+	}
+}
 
 namespace KlayGE
 {
@@ -114,25 +184,19 @@ namespace KlayGE
 			break;
 
 		case EF_ARGB8:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
+			UNorm8ToFloat(ColorChannels(output), p, num_elems * 4);
+			for (uint32_t i = 0; i < num_elems; ++ i, ++ output)
 			{
-				*output = Color(p[2] / 255.0f, p[1] / 255.0f, p[0] / 255.0f, p[3] / 255.0f);
+				std::swap(output->r(), output->b());
 			}
 			break;
 
 		case EF_ABGR8:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				*output = Color(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f);
-			}
+			UNorm8ToFloat(ColorChannels(output), p, num_elems * 4);
 			break;
 
 		case EF_SIGNED_ABGR8:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				int8_t const * s = reinterpret_cast<int8_t const *>(p);
-				*output = Color(s[0] / 127.0f, s[1] / 127.0f, s[2] / 127.0f, s[3] / 127.0f);
-			}
+			SNorm8ToFloat(ColorChannels(output), reinterpret_cast<int8_t const *>(p), num_elems * 4);
 			break;
 
 		case EF_A2BGR10:
@@ -322,11 +386,7 @@ namespace KlayGE
 			break;
 
 		case EF_ABGR16:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				uint16_t const * s = reinterpret_cast<uint16_t const *>(p);
-				*output = Color(s[0] / 65535.0f, s[1] / 65535.0f, s[2] / 65535.0f, s[3] / 65535.0f);
-			}
+			UNorm16ToFloat(ColorChannels(output), reinterpret_cast<uint16_t const *>(p), num_elems * 4);
 			break;
 
 		case EF_SIGNED_ABGR16:
@@ -538,19 +598,11 @@ namespace KlayGE
 
 
 		case EF_R16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const s = *reinterpret_cast<half const *>(p);
-				*output = Color(s, 0, 0, 1);
-			}
+			HalfToABGR32F(reinterpret_cast<half const *>(p), 1, num_elems, output);
 			break;
 
 		case EF_GR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const * s = reinterpret_cast<half const *>(p);
-				*output = Color(s[0], s[1], 0, 1);
-			}
+			HalfToABGR32F(reinterpret_cast<half const *>(p), 2, num_elems, output);
 			break;
 
 		case EF_B10G11R11F:
@@ -646,19 +698,11 @@ namespace KlayGE
 			break;
 
 		case EF_BGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const * s = reinterpret_cast<half const *>(p);
-				*output = Color(s[0], s[1], s[2], 1);
-			}
+			HalfToABGR32F(reinterpret_cast<half const *>(p), 3, num_elems, output);
 			break;
 
 		case EF_ABGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const * s = reinterpret_cast<half const *>(p);
-				*output = Color(s[0], s[1], s[2], s[3]);
-			}
+			HalfToFloat(ColorChannels(output), reinterpret_cast<half const *>(p), num_elems * 4);
 			break;
 
 		case EF_R32F:
@@ -720,23 +764,15 @@ namespace KlayGE
 
 
 		case EF_ARGB8_SRGB:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
+			SRGB8ToLinear(ColorChannels(output), p, num_elems * 4);
+			for (uint32_t i = 0; i < num_elems; ++ i, ++ output)
 			{
-				*output = Color(MathLib::srgb_to_linear(p[2] / 255.0f),
-					MathLib::srgb_to_linear(p[1] / 255.0f),
-					MathLib::srgb_to_linear(p[0] / 255.0f),
-					MathLib::srgb_to_linear(p[3] / 255.0f));
+				std::swap(output->r(), output->b());
 			}
 			break;
 
 		case EF_ABGR8_SRGB:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				*output = Color(MathLib::srgb_to_linear(p[0] / 255.0f),
-					MathLib::srgb_to_linear(p[1] / 255.0f),
-					MathLib::srgb_to_linear(p[2] / 255.0f),
-					MathLib::srgb_to_linear(p[3] / 255.0f));
-			}
+			SRGB8ToLinear(ColorChannels(output), p, num_elems * 4);
 			break;
 
 		default:
@@ -836,33 +872,16 @@ namespace KlayGE
 			break;
 
 		case EF_ARGB8:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				p[0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->b() * 255.0f + 0.5f), 0, 255));
-				p[1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->g() * 255.0f + 0.5f), 0, 255));
-				p[2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->r() * 255.0f + 0.5f), 0, 255));
-				p[3] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->a() * 255.0f + 0.5f), 0, 255));
-			}
+			FloatToUNorm8(p, ColorChannels(input), num_elems * 4);
+			SwapRB8(p, num_elems);
 			break;
 
 		case EF_ABGR8:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				p[0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->r() * 255.0f + 0.5f), 0, 255));
-				p[1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->g() * 255.0f + 0.5f), 0, 255));
-				p[2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->b() * 255.0f + 0.5f), 0, 255));
-				p[3] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(input->a() * 255.0f + 0.5f), 0, 255));
-			}
+			FloatToUNorm8(p, ColorChannels(input), num_elems * 4);
 			break;
 
 		case EF_SIGNED_ABGR8:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				p[0] = static_cast<int8_t>(MathLib::clamp(static_cast<int>(input->r() * 127.0f + 0.5f), -127, 127));
-				p[1] = static_cast<int8_t>(MathLib::clamp(static_cast<int>(input->g() * 127.0f + 0.5f), -127, 127));
-				p[2] = static_cast<int8_t>(MathLib::clamp(static_cast<int>(input->b() * 127.0f + 0.5f), -127, 127));
-				p[3] = static_cast<int8_t>(MathLib::clamp(static_cast<int>(input->a() * 127.0f + 0.5f), -127, 127));
-			}
+			FloatToSNorm8(reinterpret_cast<int8_t*>(p), ColorChannels(input), num_elems * 4);
 			break;
 
 		case EF_A2BGR10:
@@ -1041,14 +1060,7 @@ namespace KlayGE
 			break;
 
 		case EF_ABGR16:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				uint16_t* s = reinterpret_cast<uint16_t*>(p);
-				s[0] = static_cast<uint16_t>(MathLib::clamp(static_cast<int>(input->r() * 65535.0f + 0.5f), 0, 65535));
-				s[1] = static_cast<uint16_t>(MathLib::clamp(static_cast<int>(input->g() * 65535.0f + 0.5f), 0, 65535));
-				s[2] = static_cast<uint16_t>(MathLib::clamp(static_cast<int>(input->b() * 65535.0f + 0.5f), 0, 65535));
-				s[3] = static_cast<uint16_t>(MathLib::clamp(static_cast<int>(input->a() * 65535.0f + 0.5f), 0, 65535));
-			}
+			FloatToUNorm16(reinterpret_cast<uint16_t*>(p), ColorChannels(input), num_elems * 4);
 			break;
 
 		case EF_SIGNED_ABGR16:
@@ -1293,20 +1305,11 @@ namespace KlayGE
 
 
 		case EF_R16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				*s = half(input->r());
-			}
+			ABGR32FToHalf(input, 1, num_elems, reinterpret_cast<half*>(p));
 			break;
 
 		case EF_GR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				s[0] = half(input->r());
-				s[1] = half(input->g());
-			}
+			ABGR32FToHalf(input, 2, num_elems, reinterpret_cast<half*>(p));
 			break;
 
 		case EF_B10G11R11F:
@@ -1427,24 +1430,11 @@ namespace KlayGE
 			break;
 
 		case EF_BGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				s[0] = half(input->r());
-				s[1] = half(input->g());
-				s[2] = half(input->b());
-			}
+			ABGR32FToHalf(input, 3, num_elems, reinterpret_cast<half*>(p));
 			break;
 
 		case EF_ABGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				s[0] = half(input->r());
-				s[1] = half(input->g());
-				s[2] = half(input->b());
-				s[3] = half(input->a());
-			}
+			FloatToHalf(reinterpret_cast<half*>(p), ColorChannels(input), num_elems * 4);
 			break;
 
 		case EF_R32F:
@@ -1512,23 +1502,12 @@ namespace KlayGE
 
 
 		case EF_ARGB8_SRGB:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				p[0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->b()) * 255.0f + 0.5f), 0, 255));
-				p[1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->g()) * 255.0f + 0.5f), 0, 255));
-				p[2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->r()) * 255.0f + 0.5f), 0, 255));
-				p[3] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->a()) * 255.0f + 0.5f), 0, 255));
-			}
+			LinearToSRGB8(p, ColorChannels(input), num_elems * 4);
+			SwapRB8(p, num_elems);
 			break;
 
 		case EF_ABGR8_SRGB:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				p[0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->r()) * 255.0f + 0.5f), 0, 255));
-				p[1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->g()) * 255.0f + 0.5f), 0, 255));
-				p[2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->b()) * 255.0f + 0.5f), 0, 255));
-				p[3] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(input->a()) * 255.0f + 0.5f), 0, 255));
-			}
+			LinearToSRGB8(p, ColorChannels(input), num_elems * 4);
 			break;
 
 		default:
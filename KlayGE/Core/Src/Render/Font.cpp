@@ -50,6 +50,8 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ThrowErr.hpp>
 #include <KFL/Util.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/CpuInfo.hpp>
 #include <KFL/Half.hpp>
 #include <KlayGE/RenderLayout.hpp>
 #include <KFL/Math.hpp>
@@ -85,9 +87,10 @@ namespace KlayGE
 		explicit FontRenderable(shared_ptr<KFont> const & kfl)
 				: RenderableHelper(L"Font"),
 					dirty_(false),
+					text_frame_(static_cast<uint32_t>(-1)),
 					three_dim_(false),
 					kfont_loader_(kfl),
-					tick_(0)
+					num_used_slots_(0)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
@@ -111,8 +114,6 @@ namespace KlayGE
 			dist_texture_ = rf.MakeTexture2D(size, size, 1, 1, EF_R8, 1, 0, EAH_GPU_Read, nullptr);
 			a_char_texture_ = rf.MakeTexture2D(kfont_char_size, kfont_char_size, 1, 1, EF_R8, 1, 0, EAH_CPU_Write, nullptr);
 
-			char_free_list_.push_back(std::make_pair(0, size * size / kfont_char_size / kfont_char_size));
-
 			effect_ = SyncLoadRenderEffect("Font.fxml");
 			*(effect_->ParameterByName("distance_tex")) = dist_texture_;
 			*(effect_->ParameterByName("distance_base_scale")) = float2(kfont_loader_->DistBase() / 32768.0f * 32 + 1, (kfont_loader_->DistScale() / 32768.0f + 1.0f) * 32);
@@ -132,6 +133,15 @@ namespace KlayGE
 			tc_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
 		}
 
+		~FontRenderable()
+		{
+			typedef KLAYGE_DECLTYPE(pending_glyphs_) PendingGlyphsType;
+			KLAYGE_FOREACH(PendingGlyphsType::reference glyph, pending_glyphs_)
+			{
+				glyph.second->decoder();
+			}
+		}
+
 		RenderTechniquePtr const & GetRenderTechnique() const
 		{
 			if (three_dim_)
@@ -169,6 +179,9 @@ namespace KlayGE
 
 		void OnRenderBegin()
 		{
+			// Text added after the object went into the scene
+			this->UpdateBuffers();
+
 			if (!three_dim_)
 			{
 				RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
@@ -179,6 +192,20 @@ namespace KlayGE
 			}
 		}
 
+		// Drops the text left from an earlier frame that didn't render it, e.g. when it was culled
+		void BeginText(uint32_t frame)
+		{
+			if (frame != text_frame_)
+			{
+				if (!vertices_.empty())
+				{
+					this->OnRenderEnd();
+					dirty_ = true;
+				}
+				text_frame_ = frame;
+			}
+		}
+
 		void OnRenderEnd()
 		{
 			vertices_.resize(0);
@@ -533,11 +560,63 @@ namespace KlayGE
 			pos_aabb_ |= AABBox(float3(sx, sy, sz), float3(maxx, maxy, sz + 0.1f));
 		}
 
-		// ʹLRU㷨
+	public:
+		// Decodes the glyphs of text that aren't in the texture yet on the thread pool, in about one job per core
+		/////////////////////////////////////////////////////////////////////////////////
+		void Prefetch(std::wstring const & text)
+		{
+			KFont& kl = *kfont_loader_;
+			uint32_t const kfont_char_size = kl.CharSize();
+
+			std::vector<shared_ptr<PendingGlyph> > glyphs;
+			typedef KLAYGE_DECLTYPE(text) TextType;
+			KLAYGE_FOREACH(TextType::const_reference ch, text)
+			{
+				int32_t const offset = kl.CharIndex(ch);
+				if ((offset != -1) && (char_info_map_.find(ch) == char_info_map_.end())
+					&& (pending_glyphs_.find(ch) == pending_glyphs_.end()))
+				{
+					// Reading shares the font's stream, so it stays on this thread
+					shared_ptr<PendingGlyph> glyph = MakeSharedPtr<PendingGlyph>();
+					uint32_t size;
+					kl.GetLZMADistanceData(nullptr, size, offset);
+					glyph->lzma_data.resize(size);
+					kl.GetLZMADistanceData(&glyph->lzma_data[0], size, offset);
+					glyph->dist_data.resize(kfont_char_size * kfont_char_size);
+
+					pending_glyphs_.insert(std::make_pair(ch, glyph));
+					glyphs.push_back(glyph);
+				}
+			}
+
+			if (!glyphs.empty())
+			{
+				// The thread pool starts a new thread whenever none is idle, so a task per glyph would flood it
+				CPUInfo cpu;
+				uint32_t const num_glyphs = static_cast<uint32_t>(glyphs.size());
+				uint32_t const num_jobs = std::min(num_glyphs, static_cast<uint32_t>(std::max(cpu.NumHWThreads(), 1)));
+				for (uint32_t i = 0; i < num_jobs; ++ i)
+				{
+					uint32_t const begin = num_glyphs * i / num_jobs;
+					uint32_t const end = num_glyphs * (i + 1) / num_jobs;
+					joiner<void> decoder = Context::Instance().ThreadPool()(bind(&FontRenderable::DecodeGlyphs, kfont_loader_,
+						std::vector<shared_ptr<PendingGlyph> >(glyphs.begin() + begin, glyphs.begin() + end)));
+					for (uint32_t j = begin; j < end; ++ j)
+					{
+						glyphs[j]->decoder = decoder;
+					}
+				}
+			}
+		}
+
+	private:
+		// Cache glyphs in the texture, using LRU
 		/////////////////////////////////////////////////////////////////////////////////
+		// Only Prefetch is asynchronous. Here the decoding of every missing glyph is started first, and then
+		// each is joined when its slot is filled, so the wait is for the jobs running side by side.
 		void UpdateTexture(std::wstring const & text)
 		{
-			++ tick_;
+			this->Prefetch(text);
 
 			uint32_t const tex_size = dist_texture_->Width(0);
 
@@ -552,127 +631,69 @@ namespace KlayGE
 			typedef KLAYGE_DECLTYPE(text) TextType;
 			KLAYGE_FOREACH(TextType::const_reference ch, text)
 			{
-				int32_t offset = kl.CharIndex(ch);
-				if (offset != -1)
+				KLAYGE_AUTO(cmiter, cim.find(ch));
+				if (cmiter != cim.end())
 				{
-					KLAYGE_AUTO(cmiter, cim.find(ch));
-					if (cmiter != cim.end())
-					{
-						// ҵ
-
-						cmiter->second.tick = tick_;
-					}
-					else
-					{
-						// ҲԵ
-
-						KFont::font_info const & ci = kl.CharInfo(offset);
-
-						uint32_t width = ci.width;
-						uint32_t height = ci.height;
-
-						int2 char_pos;
-						CharInfo charInfo;
-						if (cim.size() < num_total_chars)
-						{
-							// пռ
-
-							uint32_t const s = char_free_list_.front().first;
-						
-							char_pos.y() = s / num_chars_a_row;
-							char_pos.x() = s - char_pos.y() * num_chars_a_row;
-
-							char_pos.x() *= kfont_char_size;
-							char_pos.y() *= kfont_char_size;
-
-							charInfo.rc.left() = static_cast<float>(char_pos.x()) / tex_size;
-							charInfo.rc.top() = static_cast<float>(char_pos.y()) / tex_size;
-
-							++ char_free_list_.front().first;
-							if (char_free_list_.front().first == char_free_list_.front().second)
-							{
-								char_free_list_.pop_front();
-							}
-						}
-						else
-						{
-							// ҵʹʱûʹõ
-
-							uint64_t min_tick = cim.begin()->second.tick;
-							KLAYGE_AUTO(min_chiter, cim.begin());
-							for (KLAYGE_AUTO(chiter, cim.begin()); chiter != cim.end(); ++ chiter)
-							{
-								if (chiter->second.tick < min_tick)
-								{
-									min_tick = chiter->second.tick;
-									min_chiter = chiter;
-								}
-							}
-
-							char_pos.x() = static_cast<int32_t>(min_chiter->second.rc.left() * tex_size);
-							char_pos.y() = static_cast<int32_t>(min_chiter->second.rc.top() * tex_size);
-							charInfo.rc.left() = min_chiter->second.rc.left();
-							charInfo.rc.top() = min_chiter->second.rc.top();
+					lru_list_.splice(lru_list_.end(), lru_list_, cmiter->second.lru_iter);
+					continue;
+				}
 
-							for (KLAYGE_AUTO(chiter, cim.begin()); chiter != cim.end(); ++ chiter)
-							{
-								if (chiter->second.tick == min_tick)
-								{
-									uint32_t const x = static_cast<int32_t>(chiter->second.rc.left() * tex_size);
-									uint32_t const y = static_cast<int32_t>(chiter->second.rc.top() * tex_size);
-									uint32_t const id = y * num_chars_a_row + x;
-									KLAYGE_AUTO(freeiter, char_free_list_.begin());
-									while ((freeiter != char_free_list_.end()) && (freeiter->second <= id))
-									{
-										++ freeiter;
-									}
-									char_free_list_.insert(freeiter, std::make_pair(id, id + 1));
-
-									cim.erase(chiter);
-									break;
-								}
-							}
-							for (KLAYGE_AUTO(freeiter, char_free_list_.begin()); freeiter != char_free_list_.end();)
-							{
-								KLAYGE_AUTO(nextiter, freeiter);
-								++ nextiter;
-
-								if (nextiter != char_free_list_.end())
-								{
-									if (freeiter->second == nextiter->first)
-									{
-										freeiter->second = nextiter->second;
-										char_free_list_.erase(nextiter);
-									}
-									else
-									{
-										++ freeiter;
-									}
-								}
-								else
-								{
-									break;
-								}
-							}
-						}
+				KLAYGE_AUTO(pgiter, pending_glyphs_.find(ch));
+				if (pgiter == pending_glyphs_.end())
+				{
+					// Not in the font
+					continue;
+				}
 
-						charInfo.rc.right()		= charInfo.rc.left() + static_cast<float>(width) / tex_size;
-						charInfo.rc.bottom()	= charInfo.rc.top() + static_cast<float>(height) / tex_size;
-						charInfo.tick			= tick_;
+				KFont::font_info const & ci = kl.CharInfo(kl.CharIndex(ch));
 
-						{
-							Texture::Mapper mapper(*a_char_texture_, 0, 0, TMA_Write_Only,
-								0, 0, kfont_char_size, kfont_char_size);
-							kl.GetDistanceData(mapper.Pointer<uint8_t>(), mapper.RowPitch(), offset);
-						}
+				int2 char_pos;
+				CharInfo charInfo;
+				if (num_used_slots_ < num_total_chars)
+				{
+					char_pos.y() = num_used_slots_ / num_chars_a_row;
+					char_pos.x() = num_used_slots_ - char_pos.y() * num_chars_a_row;
+					char_pos.x() *= kfont_char_size;
+					char_pos.y() *= kfont_char_size;
+					++ num_used_slots_;
+				}
+				else
+				{
+					// Take the slot of the least recently used one
+					KLAYGE_AUTO(lruiter, cim.find(lru_list_.front()));
+					char_pos.x() = static_cast<int32_t>(lruiter->second.rc.left() * tex_size + 0.5f);
+					char_pos.y() = static_cast<int32_t>(lruiter->second.rc.top() * tex_size + 0.5f);
+					cim.erase(lruiter);
+					lru_list_.pop_front();
+				}
 
-						a_char_texture_->CopyToSubTexture2D(*dist_texture_,
-							0, 0, char_pos.x(), char_pos.y(), kfont_char_size, kfont_char_size,
-							0, 0, 0, 0, kfont_char_size, kfont_char_size);
+				charInfo.rc.left() = static_cast<float>(char_pos.x()) / tex_size;
+				charInfo.rc.top() = static_cast<float>(char_pos.y()) / tex_size;
+				charInfo.rc.right() = charInfo.rc.left() + static_cast<float>(ci.width) / tex_size;
+				charInfo.rc.bottom() = charInfo.rc.top() + static_cast<float>(ci.height) / tex_size;
+				charInfo.lru_iter = lru_list_.insert(lru_list_.end(), ch);
 
-						cim.insert(std::make_pair(ch, charInfo));
+				PendingGlyph& glyph = *pgiter->second;
+				glyph.decoder();
+				{
+					Texture::Mapper mapper(*a_char_texture_, 0, 0, TMA_Write_Only,
+						0, 0, kfont_char_size, kfont_char_size);
+					uint8_t* p = mapper.Pointer<uint8_t>();
+					uint8_t const * dist = &glyph.dist_data[0];
+					for (uint32_t y = 0; y < kfont_char_size; ++ y)
+					{
+						std::memcpy(p, dist, kfont_char_size);
+						p += mapper.RowPitch();
+						dist += kfont_char_size;
 					}
 				}
+				pending_glyphs_.erase(pgiter);
+
+				a_char_texture_->CopyToSubTexture2D(*dist_texture_,
+					0, 0, char_pos.x(), char_pos.y(), kfont_char_size, kfont_char_size,
+					0, 0, 0, 0, kfont_char_size, kfont_char_size);
+
+				cim.insert(std::make_pair(ch, charInfo));
 			}
 		}
 
@@ -680,9 +701,28 @@ namespace KlayGE
 		struct CharInfo
 		{
 			Rect rc;
-			uint64_t tick;
+			std::list<wchar_t>::iterator lru_iter;
 		};
 
+		struct PendingGlyph
+		{
+			std::vector<uint8_t> lzma_data;
+			std::vector<uint8_t> dist_data;
+			// Shared by the glyphs decoded in the same job
+			joiner<void> decoder;
+		};
+
+		static void DecodeGlyphs(shared_ptr<KFont> const & kl, std::vector<shared_ptr<PendingGlyph> > const & glyphs)
+		{
+			uint32_t const kfont_char_size = kl->CharSize();
+			typedef KLAYGE_DECLTYPE(glyphs) GlyphsType;
+			KLAYGE_FOREACH(GlyphsType::const_reference glyph, glyphs)
+			{
+				kl->DecodeDistanceData(&glyph->dist_data[0], kfont_char_size,
+					&glyph->lzma_data[0], static_cast<uint32_t>(glyph->lzma_data.size()));
+			}
+		}
+
 #ifdef KLAYGE_HAS_STRUCT_PACK
 	#pragma pack(push, 1)
 #endif
@@ -706,9 +746,11 @@ namespace KlayGE
 
 		bool restart_;
 		bool dirty_;
+		uint32_t text_frame_;
 
 		unordered_map<wchar_t, CharInfo> char_info_map_;
-		std::list<std::pair<uint32_t, uint32_t> > char_free_list_;
+		std::list<wchar_t> lru_list_;
+		unordered_map<wchar_t, shared_ptr<PendingGlyph> > pending_glyphs_;
 
 		bool three_dim_;
 
@@ -727,7 +769,7 @@ namespace KlayGE
 
 		shared_ptr<KFont> kfont_loader_;
 
-		uint64_t tick_;
+		uint32_t num_used_slots_;
 	};
 
 	class FontObject : public SceneObjectHelper
@@ -850,6 +892,8 @@ namespace KlayGE
 			: font_renderable_(fr)
 	{
 		fso_attrib_ = SceneObject::SOA_Overlay;
+		font_obj_ = MakeSharedPtr<FontObject>(font_renderable_, fso_attrib_);
+		font_obj_frame_ = static_cast<uint32_t>(-1);
 	}
 
 	Font::Font(shared_ptr<FontRenderable> const & fr, uint32_t flags)
@@ -860,6 +904,8 @@ namespace KlayGE
 		{
 			fso_attrib_ |= SceneObject::SOA_Cullable;
 		}
+		font_obj_ = MakeSharedPtr<FontObject>(font_renderable_, fso_attrib_);
+		font_obj_frame_ = static_cast<uint32_t>(-1);
 	}
 
 	// ִС
@@ -876,6 +922,13 @@ namespace KlayGE
 		}
 	}
 
+	// Starts decoding glyphs that will be drawn soon
+	/////////////////////////////////////////////////////////////////////////////////
+	void Font::Prefetch(std::wstring const & text)
+	{
+		font_renderable_->Prefetch(text);
+	}
+
 	// ָλû
 	/////////////////////////////////////////////////////////////////////////////////
 	void Font::RenderText(float sx, float sy, Color const & clr,
@@ -892,9 +945,8 @@ namespace KlayGE
 	{
 		if (!text.empty())
 		{
-			shared_ptr<FontObject> font_obj = MakeSharedPtr<FontObject>(font_renderable_, fso_attrib_);
+			this->BeginText();
 			font_renderable_->AddText2D(x, y, z, xScale, yScale, clr, text, font_size);
-			font_obj->AddToSceneManager();
 		}
 	}
 
@@ -906,9 +958,8 @@ namespace KlayGE
 	{
 		if (!text.empty())
 		{
-			shared_ptr<FontObject> font_obj = MakeSharedPtr<FontObject>(font_renderable_, fso_attrib_);
+			this->BeginText();
 			font_renderable_->AddText2D(rc, z, xScale, yScale, clr, text, font_size, align);
-			font_obj->AddToSceneManager();
 		}
 	}
 
@@ -918,12 +969,23 @@ namespace KlayGE
 	{
 		if (!text.empty())
 		{
-			shared_ptr<FontObject> font_obj = MakeSharedPtr<FontObject>(font_renderable_, fso_attrib_);
+			this->BeginText();
 			font_renderable_->AddText3D(mvp, clr, text, font_size);
-			font_obj->AddToSceneManager();
 		}
 	}
 
+	// All text of a frame goes into one object and one draw. The scene manager drops overlays after each frame,
+	// so the object goes in again with the first text of every frame.
+	void Font::BeginText()
+	{
+		uint32_t const frame = Context::Instance().RenderFactoryInstance().RenderEngineInstance().FrameIndex();
+		font_renderable_->BeginText(frame);
+		if (frame != font_obj_frame_)
+		{
+			font_obj_->AddToSceneManager();
+			font_obj_frame_ = frame;
+		}
+	}
 
 	FontPtr SyncLoadFont(std::string const & font_name, uint32_t flags)
 	{
@@ -50,6 +50,10 @@ namespace KlayGE
 		{
 		}
 
+		void UpdateSubresource(uint32_t /*offset*/, uint32_t /*size*/, void const * /*data*/)
+		{
+		}
+
 		void DoResize()
 		{
 		}
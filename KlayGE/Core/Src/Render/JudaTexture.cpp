@@ -38,6 +38,19 @@ namespace
 
 	uint32_t const JUDA_TEX_VERSION = 2;
 
+	void EncodeTilesRange(std::vector<std::vector<uint8_t> >* comed_blocks,
+		std::vector<std::vector<uint8_t> > const * data_blocks, std::vector<uint32_t> const * data_indices,
+		size_t begin, size_t end)
+	{
+		// One codec per job, so the jobs share nothing
+		LZMACodec lzma_enc;
+		for (size_t i = begin; i < end; ++ i)
+		{
+			std::vector<uint8_t> const & data = (*data_blocks)[(*data_indices)[i]];
+			lzma_enc.Encode((*comed_blocks)[i], &data[0], data.size());
+		}
+	}
+
 	void u8_copy_1(uint8_t* output, uint8_t const * rhs)
 	{
 		*output = *rhs;
@@ -121,11 +134,19 @@ namespace KlayGE
 	float const THRESHOLD_MSE = 0.001f;
 	int const THRESHOLD_BIAS = 10;
 
+	uint32_t const DEFAULT_DECODED_BLOCKS = 64;
+	size_t const TILES_PER_DECODE_JOB = 8;
+	size_t const TILES_PER_STREAM_BATCH = 16;
+	size_t const TILES_PER_ENCODE_JOB = 16;
+	size_t const TILES_PER_ENCODE_WINDOW = 1024;
+
 	JudaTexture::JudaTexture(uint32_t num_tiles, uint32_t tile_size, ElementFormat format)
 		: root_(MakeSharedPtr<quadtree_node>()),
 			num_tiles_(num_tiles), tile_size_(tile_size), format_(format),
 			texel_size_(NumFormatBytes(format)),
-			decode_tick_(0), tile_tick_(0)
+			decoded_cache_size_(0),
+			decoded_cache_budget_(static_cast<uint64_t>(DEFAULT_DECODED_BLOCKS) * tile_size * tile_size * NumFormatBytes(format)),
+			tile_tick_(0)
 	{
 		BOOST_ASSERT(num_tiles_ <= MAX_NUM_TILES);
 		BOOST_ASSERT(tile_size_ <= MAX_TILE_SIZE);
@@ -187,6 +208,19 @@ namespace KlayGE
 		}
 	}
 
+	JudaTexture::~JudaTexture()
+	{
+		typedef KLAYGE_DECLTYPE(pending_batches_) PendingBatchesType;
+		KLAYGE_FOREACH(PendingBatchesType::reference batch, pending_batches_)
+		{
+			typedef KLAYGE_DECLTYPE(batch->decoders) DecodersType;
+			KLAYGE_FOREACH(DecodersType::reference decoder, batch->decoders)
+			{
+				decoder();
+			}
+		}
+	}
+
 	uint32_t JudaTexture::EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const
 	{
 		BOOST_ASSERT(level <= MAX_TREE_LEVEL);
@@ -423,40 +457,46 @@ namespace KlayGE
 		}
 		std::sort(shuffs.begin(), shuffs.end());
 
-		uint32_t const full_tile_bytes = cache_tile_size_ * cache_tile_size_ * texel_size_;
-
 		for (size_t i = 0; i < shuffs.size(); ++ i)
 		{
-			uint32_t shuff = shuffs[i].first;
 			uint32_t const index = shuffs[i].second;
+			this->DecodeTileMips(&data[index * mipmaps], tile_ids[index], mipmaps);
+		}
+	}
 
-			uint32_t scale = tile_size_ / cache_tile_size_;
-			if (scale != 1)
-			{
-				uint32_t level = this->ShuffLevel(shuff);
-				while (scale > 1)
-				{
-					scale /= 2;
-					-- level;
-				}
-
-				shuff = this->ShuffLevel(shuff, level);
-			}
+	void JudaTexture::DecodeTileMips(std::vector<uint8_t>* data, uint32_t tile_id, uint32_t mipmaps)
+	{
+		uint32_t tile_level, tile_x, tile_y;
+		this->DecodeTileID(tile_level, tile_x, tile_y, tile_id);
+		uint32_t shuff = this->Pos2Shuff(tile_level, tile_x, tile_y);
 
-			uint32_t s = full_tile_bytes;
-			for (size_t j = 0; j < mipmaps; ++ j)
+		uint32_t scale = tile_size_ / cache_tile_size_;
+		if (scale != 1)
+		{
+			uint32_t level = this->ShuffLevel(shuff);
+			while (scale > 1)
 			{
-				data[index * mipmaps + j].resize(s);
-				s /= 4;
+				scale /= 2;
+				-- level;
 			}
 
-			this->DecodeATile(&data[index * mipmaps], shuff, mipmaps);
+			shuff = this->ShuffLevel(shuff, level);
+		}
+
+		uint32_t s = cache_tile_size_ * cache_tile_size_ * texel_size_;
+		for (size_t j = 0; j < mipmaps; ++ j)
+		{
+			data[j].resize(s);
+			s /= 4;
 		}
+
+		this->DecodeATile(data, shuff, mipmaps);
 	}
 
 	void JudaTexture::DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps)
 	{
-		++ decode_tick_;
+		// Keeps the block returned by RetriveATile alive while it's read
+		shared_ptr<std::vector<uint8_t> > block_holder;
 
 		uint32_t const full_tile_bytes = cache_tile_size_ * cache_tile_size_ * texel_size_;
 		uint32_t target_level = this->ShuffLevel(shuff);
@@ -464,7 +504,7 @@ namespace KlayGE
 		quadtree_node_ptr node = root_;
 		if (0 == target_level)
 		{
-			std::memcpy(&data[0][0], this->RetriveATile(root_->data_index), full_tile_bytes);
+			std::memcpy(&data[0][0], this->RetriveATile(block_holder, root_->data_index), full_tile_bytes);
 		}
 		else
 		{
@@ -517,7 +557,7 @@ namespace KlayGE
 						uint8_t const * src;
 						if (1 == ll_b)
 						{
-							src = this->RetriveATile(root_->data_index);
+							src = this->RetriveATile(block_holder, root_->data_index);
 						}
 						else
 						{
@@ -541,7 +581,7 @@ namespace KlayGE
 						{
 							uint32_t start_x = (start_sub_tile_x >> shift) * used_w * 2;
 							uint32_t start_y = (start_sub_tile_y >> shift) * used_h * 2;
-							uint8_t const * start_src = this->RetriveATile(node->data_index) + (start_y * tile_size_ + start_x) * texel_size_;
+							uint8_t const * start_src = this->RetriveATile(block_holder, node->data_index) + (start_y * tile_size_ + start_x) * texel_size_;
 							uint8_t* dst = &temp[0];
 							for (size_t y = 0; y < used_h * 2; ++ y)
 							{
@@ -632,69 +672,87 @@ namespace KlayGE
 		return ret_attr;
 	}
 
-	uint8_t* JudaTexture::RetriveATile(uint32_t data_index)
+	uint8_t const * JudaTexture::RetriveATile(shared_ptr<std::vector<uint8_t> >& holder, uint32_t data_index)
 	{
 		if (data_blocks_.empty())
 		{
 			typedef KLAYGE_DECLTYPE(decoded_block_cache_) DecodedBlockCacheType;
-			DecodedBlockCacheType::iterator iter = decoded_block_cache_.find(data_index);
-			if (iter != decoded_block_cache_.end())
-			{
-				iter->second.tick = decode_tick_;
-			}
-			else
+
+			uint32_t const full_tile_bytes = tile_size_ * tile_size_ * texel_size_;
+			std::vector<uint8_t> comed_data;
+			uint8_t const * comed_src = nullptr;
+			uint32_t comed_len = 0;
 			{
-				if (decoded_block_cache_.size() >= 64)
-				{
-					DecodedBlockCacheType::iterator min_iter = decoded_block_cache_.begin();
-					uint64_t min_tick = min_iter->second.tick;
-					for (DecodedBlockCacheType::iterator dbiter = decoded_block_cache_.begin();
-						dbiter != decoded_block_cache_.end(); ++ dbiter)
-					{
-						if (dbiter->second.tick < min_tick)
-						{
-							min_tick = dbiter->second.tick;
-							min_iter = dbiter;
-						}
-					}
+				unique_lock<mutex> lock(decode_mutex_);
 
-					for (DecodedBlockCacheType::iterator dbiter = decoded_block_cache_.begin();
-						dbiter != decoded_block_cache_.end();)
-					{
-						if (dbiter->second.tick == min_tick)
-						{
-							dbiter = decoded_block_cache_.erase(dbiter);
-						}
-						else
-						{
-							++ dbiter;
-						}
-					}
+				DecodedBlockCacheType::iterator iter = decoded_block_cache_.find(data_index);
+				if (iter != decoded_block_cache_.end())
+				{
+					decoded_block_lru_.splice(decoded_block_lru_.end(), decoded_block_lru_, iter->second.lru_iter);
+					holder = iter->second.data;
+					return &(*holder)[0];
 				}
 
-				uint32_t const full_tile_bytes = tile_size_ * tile_size_ * texel_size_;
-				shared_ptr<std::vector<uint8_t> > data = MakeSharedPtr<std::vector<uint8_t> >(full_tile_bytes);
-				if (data_index != EMPTY_DATA_INDEX)
+				if ((data_index != EMPTY_DATA_INDEX) && !mapped_file_.Data())
 				{
 					uint64_t offsets[2];
 					input_file_->seekg(data_blocks_offset_ + data_index * sizeof(uint64_t), std::ios_base::beg);
 					input_file_->read(offsets, sizeof(offsets));
-					uint32_t const comed_len = static_cast<uint32_t>(offsets[1] - offsets[0]);
-					std::vector<uint8_t> comed_data(comed_len);
+					comed_len = static_cast<uint32_t>(offsets[1] - offsets[0]);
+					comed_data.resize(comed_len);
 					input_file_->seekg(offsets[0], std::ios_base::beg);
 					input_file_->read(&comed_data[0], comed_len);
-					lzma_dec_.Decode(&(*data)[0], &comed_data[0], comed_len, full_tile_bytes);
+					comed_src = &comed_data[0];
 				}
-				else
+			}
+
+			if ((data_index != EMPTY_DATA_INDEX) && mapped_file_.Data())
+			{
+				// The mapping is read only, so it needs no lock
+				uint64_t offsets[2];
+				memcpy(offsets, mapped_file_.Data() + data_blocks_offset_ + data_index * sizeof(uint64_t), sizeof(offsets));
+				BOOST_ASSERT(offsets[1] <= mapped_file_.Size());
+				comed_len = static_cast<uint32_t>(offsets[1] - offsets[0]);
+				comed_src = mapped_file_.Data() + offsets[0];
+			}
+
+			// Decompress without the lock, so other threads can read and decode at the same time
+			holder = MakeSharedPtr<std::vector<uint8_t> >(full_tile_bytes);
+			if (data_index != EMPTY_DATA_INDEX)
+			{
+				lzma_dec_.Decode(&(*holder)[0], comed_src, comed_len, full_tile_bytes);
+			}
+			else
+			{
+				memset(&(*holder)[0], 0, full_tile_bytes);
+			}
+
+			{
+				unique_lock<mutex> lock(decode_mutex_);
+
+				DecodedBlockCacheType::iterator iter = decoded_block_cache_.find(data_index);
+				if (iter != decoded_block_cache_.end())
 				{
-					memset(&(*data)[0], 0, full_tile_bytes);
+					// Another thread got it first
+					holder = iter->second.data;
 				}
+				else
+				{
+					decoded_block_cache_.insert(std::make_pair(data_index,
+						DecodedBlockInfo(holder, decoded_block_lru_.insert(decoded_block_lru_.end(), data_index))));
+					decoded_cache_size_ += full_tile_bytes;
 
-				std::pair<DecodedBlockCacheType::iterator, bool> p = decoded_block_cache_.insert(std::make_pair(data_index, DecodedBlockInfo(data, decode_tick_)));
-				iter = p.first;
+					// Evicted blocks that are still being read stay alive through their holders
+					while ((decoded_cache_size_ > decoded_cache_budget_) && (decoded_block_lru_.size() > 1))
+					{
+						decoded_block_cache_.erase(decoded_block_lru_.front());
+						decoded_block_lru_.pop_front();
+						decoded_cache_size_ -= full_tile_bytes;
+					}
+				}
 			}
 
-			return &(*iter->second.data)[0];
+			return &(*holder)[0];
 		}
 		else
 		{
@@ -904,7 +962,8 @@ namespace KlayGE
 		uint32_t tile_size;
 		ElementFormat format;
 
-		ResIdentifierPtr file = ResLoader::Instance().Open(ResLoader::Instance().Locate(file_name));
+		std::string const res_name = ResLoader::Instance().Locate(file_name);
+		ResIdentifierPtr file = ResLoader::Instance().Open(res_name);
 
 		uint32_t fourcc;
 		file->read(&fourcc, sizeof(fourcc));
@@ -1017,7 +1076,11 @@ namespace KlayGE
 			last_start_index_levels.swap(this_start_index_levels);
 		}
 
-		ret->input_file_ = file;
+		// Files inside packages, or too large for the address space, can't be mapped. They keep using the stream.
+		if (!ret->mapped_file_.Map(res_name))
+		{
+			ret->input_file_ = file;
+		}
 		ret->data_blocks_offset_ = data_blocks_offset - (non_empty_nodes + 1) * sizeof(uint64_t);
 		ret->image_entries_ = image_entries;
 
@@ -1026,8 +1089,6 @@ namespace KlayGE
 
 	void SaveJudaTexture(JudaTexturePtr const & juda_tex, std::string const & file_name)
 	{
-		LZMACodec lzma_enc;
-
 		std::vector<JudaTexture::quadtree_node_ptr> this_level;
 		std::vector<JudaTexture::quadtree_node_ptr> next_level;
 
@@ -1135,18 +1196,36 @@ namespace KlayGE
 		std::vector<uint64_t> block_start_pos(non_empty_nodes + 1);
 		ofs->write(reinterpret_cast<char const *>(&block_start_pos[0]), block_start_pos.size() * sizeof(block_start_pos[0]));
 
+		// Tiles are compressed in parallel, a window at a time to bound the memory, and written out in order
+		std::vector<std::vector<uint8_t> > comed_blocks(non_empty_block_data_index.size());
+		std::vector<joiner<void> > encoders;
 		block_start_pos[0] = data_blocks_offset;
-		for (size_t i = 0; i < non_empty_block_data_index.size(); ++ i)
+		for (size_t window_beg = 0; window_beg < non_empty_block_data_index.size(); window_beg += TILES_PER_ENCODE_WINDOW)
 		{
-			std::vector<uint8_t> const & data = juda_tex->data_blocks_[non_empty_block_data_index[i]];
+			size_t const window_end = std::min(non_empty_block_data_index.size(), window_beg + TILES_PER_ENCODE_WINDOW);
 
-			std::vector<uint8_t> comed_data;
-			lzma_enc.Encode(comed_data, &data[0], data.size());
+			encoders.clear();
+			for (size_t i = window_beg; i < window_end; i += TILES_PER_ENCODE_JOB)
+			{
+				encoders.push_back(Context::Instance().ThreadPool()(bind(EncodeTilesRange, &comed_blocks,
+					&juda_tex->data_blocks_, &non_empty_block_data_index, i, std::min(window_end, i + TILES_PER_ENCODE_JOB))));
+			}
+			for (size_t i = 0; i < encoders.size(); ++ i)
+			{
+				encoders[i]();
+			}
 
-			uint32_t comed_len = static_cast<uint32_t>(comed_data.size());
-			block_start_pos[i + 1] = block_start_pos[i] + comed_len;
+			for (size_t i = window_beg; i < window_end; ++ i)
+			{
+				std::vector<uint8_t>& comed_data = comed_blocks[i];
+
+				uint32_t comed_len = static_cast<uint32_t>(comed_data.size());
+				block_start_pos[i + 1] = block_start_pos[i] + comed_len;
+
+				ofs->write(reinterpret_cast<char const *>(&comed_data[0]), comed_data.size() * sizeof(comed_data[0]));
 
-			ofs->write(reinterpret_cast<char const *>(&comed_data[0]), comed_data.size() * sizeof(comed_data[0]));
+				std::vector<uint8_t>().swap(comed_data);
+			}
 		}
 
 		ofs->seekp(data_blocks_offset_pos, std::ios_base::beg);
@@ -1278,22 +1357,127 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(tex_cache_ || !tex_cache_array_.empty());
 
+		this->FinishPendingBatches();
+
 		++ tile_tick_;
 
-		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
-		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
-		uint32_t const tex_layer = tex_cache_ ? tex_cache_->ArraySize() : static_cast<uint32_t>(tex_cache_array_.size());
-		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+		TileBatchPtr batch = MakeSharedPtr<TileBatch>();
+		this->PrepareTiles(*batch, tile_ids);
+		this->DecodeBatch(batch);
+		typedef KLAYGE_DECLTYPE(batch->decoders) DecodersType;
+		KLAYGE_FOREACH(DecodersType::reference decoder, batch->decoders)
+		{
+			decoder();
+		}
+		this->UploadTiles(*batch, 0, batch->tile_attrs.size());
+	}
 
-		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
-		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
-		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+	void JudaTexture::StreamCache(std::vector<uint32_t> const & tile_ids, uint32_t max_uploads)
+	{
+		BOOST_ASSERT(tex_cache_ || !tex_cache_array_.empty());
+
+		++ tile_tick_;
+
+		// The number of times a tile is requested stands for its screen coverage
+		unordered_map<uint32_t, uint32_t> requests;
+		typedef KLAYGE_DECLTYPE(tile_ids) TileIDsType;
+		KLAYGE_FOREACH(TileIDsType::const_reference tile_id, tile_ids)
+		{
+			KLAYGE_AUTO(tmiter, tile_info_map_.find(tile_id));
+			if (tmiter != tile_info_map_.end())
+			{
+				tmiter->second.tick = tile_tick_;
+			}
+			else if (pending_tiles_.find(tile_id) == pending_tiles_.end())
+			{
+				++ requests[tile_id];
+			}
+		}
+
+		if (!requests.empty())
+		{
+			// Coarser levels first, then larger coverage
+			std::vector<std::pair<uint64_t, uint32_t> > order;
+			order.reserve(requests.size());
+			typedef KLAYGE_DECLTYPE(requests) RequestsType;
+			KLAYGE_FOREACH(RequestsType::const_reference request, requests)
+			{
+				uint32_t level, tile_x, tile_y;
+				this->DecodeTileID(level, tile_x, tile_y, request.first);
+				order.push_back(std::make_pair((static_cast<uint64_t>(level) << 32) | (0xFFFFFFFFU - request.second),
+					request.first));
+			}
+			std::sort(order.begin(), order.end());
+
+			// Small batches, so the first tiles are ready early
+			for (size_t i = 0; i < order.size(); i += TILES_PER_STREAM_BATCH)
+			{
+				std::vector<uint32_t> batch_tile_ids;
+				for (size_t j = i; j < std::min(order.size(), i + TILES_PER_STREAM_BATCH); ++ j)
+				{
+					batch_tile_ids.push_back(order[j].second);
+					pending_tiles_.insert(order[j].second);
+				}
+
+				TileBatchPtr batch = MakeSharedPtr<TileBatch>();
+				this->PrepareTiles(*batch, batch_tile_ids);
+				this->DecodeBatch(batch);
+				pending_batches_.push_back(batch);
+			}
+		}
+
+		while (!pending_batches_.empty() && (max_uploads > 0))
+		{
+			TileBatchPtr const batch = pending_batches_.front();
+			if (batch->remaining != 0)
+			{
+				break;
+			}
+
+			size_t const num_tiles = batch->tile_attrs.size();
+			size_t const end = std::min(num_tiles, batch->num_uploaded + max_uploads);
+			this->UploadTiles(*batch, batch->num_uploaded, end);
+			for (size_t i = batch->num_uploaded; i < end; ++ i)
+			{
+				pending_tiles_.erase(batch->all_neighbor_ids[i * 9]);
+			}
+			max_uploads -= static_cast<uint32_t>(end - batch->num_uploaded);
+			batch->num_uploaded = end;
+
+			if (end == num_tiles)
+			{
+				pending_batches_.pop_front();
+			}
+		}
+	}
+
+	void JudaTexture::DecodedCacheBudget(uint64_t bytes)
+	{
+		unique_lock<mutex> lock(decode_mutex_);
+
+		decoded_cache_budget_ = bytes;
+
+		uint32_t const full_tile_bytes = tile_size_ * tile_size_ * texel_size_;
+		while ((decoded_cache_size_ > decoded_cache_budget_) && !decoded_block_lru_.empty())
+		{
+			decoded_block_cache_.erase(decoded_block_lru_.front());
+			decoded_block_lru_.pop_front();
+			decoded_cache_size_ -= full_tile_bytes;
+		}
+	}
+
+	uint64_t JudaTexture::DecodedCacheBudget() const
+	{
+		return decoded_cache_budget_;
+	}
 
-		unordered_map<uint32_t, uint32_t> neighbor_id_map;
-		std::vector<uint32_t> all_neighbor_ids;
-		std::vector<uint32_t> neighbor_ids;
-		std::vector<uint32_t> tile_attrs;
-		std::vector<bool> in_same_image;
+	void JudaTexture::PrepareTiles(TileBatch& batch, std::vector<uint32_t> const & tile_ids)
+	{
+		unordered_map<uint32_t, uint32_t>& neighbor_id_map = batch.neighbor_id_map;
+		std::vector<uint32_t>& all_neighbor_ids = batch.all_neighbor_ids;
+		std::vector<uint32_t>& neighbor_ids = batch.neighbor_ids;
+		std::vector<uint32_t>& tile_attrs = batch.tile_attrs;
+		std::vector<bool>& in_same_image = batch.in_same_image;
 		KLAYGE_DECLTYPE(tile_info_map_)& tim = tile_info_map_;
 		for (size_t i = 0; i < tile_ids.size(); ++ i)
 		{
@@ -1397,14 +1581,90 @@ namespace KlayGE
 				}
 			}
 		}
+	}
+
+	void JudaTexture::DecodeBatch(TileBatchPtr const & batch)
+	{
+		uint32_t const mipmaps = tex_a_tile_cache_->NumMipMaps();
+		BOOST_ASSERT(mipmaps - 1 <= lower_levels_);
+
+		size_t const num = batch->neighbor_ids.size();
+		batch->neighbor_data.resize(num * mipmaps);
+		batch->num_uploaded = 0;
+
+		size_t const num_jobs = (num + TILES_PER_DECODE_JOB - 1) / TILES_PER_DECODE_JOB;
+		batch->remaining = static_cast<uint32_t>(num_jobs);
+		batch->decoders.resize(num_jobs);
+		for (size_t i = 0; i < num_jobs; ++ i)
+		{
+			batch->decoders[i] = Context::Instance().ThreadPool()(bind(&JudaTexture::DecodeBatchRange, this, batch,
+				i * TILES_PER_DECODE_JOB, std::min(num, (i + 1) * TILES_PER_DECODE_JOB)));
+		}
+	}
+
+	void JudaTexture::DecodeBatchRange(TileBatchPtr const & batch, size_t begin, size_t end)
+	{
+		uint32_t const mipmaps = tex_a_tile_cache_->NumMipMaps();
+
+		// In shuff order, so tiles sharing upper level blocks hit the decoded block cache
+		std::vector<std::pair<uint32_t, size_t> > shuffs(end - begin);
+		for (size_t i = begin; i < end; ++ i)
+		{
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, batch->neighbor_ids[i]);
+			shuffs[i - begin] = std::make_pair(this->Pos2Shuff(level, tile_x, tile_y), i);
+		}
+		std::sort(shuffs.begin(), shuffs.end());
+
+		for (size_t i = 0; i < shuffs.size(); ++ i)
+		{
+			size_t const index = shuffs[i].second;
+			this->DecodeTileMips(&batch->neighbor_data[index * mipmaps], batch->neighbor_ids[index], mipmaps);
+		}
+
+		-- batch->remaining;
+	}
+
+	void JudaTexture::FinishPendingBatches()
+	{
+		while (!pending_batches_.empty())
+		{
+			TileBatchPtr const batch = pending_batches_.front();
+			pending_batches_.pop_front();
+
+			typedef KLAYGE_DECLTYPE(batch->decoders) DecodersType;
+			KLAYGE_FOREACH(DecodersType::reference decoder, batch->decoders)
+			{
+				decoder();
+			}
+			this->UploadTiles(*batch, batch->num_uploaded, batch->tile_attrs.size());
+		}
+		pending_tiles_.clear();
+	}
+
+	void JudaTexture::UploadTiles(TileBatch& batch, size_t begin, size_t end)
+	{
+		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
+		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
+		uint32_t const tex_layer = tex_cache_ ? tex_cache_->ArraySize() : static_cast<uint32_t>(tex_cache_array_.size());
+		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+
+		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
+		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
+		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+
+		std::vector<uint32_t> const & all_neighbor_ids = batch.all_neighbor_ids;
+		std::vector<bool> const & in_same_image = batch.in_same_image;
+		std::vector<uint32_t> const & tile_attrs = batch.tile_attrs;
+		unordered_map<uint32_t, uint32_t>& neighbor_id_map = batch.neighbor_id_map;
+		std::vector<std::vector<uint8_t> > const & neighbor_data = batch.neighbor_data;
+		KLAYGE_DECLTYPE(tile_info_map_)& tim = tile_info_map_;
 
 		uint32_t mipmaps = tex_a_tile_cache_->NumMipMaps();
-		std::vector<std::vector<uint8_t> > neighbor_data;
-		this->DecodeTiles(neighbor_data, neighbor_ids, mipmaps);
 
 		TileInfo tile_info;
 		tile_info.tick = tile_tick_;
-		for (size_t i = 0; i < all_neighbor_ids.size(); i += 9)
+		for (size_t i = begin * 9; i < end * 9; i += 9)
 		{
 			tile_info.attr = tile_attrs[i / 9];
 			uint8_t border_clr[4];
@@ -36,6 +36,7 @@
 #include <KlayGE/RenderableHelper.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Camera.hpp>
+#include <KlayGE/SceneManager.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
@@ -589,21 +590,26 @@ namespace KlayGE
 	}
 
 
-	ParticleSystem::ParticleSystem(uint32_t max_num_particles)
+	ParticleSystem::ParticleSystem(uint32_t max_num_particles, bool simulation_only)
 		: SceneObjectHelper(SOA_Moveable),
 			particles_(max_num_particles),
-			gravity_(0.5f), force_(0, 0, 0), media_density_(0.0f)
+			particles_bound_(float3(0, 0, 0), float3(0, 0, 0)),
+			gravity_(0.5f), force_(0, 0, 0), media_density_(0.0f),
+			gs_support_(false)
 	{
 		this->ClearParticles();
 
-		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
-		gs_support_ = rf.RenderEngineInstance().DeviceCaps().gs_support;
-		renderable_ = MakeSharedPtr<RenderParticles>(gs_support_);
+		if (!simulation_only)
+		{
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			gs_support_ = rf.RenderEngineInstance().DeviceCaps().gs_support;
+			renderable_ = MakeSharedPtr<RenderParticles>(gs_support_);
+		}
 	}
 
 	ParticleSystemPtr ParticleSystem::Clone()
 	{
-		ParticleSystemPtr ret = MakeSharedPtr<ParticleSystem>(NUM_PARTICLES);
+		ParticleSystemPtr ret = MakeSharedPtr<ParticleSystem>(NUM_PARTICLES, !renderable_);
 
 		ret->emitters_.resize(emitters_.size());
 		for (size_t i = 0; i < emitters_.size(); ++ i)
@@ -707,11 +713,23 @@ namespace KlayGE
 	}
 
 	void ParticleSystem::SubThreadUpdate(float /*app_time*/, float elapsed_time)
+	{
+		// Particle systems can be updated without an app, e.g. by tests and benchmarks
+		if (Context::Instance().AppValid())
+		{
+			this->UpdateParticles(elapsed_time, Context::Instance().SceneManagerInstance().UpdateViewMatrix());
+		}
+		else
+		{
+			this->UpdateParticles(elapsed_time, float4x4::Identity());
+		}
+	}
+
+	void ParticleSystem::UpdateParticles(float elapsed_time, float4x4 const & view_mat)
 	{
 		KLAYGE_AUTO(emitter_iter, emitters_.begin());
 		uint32_t new_particle = (*emitter_iter)->Update(elapsed_time);
-		
-		float4x4 view_mat = Context::Instance().AppInstance().ActiveCamera().ViewMatrix();
+
 		std::vector<std::pair<uint32_t, float> > active_particles;
 
 		float3 min_bb(+1e10f, +1e10f, +1e10f);
@@ -762,19 +780,27 @@ namespace KlayGE
 				active_particles.push_back(std::make_pair(i, p_to_v));
 
 				min_bb = MathLib::minimize(min_bb, pos);
-				max_bb = MathLib::maximize(min_bb, pos);
+				max_bb = MathLib::maximize(max_bb, pos);
 			}
 		}
 
 		if (!active_particles.empty())
 		{
 			std::sort(active_particles.begin(), active_particles.end(), ParticleCmp());
-
-			checked_pointer_cast<RenderParticles>(renderable_)->PosBound(AABBox(min_bb, max_bb));
 		}
 
 		unique_lock<mutex> lock(update_mutex_);
 		active_particles_ = active_particles;
+		if (!active_particles.empty())
+		{
+			particles_bound_ = AABBox(min_bb, max_bb);
+		}
+	}
+
+	AABBox ParticleSystem::ParticlesBound()
+	{
+		unique_lock<mutex> lock(update_mutex_);
+		return particles_bound_;
 	}
 
 	bool ParticleSystem::MainThreadUpdate(float app_time, float elapsed_time)
@@ -782,6 +808,11 @@ namespace KlayGE
 		UNREF_PARAM(app_time);
 		UNREF_PARAM(elapsed_time);
 
+		if (!renderable_)
+		{
+			return false;
+		}
+
 		unique_lock<mutex> lock(update_mutex_);
 
 		uint32_t const num_active_particles = static_cast<uint32_t>(active_particles_.size());
@@ -804,6 +835,8 @@ namespace KlayGE
 
 		if (!active_particles_.empty())
 		{
+			checked_pointer_cast<RenderParticles>(renderable_)->PosBound(particles_bound_);
+
 			instance_gb->Resize(sizeof(ParticleInstance) * num_active_particles);
 			{
 				GraphicsBuffer::Mapper mapper(*instance_gb, BA_Write_Only);
@@ -827,32 +860,47 @@ namespace KlayGE
 	void ParticleSystem::ParticleAlphaFromTex(std::string const & tex_name)
 	{
 		particle_alpha_from_tex_name_ = tex_name;
-		checked_pointer_cast<RenderParticles>(renderable_)->ParticleAlphaFrom(
-			SyncLoadTexture(tex_name, EAH_GPU_Read | EAH_Immutable));
+		if (renderable_)
+		{
+			checked_pointer_cast<RenderParticles>(renderable_)->ParticleAlphaFrom(
+				SyncLoadTexture(tex_name, EAH_GPU_Read | EAH_Immutable));
+		}
 	}
 
 	void ParticleSystem::ParticleAlphaToTex(std::string const & tex_name)
 	{
 		particle_alpha_to_tex_name_ = tex_name;
-		checked_pointer_cast<RenderParticles>(renderable_)->ParticleAlphaTo(
-			SyncLoadTexture(tex_name, EAH_GPU_Read | EAH_Immutable));
+		if (renderable_)
+		{
+			checked_pointer_cast<RenderParticles>(renderable_)->ParticleAlphaTo(
+				SyncLoadTexture(tex_name, EAH_GPU_Read | EAH_Immutable));
+		}
 	}
 
 	void ParticleSystem::ParticleColorFrom(Color const & clr)
 	{
 		particle_color_from_ = clr;
-		checked_pointer_cast<RenderParticles>(renderable_)->ParticleColorFrom(clr);
+		if (renderable_)
+		{
+			checked_pointer_cast<RenderParticles>(renderable_)->ParticleColorFrom(clr);
+		}
 	}
 
 	void ParticleSystem::ParticleColorTo(Color const & clr)
 	{
 		particle_color_to_ = clr;
-		checked_pointer_cast<RenderParticles>(renderable_)->ParticleColorTo(clr);
+		if (renderable_)
+		{
+			checked_pointer_cast<RenderParticles>(renderable_)->ParticleColorTo(clr);
+		}
 	}
 
 	void ParticleSystem::SceneDepthTexture(TexturePtr const & depth_tex)
 	{
-		checked_pointer_cast<RenderParticles>(renderable_)->SceneDepthTexture(depth_tex);
+		if (renderable_)
+		{
+			checked_pointer_cast<RenderParticles>(renderable_)->SceneDepthTexture(depth_tex);
+		}
 	}
 
 
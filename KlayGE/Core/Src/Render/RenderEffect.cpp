@@ -54,6 +54,7 @@
 #include <KlayGE/ShaderObject.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KFL/Thread.hpp>
+#include <KFL/CpuInfo.hpp>
 
 #include <fstream>
 #include <boost/assert.hpp>
@@ -2666,6 +2667,42 @@ namespace
 			break;
 		}
 	}
+
+	struct pass_compile_item
+	{
+		RenderPass* pass;
+		uint32_t tech_index;
+		uint32_t pass_index;
+	};
+
+	class compile_shaders_worker
+	{
+	public:
+		compile_shaders_worker(std::vector<pass_compile_item> const & items, atomic<uint32_t>& cur_item)
+			: items_(&items), cur_item_(&cur_item)
+		{
+		}
+
+		void operator()()
+		{
+			uint32_t const num_items = static_cast<uint32_t>(items_->size());
+			for (uint32_t i = (*cur_item_) ++; i < num_items; i = (*cur_item_) ++)
+			{
+				pass_compile_item const & item = (*items_)[i];
+				item.pass->CompileShaders(item.tech_index, item.pass_index);
+			}
+		}
+
+	private:
+		std::vector<pass_compile_item> const * items_;
+		atomic<uint32_t>* cur_item_;
+	};
+
+	uint32_t NumCompileThreads()
+	{
+		static uint32_t const num_threads = static_cast<uint32_t>(std::max(CPUInfo().NumHWThreads(), 1));
+		return num_threads;
+	}
 }
 
 namespace KlayGE
@@ -3036,6 +3073,8 @@ namespace KlayGE
 
 					technique->Load(node, index);
 				}
+
+				this->CreateHwShaders();
 			}
 
 			std::ofstream ofs(kfx_name.c_str(), std::ios_base::binary | std::ios_base::out);
@@ -3390,6 +3429,68 @@ namespace KlayGE
 		return null_tech;
 	}
 
+	void RenderEffect::CreateHwShaders()
+	{
+		// Techniques inheriting passes without changing macros share the RenderPass objects of the parent.
+		// Only the first occurrence, which comes from the parent, carries the right indices.
+		std::vector<pass_compile_item> items;
+		for (uint32_t tech_index = 0; tech_index < techniques_.size(); ++ tech_index)
+		{
+			RenderTechniquePtr const & tech = techniques_[tech_index];
+			for (uint32_t pass_index = 0; pass_index < tech->NumPasses(); ++ pass_index)
+			{
+				RenderPass* pass = tech->Pass(pass_index).get();
+
+				bool found = false;
+				for (size_t i = 0; i < items.size(); ++ i)
+				{
+					if (items[i].pass == pass)
+					{
+						found = true;
+						break;
+					}
+				}
+				if (!found)
+				{
+					pass_compile_item item = { pass, tech_index, pass_index };
+					items.push_back(item);
+				}
+			}
+		}
+
+		// Shader compilation doesn't touch the graphics API, so it's fanned out to the thread pool.
+		// The current thread works on the same queue. Effects loaded by a pool thread, e.g. the
+		// ResLoader's, are compiled there only, so the pool doesn't grow a thread per nested task.
+		{
+			thread_pool& tp = Context::Instance().ThreadPool();
+			uint32_t const num_threads = tp.in_pool_thread() ? 1
+				: std::min(static_cast<uint32_t>(items.size()), NumCompileThreads());
+
+			atomic<uint32_t> cur_item(0);
+			std::vector<joiner<void> > joiners;
+			for (uint32_t i = 1; i < num_threads; ++ i)
+			{
+				joiners.push_back(tp(compile_shaders_worker(items, cur_item)));
+			}
+			compile_shaders_worker(items, cur_item)();
+			for (size_t i = 0; i < joiners.size(); ++ i)
+			{
+				joiners[i]();
+			}
+		}
+
+		// API objects are created on this thread, in the same order as the sequential loading
+		for (size_t i = 0; i < items.size(); ++ i)
+		{
+			items[i].pass->CreateHwShaders(items[i].tech_index, items[i].pass_index);
+		}
+
+		for (size_t i = 0; i < techniques_.size(); ++ i)
+		{
+			techniques_[i]->UpdateShaderStates();
+		}
+	}
+
 	uint32_t RenderEffect::AddShaderDesc(ShaderDesc const & sd)
 	{
 		for (uint32_t i = 0; i < shader_descs_->size(); ++ i)
@@ -3498,9 +3599,6 @@ namespace KlayGE
 
 		if (!node->FirstNode("pass") && parent_tech)
 		{
-			is_validate_ = parent_tech->is_validate_;
-			has_discard_ = parent_tech->has_discard_;
-			has_tessellation_ = parent_tech->has_tessellation_;
 			transparent_ = parent_tech->transparent_;
 			weight_ = parent_tech->weight_;
 
@@ -3518,16 +3616,11 @@ namespace KlayGE
 					RenderPassPtr inherit_pass = parent_tech->passes_[index];
 
 					pass->Load(tech_index, index, inherit_pass);
-					is_validate_ &= pass->Validate();
 				}
 			}
 		}
 		else
 		{
-			is_validate_ = true;
-
-			has_discard_ = false;
-			has_tessellation_ = false;
 			transparent_ = false;
 			if (parent_tech)
 			{
@@ -3552,8 +3645,6 @@ namespace KlayGE
 
 				pass->Load(pass_node, tech_index, index, inherit_pass);
 
-				is_validate_ &= pass->Validate();
-
 				for (XMLNodePtr state_node = pass_node->FirstNode("state"); state_node; state_node = state_node->NextSibling("state"))
 				{
 					++ weight_;
@@ -3568,9 +3659,6 @@ namespace KlayGE
 						}
 					}
 				}
-
-				has_discard_ |= pass->GetShaderObject()->HasDiscard();
-				has_tessellation_ |= pass->GetShaderObject()->HasTessellation();
 			}
 			if (transparent_)
 			{
@@ -3579,6 +3667,19 @@ namespace KlayGE
 		}
 	}
 
+	void RenderTechnique::UpdateShaderStates()
+	{
+		is_validate_ = true;
+		has_discard_ = false;
+		has_tessellation_ = false;
+		for (size_t i = 0; i < passes_.size(); ++ i)
+		{
+			is_validate_ &= passes_[i]->Validate();
+			has_discard_ |= passes_[i]->GetShaderObject()->HasDiscard();
+			has_tessellation_ |= passes_[i]->GetShaderObject()->HasTessellation();
+		}
+	}
+
 	bool RenderTechnique::StreamIn(ResIdentifierPtr const & res, uint32_t tech_index)
 	{
 		name_ = MakeSharedPtr<KLAYGE_DECLTYPE(*name_)>(ReadShortString(res));
@@ -4183,31 +4284,15 @@ namespace KlayGE
 		depth_stencil_state_obj_ = rf.MakeDepthStencilStateObject(dss_desc);
 		blend_state_obj_ = rf.MakeBlendStateObject(bs_desc);
 
+		// The first pass using a shader desc owns it. The shader objects are created later in CreateHwShaders.
 		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
 		{
 			ShaderDesc& sd = effect_.GetShaderDesc((*shader_desc_ids_)[type]);
-			if (!sd.func_name.empty())
+			if (!sd.func_name.empty() && (0xFFFFFFFF == sd.tech_pass_type))
 			{
-				if (sd.tech_pass_type != 0xFFFFFFFF)
-				{
-					RenderTechniquePtr const & tech = effect_.TechniqueByIndex(sd.tech_pass_type >> 16);
-					RenderPassPtr const & pass = tech->Pass((sd.tech_pass_type >> 8) & 0xFF);
-					shader_obj_->AttachShader(static_cast<ShaderObject::ShaderType>(type),
-						effect_, *tech, *pass, pass->GetShaderObject());
-				}
-				else
-				{
-					RenderTechniquePtr const & tech = effect_.TechniqueByIndex(tech_index);
-					shader_obj_->AttachShader(static_cast<ShaderObject::ShaderType>(type),
-						effect_, *tech, *this, *shader_desc_ids_);
-					sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
-				}
+				sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
 			}
 		}
-
-		shader_obj_->LinkShaders(effect_);
-
-		is_validate_ = shader_obj_->Validate();
 	}
 
 	void RenderPass::Load(uint32_t tech_index, uint32_t pass_index, RenderPassPtr const & inherit_pass)
@@ -4262,12 +4347,46 @@ namespace KlayGE
 				sd.macros_hash = macros_hash;
 				sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
 				(*shader_desc_ids_)[type] = effect_.AddShaderDesc(sd);
-				
-				RenderTechniquePtr const & tech = effect_.TechniqueByIndex(tech_index);
-				shader_obj_->AttachShader(static_cast<ShaderObject::ShaderType>(type),
+			}
+		}
+	}
+
+	void RenderPass::CompileShaders(uint32_t tech_index, uint32_t pass_index)
+	{
+		RenderTechniquePtr const & tech = effect_.TechniqueByIndex(tech_index);
+		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+		{
+			ShaderDesc const & sd = effect_.GetShaderDesc((*shader_desc_ids_)[type]);
+			if (!sd.func_name.empty() && (sd.tech_pass_type == (tech_index << 16) + (pass_index << 8) + type))
+			{
+				shader_obj_->CompileShader(static_cast<ShaderObject::ShaderType>(type),
 					effect_, *tech, *this, *shader_desc_ids_);
 			}
 		}
+	}
+
+	void RenderPass::CreateHwShaders(uint32_t tech_index, uint32_t pass_index)
+	{
+		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+		{
+			ShaderDesc const & sd = effect_.GetShaderDesc((*shader_desc_ids_)[type]);
+			if (!sd.func_name.empty())
+			{
+				if (sd.tech_pass_type != (tech_index << 16) + (pass_index << 8) + type)
+				{
+					RenderTechniquePtr const & tech = effect_.TechniqueByIndex(sd.tech_pass_type >> 16);
+					RenderPassPtr const & pass = tech->Pass((sd.tech_pass_type >> 8) & 0xFF);
+					shader_obj_->AttachShader(static_cast<ShaderObject::ShaderType>(type),
+						effect_, *tech, *pass, pass->GetShaderObject());
+				}
+				else
+				{
+					RenderTechniquePtr const & tech = effect_.TechniqueByIndex(tech_index);
+					shader_obj_->AttachShader(static_cast<ShaderObject::ShaderType>(type),
+						effect_, *tech, *this, *shader_desc_ids_);
+				}
+			}
+		}
 
 		shader_obj_->LinkShaders(effect_);
 
@@ -4539,6 +4658,8 @@ namespace KlayGE
 		ret->blend_state_obj_ = blend_state_obj_;
 		ret->blend_factor_ = blend_factor_;
 		ret->sample_mask_ = sample_mask_;
+		// A pass that shares shaders of another pass holds its own copy of them in its shader object,
+		// so it's cloned on its own, with the parameters looked up in the new effect.
 		ret->shader_obj_ = shader_obj_->Clone(effect);
 
 		ret->is_validate_ = is_validate_;
@@ -146,6 +146,7 @@ namespace KlayGE
 	RenderEngine::RenderEngine()
 		: num_primitives_just_rendered_(0), num_vertices_just_rendered_(0),
 			num_draws_just_called_(0), num_dispatches_just_called_(0),
+			num_state_changes_just_avoided_(0), num_shader_binds_just_avoided_(0), frame_index_(0),
 			cur_front_stencil_ref_(0),
 			cur_back_stencil_ref_(0),
 			cur_blend_factor_(1, 1, 1, 1),
@@ -198,6 +199,7 @@ namespace KlayGE
 	void RenderEngine::EndFrame()
 	{
 		this->BindFrameBuffer(default_frame_buffers_[0]);
+		++ frame_index_;
 	}
 
 	void RenderEngine::UpdateGPUTimestampsFrequency()
@@ -550,6 +552,10 @@ namespace KlayGE
 			}
 			cur_rs_obj_ = rs_obj;
 		}
+		else
+		{
+			++ num_state_changes_just_avoided_;
+		}
 
 		if ((cur_dss_obj_ != dss_obj) || (cur_front_stencil_ref_ != front_stencil_ref) || (cur_back_stencil_ref_ != back_stencil_ref))
 		{
@@ -558,6 +564,10 @@ namespace KlayGE
 			cur_front_stencil_ref_ = front_stencil_ref;
 			cur_back_stencil_ref_ = back_stencil_ref;
 		}
+		else
+		{
+			++ num_state_changes_just_avoided_;
+		}
 
 		if ((cur_bs_obj_ != bs_obj) || (cur_blend_factor_ != blend_factor) || (cur_sample_mask_ != sample_mask))
 		{
@@ -566,6 +576,10 @@ namespace KlayGE
 			cur_blend_factor_ = blend_factor;
 			cur_sample_mask_ = sample_mask;
 		}
+		else
+		{
+			++ num_state_changes_just_avoided_;
+		}
 	}
 
 	// õǰȾĿ
@@ -678,6 +692,24 @@ namespace KlayGE
 		return ret;
 	}
 
+	// Number of rasterizer, depth stencil and blend state changes filtered out since last call
+	/////////////////////////////////////////////////////////////////////////////////
+	uint32_t RenderEngine::NumStateChangesJustAvoided()
+	{
+		uint32_t const ret = num_state_changes_just_avoided_;
+		num_state_changes_just_avoided_ = 0;
+		return ret;
+	}
+
+	// Number of shader and program binds filtered out by the plugin since last call
+	/////////////////////////////////////////////////////////////////////////////////
+	uint32_t RenderEngine::NumShaderBindsJustAvoided()
+	{
+		uint32_t const ret = num_shader_binds_just_avoided_;
+		num_shader_binds_just_avoided_ = 0;
+		return ret;
+	}
+
 	// ȡȾ豸
 	/////////////////////////////////////////////////////////////////////////////////
 	RenderDeviceCaps const & RenderEngine::DeviceCaps() const
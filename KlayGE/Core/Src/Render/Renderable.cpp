@@ -28,12 +28,15 @@
 #include <KlayGE/Camera.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 
+#include <cstring>
+
 #include <KlayGE/Renderable.hpp>
 
 namespace KlayGE
 {
 	Renderable::Renderable()
-		: select_mode_on_(false),
+		: instances_changed_(false), instance_update_frame_(0xFFFFFFFF), static_instances_resident_(false),
+			select_mode_on_(false),
 			model_mat_(float4x4::Identity()), effect_attrs_(0)
 	{
 		DeferredRenderingLayerPtr const & drl = Context::Instance().DeferredRenderingLayerInstance();
@@ -217,45 +220,116 @@ namespace KlayGE
 	void Renderable::AddInstance(SceneObjectPtr const & obj)
 	{
 		instances_.push_back(weak_ptr<SceneObject>(obj));
+		instances_changed_ = true;
 	}
 
 	void Renderable::UpdateInstanceStream()
 	{
-		if (!instances_.empty() && !instances_[0].lock()->InstanceFormat().empty())
+		if (instances_.empty())
+		{
+			return;
+		}
+
+		// Later passes of the same frame reuse the stream as long as the instance list is unchanged
+		uint32_t const frame = Context::Instance().RenderFactoryInstance().RenderEngineInstance().FrameIndex();
+		if ((frame == instance_update_frame_) && !instances_changed_)
+		{
+			return;
+		}
+		instance_update_frame_ = frame;
+		instances_changed_ = false;
+
+		uint32_t const num_instances = static_cast<uint32_t>(instances_.size());
+		instance_ptrs_.resize(num_instances);
+		for (uint32_t i = 0; i < num_instances; ++ i)
+		{
+			instance_ptrs_[i] = instances_[i].lock().get();
+		}
+
+		if (!instance_ptrs_[0]->InstanceFormat().empty())
 		{
 			RenderLayoutPtr const & rl = this->GetRenderLayout();
 
 			GraphicsBufferPtr inst_stream = rl->InstanceStream();
 			if (inst_stream)
 			{
-				for (size_t i = 0; i < instances_.size(); ++ i)
+				for (size_t i = 0; i < instance_ptrs_.size(); ++ i)
 				{
-					BOOST_ASSERT(rl->InstanceStreamFormat() == instances_[i].lock()->InstanceFormat());
+					BOOST_ASSERT(rl->InstanceStreamFormat() == instance_ptrs_[i]->InstanceFormat());
 				}
 			}
 			else
 			{
 				RenderFactory& rf(Context::Instance().RenderFactoryInstance());
 
-				inst_stream = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, nullptr);
-				rl->BindVertexStream(inst_stream, instances_[0].lock()->InstanceFormat(), RenderLayout::ST_Instance, 1);
+				// Without CPU write access, so that a range can be updated without discarding the rest
+				inst_stream = rf.MakeVertexBuffer(BU_Dynamic, EAH_GPU_Read, nullptr);
+				rl->BindVertexStream(inst_stream, instance_ptrs_[0]->InstanceFormat(), RenderLayout::ST_Instance, 1);
+
+				uploaded_instances_.clear();
 			}
 
 			uint32_t const size = rl->InstanceSize();
 
-			inst_stream->Resize(static_cast<uint32_t>(size * instances_.size()));
+			bool resized = false;
+			if ((uploaded_instances_.size() != num_instances) || (inst_stream->Size() != size * num_instances))
+			{
+				uploaded_instances_.assign(num_instances, weak_ptr<SceneObject>());
+				uploaded_instance_data_.resize(size * num_instances);
+				resized = true;
+			}
+
+			// Only the instances that are new to their slots, or whose data differs from the last upload,
+			// are copied again. The changed slots are uploaded as one range.
+			uint32_t dirty_begin = num_instances;
+			uint32_t dirty_end = 0;
+			for (uint32_t i = 0; i < num_instances; ++ i)
 			{
-				GraphicsBuffer::Mapper mapper(*inst_stream, BA_Write_Only);
-				for (size_t i = 0; i < instances_.size(); ++ i)
+				SceneObject const * so = instance_ptrs_[i];
+				uint8_t* dst = &uploaded_instance_data_[i * size];
+				if (uploaded_instances_[i].owner_before(instances_[i]) || instances_[i].owner_before(uploaded_instances_[i]))
+				{
+					uploaded_instances_[i] = instances_[i];
+				}
+				else if (static_instances_resident_ && !(so->Attrib() & SceneObject::SOA_Moveable))
+				{
+					continue;
+				}
+				else if (0 == std::memcmp(dst, so->RenderInstanceData(), size))
+				{
+					continue;
+				}
+
+				uint8_t const * src = static_cast<uint8_t const *>(so->RenderInstanceData());
+				std::copy(src, src + size, dst);
+				dirty_begin = std::min(dirty_begin, i);
+				dirty_end = i + 1;
+			}
+
+			if (resized)
+			{
+				inst_stream->Resize(size * num_instances);
+				dirty_begin = 0;
+				dirty_end = num_instances;
+			}
+			if (dirty_begin < dirty_end)
+			{
+				if (inst_stream->AccessHint() & EAH_CPU_Write)
+				{
+					// A stream bound by the app. Mapping it for writing discards the rest, so all of it is written.
+					GraphicsBuffer::Mapper mapper(*inst_stream, BA_Write_Only);
+					std::copy(uploaded_instance_data_.begin(), uploaded_instance_data_.end(), mapper.Pointer<uint8_t>());
+				}
+				else
 				{
-					uint8_t const * src = static_cast<uint8_t const *>(instances_[i].lock()->InstanceData());
-					std::copy(src, src + size, mapper.Pointer<uint8_t>() + i * size);
+					inst_stream->UpdateSubresource(dirty_begin * size, (dirty_end - dirty_begin) * size,
+						&uploaded_instance_data_[dirty_begin * size]);
 				}
 			}
 
 			for (uint32_t i = 0; i < rl->NumVertexStreams(); ++ i)
 			{
-				rl->VertexStreamFrequencyDivider(i, RenderLayout::ST_Geometry, static_cast<uint32_t>(instances_.size()));
+				rl->VertexStreamFrequencyDivider(i, RenderLayout::ST_Geometry, num_instances);
 			}
 		}
 	}
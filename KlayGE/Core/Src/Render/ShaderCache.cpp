@@ -0,0 +1,491 @@
+/**
+* @file ShaderCache.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#if defined(KLAYGE_TR2_LIBRARY_FILESYSTEM_V2_SUPPORT) || defined(KLAYGE_TR2_LIBRARY_FILESYSTEM_V3_SUPPORT)
+	#include <filesystem>
+	namespace KlayGE
+	{
+		namespace filesystem = std::tr2::sys;
+	}
+#else
+	#include <boost/filesystem.hpp>
+	namespace KlayGE
+	{
+		namespace filesystem = boost::filesystem;
+	}
+#endif
+
+#include <KlayGE/ShaderCache.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	mutex singleton_mutex;
+
+	uint32_t const SHADER_CACHE_VERSION = 1;
+	uint32_t const SHADER_CACHE_ENTRY_FOURCC = MakeFourCC<'K', 'S', 'C', 'E'>::value;
+	uint32_t const SHADER_CACHE_INDEX_FOURCC = MakeFourCC<'K', 'S', 'C', 'I'>::value;
+
+	char const * SHADER_CACHE_EXT = ".shader";
+	char const * SHADER_CACHE_INDEX_NAME = "index.bin";
+
+	bool ParseEntryName(std::string const & name, uint64_t& key)
+	{
+		size_t const ext_len = strlen(SHADER_CACHE_EXT);
+		if ((name.size() != 16 + ext_len) || (name.compare(16, ext_len, SHADER_CACHE_EXT) != 0))
+		{
+			return false;
+		}
+
+		key = 0;
+		for (size_t i = 0; i < 16; ++ i)
+		{
+			char const ch = name[i];
+			uint32_t digit;
+			if ((ch >= '0') && (ch <= '9'))
+			{
+				digit = ch - '0';
+			}
+			else if ((ch >= 'a') && (ch <= 'f'))
+			{
+				digit = ch - 'a' + 10;
+			}
+			else
+			{
+				return false;
+			}
+			key = (key << 4) | digit;
+		}
+		return true;
+	}
+}
+
+namespace KlayGE
+{
+	shared_ptr<ShaderCache> ShaderCache::shader_cache_instance_;
+
+	ShaderCache::ShaderCache()
+		: max_size_(0), total_size_(0), use_tick_(0), index_dirty_(false)
+	{
+		ContextCfg const & cfg = Context::Instance().Config();
+		if ((cfg.shader_cache_size > 0) && !cfg.shader_cache_path.empty())
+		{
+			filesystem::path dir(cfg.shader_cache_path);
+#ifdef KLAYGE_TR2_LIBRARY_FILESYSTEM_V2_SUPPORT
+			if (!dir.is_complete())
+#else
+			if (!dir.is_absolute())
+#endif
+			{
+				dir = filesystem::path(ResLoader::Instance().AbsPath(".")) / dir;
+			}
+
+			try
+			{
+				if (!filesystem::exists(dir))
+				{
+					filesystem::create_directories(dir);
+				}
+				if (filesystem::is_directory(dir))
+				{
+					cache_dir_ = dir.string();
+#if defined KLAYGE_PLATFORM_WINDOWS
+					std::replace(cache_dir_.begin(), cache_dir_.end(), '\\', '/');
+#endif
+					cache_dir_.push_back('/');
+					max_size_ = static_cast<uint64_t>(cfg.shader_cache_size) * 1024 * 1024;
+
+					this->LoadIndex();
+				}
+			}
+			catch (...)
+			{
+				// Couldn't create the cache folder, run without the cache
+				cache_dir_.clear();
+				max_size_ = 0;
+			}
+		}
+	}
+
+	ShaderCache::~ShaderCache()
+	{
+		if (this->Enabled() && index_dirty_)
+		{
+			this->SaveIndex();
+		}
+	}
+
+	// Shaders are compiled on several threads, so the pointer is only read under the lock. It's taken once per
+	// compile, which costs nothing next to the compile itself.
+	ShaderCache& ShaderCache::Instance()
+	{
+		unique_lock<mutex> lock(singleton_mutex);
+		if (!shader_cache_instance_)
+		{
+			shader_cache_instance_ = MakeSharedPtr<ShaderCache>();
+		}
+		return *shader_cache_instance_;
+	}
+
+	void ShaderCache::Destroy()
+	{
+		unique_lock<mutex> lock(singleton_mutex);
+		shader_cache_instance_.reset();
+	}
+
+	void ShaderCache::Suspend()
+	{
+		if (this->Enabled())
+		{
+			unique_lock<mutex> lock(cache_mutex_);
+			if (index_dirty_)
+			{
+				this->SaveIndex();
+			}
+		}
+	}
+
+	void ShaderCache::Resume()
+	{
+	}
+
+	uint64_t ShaderCache::HashCombine(uint64_t seed, void const * data, size_t size)
+	{
+		uint8_t const * p = static_cast<uint8_t const *>(data);
+		for (size_t i = 0; i < size; ++ i)
+		{
+			seed ^= p[i];
+			seed *= 0x100000001B3ULL;
+		}
+		return seed;
+	}
+
+	uint64_t ShaderCache::HashCombine(uint64_t seed, std::string const & str)
+	{
+		// Includes the terminator, so that "ab" + "c" and "a" + "bc" hash differently
+		return HashCombine(seed, str.c_str(), str.size() + 1);
+	}
+
+	uint64_t ShaderCache::HashSeed()
+	{
+		uint64_t const FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+		return HashCombine(FNV_OFFSET_BASIS, &SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+	}
+
+	bool ShaderCache::Enabled() const
+	{
+		return max_size_ > 0;
+	}
+
+	bool ShaderCache::Load(uint64_t key, std::vector<uint8_t>& code)
+	{
+		if (!this->Enabled())
+		{
+			return false;
+		}
+
+		uint64_t entry_size;
+		{
+			unique_lock<mutex> lock(cache_mutex_);
+			KLAYGE_AUTO(iter, entries_.find(key));
+			if (iter == entries_.end())
+			{
+				return false;
+			}
+			entry_size = iter->second.size;
+		}
+
+		uint64_t const header_size = sizeof(SHADER_CACHE_ENTRY_FOURCC) + sizeof(uint64_t);
+
+		bool loaded = false;
+		std::string const path = this->EntryPath(key);
+		{
+			std::ifstream ifs(path.c_str(), std::ios_base::binary);
+			if (ifs)
+			{
+				ifs.seekg(0, std::ios_base::end);
+				uint64_t const file_size = static_cast<uint64_t>(ifs.tellg());
+				ifs.seekg(0, std::ios_base::beg);
+
+				uint32_t fourcc = 0;
+				uint64_t len = 0;
+				ifs.read(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
+				ifs.read(reinterpret_cast<char*>(&len), sizeof(len));
+				// The length comes from the disk, it has to agree with both the index and the file before it's trusted
+				if (ifs && (SHADER_CACHE_ENTRY_FOURCC == fourcc)
+					&& (len == file_size - header_size) && (header_size + len == entry_size))
+				{
+					code.resize(static_cast<size_t>(len));
+					if (len > 0)
+					{
+						ifs.read(reinterpret_cast<char*>(&code[0]), static_cast<std::streamsize>(len));
+					}
+					loaded = !ifs.fail();
+				}
+			}
+		}
+
+		if (loaded)
+		{
+			unique_lock<mutex> lock(cache_mutex_);
+			KLAYGE_AUTO(iter, entries_.find(key));
+			if (iter != entries_.end())
+			{
+				iter->second.last_use = ++ use_tick_;
+				index_dirty_ = true;
+			}
+		}
+		else
+		{
+			// Broken entry, drop it and let the caller compile again
+			code.clear();
+			this->Remove(key);
+		}
+
+		return loaded;
+	}
+
+	void ShaderCache::Store(uint64_t key, std::vector<uint8_t> const & code)
+	{
+		if (!this->Enabled())
+		{
+			return;
+		}
+
+		std::string const path = this->EntryPath(key);
+		std::string tmp_path;
+		{
+			unique_lock<mutex> lock(cache_mutex_);
+			if (entries_.find(key) != entries_.end())
+			{
+				return;
+			}
+
+			std::ostringstream ss;
+			ss << path << '.' << ++ use_tick_ << ".tmp";
+			tmp_path = ss.str();
+		}
+
+		// Write to a temporary file first, so that a half written entry is never picked up
+		{
+			std::ofstream ofs(tmp_path.c_str(), std::ios_base::binary);
+			if (!ofs)
+			{
+				return;
+			}
+
+			uint64_t const len = code.size();
+			ofs.write(reinterpret_cast<char const *>(&SHADER_CACHE_ENTRY_FOURCC), sizeof(SHADER_CACHE_ENTRY_FOURCC));
+			ofs.write(reinterpret_cast<char const *>(&len), sizeof(len));
+			if (len > 0)
+			{
+				ofs.write(reinterpret_cast<char const *>(&code[0]), static_cast<std::streamsize>(len));
+			}
+			if (!ofs)
+			{
+				ofs.close();
+				std::remove(tmp_path.c_str());
+				return;
+			}
+		}
+
+		unique_lock<mutex> lock(cache_mutex_);
+		if (entries_.find(key) != entries_.end())
+		{
+			// Another thread stored the same shader in the meantime
+			std::remove(tmp_path.c_str());
+			return;
+		}
+		if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+		{
+			std::remove(tmp_path.c_str());
+			return;
+		}
+
+		Entry entry;
+		entry.size = sizeof(SHADER_CACHE_ENTRY_FOURCC) + sizeof(uint64_t) + code.size();
+		entry.last_use = ++ use_tick_;
+		entries_.insert(std::make_pair(key, entry));
+		total_size_ += entry.size;
+		index_dirty_ = true;
+
+		if (total_size_ > max_size_)
+		{
+			this->Shrink();
+		}
+	}
+
+	void ShaderCache::Remove(uint64_t key)
+	{
+		if (!this->Enabled())
+		{
+			return;
+		}
+
+		unique_lock<mutex> lock(cache_mutex_);
+		KLAYGE_AUTO(iter, entries_.find(key));
+		if (iter != entries_.end())
+		{
+			total_size_ -= iter->second.size;
+			entries_.erase(iter);
+			index_dirty_ = true;
+			std::remove(this->EntryPath(key).c_str());
+		}
+	}
+
+	std::string ShaderCache::EntryPath(uint64_t key) const
+	{
+		std::ostringstream ss;
+		ss << cache_dir_ << std::hex << std::setfill('0') << std::setw(16) << key << SHADER_CACHE_EXT;
+		return ss.str();
+	}
+
+	void ShaderCache::LoadIndex()
+	{
+		filesystem::directory_iterator end_itr;
+		for (filesystem::directory_iterator i(cache_dir_); i != end_itr; ++ i)
+		{
+			if (filesystem::is_regular_file(i->status()))
+			{
+#ifdef KLAYGE_TR2_LIBRARY_FILESYSTEM_V2_SUPPORT
+				std::string const name = i->path().filename();
+#else
+				std::string const name = i->path().filename().string();
+#endif
+				uint64_t key;
+				if (ParseEntryName(name, key))
+				{
+					Entry entry;
+					entry.size = static_cast<uint64_t>(filesystem::file_size(i->path()));
+					entry.last_use = 0;
+					entries_.insert(std::make_pair(key, entry));
+					total_size_ += entry.size;
+				}
+			}
+		}
+
+		// Entries missing from the index are treated as the least recently used ones
+		std::ifstream ifs((cache_dir_ + SHADER_CACHE_INDEX_NAME).c_str(), std::ios_base::binary);
+		if (ifs)
+		{
+			uint32_t fourcc = 0;
+			uint32_t ver = 0;
+			uint64_t tick = 0;
+			uint32_t num_entries = 0;
+			ifs.read(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
+			ifs.read(reinterpret_cast<char*>(&ver), sizeof(ver));
+			ifs.read(reinterpret_cast<char*>(&tick), sizeof(tick));
+			ifs.read(reinterpret_cast<char*>(&num_entries), sizeof(num_entries));
+			if (ifs && (SHADER_CACHE_INDEX_FOURCC == fourcc) && (SHADER_CACHE_VERSION == ver))
+			{
+				use_tick_ = tick;
+				for (uint32_t i = 0; (i < num_entries) && ifs; ++ i)
+				{
+					uint64_t key;
+					uint64_t last_use;
+					ifs.read(reinterpret_cast<char*>(&key), sizeof(key));
+					ifs.read(reinterpret_cast<char*>(&last_use), sizeof(last_use));
+					if (ifs)
+					{
+						KLAYGE_AUTO(iter, entries_.find(key));
+						if (iter != entries_.end())
+						{
+							iter->second.last_use = last_use;
+							use_tick_ = std::max(use_tick_, last_use);
+						}
+					}
+				}
+			}
+		}
+
+		if (total_size_ > max_size_)
+		{
+			this->Shrink();
+		}
+	}
+
+	void ShaderCache::SaveIndex()
+	{
+		std::ofstream ofs((cache_dir_ + SHADER_CACHE_INDEX_NAME).c_str(), std::ios_base::binary);
+		if (ofs)
+		{
+			uint32_t const num_entries = static_cast<uint32_t>(entries_.size());
+			ofs.write(reinterpret_cast<char const *>(&SHADER_CACHE_INDEX_FOURCC), sizeof(SHADER_CACHE_INDEX_FOURCC));
+			ofs.write(reinterpret_cast<char const *>(&SHADER_CACHE_VERSION), sizeof(SHADER_CACHE_VERSION));
+			ofs.write(reinterpret_cast<char const *>(&use_tick_), sizeof(use_tick_));
+			ofs.write(reinterpret_cast<char const *>(&num_entries), sizeof(num_entries));
+			typedef KLAYGE_DECLTYPE(entries_) EntriesType;
+			KLAYGE_FOREACH(EntriesType::const_reference entry, entries_)
+			{
+				ofs.write(reinterpret_cast<char const *>(&entry.first), sizeof(entry.first));
+				ofs.write(reinterpret_cast<char const *>(&entry.second.last_use), sizeof(entry.second.last_use));
+			}
+
+			index_dirty_ = false;
+		}
+	}
+
+	// Evicts the least recently used entries until the cache is down to 3/4 of its limit,
+	// so that the next few stores don't trigger another eviction right away
+	void ShaderCache::Shrink()
+	{
+		std::vector<std::pair<uint64_t, uint64_t> > lru;
+		lru.reserve(entries_.size());
+		typedef KLAYGE_DECLTYPE(entries_) EntriesType;
+		KLAYGE_FOREACH(EntriesType::const_reference entry, entries_)
+		{
+			lru.push_back(std::make_pair(entry.second.last_use, entry.first));
+		}
+		std::sort(lru.begin(), lru.end());
+
+		uint64_t const target_size = max_size_ / 4 * 3;
+		for (size_t i = 0; (i < lru.size()) && (total_size_ > target_size); ++ i)
+		{
+			KLAYGE_AUTO(iter, entries_.find(lru[i].second));
+			std::remove(this->EntryPath(iter->first).c_str());
+			total_size_ -= iter->second.size;
+			entries_.erase(iter);
+		}
+
+		index_dirty_ = true;
+	}
+}
@@ -90,4 +90,14 @@ namespace KlayGE
 			cs_block_size_x_(0), cs_block_size_y_(0), cs_block_size_z_(0)
 	{
 	}
+
+	void ShaderObject::CompileShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids)
+	{
+		UNREF_PARAM(type);
+		UNREF_PARAM(effect);
+		UNREF_PARAM(tech);
+		UNREF_PARAM(pass);
+		UNREF_PARAM(shader_desc_ids);
+	}
 }
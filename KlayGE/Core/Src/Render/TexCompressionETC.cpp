@@ -34,11 +34,16 @@
 #include <KFL/Color.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KFL/Thread.hpp>
+#include <KFL/CpuInfo.hpp>
 
 #include <vector>
 #include <cstring>
 #include <boost/assert.hpp>
 
+#ifdef KLAYGE_SSE2_SUPPORT
+	#include <emmintrin.h>
+#endif
+
 #include <KlayGE/TexCompressionETC.hpp>
 
 namespace
@@ -49,6 +54,9 @@ namespace
 
 	static uint8_t const selector_index_to_etc1[] = { 3, 2, 0, 1 };
 
+	// In TCM_Speed, stop trying other subblock layouts and color modes once a block is this close, an RMS error of 4 per channel.
+	uint64_t const SPEED_EARLY_OUT_ERROR = 16 * 3 * 4 * 4;
+
 	// color8_to_etc_block_config_0_255[color][table_index] = Supplies for each 8-bit color value a list of packed ETC1 diff/intensity table/selectors/packed_colors that map to that color.
 	// To pack: diff | (inten << 1) | (selector << 4) | (packed_c << 8)
 	static uint16_t const color8_to_etc_block_config_0_255[2][33] =
@@ -502,6 +510,63 @@ namespace
 
 		return cur_ind;
 	}
+
+	// Sum of squared distances of the pixels to the average of their subblocks, times 8. Flipped subblocks are the top and bottom halves.
+	uint32_t SubblockVariance(ARGBColor32 const * argb, bool flip)
+	{
+		uint32_t variance = 0;
+		for (uint32_t subblock = 0; subblock < 2; ++ subblock)
+		{
+			uint32_t sum[3] = { 0, 0, 0 };
+			uint32_t sum_sq[3] = { 0, 0, 0 };
+			for (uint32_t i = 0; i < 8; ++ i)
+			{
+				ARGBColor32 const & c = flip ? argb[subblock * 8 + i] : argb[(i & 3) * 4 + subblock * 2 + (i >> 2)];
+				for (uint32_t ch = 0; ch < 3; ++ ch)
+				{
+					sum[ch] += c[ch];
+					sum_sq[ch] += c[ch] * c[ch];
+				}
+			}
+			for (uint32_t ch = 0; ch < 3; ++ ch)
+			{
+				variance += 8 * sum_sq[ch] - sum[ch] * sum[ch];
+			}
+		}
+		return variance;
+	}
+
+	struct ETC1EncodeParam
+	{
+		uint32_t width;
+		uint32_t height;
+		uint8_t* output;
+		uint32_t out_row_pitch;
+		uint8_t const * input;
+		uint32_t in_row_pitch;
+		TexCompressionMethod method;
+		atomic<uint32_t>* cur_block_row;
+	};
+
+	void ETC1EncodeWorker(ETC1EncodeParam const * param)
+	{
+		TexCompressionETC1 codec;
+
+		uint32_t const num_block_rows = (param->height + 3) / 4;
+		for (;;)
+		{
+			uint32_t const block_row = (*param->cur_block_row) ++;
+			if (block_row >= num_block_rows)
+			{
+				break;
+			}
+
+			uint32_t const y = block_row * 4;
+			codec.TexCompression::EncodeMem(param->width, std::min(4U, param->height - y),
+				param->output + block_row * param->out_row_pitch, param->out_row_pitch, 0,
+				param->input + y * param->in_row_pitch, param->in_row_pitch, 0, param->method);
+		}
+	}
 }
 
 namespace KlayGE
@@ -720,6 +785,45 @@ namespace KlayGE
 		this->EncodeETC1BlockInternal(*static_cast<ETC1Block*>(output), static_cast<ARGBColor32 const *>(input), method);
 	}
 
+	void TexCompressionETC1::EncodeMem(uint32_t width, uint32_t height,
+		void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
+		void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
+		TexCompressionMethod method)
+	{
+		CPUInfo cpu;
+		uint32_t const num_block_rows = (height + block_height_ - 1) / block_height_;
+		uint32_t const num_threads = std::min(static_cast<uint32_t>(std::max(cpu.NumHWThreads(), 1)), num_block_rows);
+		if (num_threads <= 1)
+		{
+			TexCompression::EncodeMem(width, height, output, out_row_pitch, out_slice_pitch,
+				input, in_row_pitch, in_slice_pitch, method);
+		}
+		else
+		{
+			atomic<uint32_t> cur_block_row(0);
+
+			ETC1EncodeParam param;
+			param.width = width;
+			param.height = height;
+			param.output = static_cast<uint8_t*>(output);
+			param.out_row_pitch = out_row_pitch;
+			param.input = static_cast<uint8_t const *>(input);
+			param.in_row_pitch = in_row_pitch;
+			param.method = method;
+			param.cur_block_row = &cur_block_row;
+
+			std::vector<joiner<void> > joiners(num_threads);
+			for (size_t i = 0; i < joiners.size(); ++ i)
+			{
+				joiners[i] = Context::Instance().ThreadPool()(bind(ETC1EncodeWorker, &param));
+			}
+			for (size_t i = 0; i < joiners.size(); ++ i)
+			{
+				joiners[i]();
+			}
+		}
+	}
+
 	uint64_t TexCompressionETC1::EncodeETC1BlockInternal(ETC1Block& dst_block, ARGBColor32 const * argb, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(argb);
@@ -752,9 +856,18 @@ namespace KlayGE
 		params.num_src_pixels_ = 8;
 		params.src_pixels_ = subblock_pixels;
 
-		for (uint32_t flip = 0; flip < 2; ++ flip)
+		// In TCM_Speed, the subblock layout with less variance goes first, and the search stops as soon as the error is low enough.
+		uint32_t first_flip = 0;
+		if (TCM_Speed == method)
+		{
+			first_flip = (SubblockVariance(argb, true) < SubblockVariance(argb, false)) ? 1 : 0;
+		}
+
+		bool early_out = false;
+		for (uint32_t flip_trial = 0; (flip_trial < 2) && !early_out; ++ flip_trial)
 		{
-			for (uint32_t use_color4 = 0; use_color4 < 2; ++ use_color4)
+			uint32_t const flip = first_flip ^ flip_trial;
+			for (uint32_t use_color4 = 0; (use_color4 < 2) && !early_out; ++ use_color4)
 			{
 				uint64_t trial_err = 0;
 
@@ -889,6 +1002,8 @@ namespace KlayGE
 				best_results[1] = results[1];
 				best_flip = flip ? true : false;
 				best_use_color4 = use_color4 ? true : false;
+
+				early_out = (TCM_Speed == method) && (best_err <= SPEED_EARLY_OUT_ERROR);
 			} // use_color4
 		} // flip
 
@@ -1652,6 +1767,75 @@ namespace KlayGE
 
 		trial_solution.error_ = std::numeric_limits<uint64_t>::max();
 
+#ifdef KLAYGE_SSE2_SUPPORT
+		// The 8 pixels as 16-bit BGR0, 2 pixels per register. Each selector is evaluated on 4 pixels at a time.
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+		__m128i pixels[4];
+		{
+			__m128i const p0 = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const *>(params_->src_pixels_ + 0)), rgb_mask);
+			__m128i const p1 = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const *>(params_->src_pixels_ + 4)), rgb_mask);
+			pixels[0] = _mm_unpacklo_epi8(p0, zero);
+			pixels[1] = _mm_unpackhi_epi8(p0, zero);
+			pixels[2] = _mm_unpacklo_epi8(p1, zero);
+			pixels[3] = _mm_unpackhi_epi8(p1, zero);
+		}
+
+		for (uint32_t inten_table = 0; inten_table < 8; ++ inten_table)
+		{
+			__m128i best_err[2];
+			__m128i best_selector[2];
+			for (uint32_t s = 0; s < 4; ++ s)
+			{
+				int const yd = GetModifier(inten_table, s);
+				ARGBColor32 const block_color = From4Ints(0, base_color.r() + yd, base_color.g() + yd, base_color.b() + yd);
+				__m128i const bc = _mm_unpacklo_epi8(_mm_set1_epi32(block_color.ARGB()), zero);
+				__m128i const selector = _mm_set1_epi32(s);
+
+				for (uint32_t half = 0; half < 2; ++ half)
+				{
+					__m128i const d0 = _mm_sub_epi16(pixels[half * 2 + 0], bc);
+					__m128i const d1 = _mm_sub_epi16(pixels[half * 2 + 1], bc);
+					// b^2+g^2 and r^2 of each pixel, summed pairwise
+					__m128 const e0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0));
+					__m128 const e1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+					__m128i const err = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(e0, e1, _MM_SHUFFLE(2, 0, 2, 0))),
+						_mm_castps_si128(_mm_shuffle_ps(e0, e1, _MM_SHUFFLE(3, 1, 3, 1))));
+
+					if (0 == s)
+					{
+						best_err[half] = err;
+						best_selector[half] = zero;
+					}
+					else
+					{
+						// Strictly less, so the lowest selector wins on ties, as in the scalar version
+						__m128i const mask = _mm_cmplt_epi32(err, best_err[half]);
+						best_err[half] = _mm_or_si128(_mm_and_si128(mask, err), _mm_andnot_si128(mask, best_err[half]));
+						best_selector[half] = _mm_or_si128(_mm_and_si128(mask, selector), _mm_andnot_si128(mask, best_selector[half]));
+					}
+				}
+			}
+
+			uint32_t errs[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(errs), _mm_add_epi32(best_err[0], best_err[1]));
+			uint64_t const total_err = errs[0] + errs[1] + errs[2] + errs[3];
+			if (total_err < trial_solution.error_)
+			{
+				uint32_t selectors[8];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&selectors[0]), best_selector[0]);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&selectors[4]), best_selector[1]);
+				for (uint32_t c = 0; c < N; ++ c)
+				{
+					trial_solution.selectors_[c] = static_cast<uint8_t>(selectors[c]);
+				}
+
+				trial_solution.error_ = total_err;
+				trial_solution.coords_.inten_table_ = inten_table;
+				trial_solution.valid_ = true;
+			}
+		}
+#else
 		for (uint32_t inten_table = 0; inten_table < 8; ++ inten_table)
 		{
 			ARGBColor32 block_colors[4];
@@ -1718,6 +1902,7 @@ namespace KlayGE
 				trial_solution.valid_ = true;
 			}
 		}
+#endif
 		trial_solution.coords_.unscaled_color_ = coords.unscaled_color_;
 		trial_solution.coords_.color4_ = params_->use_color4_;
 
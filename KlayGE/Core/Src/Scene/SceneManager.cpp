@@ -103,7 +103,9 @@ namespace KlayGE
 			num_objects_rendered_(0), num_renderables_rendered_(0),
 			num_primitives_rendered_(0), num_vertices_rendered_(0),
 			num_draw_calls_(0), num_dispatch_calls_(0),
-			quit_(false), deferred_mode_(false)
+			num_state_changes_avoided_(0), num_shader_binds_avoided_(0),
+			quit_(false), pipelined_(false), in_pipelined_update_(false), deferred_mode_(false),
+			update_view_(float4x4::Identity()), transform_objs_dirty_(true)
 	{
 	}
 
@@ -112,7 +114,10 @@ namespace KlayGE
 	SceneManager::~SceneManager()
 	{
 		quit_ = true;
-		(*update_thread_)();
+		if (update_thread_)
+		{
+			(*update_thread_)();
+		}
 
 		this->ClearLight();
 		this->ClearCamera();
@@ -143,8 +148,12 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::ClipScene()
 	{
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
+		this->ClipScene(Context::Instance().AppInstance().ActiveCamera());
+	}
+
+	void SceneManager::ClipScene(Camera const & camera)
+	{
+		frustum_ = &camera.ViewFrustum();
 
 		float4x4 view_proj = camera.ViewProjMatrix();
 		DeferredRenderingLayerPtr const & drl = Context::Instance().DeferredRenderingLayerInstance();
@@ -167,11 +176,6 @@ namespace KlayGE
 				visible = this->VisibleTestFromParent(obj, camera.EyePos(), view_proj);
 				if (BO_Partial == visible)
 				{
-					if (attr & SceneObject::SOA_Moveable)
-					{
-						obj->UpdateAbsModelMatrix();
-					}
-
 					AABBoxPtr aabb_ws;
 					if (attr & SceneObject::SOA_Cullable)
 					{
@@ -274,9 +278,22 @@ namespace KlayGE
 
 	void SceneManager::AddSceneObjectLocked(SceneObjectPtr const & obj)
 	{
-		App3DFramework& app = Context::Instance().AppInstance();
-		float const app_time = app.AppTime();
-		float const frame_time = app.FrameTime();
+		// Only the update itself is deferred. Its objects are a copy, so the main thread can add and remove meanwhile.
+		if (in_pipelined_update_ && (threadof(0) == pipelined_update_thread_))
+		{
+			pending_added_scene_objs_.push_back(obj);
+			return;
+		}
+
+		// Objects can be added without an app, e.g. by tools and benchmarks
+		float app_time = 0;
+		float frame_time = 0;
+		if (Context::Instance().AppValid())
+		{
+			App3DFramework& app = Context::Instance().AppInstance();
+			app_time = app.AppTime();
+			frame_time = app.FrameTime();
+		}
 		obj->MainThreadUpdate(app_time, frame_time);
 
 		uint32_t const attr = obj->Attrib();
@@ -286,13 +303,16 @@ namespace KlayGE
 		}
 		else
 		{
-			if ((attr & SceneObject::SOA_Cullable)
-				&& !(attr & SceneObject::SOA_Moveable))
+			if (pipelined_)
 			{
-				obj->UpdateAbsModelMatrix();
+				obj->SnapshotRenderState();
 			}
 
+			// Moving objects get their bounds now too, instead of being culled with empty ones until the next frame
+			obj->UpdateAbsModelMatrix();
+
 			scene_objs_.push_back(obj);
+			transform_objs_dirty_ = true;
 			this->OnAddSceneObject(obj);
 		}
 	}
@@ -307,6 +327,12 @@ namespace KlayGE
 
 	void SceneManager::DelSceneObjectLocked(SceneObjectPtr const & obj)
 	{
+		if (in_pipelined_update_ && (threadof(0) == pipelined_update_thread_))
+		{
+			pending_deleted_scene_objs_.push_back(obj);
+			return;
+		}
+
 		for (SceneObjsType::iterator iter = scene_objs_.begin(); iter != scene_objs_.end(); ++ iter)
 		{
 			if (*iter == obj)
@@ -326,11 +352,17 @@ namespace KlayGE
 	SceneManager::SceneObjsType::iterator SceneManager::DelSceneObjectLocked(SceneManager::SceneObjsType::iterator iter)
 	{
 		this->OnDelSceneObject(iter);
+		transform_objs_dirty_ = true;
 		return scene_objs_.erase(iter);
 	}
 
 	// Ⱦ
 	/////////////////////////////////////////////////////////////////////////////////
+	void SceneManager::SceneObjectParentChanged()
+	{
+		transform_objs_dirty_ = true;
+	}
+
 	void SceneManager::AddRenderable(RenderablePtr const & obj)
 	{
 		bool add;
@@ -465,6 +497,7 @@ namespace KlayGE
 		unique_lock<mutex> lock(update_mutex_);
 		scene_objs_.resize(0);
 		overlay_scene_objs_.resize(0);
+		transform_objs_dirty_ = true;
 	}
 
 	// ³
@@ -473,11 +506,28 @@ namespace KlayGE
 	{
 		deferred_mode_ = !!Context::Instance().DeferredRenderingLayerInstance();
 
+		this->PipelinedMode(Context::Instance().Config().pipelined_update);
+
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 		re.BeginFrame();
 
+		App3DFramework& app = Context::Instance().AppInstance();
+		float const app_time = app.AppTime();
+		float const frame_time = app.FrameTime();
+
+		shared_ptr<joiner<void> > pipelined_update;
+		if (pipelined_)
+		{
+			pipelined_update = this->BeginPipelinedUpdate(app_time, frame_time);
+		}
+
 		this->FlushScene();
 
+		if (pipelined_update)
+		{
+			this->EndPipelinedUpdate(*pipelined_update, app_time, frame_time);
+		}
+
 		if (!update_thread_ && !quit_)
 		{
 			update_thread_ = MakeSharedPtr<joiner<void> >(Context::Instance().ThreadPool()(
@@ -487,10 +537,6 @@ namespace KlayGE
 		InputEngine& ie = Context::Instance().InputFactoryInstance().InputEngineInstance();
 		ie.Update();
 
-		App3DFramework& app = Context::Instance().AppInstance();
-		float const app_time = app.AppTime();
-		float const frame_time = app.FrameTime();
-
 		typedef KLAYGE_DECLTYPE(cameras_) CamerasType;
 		KLAYGE_FOREACH(CamerasType::const_reference camera, cameras_)
 		{
@@ -510,6 +556,8 @@ namespace KlayGE
 		{
 			unique_lock<mutex> lock(update_mutex_);
 
+			update_view_ = app.ActiveCamera().ViewMatrix();
+
 			KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, scene_objs_)
 			{
 				if (scene_obj->MainThreadUpdate(app_time, frame_time))
@@ -545,21 +593,58 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Flush(uint32_t urt)
 	{
-		unique_lock<mutex> lock(update_mutex_);
-
-		urt_ = urt;
+		if (pipelined_)
+		{
+			// The pipelined update only writes state its objects own, and defers adding and removing
+			// objects. Rendering reads snapshots and state published on the main thread, so it doesn't
+			// need to wait for the update.
+			this->DoFlush(urt);
+		}
+		else
+		{
+			unique_lock<mutex> lock(update_mutex_);
+			// After the app has updated this pass, and with the latest sub thread update, so nothing is culled a frame late
+			this->UpdateTransforms();
+			this->DoFlush(urt);
+		}
+	}
 
+	void SceneManager::DoFlush(uint32_t urt)
+	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 		App3DFramework& app = Context::Instance().AppInstance();
-		float const app_time = app.AppTime();
-		float const frame_time = app.FrameTime();
 
-		num_objects_rendered_ = 0;
 		num_renderables_rendered_ = 0;
 		num_primitives_rendered_ = 0;
 		num_vertices_rendered_ = 0;
 
-		Camera& camera = app.ActiveCamera();
+		this->BuildRenderQueue(app.ActiveCamera(), urt);
+
+		typedef KLAYGE_DECLTYPE(render_queue_) RenderQueueType;
+		KLAYGE_FOREACH(RenderQueueType::reference items, render_queue_)
+		{
+			typedef KLAYGE_DECLTYPE(items.second) ItemsType;
+			KLAYGE_FOREACH(ItemsType::reference item, items.second)
+			{
+				item->Render();
+			}
+			num_renderables_rendered_ += static_cast<uint32_t>(items.second.size());
+		}
+		render_queue_.resize(0);
+
+		num_primitives_rendered_ += re.NumPrimitivesJustRendered();
+		num_vertices_rendered_ += re.NumVerticesJustRendered();
+
+		urt_ = 0;
+	}
+
+	void SceneManager::BuildRenderQueue(Camera const & camera, uint32_t urt)
+	{
+		urt_ = urt;
+
+		num_objects_rendered_ = 0;
+		render_queue_.resize(0);
+
 		SceneObjsType& scene_objs = (urt & App3DFramework::URV_Overlay) ? overlay_scene_objs_ : scene_objs_;
 
 		KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, scene_objs)
@@ -586,7 +671,7 @@ namespace KlayGE
 			KLAYGE_AUTO(vmiter, visible_marks_map_.find(seed));
 			if (vmiter == visible_marks_map_.end())
 			{
-				this->ClipScene();
+				this->ClipScene(camera);
 
 				shared_ptr<std::vector<BoundOverlap> > visible_marks
 					= MakeSharedPtr<std::vector<BoundOverlap> >(scene_objs.size());
@@ -607,6 +692,9 @@ namespace KlayGE
 		}
 		if (urt & App3DFramework::URV_Overlay)
 		{
+			App3DFramework& app = Context::Instance().AppInstance();
+			float const app_time = app.AppTime();
+			float const frame_time = app.FrameTime();
 			KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, scene_objs)
 			{
 				scene_obj->MainThreadUpdate(app_time, frame_time);
@@ -667,7 +755,7 @@ namespace KlayGE
 					float md = 1e10f;
 					for (uint32_t i = 0; i < num; ++ i)
 					{
-						float4x4 const & mat = renderable->GetInstance(i)->ModelMatrix();
+						float4x4 const & mat = renderable->GetInstance(i)->RenderModelMatrix();
 						float4 const zvec(MathLib::dot(mat.Row(0), view_mat_z),
 							MathLib::dot(mat.Row(1), view_mat_z), MathLib::dot(mat.Row(2), view_mat_z),
 							MathLib::dot(mat.Row(3), view_mat_z));
@@ -690,20 +778,7 @@ namespace KlayGE
 				}
 				items.second.swap(sorted_items);
 			}
-
-			typedef KLAYGE_DECLTYPE(items.second) ItemsType;
-			KLAYGE_FOREACH(ItemsType::reference item, items.second)
-			{
-				item->Render();
-			}
-			num_renderables_rendered_ += static_cast<uint32_t>(items.second.size());
 		}
-		render_queue_.resize(0);
-
-		num_primitives_rendered_ += re.NumPrimitivesJustRendered();
-		num_vertices_rendered_ += re.NumVerticesJustRendered();
-
-		urt_ = 0;
 	}
 
 	// ȡȾ
@@ -744,6 +819,21 @@ namespace KlayGE
 		return num_dispatch_calls_;
 	}
 
+	uint32_t SceneManager::NumStateChangesAvoided() const
+	{
+		return num_state_changes_avoided_;
+	}
+
+	uint32_t SceneManager::NumShaderBindsAvoided() const
+	{
+		return num_shader_binds_avoided_;
+	}
+
+	float4x4 const & SceneManager::UpdateViewMatrix() const
+	{
+		return update_view_;
+	}
+
 	void SceneManager::FlushScene()
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
@@ -784,6 +874,8 @@ namespace KlayGE
 
 		num_draw_calls_ = re.NumDrawsJustCalled();
 		num_dispatch_calls_ = re.NumDispatchesJustCalled();
+		num_state_changes_avoided_ = re.NumStateChangesJustAvoided();
+		num_shader_binds_avoided_ = re.NumShaderBindsJustAvoided();
 	}
 
 	void SceneManager::UpdateThreadFunc()
@@ -799,7 +891,7 @@ namespace KlayGE
 			if (Context::Instance().AppValid())
 			{
 				WindowPtr const & win = Context::Instance().AppInstance().MainWnd();
-				if (win && win->Active())
+				if (win && win->Active() && !pipelined_)
 				{
 					unique_lock<mutex> lock(update_mutex_);
 
@@ -821,6 +913,179 @@ namespace KlayGE
 		}
 	}
 
+	void SceneManager::PipelinedMode(bool pipelined)
+	{
+		if (pipelined != pipelined_)
+		{
+			unique_lock<mutex> lock(update_mutex_);
+			if (!pipelined)
+			{
+				KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, scene_objs_)
+				{
+					scene_obj->DiscardRenderState();
+				}
+			}
+			pipelined_ = pipelined;
+		}
+	}
+
+	shared_ptr<joiner<void> > SceneManager::BeginPipelinedUpdate(float app_time, float frame_time)
+	{
+		BOOST_ASSERT(pipelined_);
+
+		{
+			unique_lock<mutex> lock(update_mutex_);
+			KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, scene_objs_)
+			{
+				scene_obj->SnapshotRenderState();
+			}
+
+			this->UpdateTransforms();
+
+			pipelined_update_objs_ = scene_objs_;
+		}
+
+		return MakeSharedPtr<joiner<void> >(Context::Instance().ThreadPool()(
+			bind(&SceneManager::PipelinedUpdateFunc, this, app_time, frame_time)));
+	}
+
+	void SceneManager::EndPipelinedUpdate(joiner<void>& update, float app_time, float frame_time)
+	{
+		update();
+
+		unique_lock<mutex> lock(update_mutex_);
+
+		pipelined_update_objs_.clear();
+
+		KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, overlay_scene_objs_)
+		{
+			scene_obj->SubThreadUpdate(app_time, frame_time);
+		}
+
+		KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, pending_deleted_scene_objs_)
+		{
+			this->DelSceneObjectLocked(scene_obj);
+		}
+		pending_deleted_scene_objs_.clear();
+		KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, pending_added_scene_objs_)
+		{
+			this->AddSceneObjectLocked(scene_obj);
+		}
+		pending_added_scene_objs_.clear();
+	}
+
+	void SceneManager::PipelinedUpdateFunc(float app_time, float frame_time)
+	{
+		{
+			unique_lock<mutex> lock(update_mutex_);
+			pipelined_update_thread_ = threadof(0);
+			in_pipelined_update_ = true;
+		}
+
+		KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, pipelined_update_objs_)
+		{
+			scene_obj->SubThreadUpdate(app_time, frame_time);
+		}
+
+		unique_lock<mutex> lock(update_mutex_);
+		in_pipelined_update_ = false;
+	}
+
+	// World matrices and bounds are updated here before each flush, or once a frame from the snapshot in pipelined mode.
+	// Unchanged objects cost only a compare, and a change flows down to the children in one sweep.
+	void SceneManager::UpdateTransforms()
+	{
+		if (transform_objs_dirty_)
+		{
+			std::vector<std::pair<uint32_t, SceneObject*> > depth_objs;
+			unordered_set<SceneObject*> added;
+			KLAYGE_FOREACH(SceneObjsType::const_reference obj, scene_objs_)
+			{
+				// Static objects are swept too after they, or one of their ancestors, are reparented
+				bool moving = false;
+				uint32_t depth = 0;
+				for (SceneObject* so = obj.get(); so; so = so->Parent())
+				{
+					if ((so->Attrib() & SceneObject::SOA_Moveable) || !so->AbsModelMatrixValid())
+					{
+						moving = true;
+					}
+					if (so != obj.get())
+					{
+						++ depth;
+					}
+				}
+
+				if (moving)
+				{
+					// Ancestors are needed too, for their world matrices
+					for (SceneObject* so = obj.get(); so && added.insert(so).second; so = so->Parent())
+					{
+						depth_objs.push_back(std::make_pair(depth, so));
+						-- depth;
+					}
+				}
+			}
+			std::sort(depth_objs.begin(), depth_objs.end());
+
+			unordered_map<SceneObject*, int32_t> indices;
+			transform_objs_.resize(depth_objs.size());
+			transform_parents_.resize(depth_objs.size());
+			transform_depth_begins_.clear();
+			for (size_t i = 0; i < depth_objs.size(); ++ i)
+			{
+				if ((0 == i) || (depth_objs[i].first != depth_objs[i - 1].first))
+				{
+					transform_depth_begins_.push_back(static_cast<uint32_t>(i));
+				}
+
+				SceneObject* so = depth_objs[i].second;
+				transform_objs_[i] = so;
+				transform_parents_[i] = so->Parent() ? indices[so->Parent()] : -1;
+				indices.insert(std::make_pair(so, static_cast<int32_t>(i)));
+			}
+			transform_depth_begins_.push_back(static_cast<uint32_t>(depth_objs.size()));
+			transform_changed_.resize(transform_objs_.size());
+
+			transform_batch_.resize(transform_objs_.size());
+			transform_models_.resize(transform_objs_.size());
+			transform_parent_abs_.resize(transform_objs_.size());
+			transform_bounds_.resize(transform_objs_.size());
+
+			transform_objs_dirty_ = false;
+		}
+
+		// The changed objects of a depth go through the batch matrix products and box transforms together
+		for (size_t d = 0; d + 1 < transform_depth_begins_.size(); ++ d)
+		{
+			uint32_t num = 0;
+			for (uint32_t i = transform_depth_begins_[d]; i < transform_depth_begins_[d + 1]; ++ i)
+			{
+				int32_t const parent = transform_parents_[i];
+				bool const parent_changed = (parent >= 0) && transform_changed_[parent];
+				bool const changed = transform_objs_[i]->BeginAbsModelMatrixUpdate(parent_changed,
+					transform_models_[num], transform_bounds_[num]);
+				transform_changed_[i] = changed;
+				if (changed)
+				{
+					transform_parent_abs_[num] = (parent >= 0) ? transform_objs_[parent]->AbsModelMatrix() : float4x4::Identity();
+					transform_batch_[num] = i;
+					++ num;
+				}
+			}
+
+			if (num > 0)
+			{
+				MathLib::mul(&transform_models_[0], &transform_parent_abs_[0], &transform_models_[0], num);
+				MathLib::transform_aabb(&transform_bounds_[0], &transform_bounds_[0], &transform_models_[0], num);
+				for (uint32_t j = 0; j < num; ++ j)
+				{
+					transform_objs_[transform_batch_[j]]->EndAbsModelMatrixUpdate(transform_models_[j], transform_bounds_[j]);
+				}
+			}
+		}
+	}
+
 	BoundOverlap SceneManager::VisibleTestFromParent(SceneObjectPtr const & obj,
 		float3 const & eye_pos, float4x4 const & view_proj)
 	{
@@ -835,11 +1100,6 @@ namespace KlayGE
 			else
 			{
 				uint32_t const attr = obj->Attrib();
-				if (attr & SceneObject::SOA_Moveable)
-				{
-					obj->UpdateAbsModelMatrix();
-				}
-
 				AABBoxPtr aabb_ws;
 				if (attr & SceneObject::SOA_Cullable)
 				{
@@ -29,7 +29,8 @@ namespace KlayGE
 	SceneObject::SceneObject(uint32_t attrib)
 		: attrib_(attrib), parent_(nullptr),
 			model_(float4x4::Identity()), abs_model_(float4x4::Identity()),
-			visible_mark_(BO_No)
+			abs_model_valid_(false),
+			visible_mark_(BO_No), has_render_state_(false)
 	{
 		if (!(attrib & SOA_Overlay) && (attrib & (SOA_Cullable | SOA_Moveable)))
 		{
@@ -48,7 +49,18 @@ namespace KlayGE
 
 	void SceneObject::Parent(SceneObject* so)
 	{
-		parent_ = so;
+		if (parent_ != so)
+		{
+			parent_ = so;
+			abs_model_valid_ = false;
+
+			// The scene manager orders its transform updates by the hierarchy
+			Context& context = Context::Instance();
+			if (context.SceneManagerValid())
+			{
+				context.SceneManagerInstance().SceneObjectParentChanged();
+			}
+		}
 	}
 
 	uint32_t SceneObject::NumChildren() const
@@ -89,24 +101,92 @@ namespace KlayGE
 
 	void SceneObject::UpdateAbsModelMatrix()
 	{
+		updated_model_ = this->RenderModelMatrix();
 		if (parent_)
 		{
-			abs_model_ = parent_->ModelMatrix() * model_;
+			if (!parent_->abs_model_valid_)
+			{
+				parent_->UpdateAbsModelMatrix();
+			}
+			abs_model_ = parent_->AbsModelMatrix() * updated_model_;
 		}
 		else
 		{
-			abs_model_ = model_;
+			abs_model_ = updated_model_;
 		}
 
 		if (renderable_)
 		{
 			if (pos_aabb_ws_)
 			{
-				*pos_aabb_ws_ = MathLib::transform_aabb(renderable_->PosBound(), abs_model_);
+				updated_pos_bound_ = renderable_->PosBound();
+				*pos_aabb_ws_ = MathLib::transform_aabb(updated_pos_bound_, abs_model_);
 			}
 
 			renderable_->ModelMatrix(abs_model_);
 		}
+
+		abs_model_valid_ = true;
+	}
+
+	bool SceneObject::UpdateAbsModelMatrix(bool parent_changed)
+	{
+		bool changed = parent_changed || !abs_model_valid_ || (this->RenderModelMatrix() != updated_model_);
+		if (!changed && renderable_ && pos_aabb_ws_)
+		{
+			// Bounds of particle systems and the like change without moving
+			changed = (renderable_->PosBound() != updated_pos_bound_);
+		}
+
+		if (changed)
+		{
+			this->UpdateAbsModelMatrix();
+		}
+
+		return changed;
+	}
+
+	bool SceneObject::BeginAbsModelMatrixUpdate(bool parent_changed, float4x4& model, AABBox& pos_bound)
+	{
+		bool changed = parent_changed || !abs_model_valid_ || (this->RenderModelMatrix() != updated_model_);
+		if (!changed && renderable_ && pos_aabb_ws_)
+		{
+			changed = (renderable_->PosBound() != updated_pos_bound_);
+		}
+
+		if (changed)
+		{
+			updated_model_ = this->RenderModelMatrix();
+			model = updated_model_;
+			if (renderable_ && pos_aabb_ws_)
+			{
+				updated_pos_bound_ = renderable_->PosBound();
+			}
+			pos_bound = updated_pos_bound_;
+		}
+
+		return changed;
+	}
+
+	void SceneObject::EndAbsModelMatrixUpdate(float4x4 const & abs_model, AABBox const & pos_bound_ws)
+	{
+		abs_model_ = abs_model;
+		if (renderable_)
+		{
+			if (pos_aabb_ws_)
+			{
+				*pos_aabb_ws_ = pos_bound_ws;
+			}
+
+			renderable_->ModelMatrix(abs_model_);
+		}
+
+		abs_model_valid_ = true;
+	}
+
+	bool SceneObject::AbsModelMatrixValid() const
+	{
+		return abs_model_valid_;
 	}
 
 	void SceneObject::VisibleMark(BoundOverlap vm)
@@ -237,6 +317,52 @@ namespace KlayGE
 		return nullptr;
 	}
 
+	void SceneObject::SnapshotRenderState()
+	{
+		render_model_ = model_;
+
+		uint8_t const * src = static_cast<uint8_t const *>(this->InstanceData());
+		if (src)
+		{
+			uint32_t size = 0;
+			typedef KLAYGE_DECLTYPE(instance_format_) InstanceFormatType;
+			KLAYGE_FOREACH(InstanceFormatType::const_reference ve, instance_format_)
+			{
+				size += ve.element_size();
+			}
+			render_instance_data_.assign(src, src + size);
+		}
+		else
+		{
+			render_instance_data_.clear();
+		}
+
+		has_render_state_ = true;
+	}
+
+	void SceneObject::DiscardRenderState()
+	{
+		has_render_state_ = false;
+		render_instance_data_.clear();
+	}
+
+	float4x4 const & SceneObject::RenderModelMatrix() const
+	{
+		return has_render_state_ ? render_model_ : model_;
+	}
+
+	void const * SceneObject::RenderInstanceData() const
+	{
+		if (has_render_state_ && !render_instance_data_.empty())
+		{
+			return &render_instance_data_[0];
+		}
+		else
+		{
+			return this->InstanceData();
+		}
+	}
+
 	void SceneObject::SelectMode(bool select_mode)
 	{
 		if (renderable_)
@@ -238,9 +238,11 @@ namespace KlayGE
 		this->Init(camera, CreateMeshFactoryFunc);
 	}
 
-	void SceneObjectCameraProxy::SubThreadUpdate(float /*app_time*/, float /*elapsed_time*/)
+	bool SceneObjectCameraProxy::MainThreadUpdate(float /*app_time*/, float /*elapsed_time*/)
 	{
+		// Cameras are updated on the main thread
 		model_ = model_scaling_ * camera_->InverseViewMatrix();
+		return false;
 	}
 
 	void SceneObjectCameraProxy::Scaling(float x, float y, float z)
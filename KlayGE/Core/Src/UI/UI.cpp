@@ -88,7 +88,7 @@ namespace KlayGE
 	public:
 		UIRectRenderable(TexturePtr const & texture, RenderEffectPtr const & effect)
 			: RenderableHelper(L"UIRect"),
-				dirty_(false), texture_(texture)
+				uploaded_(false), num_quads_(0), texture_(texture)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
@@ -127,53 +127,83 @@ namespace KlayGE
 
 		void Clear()
 		{
+			// Keep what's in the vertex buffer, to be compared with the next frame
+			if (uploaded_)
+			{
+				uploaded_vertices_.swap(vertices_);
+				uploaded_ = false;
+			}
 			vertices_.resize(0);
-			indices_.resize(0);
 		}
 
 		bool Empty() const
 		{
-			return indices_.empty();
+			return vertices_.empty();
 		}
 
-		std::vector<UIManager::VertexFormat>& Vertices()
+		void AddQuad(UIManager::VertexFormat const * quad, float3 const & offset)
 		{
-			dirty_ = true;
-			return vertices_;
-		}
-
-		std::vector<uint16_t>& Indices()
-		{
-			dirty_ = true;
-			return indices_;
-		}
-
-		bool PriRestart() const
-		{
-			return restart_;
+			for (int i = 0; i < 4; ++ i)
+			{
+				vertices_.push_back(UIManager::VertexFormat(offset + quad[i].pos, quad[i].clr, quad[i].tex));
+			}
 		}
 
 		void UpdateBuffers()
 		{
-			if (dirty_)
+			if (vertices_.empty())
 			{
-				if (!vertices_.empty() || !indices_.empty())
-				{
-					vb_->Resize(static_cast<uint32_t>(vertices_.size() * sizeof(vertices_[0])));
-					{
-						GraphicsBuffer::Mapper mapper(*vb_, BA_Write_Only);
-						std::memcpy(mapper.Pointer<uint8_t>(), &vertices_[0], vb_->Size());
-					}
+				return;
+			}
 
-					ib_->Resize(static_cast<uint32_t>(indices_.size() * sizeof(indices_[0])));
+			// Every quad has the same index pattern, so the indices only change with the number of quads
+			uint32_t const num_quads = static_cast<uint32_t>(vertices_.size() / 4);
+			if (num_quads != num_quads_)
+			{
+				uint32_t const indices_per_quad = restart_ ? 5 : 6;
+				ib_->Resize(num_quads * indices_per_quad * sizeof(uint16_t));
+				{
+					GraphicsBuffer::Mapper mapper(*ib_, BA_Write_Only);
+					uint16_t* indices = mapper.Pointer<uint16_t>();
+					for (uint32_t i = 0; i < num_quads; ++ i)
 					{
-						GraphicsBuffer::Mapper mapper(*ib_, BA_Write_Only);
-						std::memcpy(mapper.Pointer<uint8_t>(), &indices_[0], ib_->Size());
+						uint16_t const base = static_cast<uint16_t>(i * 4);
+						if (restart_)
+						{
+							indices[0] = base + 0;
+							indices[1] = base + 1;
+							indices[2] = base + 3;
+							indices[3] = base + 2;
+							indices[4] = 0xFFFF;
+						}
+						else
+						{
+							indices[0] = base + 0;
+							indices[1] = base + 1;
+							indices[2] = base + 2;
+							indices[3] = base + 2;
+							indices[4] = base + 3;
+							indices[5] = base + 0;
+						}
+						indices += indices_per_quad;
 					}
 				}
 
-				dirty_ = false;
+				num_quads_ = num_quads;
+			}
+
+			// Controls that didn't change generate the same vertices as last frame
+			if ((vertices_.size() != uploaded_vertices_.size())
+				|| (std::memcmp(&vertices_[0], &uploaded_vertices_[0], vertices_.size() * sizeof(vertices_[0])) != 0))
+			{
+				vb_->Resize(static_cast<uint32_t>(vertices_.size() * sizeof(vertices_[0])));
+				{
+					GraphicsBuffer::Mapper mapper(*vb_, BA_Write_Only);
+					std::memcpy(mapper.Pointer<uint8_t>(), &vertices_[0], vb_->Size());
+				}
 			}
+			uploaded_vertices_.resize(0);
+			uploaded_ = true;
 		}
 
 		void OnRenderBegin()
@@ -200,7 +230,8 @@ namespace KlayGE
 
 	private:
 		bool restart_;
-		bool dirty_;
+		bool uploaded_;
+		uint32_t num_quads_;
 
 		RenderEffectParameterPtr ui_tex_ep_;
 		RenderEffectParameterPtr half_width_height_ep_;
@@ -208,7 +239,7 @@ namespace KlayGE
 		TexturePtr texture_;
 
 		std::vector<UIManager::VertexFormat> vertices_;
-		std::vector<uint16_t> indices_;
+		std::vector<UIManager::VertexFormat> uploaded_vertices_;
 
 		GraphicsBufferPtr vb_;
 		GraphicsBufferPtr ib_;
@@ -913,7 +944,7 @@ namespace KlayGE
 		typedef KLAYGE_DECLTYPE(rects_) RectsType;
 		KLAYGE_FOREACH(RectsType::reference rect, rects_)
 		{
-			checked_pointer_cast<UIRectRenderable>(rect.second)->Clear();
+			checked_pointer_cast<UIRectRenderable>(rect.second->GetRenderable())->Clear();
 		}
 		typedef KLAYGE_DECLTYPE(strings_) StringsType;
 		KLAYGE_FOREACH(StringsType::reference str, strings_)
@@ -929,10 +960,9 @@ namespace KlayGE
 
 		KLAYGE_FOREACH(RectsType::reference rect, rects_)
 		{
-			if (!checked_pointer_cast<UIRectRenderable>(rect.second)->Empty())
+			if (!checked_pointer_cast<UIRectRenderable>(rect.second->GetRenderable())->Empty())
 			{
-				shared_ptr<UIRectObject> ui_rect_obj = MakeSharedPtr<UIRectObject>(rect.second, SceneObject::SOA_Overlay);
-				ui_rect_obj->AddToSceneManager();
+				rect.second->AddToSceneManager();
 			}
 		}
 		KLAYGE_FOREACH(StringsType::reference str, strings_)
@@ -963,100 +993,31 @@ namespace KlayGE
 			texcoord = Rect(0, 0, 0, 0);
 		}
 
-		shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
+		VertexFormat const quad[] =
 		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
-		}
-		else
-		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
-		}
-		BOOST_ASSERT(renderable);
-
-		std::vector<VertexFormat>& vertices = renderable->Vertices();
-		std::vector<uint16_t>& indices = renderable->Indices();
-		vertices.reserve(vertices.size() + 4);
-
-		uint16_t const last_index = static_cast<uint16_t>(vertices.size());
-		if (renderable->PriRestart())
-		{
-			indices.reserve(indices.size() + 5);
-			indices.push_back(last_index + 0);
-			indices.push_back(last_index + 1);
-			indices.push_back(last_index + 3);
-			indices.push_back(last_index + 2);
-			indices.push_back(0xFFFF);
-		}
-		else
-		{
-			indices.reserve(indices.size() + 6);
-			indices.push_back(last_index + 0);
-			indices.push_back(last_index + 1);
-			indices.push_back(last_index + 2);
-			indices.push_back(last_index + 2);
-			indices.push_back(last_index + 3);
-			indices.push_back(last_index + 0);
-		}
-
-		vertices.push_back(VertexFormat(pos + float3(0, 0, 0),
-			clrs[0], float2(texcoord.left(), texcoord.top())));
-		vertices.push_back(VertexFormat(pos + float3(width, 0, 0),
-			clrs[1], float2(texcoord.right(), texcoord.top())));
-		vertices.push_back(VertexFormat(pos + float3(width, height, 0),
-			clrs[2], float2(texcoord.right(), texcoord.bottom())));
-		vertices.push_back(VertexFormat(pos + float3(0, height, 0),
-			clrs[3], float2(texcoord.left(), texcoord.bottom())));
+			VertexFormat(float3(0, 0, 0), clrs[0], float2(texcoord.left(), texcoord.top())),
+			VertexFormat(float3(width, 0, 0), clrs[1], float2(texcoord.right(), texcoord.top())),
+			VertexFormat(float3(width, height, 0), clrs[2], float2(texcoord.right(), texcoord.bottom())),
+			VertexFormat(float3(0, height, 0), clrs[3], float2(texcoord.left(), texcoord.bottom()))
+		};
+		checked_pointer_cast<UIRectRenderable>(this->RectRenderable(texture))->AddQuad(quad, pos);
 	}
 
 	void UIManager::DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture)
 	{
-		shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
-		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
-		}
-		else
-		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
-		}
-		BOOST_ASSERT(renderable);
-
-		std::vector<VertexFormat>& verts = renderable->Vertices();
-		std::vector<uint16_t>& indices = renderable->Indices();
-		verts.reserve(verts.size() + 4);
+		checked_pointer_cast<UIRectRenderable>(this->RectRenderable(texture))->AddQuad(vertices, offset);
+	}
 
-		uint16_t const last_index = static_cast<uint16_t>(verts.size());
-		if (renderable->PriRestart())
+	RenderablePtr const & UIManager::RectRenderable(TexturePtr const & texture)
+	{
+		KLAYGE_AUTO(iter, rects_.find(texture));
+		if (iter == rects_.end())
 		{
-			indices.reserve(indices.size() + 5);
-			indices.push_back(last_index + 0);
-			indices.push_back(last_index + 1);
-			indices.push_back(last_index + 3);
-			indices.push_back(last_index + 2);
-			indices.push_back(0xFFFF);
+			RenderablePtr renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
+			iter = rects_.insert(std::make_pair(texture,
+				MakeSharedPtr<UIRectObject>(renderable, SceneObject::SOA_Overlay))).first;
 		}
-		else
-		{
-			indices.reserve(indices.size() + 6);
-			indices.push_back(last_index + 0);
-			indices.push_back(last_index + 1);
-			indices.push_back(last_index + 2);
-			indices.push_back(last_index + 2);
-			indices.push_back(last_index + 3);
-			indices.push_back(last_index + 0);
-		}
-
-		verts.push_back(VertexFormat(offset + vertices[0].pos,
-			vertices[0].clr, vertices[0].tex));
-		verts.push_back(VertexFormat(offset + vertices[1].pos,
-			vertices[1].clr, vertices[1].tex));
-		verts.push_back(VertexFormat(offset + vertices[2].pos,
-			vertices[2].clr, vertices[2].tex));
-		verts.push_back(VertexFormat(offset + vertices[3].pos,
-			vertices[3].clr, vertices[3].tex));
+		return iter->second->GetRenderable();
 	}
 
 	void UIManager::DrawString(std::wstring const & strText, uint32_t font_index,
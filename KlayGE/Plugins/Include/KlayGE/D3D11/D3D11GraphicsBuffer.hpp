@@ -42,6 +42,7 @@ namespace KlayGE
 		}
 
 		void CopyToBuffer(GraphicsBuffer& rhs);
+		void UpdateSubresource(uint32_t offset, uint32_t size, void const * data);
 
 	protected:
 		void GetD3DFlags(D3D11_USAGE& usage, UINT& cpu_access_flags, UINT& bind_flags, UINT& misc_flags);
@@ -177,14 +177,20 @@ namespace KlayGE
 		typedef HRESULT (WINAPI *D3DCompileFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
 								D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, LPCSTR pEntrypoint,
 								LPCSTR pTarget, UINT Flags1, UINT Flags2, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
+		typedef HRESULT (WINAPI *D3DPreprocessFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
+								D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude,
+								ID3DBlob** ppCodeText, ID3DBlob** ppErrorMsgs);
 		typedef HRESULT (WINAPI *D3DReflectFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, REFIID pInterface, void** ppReflector);
 		typedef HRESULT (WINAPI *D3DStripShaderFunc)(LPCVOID pShaderBytecode, SIZE_T BytecodeLength, UINT uStripFlags, ID3DBlob** ppStrippedBlob);
+		typedef HRESULT (WINAPI *D3DCreateBlobFunc)(SIZE_T Size, ID3DBlob** ppBlob);
 
 		CreateDXGIFactory1Func DynamicCreateDXGIFactory1_;
 		D3D11CreateDeviceFunc DynamicD3D11CreateDevice_;
 		D3DCompileFunc DynamicD3DCompile_;
+		D3DPreprocessFunc DynamicD3DPreprocess_;
 		D3DReflectFunc DynamicD3DReflect_;
 		D3DStripShaderFunc DynamicD3DStripShader_;
+		D3DCreateBlobFunc DynamicD3DCreateBlob_;
 #endif
 
 		// Direct3D rendering device
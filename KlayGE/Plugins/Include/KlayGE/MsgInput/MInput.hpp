@@ -274,6 +274,8 @@ namespace KlayGE
 		boost::signals2::connection on_pointer_wheel_;
 
 #if defined KLAYGE_PLATFORM_WINDOWS_DESKTOP
+		std::vector<uint8_t> raw_input_buff_;
+
 		HMODULE mod_hid_;
 		typedef NTSTATUS (WINAPI *HidP_GetCapsFunc)(PHIDP_PREPARSED_DATA PreparsedData, PHIDP_CAPS Capabilities);
 		typedef NTSTATUS (WINAPI *HidP_GetButtonCapsFunc)(HIDP_REPORT_TYPE ReportType, PHIDP_BUTTON_CAPS ButtonCaps,
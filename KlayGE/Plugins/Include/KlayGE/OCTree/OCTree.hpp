@@ -41,7 +41,8 @@ namespace KlayGE
 		void MaxTreeDepth(uint32_t max_tree_depth);
 		uint32_t MaxTreeDepth() const;
 
-		virtual void ClipScene() KLAYGE_OVERRIDE;
+		using SceneManager::ClipScene;
+		virtual void ClipScene(Camera const & camera) KLAYGE_OVERRIDE;
 
 		virtual BoundOverlap AABBVisible(AABBox const & aabb) const KLAYGE_OVERRIDE;
 		virtual BoundOverlap OBBVisible(OBBox const & obb) const KLAYGE_OVERRIDE;
@@ -56,8 +57,8 @@ namespace KlayGE
 		virtual void DoResume() KLAYGE_OVERRIDE;
 
 		void DivideNode(size_t index, uint32_t curr_depth);
-		void NodeVisible(size_t index);
-		void MarkNodeObjs(size_t index, bool force);
+		void NodeVisible(size_t index, float3 const & eye_pos, float4x4 const & view_proj);
+		void MarkNodeObjs(size_t index, bool force, float3 const & eye_pos, float4x4 const & view_proj);
 
 		BoundOverlap BoundVisible(size_t index, AABBox const & aabb) const;
 		BoundOverlap BoundVisible(size_t index, OBBox const & obb) const;
@@ -35,6 +35,7 @@
 #include <vector>
 
 #include <boost/noncopyable.hpp>
+#include <KFL/Thread.hpp>
 
 #include <KlayGE/Audio.hpp>
 
@@ -79,6 +80,8 @@ namespace KlayGE
 		float3		dir_;
 	};
 
+	class OALAudioEngine;
+
 	// ֻ
 	/////////////////////////////////////////////////////////////////////////////////
 	class OALMusicBuffer : boost::noncopyable, public MusicBuffer
@@ -98,7 +101,9 @@ namespace KlayGE
 		float3 Direction() const;
 		void Direction(float3 const & v);
 
-		void LoopUpdateBuffer();
+		// Called by the streaming thread of the engine. Returns false when the music is finished.
+		bool UpdateBuffer();
+		static uint32_t UpdateInterval();
 
 	private:
 		void DoReset();
@@ -106,16 +111,15 @@ namespace KlayGE
 		void DoStop();
 
 	private:
+		OALAudioEngine&			engine_;
+
 		ALuint					source_;
 		std::vector<ALuint>		bufferQueue_;
+		std::vector<uint8_t>	decode_buff_;
 
 		bool		loop_;
 
-		bool played_;
 		bool stopped_;
-		condition_variable play_cond_;
-		mutex play_mutex_;
-		joiner<void> play_thread_;
 	};
 
 	// Ƶ
@@ -135,9 +139,22 @@ namespace KlayGE
 		void GetListenerOri(float3& face, float3& up) const;
 		void SetListenerOri(float3 const & face, float3 const & up);
 
+		// All music buffers are streamed by one thread
+		void AddStreamingBuffer(OALMusicBuffer* buffer);
+		void RemoveStreamingBuffer(OALMusicBuffer* buffer);
+
 	private:
 		virtual void DoSuspend() KLAYGE_OVERRIDE;
 		virtual void DoResume() KLAYGE_OVERRIDE;
+
+		void StreamingThreadFunc();
+
+	private:
+		std::vector<OALMusicBuffer*> streaming_buffers_;
+		mutex streaming_mutex_;
+		condition_variable streaming_cond_;
+		bool quit_streaming_;
+		joiner<void> streaming_thread_;
 	};
 }
 
@@ -39,6 +39,7 @@ namespace KlayGE
 		~OGLGraphicsBuffer();
 
 		void CopyToBuffer(GraphicsBuffer& rhs);
+		void UpdateSubresource(uint32_t offset, uint32_t size, void const * data);
 
 		void Active(bool force);
 
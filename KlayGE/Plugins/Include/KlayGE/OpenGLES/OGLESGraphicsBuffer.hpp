@@ -29,6 +29,7 @@ namespace KlayGE
 		~OGLESGraphicsBuffer();
 
 		void CopyToBuffer(GraphicsBuffer& rhs);
+		void UpdateSubresource(uint32_t offset, uint32_t size, void const * data);
 
 		void Active(bool force);
 
@@ -37,6 +37,8 @@ namespace KlayGE
 			std::vector<uint32_t> const & shader_desc_ids) KLAYGE_OVERRIDE;
 		virtual void StreamOut(std::ostream& os, ShaderType type) KLAYGE_OVERRIDE;
 
+		virtual void CompileShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids) KLAYGE_OVERRIDE;
 		void AttachShader(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids);
 		void AttachShader(ShaderType type, RenderEffect const & effect,
@@ -75,6 +77,7 @@ namespace KlayGE
 
 	private:
 		GLuint glsl_program_;
+		array<bool, ST_NumShaderTypes> is_shader_compiled_;
 		GLenum glsl_bin_format_;
 		shared_ptr<std::vector<uint8_t> > glsl_bin_program_;
 		shared_ptr<array<std::string, ST_NumShaderTypes> > shader_func_names_;
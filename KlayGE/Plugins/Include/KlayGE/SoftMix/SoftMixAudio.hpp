@@ -0,0 +1,260 @@
+/**
+* @file SoftMixAudio.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _SOFTMIXAUDIO_HPP
+#define _SOFTMIXAUDIO_HPP
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+#include <boost/noncopyable.hpp>
+#include <KFL/Thread.hpp>
+
+#include <KlayGE/Audio.hpp>
+
+namespace KlayGE
+{
+	uint32_t const SOFT_MIX_FREQ = 44100;
+	uint32_t const SOFT_MIX_BLOCK_FRAMES = 1024;
+
+	// Anything the engine mixes. Called with the mixing lock held.
+	class SoftMixSource
+	{
+	public:
+		virtual ~SoftMixSource()
+		{
+		}
+
+		// Adds num_frames stereo frames to mix. Returns false when nothing is playing any more.
+		virtual bool MixTo(float* mix, uint32_t num_frames) = 0;
+	};
+
+	class SoftMixAudioEngine;
+
+	// Sound buffer, decoded to float when created
+	/////////////////////////////////////////////////////////////////////////////////
+	class SoftMixSoundBuffer : boost::noncopyable, public SoundBuffer, public SoftMixSource
+	{
+		struct Voice
+		{
+			double cursor;
+			bool playing;
+			bool loop;
+		};
+
+	public:
+		SoftMixSoundBuffer(AudioDataSourcePtr const & dataSource, uint32_t numSource, float volume);
+		~SoftMixSoundBuffer();
+
+		void Play(bool loop = false);
+		void Stop();
+
+		void Volume(float vol);
+
+		bool IsPlaying() const;
+
+		float3 Position() const;
+		void Position(float3 const & v);
+		float3 Velocity() const;
+		void Velocity(float3 const & v);
+		float3 Direction() const;
+		void Direction(float3 const & v);
+
+		virtual bool MixTo(float* mix, uint32_t num_frames) KLAYGE_OVERRIDE;
+
+	private:
+		void DoReset();
+
+	private:
+		SoftMixAudioEngine& engine_;
+
+		std::vector<float> samples_;
+		uint32_t num_channels_;
+		uint32_t num_frames_;
+
+		std::vector<Voice> voices_;
+
+		float volume_;
+		float3 pos_;
+		float3 vel_;
+		float3 dir_;
+	};
+
+	// Music buffer, decoded ahead into a ring of bufferSeconds by the streaming thread of the engine
+	/////////////////////////////////////////////////////////////////////////////////
+	class SoftMixMusicBuffer : boost::noncopyable, public MusicBuffer, public SoftMixSource
+	{
+	public:
+		SoftMixMusicBuffer(AudioDataSourcePtr const & dataSource, uint32_t bufferSeconds, float volume);
+		~SoftMixMusicBuffer();
+
+		void Volume(float vol);
+
+		bool IsPlaying() const;
+
+		float3 Position() const;
+		void Position(float3 const & v);
+		float3 Velocity() const;
+		void Velocity(float3 const & v);
+		float3 Direction() const;
+		void Direction(float3 const & v);
+
+		virtual bool MixTo(float* mix, uint32_t num_frames) KLAYGE_OVERRIDE;
+
+		// Called by the streaming thread of the engine. Fills the free part of the ring.
+		void Decode();
+
+	private:
+		void DoReset();
+		void DoPlay(bool loop);
+		void DoStop();
+
+	private:
+		SoftMixAudioEngine& engine_;
+
+		uint32_t num_channels_;
+
+		// The streaming thread writes behind the ready frames, and MixTo reads from read_frame_.
+		// Each side only holds ring_mutex_ to move the counters, never while decoding or mixing.
+		std::vector<float> ring_;
+		uint32_t buffer_frames_;
+		uint32_t read_frame_;
+		uint32_t ready_frames_;
+		bool eof_;
+		mutex ring_mutex_;
+
+		// Only touched by the streaming thread
+		std::vector<uint8_t> decode_buff_;
+		std::vector<float> decoded_;
+		size_t decoded_pos_;
+
+		// Only touched by the mixing thread, in source frames from read_frame_
+		double cursor_;
+
+		bool loop_;
+		bool playing_;
+
+		float volume_;
+		float3 pos_;
+		float3 vel_;
+		float3 dir_;
+	};
+
+	// Software mixing audio engine. Mixes all sources to 16-bit stereo, and writes the result to a null sink or a wav file.
+	/////////////////////////////////////////////////////////////////////////////////
+	class SoftMixAudioEngine : boost::noncopyable, public AudioEngine
+	{
+	public:
+		SoftMixAudioEngine();
+		~SoftMixAudioEngine();
+
+		std::wstring const & Name() const;
+
+		float3 GetListenerPos() const;
+		void SetListenerPos(float3 const & v);
+		float3 GetListenerVel() const;
+		void SetListenerVel(float3 const & v);
+		void GetListenerOri(float3& face, float3& up) const;
+		void SetListenerOri(float3 const & face, float3 const & up);
+
+		// A realtime engine mixes on its own thread at the output rate. Turn it off to drive Mix directly, e.g. in benchmarks.
+		void Realtime(bool rt);
+		bool Realtime() const;
+		void Mix(uint32_t num_frames);
+
+		void StartCapture(std::string const & file_name);
+		void StopCapture();
+
+		void AddSource(SoftMixSource* source);
+		void RemoveSource(SoftMixSource* source);
+		mutex& MixMutex() const;
+
+		// All music buffers are decoded by one streaming thread, outside the mixing lock.
+		// RemoveStreamingBuffer returns once the thread is no longer touching the buffer.
+		void AddStreamingBuffer(SoftMixMusicBuffer* buffer);
+		void RemoveStreamingBuffer(SoftMixMusicBuffer* buffer);
+		void RequestStreaming();
+
+		// These are for the sources, when they are mixing
+		void Spatialize(float3 const & pos, float volume, float& gain_l, float& gain_r) const;
+		float* ScratchBuffer(uint32_t num_frames);
+
+		static uint32_t NumChannels(AudioFormat format);
+		// Appends the PCM data as float samples in [-1, 1]
+		static void DecodeToFloat(std::vector<float>& samples, uint8_t const * data, size_t size, AudioFormat format);
+		// Linearly resamples interleaved mono or stereo samples into a stereo block, starting from the cursor in source frames.
+		// Returns the number of frames written, less than num_frames if the source runs out.
+		static uint32_t ResampleToStereo(float* dst, uint32_t num_frames, float const * src, uint32_t num_channels,
+			uint32_t num_src_frames, double& cursor, double step);
+		// mix += src * gains, on stereo frames
+		static void MixStereo(float* mix, float const * src, float gain_l, float gain_r, uint32_t num_frames);
+
+	private:
+		virtual void DoSuspend() KLAYGE_OVERRIDE;
+		virtual void DoResume() KLAYGE_OVERRIDE;
+
+		void MixThreadFunc();
+		void StreamingThreadFunc();
+
+	private:
+		float3 listener_pos_;
+		float3 listener_vel_;
+		float3 listener_face_;
+		float3 listener_up_;
+
+		std::vector<SoftMixSource*> sources_;
+		std::vector<float> mix_buff_;
+		std::vector<float> scratch_buff_;
+		std::vector<int16_t> output_buff_;
+		mutable mutex mix_mutex_;
+
+		shared_ptr<std::ostream> capture_stream_;
+		uint32_t capture_frames_;
+
+		bool realtime_;
+		bool realtime_before_suspend_;
+		bool quit_;
+		condition_variable mix_cond_;
+		joiner<void> mix_thread_;
+
+		std::vector<SoftMixMusicBuffer*> streaming_buffers_;
+		SoftMixMusicBuffer* decoding_buffer_;
+		bool streaming_requested_;
+		bool quit_streaming_;
+		mutex streaming_mutex_;
+		condition_variable streaming_cond_;
+		joiner<void> streaming_thread_;
+	};
+}
+
+#endif		// _SOFTMIXAUDIO_HPP
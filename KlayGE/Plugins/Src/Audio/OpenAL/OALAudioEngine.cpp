@@ -12,8 +12,11 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ThrowErr.hpp>
+#include <KFL/Util.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
+#include <algorithm>
+
 #include <boost/assert.hpp>
 
 #include <KlayGE/OpenAL/OALAudio.hpp>
@@ -73,6 +76,7 @@ namespace KlayGE
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	OALAudioEngine::OALAudioEngine()
+		: quit_streaming_(false)
 	{
 		ALCdevice* device(alcOpenDevice(nullptr));
 		ALCcontext* context(alcCreateContext(device, 0));
@@ -87,12 +91,22 @@ namespace KlayGE
 
 		alDopplerFactor(1);		// ʵĶЧӦ
 		alDopplerVelocity(343); //  / Ϊλ
+
+		streaming_thread_ = Context::Instance().ThreadPool()(bind(&OALAudioEngine::StreamingThreadFunc, this));
 	}
 
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
 	OALAudioEngine::~OALAudioEngine()
 	{
+		{
+			unique_lock<mutex> lock(streaming_mutex_);
+			quit_streaming_ = true;
+			streaming_buffers_.clear();
+		}
+		streaming_cond_.notify_one();
+		streaming_thread_();
+
 		audioBufs_.clear();
 
 		ALCcontext* context(alcGetCurrentContext());
@@ -104,6 +118,60 @@ namespace KlayGE
 		alcCloseDevice(device);
 	}
 
+	void OALAudioEngine::AddStreamingBuffer(OALMusicBuffer* buffer)
+	{
+		{
+			unique_lock<mutex> lock(streaming_mutex_);
+			if (std::find(streaming_buffers_.begin(), streaming_buffers_.end(), buffer) == streaming_buffers_.end())
+			{
+				streaming_buffers_.push_back(buffer);
+			}
+		}
+		streaming_cond_.notify_one();
+	}
+
+	void OALAudioEngine::RemoveStreamingBuffer(OALMusicBuffer* buffer)
+	{
+		unique_lock<mutex> lock(streaming_mutex_);
+		KLAYGE_AUTO(iter, std::find(streaming_buffers_.begin(), streaming_buffers_.end(), buffer));
+		if (iter != streaming_buffers_.end())
+		{
+			streaming_buffers_.erase(iter);
+		}
+	}
+
+	// OpenAL has no notification of processed buffers, so the thread sleeps on the condition while nothing is
+	// playing, and polls the playing buffers once per update interval otherwise.
+	void OALAudioEngine::StreamingThreadFunc()
+	{
+		unique_lock<mutex> lock(streaming_mutex_);
+		while (!quit_streaming_)
+		{
+			if (streaming_buffers_.empty())
+			{
+				streaming_cond_.wait(lock);
+			}
+			else
+			{
+				for (size_t i = 0; i < streaming_buffers_.size();)
+				{
+					if (streaming_buffers_[i]->UpdateBuffer())
+					{
+						++ i;
+					}
+					else
+					{
+						streaming_buffers_.erase(streaming_buffers_.begin() + i);
+					}
+				}
+
+				lock.unlock();
+				Sleep(OALMusicBuffer::UpdateInterval());
+				lock.lock();
+			}
+		}
+	}
+
 	void OALAudioEngine::DoSuspend()
 	{
 		// TODO
@@ -23,6 +23,7 @@
 #include <KFL/ThrowErr.hpp>
 #include <KFL/Util.hpp>
 #include <KlayGE/AudioDataSource.hpp>
+#include <KlayGE/AudioFactory.hpp>
 
 #include <boost/assert.hpp>
 
@@ -36,8 +37,10 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	OALMusicBuffer::OALMusicBuffer(AudioDataSourcePtr const & dataSource, uint32_t bufferSeconds, float volume)
 							: MusicBuffer(dataSource),
+								engine_(*checked_cast<OALAudioEngine*>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance())),
 								bufferQueue_(bufferSeconds * PreSecond),
-								played_(false), stopped_(true)
+								decode_buff_(READSIZE),
+								stopped_(true)
 	{
 		alGenBuffers(static_cast<ALsizei>(bufferQueue_.size()), &bufferQueue_[0]);
 
@@ -65,57 +68,46 @@ namespace KlayGE
 
 	// »
 	/////////////////////////////////////////////////////////////////////////////////
-	void OALMusicBuffer::LoopUpdateBuffer()
+	bool OALMusicBuffer::UpdateBuffer()
 	{
-		unique_lock<mutex> lock(play_mutex_);
-		while (!played_)
+		ALint processed;
+		alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
+		while ((processed > 0) && !stopped_)
 		{
-			play_cond_.wait(lock);
-		}
-		played_ = false;
+			-- processed;
 
-		while (!stopped_)
-		{
-			ALint processed;
-			alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
-			if (processed > 0)
+			ALuint buf;
+			alSourceUnqueueBuffers(source_, 1, &buf);
+
+			size_t const size = dataSource_->Read(&decode_buff_[0], decode_buff_.size());
+			if (0 == size)
 			{
-				while (processed > 0)
+				if (loop_)
+				{
+					alSourceStopv(1, &source_);
+					this->DoReset();
+					alSourcePlay(source_);
+					processed = 0;
+				}
+				else
 				{
-					-- processed;
-
-					ALuint buf;
-					alSourceUnqueueBuffers(source_, 1, &buf);
-
-					std::vector<uint8_t> data(READSIZE);
-					data.resize(dataSource_->Read(&data[0], data.size()));
-					if (data.empty())
-					{
-						if (loop_)
-						{
-							stopped_ = false;
-							alSourceStopv(1, &source_);
-							this->DoReset();
-							alSourcePlay(source_);
-						}
-						else
-						{
-							stopped_ = true;
-						}
-					}
-					else
-					{
-						alBufferData(buf, Convert(format_), &data[0],
-							static_cast<ALsizei>(data.size()), freq_);
-						alSourceQueueBuffers(source_, 1, &buf);
-					}
+					stopped_ = true;
 				}
 			}
 			else
 			{
-				Sleep(500 / PreSecond);
+				alBufferData(buf, Convert(format_), &decode_buff_[0],
+					static_cast<ALsizei>(size), freq_);
+				alSourceQueueBuffers(source_, 1, &buf);
 			}
 		}
+
+		return !stopped_;
+	}
+
+	uint32_t OALMusicBuffer::UpdateInterval()
+	{
+		return 500 / PreSecond;
 	}
 
 	// λԱڴͷ
@@ -131,7 +123,6 @@ namespace KlayGE
 		}
 
 		ALenum const format(Convert(format_));
-		std::vector<uint8_t> data(READSIZE);
 
 		dataSource_->Reset();
 
@@ -140,16 +131,16 @@ namespace KlayGE
 		typedef KLAYGE_DECLTYPE(bufferQueue_) BufferQueueType;
 		KLAYGE_FOREACH(BufferQueueType::reference buf, bufferQueue_)
 		{
-			data.resize(dataSource_->Read(&data[0], data.size()));
-			if (data.empty())
+			size_t const size = dataSource_->Read(&decode_buff_[0], decode_buff_.size());
+			if (0 == size)
 			{
 				break;
 			}
 			else
 			{
 				++ non_empty_buf;
-				alBufferData(buf, format, &data[0],
-					static_cast<ALuint>(data.size()), static_cast<ALuint>(freq_));
+				alBufferData(buf, format, &decode_buff_[0],
+					static_cast<ALuint>(size), static_cast<ALuint>(freq_));
 			}
 		}
 
@@ -162,30 +153,23 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void OALMusicBuffer::DoPlay(bool loop)
 	{
-		play_thread_ = Context::Instance().ThreadPool()(bind(&OALMusicBuffer::LoopUpdateBuffer, this));
-
 		loop_ = loop;
 
 		stopped_ = false;
-		{
-			unique_lock<mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
 
 		alSourcei(source_, AL_LOOPING, false);
 		alSourcePlay(source_);
+
+		engine_.AddStreamingBuffer(this);
 	}
 
 	// ֹͣƵ
 	////////////////////////////////////////////////////////////////////////////////
 	void OALMusicBuffer::DoStop()
 	{
-		if (!stopped_)
-		{
-			stopped_ = true;
-			play_thread_();
-		}
+		// Once removed, the streaming thread is no longer touching this buffer
+		engine_.RemoveStreamingBuffer(this);
+		stopped_ = true;
 
 		alSourceStopv(1, &source_);
 	}
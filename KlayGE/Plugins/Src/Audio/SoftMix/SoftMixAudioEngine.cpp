@@ -0,0 +1,527 @@
+/**
+* @file SoftMixAudioEngine.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+#include <boost/assert.hpp>
+
+#ifdef KLAYGE_SSE_SUPPORT
+#include <xmmintrin.h>
+#endif
+
+#include <KlayGE/SoftMix/SoftMixAudio.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	template <typename T>
+	void WriteLE(std::ostream& os, T value)
+	{
+		value = Native2LE(value);
+		os.write(reinterpret_cast<char const *>(&value), sizeof(value));
+	}
+
+	void WriteWavHeader(std::ostream& os, uint32_t num_frames)
+	{
+		uint32_t const num_channels = 2;
+		uint32_t const block_align = num_channels * sizeof(int16_t);
+		uint32_t const data_size = num_frames * block_align;
+
+		WriteLE(os, MakeFourCC<'R', 'I', 'F', 'F'>::value);
+		WriteLE(os, 36 + data_size);
+		WriteLE(os, MakeFourCC<'W', 'A', 'V', 'E'>::value);
+
+		WriteLE(os, MakeFourCC<'f', 'm', 't', ' '>::value);
+		WriteLE(os, static_cast<uint32_t>(16));
+		WriteLE(os, static_cast<uint16_t>(1));
+		WriteLE(os, static_cast<uint16_t>(num_channels));
+		WriteLE(os, SOFT_MIX_FREQ);
+		WriteLE(os, SOFT_MIX_FREQ * block_align);
+		WriteLE(os, static_cast<uint16_t>(block_align));
+		WriteLE(os, static_cast<uint16_t>(16));
+
+		WriteLE(os, MakeFourCC<'d', 'a', 't', 'a'>::value);
+		WriteLE(os, data_size);
+	}
+}
+
+namespace KlayGE
+{
+	uint32_t SoftMixAudioEngine::NumChannels(AudioFormat format)
+	{
+		switch (format)
+		{
+		case AF_Mono8:
+		case AF_Mono16:
+			return 1;
+
+		case AF_Stereo8:
+		case AF_Stereo16:
+			return 2;
+
+		default:
+			BOOST_ASSERT(false);
+			return 1;
+		}
+	}
+
+	void SoftMixAudioEngine::DecodeToFloat(std::vector<float>& samples, uint8_t const * data, size_t size, AudioFormat format)
+	{
+		size_t const base = samples.size();
+		switch (format)
+		{
+		case AF_Mono8:
+		case AF_Stereo8:
+			samples.resize(base + size);
+			for (size_t i = 0; i < size; ++ i)
+			{
+				samples[base + i] = (static_cast<int>(data[i]) - 128) / 128.0f;
+			}
+			break;
+
+		case AF_Mono16:
+		case AF_Stereo16:
+			{
+				size_t const num_samples = size / sizeof(int16_t);
+				samples.resize(base + num_samples);
+				for (size_t i = 0; i < num_samples; ++ i)
+				{
+					int16_t s;
+					std::memcpy(&s, data + i * sizeof(int16_t), sizeof(s));
+					samples[base + i] = LE2Native(s) / 32768.0f;
+				}
+			}
+			break;
+
+		default:
+			BOOST_ASSERT(false);
+			break;
+		}
+	}
+
+	uint32_t SoftMixAudioEngine::ResampleToStereo(float* dst, uint32_t num_frames, float const * src, uint32_t num_channels,
+		uint32_t num_src_frames, double& cursor, double step)
+	{
+		uint32_t i = 0;
+		for (; i < num_frames; ++ i)
+		{
+			uint32_t const index = static_cast<uint32_t>(cursor);
+			if (index >= num_src_frames)
+			{
+				break;
+			}
+
+			uint32_t const next = std::min(index + 1, num_src_frames - 1);
+			float const frac = static_cast<float>(cursor - index);
+			if (1 == num_channels)
+			{
+				float const s = src[index] + (src[next] - src[index]) * frac;
+				dst[i * 2 + 0] = s;
+				dst[i * 2 + 1] = s;
+			}
+			else
+			{
+				dst[i * 2 + 0] = src[index * 2 + 0] + (src[next * 2 + 0] - src[index * 2 + 0]) * frac;
+				dst[i * 2 + 1] = src[index * 2 + 1] + (src[next * 2 + 1] - src[index * 2 + 1]) * frac;
+			}
+
+			cursor += step;
+		}
+
+		return i;
+	}
+
+	void SoftMixAudioEngine::MixStereo(float* mix, float const * src, float gain_l, float gain_r, uint32_t num_frames)
+	{
+		uint32_t i = 0;
+#ifdef KLAYGE_SSE_SUPPORT
+		__m128 const gains = _mm_setr_ps(gain_l, gain_r, gain_l, gain_r);
+		for (; i + 2 <= num_frames; i += 2)
+		{
+			__m128 const m = _mm_loadu_ps(mix + i * 2);
+			__m128 const s = _mm_loadu_ps(src + i * 2);
+			_mm_storeu_ps(mix + i * 2, _mm_add_ps(m, _mm_mul_ps(s, gains)));
+		}
+#endif
+		for (; i < num_frames; ++ i)
+		{
+			mix[i * 2 + 0] += src[i * 2 + 0] * gain_l;
+			mix[i * 2 + 1] += src[i * 2 + 1] * gain_r;
+		}
+	}
+
+
+	SoftMixAudioEngine::SoftMixAudioEngine()
+		: listener_pos_(0, 0, 0), listener_vel_(0, 0, 0), listener_face_(0, 0, 1), listener_up_(0, 1, 0),
+			capture_frames_(0), realtime_(true), realtime_before_suspend_(true), quit_(false),
+			decoding_buffer_(nullptr), streaming_requested_(false), quit_streaming_(false)
+	{
+		mix_thread_ = Context::Instance().ThreadPool()(bind(&SoftMixAudioEngine::MixThreadFunc, this));
+		streaming_thread_ = Context::Instance().ThreadPool()(bind(&SoftMixAudioEngine::StreamingThreadFunc, this));
+	}
+
+	SoftMixAudioEngine::~SoftMixAudioEngine()
+	{
+		{
+			unique_lock<mutex> lock(mix_mutex_);
+			quit_ = true;
+		}
+		mix_cond_.notify_one();
+		mix_thread_();
+
+		{
+			unique_lock<mutex> lock(streaming_mutex_);
+			quit_streaming_ = true;
+			streaming_buffers_.clear();
+		}
+		streaming_cond_.notify_all();
+		streaming_thread_();
+
+		this->StopCapture();
+
+		audioBufs_.clear();
+	}
+
+	void SoftMixAudioEngine::DoSuspend()
+	{
+		realtime_before_suspend_ = this->Realtime();
+		this->Realtime(false);
+	}
+
+	void SoftMixAudioEngine::DoResume()
+	{
+		this->Realtime(realtime_before_suspend_);
+	}
+
+	std::wstring const & SoftMixAudioEngine::Name() const
+	{
+		static std::wstring const name(L"Software Mixing Audio Engine");
+		return name;
+	}
+
+	float3 SoftMixAudioEngine::GetListenerPos() const
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		return listener_pos_;
+	}
+
+	void SoftMixAudioEngine::SetListenerPos(float3 const & v)
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		listener_pos_ = v;
+	}
+
+	float3 SoftMixAudioEngine::GetListenerVel() const
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		return listener_vel_;
+	}
+
+	void SoftMixAudioEngine::SetListenerVel(float3 const & v)
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		listener_vel_ = v;
+	}
+
+	void SoftMixAudioEngine::GetListenerOri(float3& face, float3& up) const
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		face = listener_face_;
+		up = listener_up_;
+	}
+
+	void SoftMixAudioEngine::SetListenerOri(float3 const & face, float3 const & up)
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		listener_face_ = face;
+		listener_up_ = up;
+	}
+
+	void SoftMixAudioEngine::Realtime(bool rt)
+	{
+		{
+			unique_lock<mutex> lock(mix_mutex_);
+			realtime_ = rt;
+		}
+		mix_cond_.notify_one();
+	}
+
+	bool SoftMixAudioEngine::Realtime() const
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		return realtime_;
+	}
+
+	void SoftMixAudioEngine::Mix(uint32_t num_frames)
+	{
+		if (0 == num_frames)
+		{
+			return;
+		}
+
+		unique_lock<mutex> lock(mix_mutex_);
+
+		mix_buff_.assign(num_frames * 2, 0.0f);
+		for (size_t i = 0; i < sources_.size();)
+		{
+			if (sources_[i]->MixTo(&mix_buff_[0], num_frames))
+			{
+				++ i;
+			}
+			else
+			{
+				sources_.erase(sources_.begin() + i);
+			}
+		}
+
+		// The null sink still gets the final 16-bit samples, so the cost doesn't depend on capturing
+		output_buff_.resize(mix_buff_.size());
+		for (size_t i = 0; i < mix_buff_.size(); ++ i)
+		{
+			output_buff_[i] = static_cast<int16_t>(MathLib::clamp(mix_buff_[i], -1.0f, 1.0f) * 32767);
+		}
+
+		if (capture_stream_)
+		{
+			for (size_t i = 0; i < output_buff_.size(); ++ i)
+			{
+				output_buff_[i] = Native2LE(output_buff_[i]);
+			}
+			capture_stream_->write(reinterpret_cast<char const *>(&output_buff_[0]),
+				static_cast<std::streamsize>(output_buff_.size() * sizeof(output_buff_[0])));
+			capture_frames_ += num_frames;
+		}
+	}
+
+	void SoftMixAudioEngine::StartCapture(std::string const & file_name)
+	{
+		this->StopCapture();
+
+		unique_lock<mutex> lock(mix_mutex_);
+		capture_stream_ = MakeSharedPtr<std::ofstream>(file_name.c_str(), std::ios_base::binary | std::ios_base::out);
+		if (*capture_stream_)
+		{
+			capture_frames_ = 0;
+			WriteWavHeader(*capture_stream_, capture_frames_);
+		}
+		else
+		{
+			capture_stream_.reset();
+		}
+	}
+
+	void SoftMixAudioEngine::StopCapture()
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		if (capture_stream_)
+		{
+			capture_stream_->seekp(0, std::ios_base::beg);
+			WriteWavHeader(*capture_stream_, capture_frames_);
+			capture_stream_.reset();
+		}
+	}
+
+	void SoftMixAudioEngine::AddSource(SoftMixSource* source)
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		if (std::find(sources_.begin(), sources_.end(), source) == sources_.end())
+		{
+			sources_.push_back(source);
+		}
+	}
+
+	void SoftMixAudioEngine::RemoveSource(SoftMixSource* source)
+	{
+		unique_lock<mutex> lock(mix_mutex_);
+		KLAYGE_AUTO(iter, std::find(sources_.begin(), sources_.end(), source));
+		if (iter != sources_.end())
+		{
+			sources_.erase(iter);
+		}
+	}
+
+	mutex& SoftMixAudioEngine::MixMutex() const
+	{
+		return mix_mutex_;
+	}
+
+	void SoftMixAudioEngine::AddStreamingBuffer(SoftMixMusicBuffer* buffer)
+	{
+		{
+			unique_lock<mutex> lock(streaming_mutex_);
+			if (std::find(streaming_buffers_.begin(), streaming_buffers_.end(), buffer) == streaming_buffers_.end())
+			{
+				streaming_buffers_.push_back(buffer);
+			}
+			streaming_requested_ = true;
+		}
+		streaming_cond_.notify_all();
+	}
+
+	void SoftMixAudioEngine::RemoveStreamingBuffer(SoftMixMusicBuffer* buffer)
+	{
+		unique_lock<mutex> lock(streaming_mutex_);
+		KLAYGE_AUTO(iter, std::find(streaming_buffers_.begin(), streaming_buffers_.end(), buffer));
+		if (iter != streaming_buffers_.end())
+		{
+			streaming_buffers_.erase(iter);
+		}
+
+		while (decoding_buffer_ == buffer)
+		{
+			streaming_cond_.wait(lock);
+		}
+	}
+
+	// Called by the sources when they run low. Only holds the streaming lock for the flag, so it's safe under the mixing lock.
+	void SoftMixAudioEngine::RequestStreaming()
+	{
+		{
+			unique_lock<mutex> lock(streaming_mutex_);
+			streaming_requested_ = true;
+		}
+		streaming_cond_.notify_all();
+	}
+
+	void SoftMixAudioEngine::Spatialize(float3 const & pos, float volume, float& gain_l, float& gain_r) const
+	{
+		float3 const vec = pos - listener_pos_;
+		float const dist = MathLib::length(vec);
+
+		// Inverse distance clamped at a reference distance of 1, as the default OpenAL model
+		float const attenuation = 1 / std::max(dist, 1.0f);
+
+		float pan = 0;
+		if (dist > 1e-3f)
+		{
+			float3 const right = MathLib::normalize(MathLib::cross(listener_up_, listener_face_));
+			pan = MathLib::clamp(MathLib::dot(vec, right) / dist, -1.0f, 1.0f);
+		}
+
+		// Equal power panning
+		float const angle = (pan + 1) * PI / 4;
+		gain_l = volume * attenuation * MathLib::cos(angle);
+		gain_r = volume * attenuation * MathLib::sin(angle);
+	}
+
+	float* SoftMixAudioEngine::ScratchBuffer(uint32_t num_frames)
+	{
+		if (scratch_buff_.size() < num_frames * 2)
+		{
+			scratch_buff_.resize(num_frames * 2);
+		}
+		return &scratch_buff_[0];
+	}
+
+	// Mixes one block after another, paced by the wall clock, as an audio device would pull them
+	void SoftMixAudioEngine::MixThreadFunc()
+	{
+		double const block_time = static_cast<double>(SOFT_MIX_BLOCK_FRAMES) / SOFT_MIX_FREQ;
+
+		Timer timer;
+		double next_time = 0;
+		for (;;)
+		{
+			{
+				unique_lock<mutex> lock(mix_mutex_);
+				if (!quit_ && !realtime_)
+				{
+					while (!quit_ && !realtime_)
+					{
+						mix_cond_.wait(lock);
+					}
+
+					timer.restart();
+					next_time = 0;
+				}
+				if (quit_)
+				{
+					break;
+				}
+			}
+
+			this->Mix(SOFT_MIX_BLOCK_FRAMES);
+
+			next_time += block_time;
+			double const ahead = next_time - timer.elapsed();
+			if (ahead > 0)
+			{
+				Sleep(static_cast<uint32_t>(ahead * 1000));
+			}
+		}
+	}
+
+	// Sleeps until a music buffer asks for more, then tops up every streaming buffer.
+	// The streaming lock is released while a buffer decodes, so the mixing thread never waits for decoding.
+	void SoftMixAudioEngine::StreamingThreadFunc()
+	{
+		unique_lock<mutex> lock(streaming_mutex_);
+		while (!quit_streaming_)
+		{
+			if (!streaming_requested_)
+			{
+				streaming_cond_.wait(lock);
+			}
+			else
+			{
+				streaming_requested_ = false;
+
+				// Buffers can be added and removed while the lock is released, so this walks a copy. The ones removed
+				// meanwhile are skipped, and RemoveStreamingBuffer waits for the one being decoded.
+				std::vector<SoftMixMusicBuffer*> const buffers = streaming_buffers_;
+				for (size_t i = 0; (i < buffers.size()) && !quit_streaming_; ++ i)
+				{
+					if (std::find(streaming_buffers_.begin(), streaming_buffers_.end(), buffers[i]) == streaming_buffers_.end())
+					{
+						continue;
+					}
+
+					decoding_buffer_ = buffers[i];
+
+					lock.unlock();
+					decoding_buffer_->Decode();
+					lock.lock();
+
+					decoding_buffer_ = nullptr;
+					streaming_cond_.notify_all();
+				}
+			}
+		}
+	}
+}
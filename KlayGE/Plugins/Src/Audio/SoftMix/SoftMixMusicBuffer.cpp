@@ -0,0 +1,285 @@
+/**
+* @file SoftMixMusicBuffer.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+#include <KlayGE/AudioFactory.hpp>
+
+#include <algorithm>
+
+#include <KlayGE/SoftMix/SoftMixAudio.hpp>
+
+namespace
+{
+	size_t const READSIZE(88200);
+}
+
+namespace KlayGE
+{
+	SoftMixMusicBuffer::SoftMixMusicBuffer(AudioDataSourcePtr const & dataSource, uint32_t bufferSeconds, float volume)
+						: MusicBuffer(dataSource),
+							engine_(*checked_cast<SoftMixAudioEngine*>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance())),
+							read_frame_(0), ready_frames_(0), eof_(false),
+							decode_buff_(READSIZE), decoded_pos_(0),
+							cursor_(0),
+							loop_(false), playing_(false),
+							volume_(volume),
+							pos_(0, 0, 0.1f), vel_(0, 0, 0), dir_(0, 0, 0)
+	{
+		num_channels_ = SoftMixAudioEngine::NumChannels(format_);
+		buffer_frames_ = std::max(bufferSeconds, 1U) * freq_;
+		ring_.resize(buffer_frames_ * num_channels_);
+		decoded_.reserve(READSIZE);
+
+		this->Reset();
+	}
+
+	SoftMixMusicBuffer::~SoftMixMusicBuffer()
+	{
+		this->Stop();
+	}
+
+	void SoftMixMusicBuffer::Decode()
+	{
+		uint32_t write_frame;
+		uint32_t free_frames;
+		{
+			unique_lock<mutex> lock(ring_mutex_);
+			if (eof_)
+			{
+				return;
+			}
+
+			write_frame = (read_frame_ + ready_frames_) % buffer_frames_;
+			free_frames = buffer_frames_ - ready_frames_;
+		}
+
+		bool rewound = false;
+		bool eof = false;
+		while ((free_frames > 0) && !eof)
+		{
+			if (decoded_pos_ + num_channels_ > decoded_.size())
+			{
+				// A partial frame left over is dropped
+				decoded_.clear();
+				decoded_pos_ = 0;
+
+				size_t const size = dataSource_->Read(&decode_buff_[0], decode_buff_.size());
+				if (size > 0)
+				{
+					SoftMixAudioEngine::DecodeToFloat(decoded_, &decode_buff_[0], size, format_);
+					rewound = false;
+				}
+				else if (loop_ && !rewound)
+				{
+					dataSource_->Reset();
+					rewound = true;
+				}
+				else
+				{
+					eof = true;
+				}
+			}
+			else
+			{
+				uint32_t const num_frames = std::min(std::min(free_frames, buffer_frames_ - write_frame),
+					static_cast<uint32_t>((decoded_.size() - decoded_pos_) / num_channels_));
+				std::copy(decoded_.begin() + decoded_pos_, decoded_.begin() + decoded_pos_ + num_frames * num_channels_,
+					ring_.begin() + write_frame * num_channels_);
+				decoded_pos_ += num_frames * num_channels_;
+				write_frame = (write_frame + num_frames) % buffer_frames_;
+				free_frames -= num_frames;
+
+				// Publish as it goes, so the mixer doesn't wait for a full ring after a start
+				unique_lock<mutex> lock(ring_mutex_);
+				ready_frames_ += num_frames;
+			}
+		}
+
+		if (eof)
+		{
+			unique_lock<mutex> lock(ring_mutex_);
+			eof_ = true;
+		}
+	}
+
+	// Neither the mixing nor the streaming thread is touching the buffer here
+	void SoftMixMusicBuffer::DoReset()
+	{
+		dataSource_->Reset();
+		read_frame_ = 0;
+		ready_frames_ = 0;
+		eof_ = false;
+		decoded_.clear();
+		decoded_pos_ = 0;
+		cursor_ = 0;
+	}
+
+	void SoftMixMusicBuffer::DoPlay(bool loop)
+	{
+		this->DoReset();
+
+		loop_ = loop;
+		playing_ = true;
+
+		engine_.AddStreamingBuffer(this);
+		engine_.AddSource(this);
+	}
+
+	void SoftMixMusicBuffer::DoStop()
+	{
+		engine_.RemoveSource(this);
+		engine_.RemoveStreamingBuffer(this);
+
+		playing_ = false;
+	}
+
+	bool SoftMixMusicBuffer::IsPlaying() const
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		return playing_;
+	}
+
+	void SoftMixMusicBuffer::Volume(float vol)
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		volume_ = vol;
+	}
+
+	float3 SoftMixMusicBuffer::Position() const
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		return pos_;
+	}
+
+	void SoftMixMusicBuffer::Position(float3 const & v)
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		pos_ = v;
+	}
+
+	float3 SoftMixMusicBuffer::Velocity() const
+	{
+		return vel_;
+	}
+
+	void SoftMixMusicBuffer::Velocity(float3 const & v)
+	{
+		vel_ = v;
+	}
+
+	float3 SoftMixMusicBuffer::Direction() const
+	{
+		return dir_;
+	}
+
+	void SoftMixMusicBuffer::Direction(float3 const & v)
+	{
+		dir_ = v;
+	}
+
+	// Only consumes what the streaming thread has decoded. An underrun mixes silence instead of waiting.
+	bool SoftMixMusicBuffer::MixTo(float* mix, uint32_t num_frames)
+	{
+		if (!playing_)
+		{
+			return false;
+		}
+
+		uint32_t ready;
+		bool eof;
+		{
+			unique_lock<mutex> lock(ring_mutex_);
+			ready = ready_frames_;
+			eof = eof_;
+		}
+
+		float gain_l, gain_r;
+		engine_.Spatialize(pos_, volume_, gain_l, gain_r);
+		double const step = static_cast<double>(freq_) / SOFT_MIX_FREQ;
+		float* tmp = engine_.ScratchBuffer(num_frames);
+
+		// Linear resampling as in ResampleToStereo, with the source wrapping around the ring
+		uint32_t mixed = 0;
+		for (; mixed < num_frames; ++ mixed)
+		{
+			uint32_t const index = static_cast<uint32_t>(cursor_);
+			// The next frame is needed to interpolate, unless this is the last one of the data
+			if ((index >= ready) || ((index + 1 >= ready) && !eof))
+			{
+				break;
+			}
+
+			uint32_t const frame = (read_frame_ + index) % buffer_frames_;
+			uint32_t const next = (index + 1 < ready) ? (frame + 1) % buffer_frames_ : frame;
+			float const frac = static_cast<float>(cursor_ - index);
+			float const * s0 = &ring_[frame * num_channels_];
+			float const * s1 = &ring_[next * num_channels_];
+			if (1 == num_channels_)
+			{
+				float const s = s0[0] + (s1[0] - s0[0]) * frac;
+				tmp[mixed * 2 + 0] = s;
+				tmp[mixed * 2 + 1] = s;
+			}
+			else
+			{
+				tmp[mixed * 2 + 0] = s0[0] + (s1[0] - s0[0]) * frac;
+				tmp[mixed * 2 + 1] = s0[1] + (s1[1] - s0[1]) * frac;
+			}
+
+			cursor_ += step;
+		}
+
+		SoftMixAudioEngine::MixStereo(mix, tmp, gain_l, gain_r, mixed);
+
+		uint32_t const consumed = std::min(static_cast<uint32_t>(cursor_), ready);
+		cursor_ -= consumed;
+
+		bool request;
+		{
+			unique_lock<mutex> lock(ring_mutex_);
+			read_frame_ = (read_frame_ + consumed) % buffer_frames_;
+			ready_frames_ -= consumed;
+			request = !eof_ && (ready_frames_ < buffer_frames_ / 2);
+			if (eof_ && (0 == ready_frames_))
+			{
+				playing_ = false;
+			}
+		}
+
+		if (request)
+		{
+			engine_.RequestStreaming();
+		}
+
+		return playing_;
+	}
+}
@@ -0,0 +1,218 @@
+/**
+* @file SoftMixSoundBuffer.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+#include <KlayGE/AudioFactory.hpp>
+
+#include <cmath>
+
+#include <KlayGE/SoftMix/SoftMixAudio.hpp>
+
+namespace KlayGE
+{
+	SoftMixSoundBuffer::SoftMixSoundBuffer(AudioDataSourcePtr const & dataSource, uint32_t numSource, float volume)
+						: SoundBuffer(dataSource),
+							engine_(*checked_cast<SoftMixAudioEngine*>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance())),
+							voices_(numSource),
+							volume_(volume),
+							pos_(0, 0, 0.1f), vel_(0, 0, 0), dir_(0, 0, 0)
+	{
+		BOOST_ASSERT(!voices_.empty());
+
+		num_channels_ = SoftMixAudioEngine::NumChannels(format_);
+
+		std::vector<uint8_t> data(dataSource_->Size());
+		if (!data.empty())
+		{
+			data.resize(dataSource_->Read(&data[0], data.size()));
+			SoftMixAudioEngine::DecodeToFloat(samples_, &data[0], data.size(), format_);
+		}
+		num_frames_ = static_cast<uint32_t>(samples_.size() / num_channels_);
+
+		for (size_t i = 0; i < voices_.size(); ++ i)
+		{
+			voices_[i].cursor = 0;
+			voices_[i].playing = false;
+			voices_[i].loop = false;
+		}
+
+		this->Reset();
+	}
+
+	SoftMixSoundBuffer::~SoftMixSoundBuffer()
+	{
+		this->Stop();
+	}
+
+	// Takes a free voice, or the first one if all of them are playing
+	void SoftMixSoundBuffer::Play(bool loop)
+	{
+		{
+			unique_lock<mutex> lock(engine_.MixMutex());
+
+			Voice* voice = &voices_[0];
+			for (size_t i = 0; i < voices_.size(); ++ i)
+			{
+				if (!voices_[i].playing)
+				{
+					voice = &voices_[i];
+					break;
+				}
+			}
+
+			voice->cursor = 0;
+			voice->playing = true;
+			voice->loop = loop;
+		}
+
+		engine_.AddSource(this);
+	}
+
+	void SoftMixSoundBuffer::Stop()
+	{
+		engine_.RemoveSource(this);
+
+		for (size_t i = 0; i < voices_.size(); ++ i)
+		{
+			voices_[i].playing = false;
+		}
+	}
+
+	void SoftMixSoundBuffer::DoReset()
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		for (size_t i = 0; i < voices_.size(); ++ i)
+		{
+			voices_[i].cursor = 0;
+		}
+	}
+
+	bool SoftMixSoundBuffer::IsPlaying() const
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		for (size_t i = 0; i < voices_.size(); ++ i)
+		{
+			if (voices_[i].playing)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void SoftMixSoundBuffer::Volume(float vol)
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		volume_ = vol;
+	}
+
+	float3 SoftMixSoundBuffer::Position() const
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		return pos_;
+	}
+
+	void SoftMixSoundBuffer::Position(float3 const & v)
+	{
+		unique_lock<mutex> lock(engine_.MixMutex());
+		pos_ = v;
+	}
+
+	float3 SoftMixSoundBuffer::Velocity() const
+	{
+		return vel_;
+	}
+
+	void SoftMixSoundBuffer::Velocity(float3 const & v)
+	{
+		vel_ = v;
+	}
+
+	float3 SoftMixSoundBuffer::Direction() const
+	{
+		return dir_;
+	}
+
+	void SoftMixSoundBuffer::Direction(float3 const & v)
+	{
+		dir_ = v;
+	}
+
+	bool SoftMixSoundBuffer::MixTo(float* mix, uint32_t num_frames)
+	{
+		if (0 == num_frames_)
+		{
+			for (size_t i = 0; i < voices_.size(); ++ i)
+			{
+				voices_[i].playing = false;
+			}
+			return false;
+		}
+
+		float gain_l, gain_r;
+		engine_.Spatialize(pos_, volume_, gain_l, gain_r);
+		double const step = static_cast<double>(freq_) / SOFT_MIX_FREQ;
+		float* tmp = engine_.ScratchBuffer(num_frames);
+
+		bool any_playing = false;
+		for (size_t i = 0; i < voices_.size(); ++ i)
+		{
+			Voice& voice = voices_[i];
+			if (voice.playing)
+			{
+				uint32_t mixed = 0;
+				while (mixed < num_frames)
+				{
+					mixed += SoftMixAudioEngine::ResampleToStereo(tmp + mixed * 2, num_frames - mixed, &samples_[0], num_channels_, num_frames_,
+						voice.cursor, step);
+					if (mixed < num_frames)
+					{
+						if (voice.loop)
+						{
+							voice.cursor = std::fmod(voice.cursor, static_cast<double>(num_frames_));
+						}
+						else
+						{
+							voice.playing = false;
+							break;
+						}
+					}
+				}
+
+				SoftMixAudioEngine::MixStereo(mix, tmp, gain_l, gain_r, mixed);
+				any_playing |= voice.playing;
+			}
+		}
+
+		return any_playing;
+	}
+}
@@ -274,10 +274,14 @@ namespace KlayGE
 		UINT size = 0;
 		if (0 == ::GetRawInputData(ri, RID_INPUT, nullptr, &size, sizeof(RAWINPUTHEADER)))
 		{
-			std::vector<uint8_t> data(size);
-			::GetRawInputData(ri, RID_INPUT, &data[0], &size, sizeof(RAWINPUTHEADER));
+			// Reuse the buffer, high rate mice send WM_INPUT on every report
+			if (raw_input_buff_.size() < size)
+			{
+				raw_input_buff_.resize(size);
+			}
+			::GetRawInputData(ri, RID_INPUT, &raw_input_buff_[0], &size, sizeof(RAWINPUTHEADER));
 
-			RAWINPUT* raw = reinterpret_cast<RAWINPUT*>(&data[0]);
+			RAWINPUT* raw = reinterpret_cast<RAWINPUT*>(&raw_input_buff_[0]);
 
 			typedef KLAYGE_DECLTYPE(devices_) DevicesType;
 			KLAYGE_FOREACH(DevicesType::reference device, devices_)
@@ -255,4 +255,20 @@ namespace KlayGE
 		D3D11GraphicsBuffer& d3d_gb = *checked_cast<D3D11GraphicsBuffer*>(&rhs);
 		d3d_imm_ctx_->CopyResource(d3d_gb.D3DBuffer().get(), buffer_.get());
 	}
+
+	void D3D11GraphicsBuffer::UpdateSubresource(uint32_t offset, uint32_t size, void const * data)
+	{
+		BOOST_ASSERT(buffer_);
+		BOOST_ASSERT(!(access_hint_ & EAH_CPU_Write));
+		BOOST_ASSERT(offset + size <= size_in_byte_);
+
+		D3D11_BOX box;
+		box.left = offset;
+		box.top = 0;
+		box.front = 0;
+		box.right = offset + size;
+		box.bottom = 1;
+		box.back = 1;
+		d3d_imm_ctx_->UpdateSubresource(buffer_.get(), 0, &box, data, size, size);
+	}
 }
@@ -29,6 +29,7 @@
 #include <KlayGE/RenderEffect.hpp>
 #include <KlayGE/RenderSettings.hpp>
 #include <KlayGE/PostProcess.hpp>
+#include <KlayGE/ShaderCache.hpp>
 
 #include <KlayGE/D3D11/D3D11RenderWindow.hpp>
 #include <KlayGE/D3D11/D3D11FrameBuffer.hpp>
@@ -151,11 +152,16 @@ namespace KlayGE
 		{
 			DynamicD3D11CreateDevice_ = reinterpret_cast<D3D11CreateDeviceFunc>(::GetProcAddress(mod_d3d11_, "D3D11CreateDevice"));
 		}
+		// The shader cache checks these, they stay null if the compiler dll is missing
+		DynamicD3DPreprocess_ = nullptr;
+		DynamicD3DCreateBlob_ = nullptr;
 		if (mod_d3dcompiler_ != nullptr)
 		{
 			DynamicD3DCompile_ = reinterpret_cast<D3DCompileFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DCompile"));
+			DynamicD3DPreprocess_ = reinterpret_cast<D3DPreprocessFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DPreprocess"));
 			DynamicD3DReflect_ = reinterpret_cast<D3DReflectFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DReflect"));
 			DynamicD3DStripShader_ = reinterpret_cast<D3DStripShaderFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DStripShader"));
+			DynamicD3DCreateBlob_ = reinterpret_cast<D3DCreateBlobFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DCreateBlob"));
 		}
 
 		IDXGIFactory1* gi_factory;
@@ -1550,6 +1556,10 @@ namespace KlayGE
 			d3d_imm_ctx_->VSSetShader(shader.get(), nullptr, 0);
 			vertex_shader_cache_ = shader;
 		}
+		else
+		{
+			++ num_shader_binds_just_avoided_;
+		}
 	}
 
 	void D3D11RenderEngine::PSSetShader(ID3D11PixelShaderPtr const & shader)
@@ -1559,6 +1569,10 @@ namespace KlayGE
 			d3d_imm_ctx_->PSSetShader(shader.get(), nullptr, 0);
 			pixel_shader_cache_ = shader;
 		}
+		else
+		{
+			++ num_shader_binds_just_avoided_;
+		}
 	}
 
 	void D3D11RenderEngine::GSSetShader(ID3D11GeometryShaderPtr const & shader)
@@ -1568,6 +1582,10 @@ namespace KlayGE
 			d3d_imm_ctx_->GSSetShader(shader.get(), nullptr, 0);
 			geometry_shader_cache_ = shader;
 		}
+		else
+		{
+			++ num_shader_binds_just_avoided_;
+		}
 	}
 
 	void D3D11RenderEngine::CSSetShader(ID3D11ComputeShaderPtr const & shader)
@@ -1577,6 +1595,10 @@ namespace KlayGE
 			d3d_imm_ctx_->CSSetShader(shader.get(), nullptr, 0);
 			compute_shader_cache_ = shader;
 		}
+		else
+		{
+			++ num_shader_binds_just_avoided_;
+		}
 	}
 
 	void D3D11RenderEngine::HSSetShader(ID3D11HullShaderPtr const & shader)
@@ -1586,6 +1608,10 @@ namespace KlayGE
 			d3d_imm_ctx_->HSSetShader(shader.get(), nullptr, 0);
 			hull_shader_cache_ = shader;
 		}
+		else
+		{
+			++ num_shader_binds_just_avoided_;
+		}
 	}
 
 	void D3D11RenderEngine::DSSetShader(ID3D11DomainShaderPtr const & shader)
@@ -1595,6 +1621,10 @@ namespace KlayGE
 			d3d_imm_ctx_->DSSetShader(shader.get(), nullptr, 0);
 			domain_shader_cache_ = shader;
 		}
+		else
+		{
+			++ num_shader_binds_just_avoided_;
+		}
 	}
 
 	void D3D11RenderEngine::RSSetViewports(UINT NumViewports, D3D11_VIEWPORT const * pViewports)
@@ -1743,8 +1773,70 @@ namespace KlayGE
 					D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, LPCSTR pEntrypoint,
 					LPCSTR pTarget, UINT Flags1, UINT Flags2, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs) const
 	{
-		return DynamicD3DCompile_(pSrcData, SrcDataSize, pSourceName, pDefines, pInclude, pEntrypoint,
+		// The key is built from the preprocessed text, so includes are resolved, and unused macro branches and
+		// comments don't take part. Effects generating the same text for a shader share the compiled code.
+		ShaderCache& shader_cache = ShaderCache::Instance();
+		bool const cacheable = shader_cache.Enabled() && (DynamicD3DPreprocess_ != nullptr) && (DynamicD3DCreateBlob_ != nullptr);
+		uint64_t cache_key = 0;
+		bool cache_key_valid = false;
+		if (cacheable)
+		{
+			ID3DBlob* text_blob = nullptr;
+			ID3DBlob* preprocess_error_blob = nullptr;
+			if (SUCCEEDED(DynamicD3DPreprocess_(pSrcData, SrcDataSize, pSourceName, pDefines, pInclude,
+				&text_blob, &preprocess_error_blob)) && (text_blob != nullptr))
+			{
+				cache_key = ShaderCache::HashSeed();
+				cache_key = ShaderCache::HashCombine(cache_key, std::string("D3D11"));
+				cache_key = ShaderCache::HashCombine(cache_key, text_blob->GetBufferPointer(), text_blob->GetBufferSize());
+				for (D3D_SHADER_MACRO const * macro = pDefines; (macro != nullptr) && (macro->Name != nullptr); ++ macro)
+				{
+					cache_key = ShaderCache::HashCombine(cache_key, std::string(macro->Name));
+					cache_key = ShaderCache::HashCombine(cache_key, std::string(macro->Definition ? macro->Definition : ""));
+				}
+				cache_key = ShaderCache::HashCombine(cache_key, std::string(pEntrypoint));
+				cache_key = ShaderCache::HashCombine(cache_key, std::string(pTarget));
+				cache_key = ShaderCache::HashCombine(cache_key, &Flags1, sizeof(Flags1));
+				cache_key = ShaderCache::HashCombine(cache_key, &Flags2, sizeof(Flags2));
+				cache_key_valid = true;
+			}
+			if (text_blob)
+			{
+				text_blob->Release();
+			}
+			if (preprocess_error_blob)
+			{
+				preprocess_error_blob->Release();
+			}
+		}
+
+		if (cache_key_valid)
+		{
+			std::vector<uint8_t> cached_code;
+			if (shader_cache.Load(cache_key, cached_code) && !cached_code.empty())
+			{
+				ID3DBlob* code_blob = nullptr;
+				if (SUCCEEDED(DynamicD3DCreateBlob_(cached_code.size(), &code_blob)))
+				{
+					memcpy(code_blob->GetBufferPointer(), &cached_code[0], cached_code.size());
+					*ppCode = code_blob;
+					if (ppErrorMsgs != nullptr)
+					{
+						*ppErrorMsgs = nullptr;
+					}
+					return S_OK;
+				}
+			}
+		}
+
+		HRESULT hr = DynamicD3DCompile_(pSrcData, SrcDataSize, pSourceName, pDefines, pInclude, pEntrypoint,
 					pTarget, Flags1, Flags2, ppCode, ppErrorMsgs);
+		if (cache_key_valid && SUCCEEDED(hr) && (*ppCode != nullptr))
+		{
+			uint8_t const * p = static_cast<uint8_t const *>((*ppCode)->GetBufferPointer());
+			shader_cache.Store(cache_key, std::vector<uint8_t>(p, p + (*ppCode)->GetBufferSize()));
+		}
+		return hr;
 	}
 	
 	HRESULT D3D11RenderEngine::D3DReflect(LPCVOID pSrcData, SIZE_T SrcDataSize, REFIID pInterface, void** ppReflector) const
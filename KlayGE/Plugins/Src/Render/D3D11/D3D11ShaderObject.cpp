@@ -228,6 +228,7 @@ namespace KlayGE
 		has_discard_ = true;
 		has_tessellation_ = false;
 		is_shader_validate_.fill(true);
+		is_shader_compiled_.fill(false);
 	}
 
 	std::string D3D11ShaderObject::GenShaderText(ShaderType type, RenderEffect const & effect,
@@ -1652,11 +1653,25 @@ namespace KlayGE
 		}
 	}
 
+	void D3D11ShaderObject::CompileShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids)
+	{
+		compiled_code_blobs_[type] = this->CompiteToBytecode(type, effect, tech, pass, shader_desc_ids);
+		is_shader_compiled_[type] = true;
+	}
+
 	void D3D11ShaderObject::AttachShader(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids)
 	{
-		shared_ptr<std::vector<uint8_t> > code_blob = this->CompiteToBytecode(type, effect, tech, pass, shader_desc_ids);
-		this->AttachShaderBytecode(type, effect, shader_desc_ids, code_blob);
+		if (!is_shader_compiled_[type])
+		{
+			this->CompileShader(type, effect, tech, pass, shader_desc_ids);
+		}
+
+		this->AttachShaderBytecode(type, effect, shader_desc_ids, compiled_code_blobs_[type]);
+
+		compiled_code_blobs_[type].reset();
+		is_shader_compiled_[type] = false;
 	}
 
 	void D3D11ShaderObject::AttachShader(ShaderType type, RenderEffect const & /*effect*/,
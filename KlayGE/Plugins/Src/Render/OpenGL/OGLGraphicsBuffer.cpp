@@ -170,6 +170,23 @@ namespace KlayGE
 		re.BindBuffer(target_, vb_, force);
 	}
 
+	void OGLGraphicsBuffer::UpdateSubresource(uint32_t offset, uint32_t size, void const * data)
+	{
+		BOOST_ASSERT(!(access_hint_ & EAH_CPU_Write));
+		BOOST_ASSERT(offset + size <= size_in_byte_);
+
+		if (glloader_GL_EXT_direct_state_access())
+		{
+			glNamedBufferSubDataEXT(vb_, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+		}
+		else
+		{
+			OGLRenderEngine& re = *checked_cast<OGLRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+			re.BindBuffer(target_, vb_);
+			glBufferSubData(target_, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+		}
+	}
+
 	void OGLGraphicsBuffer::CopyToBuffer(GraphicsBuffer& rhs)
 	{
 		if (glloader_GL_VERSION_3_1() || glloader_GL_ARB_copy_buffer())
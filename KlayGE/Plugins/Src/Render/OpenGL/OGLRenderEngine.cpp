@@ -528,6 +528,10 @@ namespace KlayGE
 			glUseProgram(program);
 			cur_program_ = program;
 		}
+		else
+		{
+			++ num_shader_binds_just_avoided_;
+		}
 	}
 
 	void OGLRenderEngine::Uniform1i(GLint location, GLint value)
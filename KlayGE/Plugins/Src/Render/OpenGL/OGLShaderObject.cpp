@@ -27,8 +27,10 @@
 #include <KlayGE/Context.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/Matrix.hpp>
+#include <KFL/Thread.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/ShaderCache.hpp>
 
 #include <cstdio>
 #include <string>
@@ -143,6 +145,81 @@ namespace
 			std::string const & target, uint32_t flags1, uint32_t flags2,
 			std::vector<uint8_t>& code, std::string& error_msgs) const
 		{
+			ShaderCache& shader_cache = ShaderCache::Instance();
+			uint64_t cache_key = 0;
+			if (shader_cache.Enabled())
+			{
+				cache_key = ShaderCache::HashSeed();
+				cache_key = ShaderCache::HashCombine(cache_key, std::string("OpenGL"));
+				cache_key = ShaderCache::HashCombine(cache_key, this->CacheKeyText(src_data, defines));
+				for (D3D_SHADER_MACRO const * macro = defines; (macro != nullptr) && (macro->Name != nullptr); ++ macro)
+				{
+					cache_key = ShaderCache::HashCombine(cache_key, std::string(macro->Name));
+					cache_key = ShaderCache::HashCombine(cache_key, std::string(macro->Definition ? macro->Definition : ""));
+				}
+				cache_key = ShaderCache::HashCombine(cache_key, entry_point);
+				cache_key = ShaderCache::HashCombine(cache_key, target);
+				cache_key = ShaderCache::HashCombine(cache_key, &flags1, sizeof(flags1));
+				cache_key = ShaderCache::HashCombine(cache_key, &flags2, sizeof(flags2));
+
+				if (shader_cache.Load(cache_key, code) && !code.empty())
+				{
+					error_msgs.clear();
+					return 0;
+				}
+			}
+
+			HRESULT hr = this->DoD3DCompile(src_data, defines, entry_point, target, flags1, flags2, code, error_msgs);
+			if (shader_cache.Enabled() && (hr >= 0) && !code.empty())
+			{
+				shader_cache.Store(cache_key, code);
+			}
+			return hr;
+		}
+
+		GLSLVersion GLSLVer() const
+		{
+			return gsv_;
+		}
+
+	private:
+		// With the compiler loaded in process, the key is built from the preprocessed text, so unused macro
+		// branches and comments don't take part. The external compiler process can only be keyed by the full text.
+		std::string CacheKeyText(std::string const & src_data, D3D_SHADER_MACRO const * defines) const
+		{
+#ifdef CALL_D3DCOMPILER_DIRECTLY
+			std::string text = src_data;
+			if (DynamicD3DPreprocess_ != nullptr)
+			{
+				ID3DBlob* text_blob = nullptr;
+				ID3DBlob* error_msgs_blob = nullptr;
+				if (SUCCEEDED(DynamicD3DPreprocess_(src_data.c_str(), static_cast<UINT>(src_data.size()),
+					nullptr, defines, nullptr, &text_blob, &error_msgs_blob)) && (text_blob != nullptr))
+				{
+					char const * p = static_cast<char const *>(text_blob->GetBufferPointer());
+					text.assign(p, p + text_blob->GetBufferSize());
+				}
+				if (text_blob)
+				{
+					text_blob->Release();
+				}
+				if (error_msgs_blob)
+				{
+					error_msgs_blob->Release();
+				}
+			}
+			return text;
+#else
+			UNREF_PARAM(defines);
+			return src_data;
+#endif
+		}
+
+		HRESULT DoD3DCompile(std::string const & src_data,
+			D3D_SHADER_MACRO const * defines, std::string const & entry_point,
+			std::string const & target, uint32_t flags1, uint32_t flags2,
+			std::vector<uint8_t>& code, std::string& error_msgs) const
+		{
 #ifdef CALL_D3DCOMPILER_DIRECTLY
 			ID3DBlob* code_blob = nullptr;
 			ID3DBlob* error_msgs_blob = nullptr;
@@ -171,7 +248,12 @@ namespace
 			}
 			return hr;
 #else
-			std::string mark = boost::lexical_cast<std::string>(static_cast<void const *>(src_data.c_str()));
+			// Shaders are compiled on several threads at once, and a freed address can come back,
+			// so the names come from the thread and a counter
+			static atomic<uint32_t> num_compiles(0);
+			std::stringstream mark_ss;
+			mark_ss << threadof(0) << '_' << (num_compiles ++);
+			std::string mark = mark_ss.str();
 			std::string compile_input_file = entry_point + mark + "Input.tmp";
 			std::string compile_output_file = entry_point + mark + "Output.tmp";
 
@@ -209,13 +291,12 @@ namespace
 #ifdef KLAYGE_PLATFORM_WINDOWS
 			ss << d3dcompiler_wrapper_name << ".exe";
 #else
-			static bool first = true;
-			if (first)
+			static atomic<bool> first(true);
+			if (first.exchange(false))
 			{
 				ss << WINE_PATH << "wineserver -p";
 				system(ss.str().c_str());
 				// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
-				first = false;
 				ss.str(std::string());
 			}
 			ss << WINE_PATH << "wine ./" << d3dcompiler_wrapper_name << ".exe.so";
@@ -266,12 +347,6 @@ namespace
 #endif
 		}
 
-		GLSLVersion GLSLVer() const
-		{
-			return gsv_;
-		}
-
-	private:
 		DXBC2GLSLIniter()
 		{
 #ifdef CALL_D3DCOMPILER_DIRECTLY
@@ -280,6 +355,7 @@ namespace
 			__assume(mod_d3dcompiler_ != nullptr);
 #endif
 			DynamicD3DCompile_ = reinterpret_cast<D3DCompileFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DCompile"));
+			DynamicD3DPreprocess_ = reinterpret_cast<D3DPreprocessFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DPreprocess"));
 #endif
 			if (glloader_GL_VERSION_4_5())
 			{
@@ -332,9 +408,12 @@ namespace
 		typedef HRESULT(WINAPI *D3DCompileFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
 			D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, LPCSTR pEntrypoint,
 			LPCSTR pTarget, UINT Flags1, UINT Flags2, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
+		typedef HRESULT(WINAPI *D3DPreprocessFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
+			D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, ID3DBlob** ppCodeText, ID3DBlob** ppErrorMsgs);
 
 		HMODULE mod_d3dcompiler_;
 		D3DCompileFunc DynamicD3DCompile_;
+		D3DPreprocessFunc DynamicD3DPreprocess_;
 #endif
 		GLSLVersion gsv_;
 	};
@@ -1084,6 +1163,7 @@ namespace KlayGE
 		has_discard_ = false;
 		has_tessellation_ = false;
 		is_shader_validate_.fill(true);
+		is_shader_compiled_.fill(false);
 
 		glsl_program_ = glCreateProgram();
 
@@ -1528,8 +1608,6 @@ namespace KlayGE
 				gs_max_output_vertex_ = LE2Native(gs_max_output_vertex_);
 			}
 
-			this->AttachGLSL(type);
-
 			ret = is_shader_validate_[type];
 		}
 
@@ -1658,7 +1736,7 @@ namespace KlayGE
 		}
 	}
 
-	void OGLShaderObject::AttachShader(ShaderType type, RenderEffect const & effect,
+	void OGLShaderObject::CompileShader(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids)
 	{
 		ShaderDesc const & sd = effect.GetShaderDesc(shader_desc_ids[type]);
@@ -2229,10 +2307,17 @@ namespace KlayGE
 			}
 		}
 
-		if (is_shader_validate_[type])
+		is_shader_compiled_[type] = true;
+	}
+
+	void OGLShaderObject::AttachShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids)
+	{
+		if (!is_shader_compiled_[type])
 		{
-			this->AttachGLSL(type);
+			this->CompileShader(type, effect, tech, pass, shader_desc_ids);
 		}
+		is_shader_compiled_[type] = false;
 	}
 
 	void OGLShaderObject::AttachShader(ShaderType type, RenderEffect const & /*effect*/,
@@ -2288,8 +2373,6 @@ namespace KlayGE
 					}
 				}
 			}
-
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -2306,15 +2389,46 @@ namespace KlayGE
 
 		if (is_validate_)
 		{
-			if (glloader_GL_VERSION_4_1() || glloader_GL_ARB_get_program_binary())
+			bool const program_binary = glloader_GL_VERSION_4_1() || glloader_GL_ARB_get_program_binary();
+			ShaderCache& shader_cache = ShaderCache::Instance();
+			bool const use_cache = program_binary && shader_cache.Enabled();
+
+			// The GLSLs are compiled here rather than when they are attached, so that a cached program skips the compiling too
+			uint64_t cache_key = 0;
+			bool from_cache = false;
+			if (use_cache)
 			{
-				glProgramParameteri(glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+				cache_key = this->GLSLProgramKey();
+				from_cache = this->LoadGLSLProgram(cache_key);
 			}
+			if (!from_cache)
+			{
+				for (uint32_t type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+				{
+					if (!(*shader_func_names_)[type].empty())
+					{
+						this->AttachGLSL(type);
+						is_validate_ &= is_shader_validate_[type];
+					}
+				}
 
-			this->LinkGLSL();
-			this->AttachUBOs(effect);
+				if (is_validate_)
+				{
+					if (program_binary)
+					{
+						glProgramParameteri(glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+					}
 
-			if (is_validate_ && (glloader_GL_VERSION_4_1() || glloader_GL_ARB_get_program_binary()))
+					this->LinkGLSL();
+				}
+			}
+
+			if (is_validate_)
+			{
+				this->AttachUBOs(effect);
+			}
+
+			if (is_validate_ && program_binary && !from_cache)
 			{
 				GLint num = 0;
 				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num);
@@ -2324,6 +2438,14 @@ namespace KlayGE
 					glGetProgramiv(glsl_program_, GL_PROGRAM_BINARY_LENGTH, &len);
 					glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t> >(len);
 					glGetProgramBinary(glsl_program_, len, nullptr, &glsl_bin_format_, &(*glsl_bin_program_)[0]);
+
+					if (use_cache && (len > 0))
+					{
+						std::vector<uint8_t> code(sizeof(glsl_bin_format_) + len);
+						std::memcpy(&code[0], &glsl_bin_format_, sizeof(glsl_bin_format_));
+						std::memcpy(&code[sizeof(glsl_bin_format_)], &(*glsl_bin_program_)[0], len);
+						shader_cache.Store(cache_key, code);
+					}
 				}
 			}
 
@@ -2412,6 +2534,7 @@ namespace KlayGE
 			get<3>(ret->tex_sampler_binds_[i]) = get<3>(tex_sampler_binds_[i]);
 		}
 
+		bool from_binary = false;
 		if ((glloader_GL_VERSION_4_1() || glloader_GL_ARB_get_program_binary()) && glsl_bin_program_)
 		{
 			ret->is_validate_ = is_validate_;
@@ -2420,6 +2543,7 @@ namespace KlayGE
 				ret->is_shader_validate_[type] = is_shader_validate_[type];
 			}
 
+			from_binary = true;
 			if (ret->is_validate_)
 			{
 				glProgramParameteri(ret->glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
@@ -2442,10 +2566,11 @@ namespace KlayGE
 					}
 				}
 #endif
-				ret->is_validate_ &= linked ? true : false;
+				// A rejected binary falls back to the GLSLs below
+				from_binary = linked ? true : false;
 			}
 		}
-		else
+		if (!from_binary)
 		{
 			ret->is_validate_ = true;
 			for (size_t type = 0; type < ST_NumShaderTypes; ++ type)
@@ -2777,6 +2902,66 @@ namespace KlayGE
 		glDeleteShader(object);
 	}
 
+	// Keyed by the final GLSLs, not the HLSL they come from, and by the driver, so that binaries from another driver are never looked up
+	uint64_t OGLShaderObject::GLSLProgramKey() const
+	{
+		uint64_t key = ShaderCache::HashSeed();
+		key = ShaderCache::HashCombine(key, std::string("OpenGL program binary"));
+
+		GLenum const driver_strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (size_t i = 0; i < sizeof(driver_strings) / sizeof(driver_strings[0]); ++ i)
+		{
+			char const * str = reinterpret_cast<char const *>(glGetString(driver_strings[i]));
+			key = ShaderCache::HashCombine(key, std::string(str ? str : ""));
+		}
+
+		for (uint32_t type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+		{
+			if (!(*shader_func_names_)[type].empty() && (*glsl_srcs_)[type])
+			{
+				key = ShaderCache::HashCombine(key, &type, sizeof(type));
+				key = ShaderCache::HashCombine(key, *(*glsl_srcs_)[type]);
+			}
+		}
+		key = ShaderCache::HashCombine(key, &gs_input_type_, sizeof(gs_input_type_));
+		key = ShaderCache::HashCombine(key, &gs_output_type_, sizeof(gs_output_type_));
+		key = ShaderCache::HashCombine(key, &gs_max_output_vertex_, sizeof(gs_max_output_vertex_));
+
+		return key;
+	}
+
+	bool OGLShaderObject::LoadGLSLProgram(uint64_t key)
+	{
+		ShaderCache& shader_cache = ShaderCache::Instance();
+
+		std::vector<uint8_t> code;
+		if (!shader_cache.Load(key, code) || (code.size() <= sizeof(glsl_bin_format_)))
+		{
+			return false;
+		}
+
+		GLenum format;
+		std::memcpy(&format, &code[0], sizeof(format));
+		GLsizei const len = static_cast<GLsizei>(code.size() - sizeof(format));
+
+		glProgramParameteri(glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glProgramBinary(glsl_program_, format, &code[sizeof(format)], len);
+
+		GLint linked = false;
+		glGetProgramiv(glsl_program_, GL_LINK_STATUS, &linked);
+		if (!linked)
+		{
+			// Drivers are free to reject binaries, e.g. after an update that keeps the version string.
+			// Drop the entry, and let the caller compile the GLSLs. The program object stays usable for that.
+			shader_cache.Remove(key);
+			return false;
+		}
+
+		glsl_bin_format_ = format;
+		glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t> >(code.begin() + sizeof(format), code.end());
+		return true;
+	}
+
 	void OGLShaderObject::LinkGLSL()
 	{
 		glLinkProgram(glsl_program_);
@@ -18,6 +18,7 @@
 #include <KlayGE/RenderFactory.hpp>
 
 #include <algorithm>
+#include <cstring>
 
 #include <KlayGE/OpenGLES/OGLESRenderEngine.hpp>
 #include <KlayGE/OpenGLES/OGLESGraphicsBuffer.hpp>
@@ -151,6 +152,21 @@ namespace KlayGE
 		re.BindBuffer(target_, vb_, force);
 	}
 
+	void OGLESGraphicsBuffer::UpdateSubresource(uint32_t offset, uint32_t size, void const * data)
+	{
+		BOOST_ASSERT(!(access_hint_ & EAH_CPU_Write));
+		BOOST_ASSERT(offset + size <= size_in_byte_);
+
+		if (!buf_data_.empty())
+		{
+			std::memcpy(&buf_data_[offset], data, size);
+		}
+
+		OGLESRenderEngine& re = *checked_cast<OGLESRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+		re.BindBuffer(target_, vb_);
+		glBufferSubData(target_, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+	}
+
 	void OGLESGraphicsBuffer::CopyToBuffer(GraphicsBuffer& rhs)
 	{
 		GraphicsBuffer::Mapper lhs_mapper(*this, BA_Read_Only);
@@ -20,8 +20,10 @@
 #include <KlayGE/Context.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/Matrix.hpp>
+#include <KFL/Thread.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/ShaderCache.hpp>
 
 #include <cstdio>
 #include <string>
@@ -139,6 +141,81 @@ namespace
 			std::string const & target, uint32_t flags1, uint32_t flags2,
 			std::vector<uint8_t>& code, std::string& error_msgs) const
 		{
+			ShaderCache& shader_cache = ShaderCache::Instance();
+			uint64_t cache_key = 0;
+			if (shader_cache.Enabled())
+			{
+				cache_key = ShaderCache::HashSeed();
+				cache_key = ShaderCache::HashCombine(cache_key, std::string("OpenGLES"));
+				cache_key = ShaderCache::HashCombine(cache_key, this->CacheKeyText(src_data, defines));
+				for (D3D_SHADER_MACRO const * macro = defines; (macro != nullptr) && (macro->Name != nullptr); ++ macro)
+				{
+					cache_key = ShaderCache::HashCombine(cache_key, std::string(macro->Name));
+					cache_key = ShaderCache::HashCombine(cache_key, std::string(macro->Definition ? macro->Definition : ""));
+				}
+				cache_key = ShaderCache::HashCombine(cache_key, entry_point);
+				cache_key = ShaderCache::HashCombine(cache_key, target);
+				cache_key = ShaderCache::HashCombine(cache_key, &flags1, sizeof(flags1));
+				cache_key = ShaderCache::HashCombine(cache_key, &flags2, sizeof(flags2));
+
+				if (shader_cache.Load(cache_key, code) && !code.empty())
+				{
+					error_msgs.clear();
+					return 0;
+				}
+			}
+
+			HRESULT hr = this->DoD3DCompile(src_data, defines, entry_point, target, flags1, flags2, code, error_msgs);
+			if (shader_cache.Enabled() && (hr >= 0) && !code.empty())
+			{
+				shader_cache.Store(cache_key, code);
+			}
+			return hr;
+		}
+
+		GLSLVersion GLSLVer() const
+		{
+			return gsv_;
+		}
+
+	private:
+		// With the compiler loaded in process, the key is built from the preprocessed text, so unused macro
+		// branches and comments don't take part. The external compiler process can only be keyed by the full text.
+		std::string CacheKeyText(std::string const & src_data, D3D_SHADER_MACRO const * defines) const
+		{
+#ifdef CALL_D3DCOMPILER_DIRECTLY
+			std::string text = src_data;
+			if (DynamicD3DPreprocess_ != nullptr)
+			{
+				ID3DBlob* text_blob = nullptr;
+				ID3DBlob* error_msgs_blob = nullptr;
+				if (SUCCEEDED(DynamicD3DPreprocess_(src_data.c_str(), static_cast<UINT>(src_data.size()),
+					nullptr, defines, nullptr, &text_blob, &error_msgs_blob)) && (text_blob != nullptr))
+				{
+					char const * p = static_cast<char const *>(text_blob->GetBufferPointer());
+					text.assign(p, p + text_blob->GetBufferSize());
+				}
+				if (text_blob)
+				{
+					text_blob->Release();
+				}
+				if (error_msgs_blob)
+				{
+					error_msgs_blob->Release();
+				}
+			}
+			return text;
+#else
+			UNREF_PARAM(defines);
+			return src_data;
+#endif
+		}
+
+		HRESULT DoD3DCompile(std::string const & src_data,
+			D3D_SHADER_MACRO const * defines, std::string const & entry_point,
+			std::string const & target, uint32_t flags1, uint32_t flags2,
+			std::vector<uint8_t>& code, std::string& error_msgs) const
+		{
 #ifdef CALL_D3DCOMPILER_DIRECTLY
 			ID3DBlob* code_blob = nullptr;
 			ID3DBlob* error_msgs_blob = nullptr;
@@ -167,7 +244,12 @@ namespace
 			}
 			return hr;
 #else
-			std::string mark = boost::lexical_cast<std::string>(static_cast<void const *>(src_data.c_str()));
+			// Shaders are compiled on several threads at once, and a freed address can come back,
+			// so the names come from the thread and a counter
+			static atomic<uint32_t> num_compiles(0);
+			std::stringstream mark_ss;
+			mark_ss << threadof(0) << '_' << (num_compiles ++);
+			std::string mark = mark_ss.str();
 			std::string compile_input_file = entry_point + mark + "Input.tmp";
 			std::string compile_output_file = entry_point + mark + "Output.tmp";
 
@@ -205,13 +287,12 @@ namespace
 #ifdef KLAYGE_PLATFORM_WINDOWS
 			ss << d3dcompiler_wrapper_name << ".exe";
 #else
-			static bool first = true;
-			if (first)
+			static atomic<bool> first(true);
+			if (first.exchange(false))
 			{
 				ss << WINE_PATH << "wineserver -p";
 				system(ss.str().c_str());
 				// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
-				first = false;
 				ss.str(std::string());
 			}
 			ss << WINE_PATH << "wine ./" << d3dcompiler_wrapper_name << ".exe.so";
@@ -262,12 +343,6 @@ namespace
 #endif
 		}
 
-		GLSLVersion GLSLVer() const
-		{
-			return gsv_;
-		}
-
-	private:
 		DXBC2GLSLIniter()
 		{
 #ifdef CALL_D3DCOMPILER_DIRECTLY
@@ -276,6 +351,7 @@ namespace
 			__assume(mod_d3dcompiler_ != nullptr);
 #endif
 			DynamicD3DCompile_ = reinterpret_cast<D3DCompileFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DCompile"));
+			DynamicD3DPreprocess_ = reinterpret_cast<D3DPreprocessFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DPreprocess"));
 #endif
 
 			if (glloader_GLES_VERSION_3_1())
@@ -297,9 +373,12 @@ namespace
 		typedef HRESULT(WINAPI *D3DCompileFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
 			D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, LPCSTR pEntrypoint,
 			LPCSTR pTarget, UINT Flags1, UINT Flags2, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
+		typedef HRESULT(WINAPI *D3DPreprocessFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
+			D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, ID3DBlob** ppCodeText, ID3DBlob** ppErrorMsgs);
 
 		HMODULE mod_d3dcompiler_;
 		D3DCompileFunc DynamicD3DCompile_;
+		D3DPreprocessFunc DynamicD3DPreprocess_;
 #endif
 		GLSLVersion gsv_;
 	};
@@ -1055,6 +1134,7 @@ namespace KlayGE
 		has_discard_ = false;
 		has_tessellation_ = false;
 		is_shader_validate_.fill(true);
+		is_shader_compiled_.fill(false);
 
 		glsl_program_ = glCreateProgram();
 
@@ -1615,7 +1695,7 @@ namespace KlayGE
 		}
 	}
 
-	void OGLESShaderObject::AttachShader(ShaderType type, RenderEffect const & effect,
+	void OGLESShaderObject::CompileShader(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids)
 	{
 		ShaderDesc const & sd = effect.GetShaderDesc(shader_desc_ids[type]);
@@ -2160,6 +2240,18 @@ namespace KlayGE
 #endif
 		}
 
+		is_shader_compiled_[type] = true;
+	}
+
+	void OGLESShaderObject::AttachShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::vector<uint32_t> const & shader_desc_ids)
+	{
+		if (!is_shader_compiled_[type])
+		{
+			this->CompileShader(type, effect, tech, pass, shader_desc_ids);
+		}
+		is_shader_compiled_[type] = false;
+
 		if (is_shader_validate_[type])
 		{
 			this->AttachGLSL(type);
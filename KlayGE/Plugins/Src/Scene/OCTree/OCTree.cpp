@@ -113,8 +113,21 @@ namespace KlayGE
 		return max_tree_depth_;
 	}
 
-	void OCTree::ClipScene()
+	void OCTree::ClipScene(Camera const & camera)
 	{
+		frustum_ = &camera.ViewFrustum();
+
+		float4x4 view_proj = camera.ViewProjMatrix();
+		DeferredRenderingLayerPtr const & drl = Context::Instance().DeferredRenderingLayerInstance();
+		if (drl)
+		{
+			int32_t cas_index = drl->CurrCascadeIndex();
+			if (cas_index >= 0)
+			{
+				view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
+			}
+		}
+
 		if (rebuild_tree_)
 		{
 			octree_.resize(1);
@@ -152,22 +165,7 @@ namespace KlayGE
 
 		if (!octree_.empty())
 		{
-			this->NodeVisible(0);
-		}
-
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
-
-		float4x4 view_proj = camera.ViewProjMatrix();
-		DeferredRenderingLayerPtr const & drl = Context::Instance().DeferredRenderingLayerInstance();
-		if (drl)
-		{
-			float4x4 proj = camera.ProjMatrix();
-			int32_t cas_index = drl->CurrCascadeIndex();
-			if (cas_index >= 0)
-			{
-				view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
-			}
+			this->NodeVisible(0, camera.EyePos(), view_proj);
 		}
 
 		if (camera.OmniDirectionalMode())
@@ -177,11 +175,6 @@ namespace KlayGE
 				if (obj->Visible())
 				{
 					uint32_t const attr = obj->Attrib();
-					if (attr & SceneObject::SOA_Moveable)
-					{
-						obj->UpdateAbsModelMatrix();
-					}
-
 					if (attr & SceneObject::SOA_Cullable)
 					{
 						AABBoxPtr aabb_ws = obj->PosBoundWS();
@@ -199,7 +192,7 @@ namespace KlayGE
 		{
 			if (!octree_.empty())
 			{
-				this->MarkNodeObjs(0, false);
+				this->MarkNodeObjs(0, false, camera.EyePos(), view_proj);
 			}
 
 			KLAYGE_FOREACH(SceneObjsType::const_reference obj, scene_objs_)
@@ -210,11 +203,6 @@ namespace KlayGE
 					if (BO_Partial == visible)
 					{
 						uint32_t const attr = obj->Attrib();
-						if (attr & SceneObject::SOA_Moveable)
-						{
-							obj->UpdateAbsModelMatrix();
-						}
-
 						if (attr & SceneObject::SOA_Cullable)
 						{
 							if (attr & SceneObject::SOA_Moveable)
@@ -338,27 +326,12 @@ namespace KlayGE
 		}
 	}
 
-	void OCTree::NodeVisible(size_t index)
+	void OCTree::NodeVisible(size_t index, float3 const & eye_pos, float4x4 const & view_proj)
 	{
 		BOOST_ASSERT(index < octree_.size());
 
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
-
-		float4x4 view_proj = camera.ViewProjMatrix();
-		DeferredRenderingLayerPtr const & drl = Context::Instance().DeferredRenderingLayerInstance();
-		if (drl)
-		{
-			float4x4 proj = camera.ProjMatrix();
-			int32_t cas_index = drl->CurrCascadeIndex();
-			if (cas_index >= 0)
-			{
-				view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
-			}
-		}
-
 		octree_node_t& node = octree_[index];
-		if (MathLib::perspective_area(camera.EyePos(), view_proj, node.bb) > small_obj_threshold_)
+		if (MathLib::perspective_area(eye_pos, view_proj, node.bb) > small_obj_threshold_)
 		{
 			BoundOverlap const vis = frustum_->Intersect(node.bb);
 			node.visible = vis;
@@ -368,7 +341,7 @@ namespace KlayGE
 				{
 					for (int i = 0; i < 8; ++ i)
 					{
-						this->NodeVisible(node.first_child_index + i);
+						this->NodeVisible(node.first_child_index + i, eye_pos, view_proj);
 					}
 				}
 			}
@@ -386,25 +359,10 @@ namespace KlayGE
 #endif
 	}
 
-	void OCTree::MarkNodeObjs(size_t index, bool force)
+	void OCTree::MarkNodeObjs(size_t index, bool force, float3 const & eye_pos, float4x4 const & view_proj)
 	{
 		BOOST_ASSERT(index < octree_.size());
 
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
-
-		float4x4 view_proj = camera.ViewProjMatrix();
-		DeferredRenderingLayerPtr const & drl = Context::Instance().DeferredRenderingLayerInstance();
-		if (drl)
-		{
-			float4x4 proj = camera.ProjMatrix();
-			int32_t cas_index = drl->CurrCascadeIndex();
-			if (cas_index >= 0)
-			{
-				view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
-			}
-		}
-
 		octree_node_t const & node = octree_[index];
 		if ((node.visible != BO_No) || force)
 		{
@@ -412,10 +370,10 @@ namespace KlayGE
 			{
 				if ((BO_No == so->VisibleMark()) && so->Visible())
 				{
-					BoundOverlap visible = this->VisibleTestFromParent(so, camera.EyePos(), view_proj);
+					BoundOverlap visible = this->VisibleTestFromParent(so, eye_pos, view_proj);
 					if (BO_Partial == visible)
 					{
-						if (so->Parent() || (MathLib::perspective_area(camera.EyePos(), view_proj,
+						if (so->Parent() || (MathLib::perspective_area(eye_pos, view_proj,
 							*so->PosBoundWS()) > small_obj_threshold_))
 						{
 							so->VisibleMark(frustum_->Intersect(*so->PosBoundWS()));
@@ -436,7 +394,7 @@ namespace KlayGE
 			{
 				for (int i = 0; i < 8; ++ i)
 				{
-					this->MarkNodeObjs(node.first_child_index + i, (BO_Yes == node.visible) || force);
+					this->MarkNodeObjs(node.first_child_index + i, (BO_Yes == node.visible) || force, eye_pos, view_proj);
 				}
 			}
 		}
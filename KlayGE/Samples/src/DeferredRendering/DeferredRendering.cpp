@@ -432,6 +432,11 @@ void DeferredRenderingApp::DoUpdateOverlay()
 	stream << scene_mgr.NumDrawCalls() << " Draws/frame "
 		<< scene_mgr.NumDispatchCalls() << " Dispatches/frame";
 	font_->RenderText(0, 90, Color(1, 1, 1, 1), stream.str(), 16);
+
+	stream.str(L"");
+	stream << scene_mgr.NumStateChangesAvoided() << " State changes avoided/frame "
+		<< scene_mgr.NumShaderBindsAvoided() << " Shader binds avoided/frame";
+	font_->RenderText(0, 108, Color(1, 1, 1, 1), stream.str(), 16);
 }
 
 uint32_t DeferredRenderingApp::DoUpdate(uint32_t pass)
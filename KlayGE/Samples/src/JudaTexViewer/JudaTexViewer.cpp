@@ -31,6 +31,8 @@ using namespace KlayGE;
 namespace
 {
 	uint32_t const BORDER_SIZE = 4;
+	// Tiles uploaded to the cache per frame. The rest keep decoding in the background.
+	uint32_t const MAX_TILE_UPLOADS = 32;
 
 #ifdef KLAYGE_HAS_STRUCT_PACK
 #pragma pack(push, 1)
@@ -551,7 +553,7 @@ uint32_t JudaTexViewer::DoUpdate(uint32_t /*pass*/)
 		rl_border->VertexStreamFrequencyDivider(i, RenderLayout::ST_Geometry, nx * ny);
 	}
 
-	juda_tex_->UpdateCache(tile_ids);
+	juda_tex_->StreamCache(tile_ids, MAX_TILE_UPLOADS);
 
 	Color clear_clr(0.2f, 0.4f, 0.6f, 1);
 	if (Context::Instance().Config().graphics_cfg.gamma)
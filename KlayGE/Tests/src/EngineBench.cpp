@@ -0,0 +1,1037 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/XMLDom.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Renderable.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KlayGE/Mesh.hpp>
+#include <KlayGE/ParticleSystem.hpp>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+using namespace KlayGE;
+
+// On MSVC every KlayGE DLL binds to the operator new of its CRT, so a replacement here only sees the allocations
+// of this executable. The release CRT has no allocation hook either. The allocation columns are left out there.
+#ifndef KLAYGE_COMPILER_MSVC
+#define KLAYGE_BENCH_COUNT_ALLOCS
+#endif
+
+#ifdef KLAYGE_BENCH_COUNT_ALLOCS
+namespace
+{
+	// Every allocation of the process goes through the operators below, including the ones in the shared libraries
+	atomic<uint64_t> num_allocs(0);
+	atomic<uint64_t> num_alloc_bytes(0);
+}
+
+// Once these are inlined, GCC 11+ sees free() on pointers from new and warns, although the pair is matched
+#if defined(KLAYGE_COMPILER_GCC) && (__GNUC__ >= 11)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size)
+{
+	++ num_allocs;
+	num_alloc_bytes += size;
+
+	void* p = std::malloc(size > 0 ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) KLAYGE_NOEXCEPT
+{
+	std::free(p);
+}
+
+// The other forms forward to the ones above, so that every new is paired with a matching delete
+
+void* operator new[](size_t size)
+{
+	return ::operator new(size);
+}
+
+void* operator new(size_t size, std::nothrow_t const &) KLAYGE_NOEXCEPT
+{
+	try
+	{
+		return ::operator new(size);
+	}
+	catch (std::bad_alloc const &)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, std::nothrow_t const &) KLAYGE_NOEXCEPT
+{
+	return ::operator new(size, std::nothrow);
+}
+
+void operator delete[](void* p) KLAYGE_NOEXCEPT
+{
+	::operator delete(p);
+}
+
+void operator delete(void* p, std::nothrow_t const &) KLAYGE_NOEXCEPT
+{
+	::operator delete(p);
+}
+
+void operator delete[](void* p, std::nothrow_t const &) KLAYGE_NOEXCEPT
+{
+	::operator delete(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) KLAYGE_NOEXCEPT
+{
+	::operator delete(p);
+}
+
+void operator delete[](void* p, size_t) KLAYGE_NOEXCEPT
+{
+	::operator delete(p);
+}
+#endif
+
+#if defined(KLAYGE_COMPILER_GCC) && (__GNUC__ >= 11)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+namespace
+{
+	// Every measurement is repeated until it has taken at least this long, and the average is reported
+	double const MIN_MEASURE_TIME = 0.5;
+
+	uint32_t const NUM_MESHES = 16;
+	uint32_t const NUM_JOINTS = 64;
+	uint32_t const NUM_KEY_FRAMES = 16;
+	uint32_t const NUM_PARTICLES = 4096;
+	uint32_t const NUM_RESOURCES = 256;
+	uint32_t const NUM_XML_TECHS = 512;
+	uint32_t const NUM_MATH_ITEMS = 4096;
+
+	// A line of the results. The allocations are negative if they aren't counted, and left empty in the CSV.
+	struct BenchResult
+	{
+		std::string benchmark;
+		std::string variant;
+		uint32_t items;
+		double seconds;
+		double allocs;
+		double alloc_bytes;
+	};
+
+	struct BaselineEntry
+	{
+		double ms;
+		double allocs;	// Negative if they weren't counted
+	};
+
+	template <typename Func>
+	BenchResult Measure(std::string const & benchmark, std::string const & variant, uint32_t items, Func const & func)
+	{
+		// The first run fills the caches and grows the buffers, it's not a part of the steady state
+		func();
+
+#ifdef KLAYGE_BENCH_COUNT_ALLOCS
+		uint64_t const allocs_before = num_allocs;
+		uint64_t const bytes_before = num_alloc_bytes;
+#endif
+
+		Timer timer;
+		uint32_t runs = 0;
+		do
+		{
+			func();
+			++ runs;
+		} while (timer.elapsed() < MIN_MEASURE_TIME);
+		double const elapsed = timer.elapsed();
+
+		BenchResult result;
+		result.benchmark = benchmark;
+		result.variant = variant;
+		result.items = items;
+		result.seconds = elapsed / runs;
+#ifdef KLAYGE_BENCH_COUNT_ALLOCS
+		result.allocs = static_cast<double>(num_allocs - allocs_before) / runs;
+		result.alloc_bytes = static_cast<double>(num_alloc_bytes - bytes_before) / runs;
+#else
+		result.allocs = -1;
+		result.alloc_bytes = -1;
+#endif
+		return result;
+	}
+
+	std::string ResultKey(std::string const & benchmark, std::string const & variant, uint32_t items)
+	{
+		std::ostringstream ss;
+		ss << benchmark << ',' << variant << ',' << items;
+		return ss.str();
+	}
+
+	void AddResult(std::vector<BenchResult>& results, BenchResult const & result)
+	{
+		std::cout << std::left << std::setw(16) << result.benchmark << std::setw(12) << result.variant
+			<< std::right << std::setw(8) << result.items
+			<< std::fixed << std::setprecision(4) << std::setw(12) << result.seconds * 1000 << " ms"
+			<< std::setprecision(0) << std::setw(14) << result.items / result.seconds << " items/s";
+		if (result.allocs >= 0)
+		{
+			std::cout << std::setprecision(1) << std::setw(10) << result.allocs << " allocs"
+				<< std::setprecision(1) << std::setw(10) << result.alloc_bytes / 1024 << " KB";
+		}
+		std::cout << std::endl;
+
+		results.push_back(result);
+	}
+
+	void SaveResults(std::vector<BenchResult> const & results, std::string const & file_name)
+	{
+		std::ofstream ofs(file_name.c_str());
+		ofs << "benchmark,variant,items,ms,items_per_sec,allocs,alloc_bytes" << std::endl;
+		ofs << std::fixed << std::setprecision(4);
+		for (size_t i = 0; i < results.size(); ++ i)
+		{
+			BenchResult const & result = results[i];
+			ofs << ResultKey(result.benchmark, result.variant, result.items) << ','
+				<< result.seconds * 1000 << ',' << result.items / result.seconds << ',';
+			if (result.allocs >= 0)
+			{
+				ofs << result.allocs << ',' << result.alloc_bytes;
+			}
+			else
+			{
+				ofs << ',';
+			}
+			ofs << std::endl;
+		}
+	}
+
+	bool LoadBaseline(std::map<std::string, BaselineEntry>& baseline, std::string const & file_name)
+	{
+		std::ifstream ifs(file_name.c_str());
+		if (!ifs)
+		{
+			return false;
+		}
+
+		std::string line;
+		std::getline(ifs, line);
+		while (std::getline(ifs, line))
+		{
+			std::vector<std::string> fields;
+			std::istringstream ss(line);
+			std::string field;
+			while (std::getline(ss, field, ','))
+			{
+				fields.push_back(field);
+			}
+			// The empty allocation fields at the end of the line aren't split out
+			if (fields.size() >= 5)
+			{
+				BaselineEntry entry;
+				entry.ms = std::atof(fields[3].c_str());
+				entry.allocs = ((fields.size() > 5) && !fields[5].empty()) ? std::atof(fields[5].c_str()) : -1;
+				baseline[fields[0] + ',' + fields[1] + ',' + fields[2]] = entry;
+			}
+		}
+
+		return true;
+	}
+
+	// Returns the number of regressions. A benchmark regresses if it's slower than the baseline by more than
+	// the threshold, or if it allocates more where allocations are counted. Benchmarks missing from either side are only reported.
+	uint32_t CompareWithBaseline(std::vector<BenchResult> const & results,
+		std::map<std::string, BaselineEntry> const & baseline, double threshold)
+	{
+		uint32_t num_regressions = 0;
+
+		std::cout << std::endl << "Compared with the baseline, threshold " << threshold * 100 << "%:" << std::endl;
+		for (size_t i = 0; i < results.size(); ++ i)
+		{
+			BenchResult const & result = results[i];
+			std::string const key = ResultKey(result.benchmark, result.variant, result.items);
+			std::cout << std::left << std::setw(16) << result.benchmark << std::setw(12) << result.variant << std::right << std::setw(8) << result.items;
+
+			KLAYGE_AUTO(iter, baseline.find(key));
+			if (iter == baseline.end())
+			{
+				std::cout << "    not in the baseline" << std::endl;
+				continue;
+			}
+
+			double const ms = result.seconds * 1000;
+			double const change = (iter->second.ms > 0) ? (ms / iter->second.ms - 1) : 0;
+			bool const slower = change > threshold;
+			std::cout << std::showpos << std::fixed << std::setprecision(1) << std::setw(10) << change * 100 << "%" << std::noshowpos;
+
+			bool more_allocs = false;
+			if ((result.allocs >= 0) && (iter->second.allocs >= 0))
+			{
+				more_allocs = result.allocs > iter->second.allocs + 0.5;
+				std::cout << std::setw(10) << iter->second.allocs << " -> " << result.allocs << " allocs";
+			}
+			if (slower || more_allocs)
+			{
+				std::cout << "    REGRESSION";
+				++ num_regressions;
+			}
+			std::cout << std::endl;
+		}
+
+		return num_regressions;
+	}
+
+	bool Selected(std::string const & filter, std::string const & benchmark)
+	{
+		return filter.empty() || (benchmark.find(filter) != std::string::npos);
+	}
+
+
+	// Deterministic, so every run generates the same scenes
+	class SceneRandom
+	{
+	public:
+		explicit SceneRandom(uint32_t seed)
+			: state_(seed)
+		{
+		}
+
+		float operator()(float min_val, float max_val)
+		{
+			state_ = state_ * 1664525U + 1013904223U;
+			return min_val + (max_val - min_val) * ((state_ >> 8) / 16777216.0f);
+		}
+
+	private:
+		uint32_t state_;
+	};
+
+	// A mesh without GPU resources. No effects can be loaded without a device, so adding to the render queue
+	// only counts the calls. Everything before it, clipping, grouping and instance assignment, is the real code.
+	class BenchRenderable : public Renderable
+	{
+	public:
+		BenchRenderable(std::wstring const & name, AABBox const & pos_aabb)
+			: name_(name), pos_aabb_(pos_aabb), tc_aabb_(float3(0, 0, 0), float3(1, 1, 0)),
+				num_queued_(0)
+		{
+		}
+
+		virtual RenderLayoutPtr const & GetRenderLayout() const KLAYGE_OVERRIDE
+		{
+			return rl_;
+		}
+		virtual std::wstring const & Name() const KLAYGE_OVERRIDE
+		{
+			return name_;
+		}
+		virtual AABBox const & PosBound() const KLAYGE_OVERRIDE
+		{
+			return pos_aabb_;
+		}
+		virtual AABBox const & TexcoordBound() const KLAYGE_OVERRIDE
+		{
+			return tc_aabb_;
+		}
+
+		virtual void AddToRenderQueue() KLAYGE_OVERRIDE
+		{
+			++ num_queued_;
+		}
+
+		uint32_t NumQueued() const
+		{
+			return num_queued_;
+		}
+
+	private:
+		std::wstring name_;
+		RenderLayoutPtr rl_;
+		AABBox pos_aabb_;
+		AABBox tc_aabb_;
+		uint32_t num_queued_;
+	};
+
+	// Tests every object against the frustum, as a reference for the spatial scene managers
+	class FlatSceneManager : public SceneManager
+	{
+	private:
+		virtual void OnAddSceneObject(SceneObjectPtr const & /*obj*/) KLAYGE_OVERRIDE
+		{
+		}
+		virtual void OnDelSceneObject(SceneObjsType::iterator /*iter*/) KLAYGE_OVERRIDE
+		{
+		}
+		virtual void DoSuspend() KLAYGE_OVERRIDE
+		{
+		}
+		virtual void DoResume() KLAYGE_OVERRIDE
+		{
+		}
+	};
+
+	struct BenchScene
+	{
+		std::vector<RenderablePtr> meshes;
+		std::vector<SceneObjectPtr> objs;
+		std::vector<Sphere> lights;
+		std::vector<SkinnedModelPtr> skinned;
+		std::vector<ParticleSystemPtr> particles;
+	};
+
+	// num_objs objects sharing NUM_MESHES meshes, scattered in a cube around the camera. One in ten moves.
+	// Lights are bounding spheres of point lights, what the lighting passes cull against the scene.
+	void GenerateScene(BenchScene& scene, uint32_t num_objs, uint32_t num_lights, uint32_t num_skinned, uint32_t num_particle_systems)
+	{
+		SceneRandom rand(0x4B47454EU);
+		float const SCENE_SIZE = 500;
+
+		for (uint32_t i = 0; i < NUM_MESHES; ++ i)
+		{
+			float3 const extent(rand(0.5f, 4), rand(0.5f, 4), rand(0.5f, 4));
+			std::wostringstream ss;
+			ss << L"Mesh" << i;
+			scene.meshes.push_back(MakeSharedPtr<BenchRenderable>(ss.str(), AABBox(-extent, extent)));
+		}
+
+		for (uint32_t i = 0; i < num_objs; ++ i)
+		{
+			uint32_t const attr = SceneObject::SOA_Cullable | ((i % 10 == 9) ? SceneObject::SOA_Moveable : 0);
+			SceneObjectPtr so = MakeSharedPtr<SceneObjectHelper>(scene.meshes[i % NUM_MESHES], attr);
+			float const scale = rand(0.5f, 2);
+			so->ModelMatrix(MathLib::scaling(scale, scale, scale)
+				* MathLib::rotation_y(rand(-PI, PI))
+				* MathLib::translation(rand(-SCENE_SIZE, SCENE_SIZE), rand(-SCENE_SIZE / 10, SCENE_SIZE / 10), rand(-SCENE_SIZE, SCENE_SIZE)));
+			so->UpdateAbsModelMatrix();
+			scene.objs.push_back(so);
+		}
+
+		for (uint32_t i = 0; i < num_lights; ++ i)
+		{
+			scene.lights.push_back(Sphere(float3(rand(-SCENE_SIZE, SCENE_SIZE), rand(0, SCENE_SIZE / 10), rand(-SCENE_SIZE, SCENE_SIZE)),
+				rand(5, 50)));
+		}
+
+		// Each skinned model has a binary tree of joints, animated by key frames of random rotations
+		for (uint32_t i = 0; i < num_skinned; ++ i)
+		{
+			std::vector<Joint> joints(NUM_JOINTS);
+			shared_ptr<KeyFramesType> kfs = MakeSharedPtr<KeyFramesType>(NUM_JOINTS);
+			for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+			{
+				Joint& joint = joints[j];
+				std::ostringstream ss;
+				ss << "Joint" << j;
+				joint.name = ss.str();
+				joint.parent = (0 == j) ? -1 : static_cast<int16_t>((j - 1) / 2);
+
+				KeyFrames& kf = (*kfs)[j];
+				for (uint32_t f = 0; f < NUM_KEY_FRAMES; ++ f)
+				{
+					Quaternion const rot = MathLib::rotation_axis(MathLib::normalize(float3(rand(-1, 1), rand(-1, 1), rand(0.1f, 1))),
+						rand(-PI / 4, PI / 4));
+					kf.frame_id.push_back(f * 4);
+					kf.bind_real.push_back(rot);
+					kf.bind_dual.push_back(MathLib::quat_trans_to_udq(rot, float3(0, (0 == j) ? 0 : 0.5f, 0)));
+					kf.bind_scale.push_back(1);
+				}
+
+				joint.bind_real = kf.bind_real[0];
+				joint.bind_dual = kf.bind_dual[0];
+				joint.bind_scale = 1;
+				joint.inverse_origin_real = Quaternion::Identity();
+				joint.inverse_origin_dual = Quaternion(0, 0, 0, 0);
+				joint.inverse_origin_scale = 1;
+			}
+
+			SkinnedModelPtr model = MakeSharedPtr<SkinnedModel>(L"Skinned");
+			model->AssignJoints(joints.begin(), joints.end());
+			model->AttachKeyFrames(kfs);
+			model->NumFrames(NUM_KEY_FRAMES * 4);
+			model->FrameRate(30);
+			scene.skinned.push_back(model);
+		}
+
+		for (uint32_t i = 0; i < num_particle_systems; ++ i)
+		{
+			ParticleSystemPtr ps = MakeSharedPtr<ParticleSystem>(NUM_PARTICLES, true);
+
+			ParticleEmitterPtr emitter = ps->MakeEmitter("point");
+			emitter->ModelMatrix(MathLib::translation(rand(-50, 50), 0.0f, rand(10, 100)));
+			emitter->Frequency(1200);
+			emitter->EmitAngle(PI / 3);
+			emitter->MinPosition(float3(-0.1f, 0, -0.1f));
+			emitter->MaxPosition(float3(+0.1f, 0, +0.1f));
+			emitter->MinVelocity(1);
+			emitter->MaxVelocity(2);
+			emitter->MinLife(2);
+			emitter->MaxLife(3);
+			emitter->MinSpin(-PI / 2);
+			emitter->MaxSpin(+PI / 2);
+			emitter->MinSize(0.1f);
+			emitter->MaxSize(0.2f);
+			ps->AddEmitter(emitter);
+
+			ParticleUpdaterPtr updater = ps->MakeUpdater("polyline");
+			std::vector<float2> ctrl_pts;
+			ctrl_pts.push_back(float2(0, 1));
+			ctrl_pts.push_back(float2(0.5f, 0.8f));
+			ctrl_pts.push_back(float2(1, 0));
+			checked_pointer_cast<PolylineParticleUpdater>(updater)->SizeOverLife(ctrl_pts);
+			checked_pointer_cast<PolylineParticleUpdater>(updater)->MassOverLife(ctrl_pts);
+			checked_pointer_cast<PolylineParticleUpdater>(updater)->OpacityOverLife(ctrl_pts);
+			ps->AddUpdater(updater);
+
+			scene.particles.push_back(ps);
+		}
+	}
+
+
+	void AddObjects(SceneManager* sm, std::vector<SceneObjectPtr> const * objs)
+	{
+		sm->ClearObject();
+		for (size_t i = 0; i < objs->size(); ++ i)
+		{
+			sm->AddSceneObject((*objs)[i]);
+		}
+	}
+
+	void ClipScene(SceneManager* sm, Camera const * camera)
+	{
+		sm->ClipScene(*camera);
+	}
+
+	// Removing and adding back a static object makes a spatial scene manager rebuild its tree in the next clip
+	void RebuildAndClipScene(SceneManager* sm, SceneObjectPtr const * obj, Camera const * camera)
+	{
+		sm->DelSceneObject(*obj);
+		sm->AddSceneObject(*obj);
+		sm->ClipScene(*camera);
+	}
+
+	void CullLights(SceneManager* sm, std::vector<Sphere> const * lights, uint32_t* num_visible)
+	{
+		*num_visible = 0;
+		for (size_t i = 0; i < lights->size(); ++ i)
+		{
+			if (sm->SphereVisible((*lights)[i]) != BO_No)
+			{
+				++ *num_visible;
+			}
+		}
+	}
+
+	void BuildRenderQueue(SceneManager* sm, Camera const * camera)
+	{
+		sm->BuildRenderQueue(*camera, App3DFramework::URV_NeedFlush);
+	}
+
+	void BuildBones(std::vector<SkinnedModelPtr> const * models, float* frame)
+	{
+		*frame += 0.37f;
+		for (size_t i = 0; i < models->size(); ++ i)
+		{
+			(*models)[i]->SetFrame(*frame);
+		}
+	}
+
+	void UpdateParticles(std::vector<ParticleSystemPtr> const * systems, float4x4 const * view)
+	{
+		for (size_t i = 0; i < systems->size(); ++ i)
+		{
+			(*systems)[i]->UpdateParticles(1.0f / 60, *view);
+		}
+	}
+
+	void BenchSceneManager(std::vector<BenchResult>& results, std::string const & filter, std::string const & name,
+		SceneManager& sm, BenchScene const & scene, Camera const & camera)
+	{
+		uint32_t const num_objs = static_cast<uint32_t>(scene.objs.size());
+
+		if (Selected(filter, "AddObjects"))
+		{
+			AddResult(results, Measure("AddObjects", name, num_objs,
+				KlayGE::bind(AddObjects, &sm, &scene.objs)));
+		}
+
+		AddObjects(&sm, &scene.objs);
+
+		if (Selected(filter, "ClipScene"))
+		{
+			AddResult(results, Measure("ClipScene", name, num_objs,
+				KlayGE::bind(ClipScene, &sm, &camera)));
+			AddResult(results, Measure("ClipScene", name + "_rebuild", num_objs,
+				KlayGE::bind(RebuildAndClipScene, &sm, &scene.objs[0], &camera)));
+		}
+
+		if (Selected(filter, "LightCull") && !scene.lights.empty())
+		{
+			sm.ClipScene(camera);
+			uint32_t num_visible;
+			AddResult(results, Measure("LightCull", name, static_cast<uint32_t>(scene.lights.size()),
+				KlayGE::bind(CullLights, &sm, &scene.lights, &num_visible)));
+		}
+
+		if (Selected(filter, "RenderQueue"))
+		{
+			AddResult(results, Measure("RenderQueue", name, num_objs,
+				KlayGE::bind(BuildRenderQueue, &sm, &camera)));
+		}
+
+		sm.ClearObject();
+	}
+
+
+	void GenerateXML(std::string& xml)
+	{
+		XMLDocument doc;
+		XMLNodePtr root = doc.AllocNode(XNT_Element, "effect");
+		doc.RootNode(root);
+
+		for (uint32_t i = 0; i < NUM_XML_TECHS; ++ i)
+		{
+			std::ostringstream ss;
+			ss << "param" << i;
+			XMLNodePtr param = doc.AllocNode(XNT_Element, "parameter");
+			param->AppendAttrib(doc.AllocAttribString("type", "float4x4"));
+			param->AppendAttrib(doc.AllocAttribString("name", ss.str()));
+			root->AppendNode(param);
+		}
+		for (uint32_t i = 0; i < NUM_XML_TECHS; ++ i)
+		{
+			std::ostringstream ss;
+			ss << "Tech" << i;
+			XMLNodePtr tech = doc.AllocNode(XNT_Element, "technique");
+			tech->AppendAttrib(doc.AllocAttribString("name", ss.str()));
+			for (uint32_t p = 0; p < 2; ++ p)
+			{
+				XMLNodePtr pass = doc.AllocNode(XNT_Element, "pass");
+				pass->AppendAttrib(doc.AllocAttribUInt("index", p));
+				char const * states[] = { "cull_mode", "depth_enable", "blend_enable", "vertex_shader", "pixel_shader" };
+				char const * values[] = { "back", "true", "false", "MeshVS()", "MeshPS()" };
+				for (size_t s = 0; s < sizeof(states) / sizeof(states[0]); ++ s)
+				{
+					XMLNodePtr state = doc.AllocNode(XNT_Element, "state");
+					state->AppendAttrib(doc.AllocAttribString("name", states[s]));
+					state->AppendAttrib(doc.AllocAttribString("value", values[s]));
+					pass->AppendNode(state);
+				}
+				tech->AppendNode(pass);
+			}
+			root->AppendNode(tech);
+		}
+
+		std::ostringstream os;
+		doc.Print(os);
+		xml = os.str();
+	}
+
+	uint32_t CountNodes(XMLNodePtr const & node)
+	{
+		uint32_t num = 1;
+		for (XMLNodePtr child = node->FirstNode(); child; child = child->NextSibling())
+		{
+			num += CountNodes(child);
+		}
+		return num;
+	}
+
+	void ParseXML(ResIdentifierPtr const * source, uint32_t* num_nodes)
+	{
+		(*source)->clear();
+		(*source)->seekg(0, std::ios_base::beg);
+
+		XMLDocument doc;
+		XMLNodePtr root = doc.Parse(*source);
+		*num_nodes = CountNodes(root);
+	}
+
+	void BenchXML(std::vector<BenchResult>& results)
+	{
+		std::string xml;
+		GenerateXML(xml);
+		ResIdentifierPtr source = MakeSharedPtr<ResIdentifier>("bench.fxml", 0, MakeSharedPtr<std::stringstream>(xml));
+
+		uint32_t num_nodes;
+		AddResult(results, Measure("XMLParse", "effect", static_cast<uint32_t>(xml.size()),
+			KlayGE::bind(ParseXML, &source, &num_nodes)));
+	}
+
+
+	class BenchLoadingDesc : public ResLoadingDesc
+	{
+	public:
+		explicit BenchLoadingDesc(std::string const & name)
+			: name_(name)
+		{
+		}
+
+		uint64_t Type() const
+		{
+			static uint64_t const type = CT_HASH("BenchLoadingDesc");
+			return type;
+		}
+
+		bool StateLess() const
+		{
+			return true;
+		}
+
+		void SubThreadStage()
+		{
+		}
+
+		shared_ptr<void> MainThreadStage()
+		{
+			return MakeSharedPtr<std::string>(name_);
+		}
+
+		bool HasSubThreadStage() const
+		{
+			return false;
+		}
+
+		bool Match(ResLoadingDesc const & rhs) const
+		{
+			if (this->Type() == rhs.Type())
+			{
+				BenchLoadingDesc const & bld = static_cast<BenchLoadingDesc const &>(rhs);
+				return name_ == bld.name_;
+			}
+			return false;
+		}
+
+		void CopyDataFrom(ResLoadingDesc const & rhs)
+		{
+			BOOST_ASSERT(this->Type() == rhs.Type());
+
+			BenchLoadingDesc const & bld = static_cast<BenchLoadingDesc const &>(rhs);
+			name_ = bld.name_;
+		}
+
+		shared_ptr<void> CloneResourceFrom(shared_ptr<void> const & resource)
+		{
+			return resource;
+		}
+
+	private:
+		std::string name_;
+	};
+
+	void LocateResources(std::vector<std::string> const * names)
+	{
+		for (size_t i = 0; i < names->size(); ++ i)
+		{
+			ResLoader::Instance().Locate((*names)[i]);
+		}
+	}
+
+	void QueryResources(std::vector<ResLoadingDescPtr> const * descs)
+	{
+		for (size_t i = 0; i < descs->size(); ++ i)
+		{
+			ResLoader::Instance().SyncQuery((*descs)[i]);
+		}
+	}
+
+	void BenchResLoader(std::vector<BenchResult>& results)
+	{
+		std::vector<std::string> found_names;
+		found_names.push_back("Lenna.dds");
+		found_names.push_back("memorial.dds");
+		std::vector<std::string> missing_names;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			std::ostringstream ss;
+			ss << "missing_" << i << ".dds";
+			missing_names.push_back(ss.str());
+		}
+
+		AddResult(results, Measure("ResLoader", "locate", static_cast<uint32_t>(found_names.size()),
+			KlayGE::bind(LocateResources, &found_names)));
+		AddResult(results, Measure("ResLoader", "locate_miss", static_cast<uint32_t>(missing_names.size()),
+			KlayGE::bind(LocateResources, &missing_names)));
+
+		// Queries of loaded resources, with NUM_RESOURCES of them kept alive
+		std::vector<ResLoadingDescPtr> descs;
+		std::vector<shared_ptr<void> > resources;
+		for (uint32_t i = 0; i < NUM_RESOURCES; ++ i)
+		{
+			std::ostringstream ss;
+			ss << "res_" << i;
+			descs.push_back(MakeSharedPtr<BenchLoadingDesc>(ss.str()));
+			resources.push_back(ResLoader::Instance().SyncQuery(descs.back()));
+		}
+
+		AddResult(results, Measure("ResLoader", "query", NUM_RESOURCES,
+			KlayGE::bind(QueryResources, &descs)));
+	}
+
+
+	// The inputs and outputs of the batch math, per-element loops are measured against the batch functions
+	struct MathData
+	{
+		std::vector<float3> points;
+		std::vector<AABBox> boxes;
+		std::vector<float4x4> mats;
+		std::vector<float4x4> rhs_mats;
+		float4x4 mat;
+
+		std::vector<float3> out_points;
+		std::vector<AABBox> out_boxes;
+		std::vector<float4x4> out_mats;
+	};
+
+	void TransformCoordScalar(MathData* data)
+	{
+		for (size_t i = 0; i < data->points.size(); ++ i)
+		{
+			data->out_points[i] = MathLib::transform_coord(data->points[i], data->mat);
+		}
+	}
+
+	void TransformCoordBatch(MathData* data)
+	{
+		MathLib::transform_coord(&data->out_points[0], &data->points[0], data->points.size(), data->mat);
+	}
+
+	void TransformAABBScalar(MathData* data)
+	{
+		for (size_t i = 0; i < data->boxes.size(); ++ i)
+		{
+			data->out_boxes[i] = MathLib::transform_aabb(data->boxes[i], data->mat);
+		}
+	}
+
+	void TransformAABBBatch(MathData* data)
+	{
+		MathLib::transform_aabb(&data->out_boxes[0], &data->boxes[0], data->boxes.size(), data->mat);
+	}
+
+	void MulScalar(MathData* data)
+	{
+		for (size_t i = 0; i < data->mats.size(); ++ i)
+		{
+			data->out_mats[i] = MathLib::mul(data->mats[i], data->rhs_mats[i]);
+		}
+	}
+
+	void MulBatch(MathData* data)
+	{
+		MathLib::mul(&data->out_mats[0], &data->mats[0], &data->rhs_mats[0], data->mats.size());
+	}
+
+	void BenchMath(std::vector<BenchResult>& results)
+	{
+		MathData data;
+		data.mat = MathLib::translation(1.0f, 2.0f, 3.0f) * MathLib::perspective_fov_lh(PI / 4, 16.0f / 9, 1.0f, 1000.0f);
+		data.points.resize(NUM_MATH_ITEMS);
+		data.boxes.resize(NUM_MATH_ITEMS);
+		data.mats.resize(NUM_MATH_ITEMS);
+		data.rhs_mats.assign(NUM_MATH_ITEMS, data.mat);
+		for (uint32_t i = 0; i < NUM_MATH_ITEMS; ++ i)
+		{
+			data.points[i] = float3(i * 0.01f, 1 - i * 0.02f, i * 0.03f);
+			data.boxes[i] = AABBox(data.points[i], data.points[i] + float3(1, 2, 3));
+			data.mats[i] = MathLib::rotation_y(i * 0.001f);
+		}
+		data.out_points.resize(NUM_MATH_ITEMS);
+		data.out_boxes.resize(NUM_MATH_ITEMS);
+		data.out_mats.resize(NUM_MATH_ITEMS);
+
+		AddResult(results, Measure("Math", "coord", NUM_MATH_ITEMS, KlayGE::bind(TransformCoordScalar, &data)));
+		AddResult(results, Measure("Math", "coord_batch", NUM_MATH_ITEMS, KlayGE::bind(TransformCoordBatch, &data)));
+		AddResult(results, Measure("Math", "aabb", NUM_MATH_ITEMS, KlayGE::bind(TransformAABBScalar, &data)));
+		AddResult(results, Measure("Math", "aabb_batch", NUM_MATH_ITEMS, KlayGE::bind(TransformAABBBatch, &data)));
+		AddResult(results, Measure("Math", "mul", NUM_MATH_ITEMS, KlayGE::bind(MulScalar, &data)));
+		AddResult(results, Measure("Math", "mul_batch", NUM_MATH_ITEMS, KlayGE::bind(MulBatch, &data)));
+	}
+
+	bool ParseUInt(int argc, char* argv[], int& i, uint32_t& value)
+	{
+		if (i + 1 < argc)
+		{
+			++ i;
+			value = static_cast<uint32_t>(std::atoi(argv[i]));
+			return true;
+		}
+		return false;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string out_file = "EngineBench.csv";
+	std::string baseline_file;
+	std::string filter;
+	double threshold = 0.1;
+	uint32_t num_objs = 10000;
+	uint32_t num_lights = 256;
+	uint32_t num_skinned = 64;
+	uint32_t num_particle_systems = 8;
+
+	for (int i = 1; i < argc; ++ i)
+	{
+		std::string const arg = argv[i];
+		bool valid = true;
+		if (("-o" == arg) && (i + 1 < argc))
+		{
+			out_file = argv[++ i];
+		}
+		else if (("-b" == arg) && (i + 1 < argc))
+		{
+			baseline_file = argv[++ i];
+		}
+		else if (("-f" == arg) && (i + 1 < argc))
+		{
+			filter = argv[++ i];
+		}
+		else if (("-t" == arg) && (i + 1 < argc))
+		{
+			threshold = std::atof(argv[++ i]) / 100;
+		}
+		else if ("-n" == arg)
+		{
+			valid = ParseUInt(argc, argv, i, num_objs);
+		}
+		else if ("-l" == arg)
+		{
+			valid = ParseUInt(argc, argv, i, num_lights);
+		}
+		else if ("-k" == arg)
+		{
+			valid = ParseUInt(argc, argv, i, num_skinned);
+		}
+		else if ("-p" == arg)
+		{
+			valid = ParseUInt(argc, argv, i, num_particle_systems);
+		}
+		else
+		{
+			valid = false;
+		}
+
+		if (!valid || (0 == num_objs))
+		{
+			std::cout << "Usage: EngineBench [-o results.csv] [-b baseline.csv] [-t threshold%] [-f filter]" << std::endl;
+			std::cout << "\t[-n objects] [-l lights] [-k skinned models] [-p particle systems]" << std::endl;
+			std::cout << "\tRuns the benchmarks whose names contain the filter on a synthetic scene, and saves the results as CSV." << std::endl;
+			std::cout << "\tWith a baseline, returns non-zero if a benchmark is slower by more than the threshold, or allocates more." << std::endl;
+			return ("-h" == arg) || ("--help" == arg) ? 0 : 1;
+		}
+	}
+
+	ResLoader::Instance().AddPath("../../Tests/media");
+	Context::Instance().LoadCfg("KlayGE.cfg");
+
+	std::vector<BenchResult> results;
+
+	{
+		// Cameras only need the render factory for the projection conventions, no window or device is created
+		Camera camera;
+		camera.ViewParams(float3(0, 10, -20), float3(0, 0, 100));
+		camera.ProjParams(PI / 4, 16.0f / 9, 1, 1000);
+
+		BenchScene scene;
+		GenerateScene(scene, num_objs, num_lights, num_skinned, num_particle_systems);
+
+		{
+			FlatSceneManager flat;
+			BenchSceneManager(results, filter, "flat", flat, scene, camera);
+		}
+
+		Context::Instance().LoadSceneManager("OCTree");
+		if (Context::Instance().SceneManagerValid())
+		{
+			BenchSceneManager(results, filter, "octree", Context::Instance().SceneManagerInstance(), scene, camera);
+		}
+		else
+		{
+			std::cout << "Couldn't load the OCTree scene manager. Skipped." << std::endl;
+		}
+
+		if (Selected(filter, "BuildBones") && !scene.skinned.empty())
+		{
+			float frame = 0;
+			AddResult(results, Measure("BuildBones", "", static_cast<uint32_t>(scene.skinned.size() * NUM_JOINTS),
+				KlayGE::bind(BuildBones, &scene.skinned, &frame)));
+		}
+
+		if (Selected(filter, "Particles") && !scene.particles.empty())
+		{
+			// Runs the systems for a few seconds first, to have them full
+			float4x4 const & view = camera.ViewMatrix();
+			for (int i = 0; i < 240; ++ i)
+			{
+				UpdateParticles(&scene.particles, &view);
+			}
+
+			AddResult(results, Measure("Particles", "update", static_cast<uint32_t>(scene.particles.size() * NUM_PARTICLES),
+				KlayGE::bind(UpdateParticles, &scene.particles, &view)));
+		}
+	}
+
+	if (Selected(filter, "XMLParse"))
+	{
+		BenchXML(results);
+	}
+
+	if (Selected(filter, "ResLoader"))
+	{
+		BenchResLoader(results);
+	}
+
+	if (Selected(filter, "Math"))
+	{
+		BenchMath(results);
+	}
+
+	SaveResults(results, out_file);
+	std::cout << "Results are saved to " << out_file << std::endl;
+
+	int ret = 0;
+	if (!baseline_file.empty())
+	{
+		std::map<std::string, BaselineEntry> baseline;
+		if (LoadBaseline(baseline, baseline_file))
+		{
+			if (CompareWithBaseline(results, baseline, threshold) > 0)
+			{
+				ret = 1;
+			}
+		}
+		else
+		{
+			std::cout << "Couldn't open the baseline " << baseline_file << "." << std::endl;
+			ret = 1;
+		}
+	}
+
+	Context::Destroy();
+
+	return ret;
+}
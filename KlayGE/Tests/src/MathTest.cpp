@@ -1,5 +1,7 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/Half.hpp>
+#include <KFL/FormatConversion.hpp>
 
 #include <boost/assert.hpp>
 #include <boost/test/unit_test.hpp>
@@ -7,6 +9,7 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 using namespace KlayGE;
@@ -31,3 +34,219 @@ BOOST_AUTO_TEST_CASE(NormalizeFloat4)
 	v = MathLib::normalize(v);
 	BOOST_CHECK(MathLib::abs(MathLib::length(v) - 1.0f) < 1e-5f);
 }
+
+BOOST_AUTO_TEST_CASE(HalfFloatArray)
+{
+	// Long enough for the SIMD loops, plus an odd tail
+	float const special[] = { 0.0f, -0.0f, 1.0f, -2.5f, HALF_MAX, HALF_MIN, HALF_NRM_MIN, 1e10f, -1e10f };
+	std::vector<float> src;
+	for (size_t i = 0; i < sizeof(special) / sizeof(special[0]); ++ i)
+	{
+		src.push_back(special[i]);
+	}
+	for (int i = 0; i < 30; ++ i)
+	{
+		src.push_back((i - 15) * 0.37f);
+	}
+
+	std::vector<half> h(src.size());
+	std::vector<float> dst(src.size());
+	FloatToHalf(&h[0], &src[0], src.size());
+	HalfToFloat(&dst[0], &h[0], h.size());
+	for (size_t i = 0; i < src.size(); ++ i)
+	{
+		BOOST_CHECK_EQUAL(dst[i], static_cast<float>(h[i]));
+		if (MathLib::abs(src[i]) <= HALF_MAX)
+		{
+			BOOST_CHECK(MathLib::abs(dst[i] - src[i]) <= MathLib::abs(src[i]) * HALF_EPSILON + HALF_MIN);
+		}
+	}
+	BOOST_CHECK(dst[7] > HALF_MAX);
+	BOOST_CHECK(dst[8] < -HALF_MAX);
+}
+
+BOOST_AUTO_TEST_CASE(NormArray)
+{
+	std::vector<float> src;
+	for (int i = 0; i < 53; ++ i)
+	{
+		src.push_back(i / 26.0f - 1.2f);
+	}
+
+	std::vector<uint8_t> u8(src.size());
+	std::vector<int8_t> s8(src.size());
+	std::vector<uint16_t> u16(src.size());
+	std::vector<uint8_t> srgb(src.size());
+	FloatToUNorm8(&u8[0], &src[0], src.size());
+	FloatToSNorm8(&s8[0], &src[0], src.size());
+	FloatToUNorm16(&u16[0], &src[0], src.size());
+	LinearToSRGB8(&srgb[0], &src[0], src.size());
+	for (size_t i = 0; i < src.size(); ++ i)
+	{
+		BOOST_CHECK_EQUAL(u8[i], MathLib::clamp(static_cast<int>(src[i] * 255.0f + 0.5f), 0, 255));
+		BOOST_CHECK_EQUAL(s8[i], MathLib::clamp(static_cast<int>(src[i] * 127.0f + 0.5f), -127, 127));
+		BOOST_CHECK_EQUAL(u16[i], MathLib::clamp(static_cast<int>(src[i] * 65535.0f + 0.5f), 0, 65535));
+		BOOST_CHECK_EQUAL(srgb[i], MathLib::clamp(static_cast<int>(MathLib::linear_to_srgb(src[i]) * 255.0f + 0.5f), 0, 255));
+	}
+
+	std::vector<uint8_t> all(256);
+	for (int i = 0; i < 256; ++ i)
+	{
+		all[i] = static_cast<uint8_t>(i);
+	}
+	std::vector<float> dst(all.size());
+	UNorm8ToFloat(&dst[0], &all[0], all.size());
+	for (int i = 0; i < 256; ++ i)
+	{
+		BOOST_CHECK_EQUAL(dst[i], i / 255.0f);
+	}
+	SRGB8ToLinear(&dst[0], &all[0], all.size());
+	for (int i = 0; i < 256; ++ i)
+	{
+		BOOST_CHECK_EQUAL(dst[i], MathLib::srgb_to_linear(i / 255.0f));
+	}
+}
+
+namespace
+{
+	float4x4 TestMatrix()
+	{
+		return MathLib::scaling(1.5f, -2.0f, 0.5f) * MathLib::rotation_y(0.7f) * MathLib::rotation_x(-0.3f)
+			* MathLib::translation(3.0f, -1.0f, 2.0f);
+	}
+
+	float4x4 TestProjMatrix()
+	{
+		return TestMatrix() * MathLib::perspective_fov_lh(1.0f, 1.3f, 0.1f, 100.0f);
+	}
+
+	bool Near(float3 const & lhs, float3 const & rhs)
+	{
+		return MathLib::length(lhs - rhs) <= 1e-4f * std::max(1.0f, MathLib::length(rhs));
+	}
+
+	bool Near(Quaternion const & lhs, Quaternion const & rhs)
+	{
+		return MathLib::length(lhs - rhs) <= 1e-5f;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BatchTransformCoord)
+{
+	// Includes w == 0 points for the projection, and an odd tail
+	std::vector<float3> src;
+	for (int i = 0; i < 23; ++ i)
+	{
+		src.push_back(float3(i * 0.7f - 5, 3 - i * 0.3f, i * 1.1f - 0.1f));
+	}
+	src.push_back(float3(1, 2, 0));
+
+	float4x4 const mats[] = { TestMatrix(), TestProjMatrix() };
+	for (size_t m = 0; m < sizeof(mats) / sizeof(mats[0]); ++ m)
+	{
+		std::vector<float3> dst(src.size());
+		MathLib::transform_coord(&dst[0], &src[0], src.size(), mats[m]);
+		std::vector<float3> normals(src.size());
+		MathLib::transform_normal(&normals[0], &src[0], src.size(), mats[m]);
+		for (size_t i = 0; i < src.size(); ++ i)
+		{
+			BOOST_CHECK(Near(dst[i], MathLib::transform_coord(src[i], mats[m])));
+			BOOST_CHECK(Near(normals[i], MathLib::transform_normal(src[i], mats[m])));
+		}
+	}
+
+	// In place
+	std::vector<float3> dst(src);
+	MathLib::transform_coord(&dst[0], &dst[0], dst.size(), TestMatrix());
+	for (size_t i = 0; i < src.size(); ++ i)
+	{
+		BOOST_CHECK(Near(dst[i], MathLib::transform_coord(src[i], TestMatrix())));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BatchTransformAABB)
+{
+	std::vector<AABBox> src;
+	for (int i = 0; i < 11; ++ i)
+	{
+		float3 const center(i * 1.3f - 7, i * 0.2f, 4 - i * 0.9f);
+		float3 const half_size(0.5f + i * 0.1f, 1.0f, 2.0f - i * 0.1f);
+		src.push_back(AABBox(center - half_size, center + half_size));
+	}
+
+	std::vector<AABBox> dst(src.size());
+	MathLib::transform_aabb(&dst[0], &src[0], src.size(), TestMatrix());
+	for (size_t i = 0; i < src.size(); ++ i)
+	{
+		AABBox const ref = MathLib::transform_aabb(src[i], TestMatrix());
+		BOOST_CHECK(Near(dst[i].Min(), ref.Min()));
+		BOOST_CHECK(Near(dst[i].Max(), ref.Max()));
+	}
+
+	std::vector<float4x4> mats;
+	for (size_t i = 0; i < src.size(); ++ i)
+	{
+		mats.push_back(TestMatrix() * MathLib::rotation_y(i * 0.3f) * MathLib::translation(1.0f, -2.0f, i * 0.5f));
+	}
+	MathLib::transform_aabb(&dst[0], &src[0], &mats[0], src.size());
+	for (size_t i = 0; i < src.size(); ++ i)
+	{
+		AABBox const ref = MathLib::transform_aabb(src[i], mats[i]);
+		BOOST_CHECK(Near(dst[i].Min(), ref.Min()));
+		BOOST_CHECK(Near(dst[i].Max(), ref.Max()));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BatchMul)
+{
+	std::vector<float4x4> lhs, rhs;
+	for (int i = 0; i < 7; ++ i)
+	{
+		lhs.push_back(TestMatrix() * MathLib::rotation_z(i * 0.4f));
+		rhs.push_back(MathLib::translation(i * 1.0f, 2.0f, -3.0f) * TestProjMatrix());
+	}
+
+	std::vector<float4x4> dst(lhs.size());
+	MathLib::mul(&dst[0], &lhs[0], &rhs[0], lhs.size());
+	for (size_t i = 0; i < lhs.size(); ++ i)
+	{
+		BOOST_CHECK(dst[i] == MathLib::mul(lhs[i], rhs[i]));
+	}
+
+	// In place, as in concatenating a chain of transforms
+	MathLib::mul(&lhs[0], &lhs[0], &rhs[0], lhs.size());
+	BOOST_CHECK(std::equal(lhs.begin(), lhs.end(), dst.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(UDQBlend)
+{
+	Quaternion const rot0 = MathLib::rotation_axis(float3(0, 1, 0), 0.5f);
+	Quaternion const rot1 = MathLib::rotation_axis(float3(1, 0, 1), 1.2f);
+	float3 const trans0(1, 2, 3);
+	float3 const trans1(-2, 0, 1);
+
+	Quaternion reals[] = { rot0, -rot1 };
+	Quaternion duals[] = { MathLib::quat_trans_to_udq(rot0, trans0), -MathLib::quat_trans_to_udq(rot1, trans1) };
+
+	// A single one gives itself back
+	float const one = 1;
+	std::pair<Quaternion, Quaternion> dq = MathLib::udq_blend(reals, duals, &one, 1);
+	BOOST_CHECK(Near(dq.first, rot0));
+	BOOST_CHECK(Near(MathLib::udq_to_trans(dq.first, dq.second), trans0));
+
+	// The second one is in the other hemisphere, and gets flipped back
+	float const weights[] = { 0.25f, 0.75f };
+	dq = MathLib::udq_blend(reals, duals, weights, 2);
+	Quaternion const real = MathLib::normalize(rot0 * 0.25f + rot1 * 0.75f);
+	BOOST_CHECK(Near(dq.first, real));
+
+	std::pair<Quaternion, Quaternion> const lerp = MathLib::sclerp(rot0, duals[0], rot1, -duals[1], 0.75f);
+	BOOST_CHECK(MathLib::abs(MathLib::dot(dq.first, lerp.first)) > 0.99f);
+
+	// The same transform from both hemispheres
+	reals[1] = -rot0;
+	duals[1] = -duals[0];
+	dq = MathLib::udq_blend(reals, duals, weights, 2);
+	BOOST_CHECK(Near(dq.first, rot0));
+	BOOST_CHECK(Near(MathLib::udq_to_trans(dq.first, dq.second), trans0));
+}
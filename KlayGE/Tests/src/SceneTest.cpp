@@ -0,0 +1,207 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Renderable.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KlayGE/ParticleSystem.hpp>
+
+#include <boost/assert.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Runs the pipelined update by hand, without a device or an app. The current frame is culled
+	// while the next one is updated on the thread pool, the same as SceneManager::Update does.
+	class PipelinedSceneManager : public SceneManager
+	{
+	public:
+		void Frame(Camera const & camera, float app_time, float frame_time)
+		{
+			this->PipelinedMode(true);
+
+			KlayGE::shared_ptr<joiner<void> > update = this->BeginPipelinedUpdate(app_time, frame_time);
+			this->ClipScene(camera);
+			this->EndPipelinedUpdate(*update, app_time, frame_time);
+
+			KLAYGE_FOREACH(SceneObjsType::const_reference scene_obj, scene_objs_)
+			{
+				scene_obj->MainThreadUpdate(app_time, frame_time);
+			}
+		}
+
+	private:
+		virtual void OnAddSceneObject(SceneObjectPtr const & /*obj*/) KLAYGE_OVERRIDE
+		{
+		}
+		virtual void OnDelSceneObject(SceneObjsType::iterator /*iter*/) KLAYGE_OVERRIDE
+		{
+		}
+		virtual void DoSuspend() KLAYGE_OVERRIDE
+		{
+		}
+		virtual void DoResume() KLAYGE_OVERRIDE
+		{
+		}
+	};
+
+	class BoxRenderable : public Renderable
+	{
+	public:
+		explicit BoxRenderable(AABBox const & pos_aabb)
+			: name_(L"Box"), pos_aabb_(pos_aabb), tc_aabb_(float3(0, 0, 0), float3(1, 1, 0))
+		{
+		}
+
+		virtual RenderLayoutPtr const & GetRenderLayout() const KLAYGE_OVERRIDE
+		{
+			return rl_;
+		}
+		virtual std::wstring const & Name() const KLAYGE_OVERRIDE
+		{
+			return name_;
+		}
+		virtual AABBox const & PosBound() const KLAYGE_OVERRIDE
+		{
+			return pos_aabb_;
+		}
+		virtual AABBox const & TexcoordBound() const KLAYGE_OVERRIDE
+		{
+			return tc_aabb_;
+		}
+
+	private:
+		std::wstring name_;
+		RenderLayoutPtr rl_;
+		AABBox pos_aabb_;
+		AABBox tc_aabb_;
+	};
+
+	void MoveObject(SceneObject& obj, float /*app_time*/, float elapsed_time)
+	{
+		obj.ModelMatrix(obj.ModelMatrix() * MathLib::translation(elapsed_time, 0.0f, 0.0f));
+	}
+
+	void SpawnObject(SceneObject& /*obj*/, float /*app_time*/, float /*elapsed_time*/, RenderablePtr const & renderable, bool* spawned)
+	{
+		if (!*spawned)
+		{
+			SceneObjectPtr so = MakeSharedPtr<SceneObjectHelper>(renderable, SceneObject::SOA_Cullable);
+			so->AddToSceneManagerLocked();
+			*spawned = true;
+		}
+	}
+
+	ParticleSystemPtr MakeParticleSystem(float3 const & pos)
+	{
+		ParticleSystemPtr ps = MakeSharedPtr<ParticleSystem>(1024, true);
+
+		ParticleEmitterPtr emitter = ps->MakeEmitter("point");
+		emitter->ModelMatrix(MathLib::translation(pos));
+		emitter->Frequency(1200);
+		emitter->EmitAngle(PI / 3);
+		emitter->MinPosition(float3(-0.1f, 0, -0.1f));
+		emitter->MaxPosition(float3(+0.1f, 0, +0.1f));
+		emitter->MinVelocity(1);
+		emitter->MaxVelocity(2);
+		emitter->MinLife(2);
+		emitter->MaxLife(3);
+		emitter->MinSpin(-PI / 2);
+		emitter->MaxSpin(+PI / 2);
+		emitter->MinSize(0.1f);
+		emitter->MaxSize(0.2f);
+		ps->AddEmitter(emitter);
+
+		ParticleUpdaterPtr updater = ps->MakeUpdater("polyline");
+		std::vector<float2> ctrl_pts;
+		ctrl_pts.push_back(float2(0, 1));
+		ctrl_pts.push_back(float2(1, 0));
+		checked_pointer_cast<PolylineParticleUpdater>(updater)->SizeOverLife(ctrl_pts);
+		checked_pointer_cast<PolylineParticleUpdater>(updater)->MassOverLife(ctrl_pts);
+		checked_pointer_cast<PolylineParticleUpdater>(updater)->OpacityOverLife(ctrl_pts);
+		ps->AddUpdater(updater);
+
+		return ps;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(PipelinedSceneUpdate)
+{
+	KlayGE::shared_ptr<PipelinedSceneManager> sm = MakeSharedPtr<PipelinedSceneManager>();
+	Context::Instance().SceneManagerInstance(sm);
+
+	Camera camera;
+	camera.ViewParams(float3(0, 10, -20), float3(0, 0, 100));
+	camera.ProjParams(PI / 4, 16.0f / 9, 1, 1000);
+
+	RenderablePtr box = MakeSharedPtr<BoxRenderable>(AABBox(float3(-1, -1, -1), float3(1, 1, 1)));
+
+	std::vector<SceneObjectPtr> movers;
+	for (int i = 0; i < 64; ++ i)
+	{
+		SceneObjectPtr so = MakeSharedPtr<SceneObjectHelper>(box, SceneObject::SOA_Cullable | SceneObject::SOA_Moveable);
+		so->ModelMatrix(MathLib::translation((i - 32) * 4.0f, 0.0f, 50.0f));
+		so->BindSubThreadUpdateFunc(MoveObject);
+		so->AddToSceneManager();
+		movers.push_back(so);
+	}
+
+	std::vector<ParticleSystemPtr> particles;
+	for (int i = 0; i < 4; ++ i)
+	{
+		ParticleSystemPtr ps = MakeParticleSystem(float3((i - 2) * 10.0f, 0, 30));
+		ps->AddToSceneManager();
+		particles.push_back(ps);
+	}
+
+	bool spawned = false;
+	SceneObjectPtr spawner = MakeSharedPtr<SceneObjectHelper>(SceneObject::SOA_Moveable);
+	spawner->BindSubThreadUpdateFunc(KlayGE::bind(SpawnObject, KlayGE::placeholders::_1, KlayGE::placeholders::_2,
+		KlayGE::placeholders::_3, box, &spawned));
+	spawner->AddToSceneManager();
+
+	uint32_t const num_objs = sm->NumSceneObjects();
+
+	float const frame_time = 1.0f / 60;
+	for (int frame = 0; frame < 60; ++ frame)
+	{
+		// Culling and transforms use the state from before the update that runs beside them
+		std::vector<float4x4> models(movers.size());
+		for (size_t i = 0; i < movers.size(); ++ i)
+		{
+			models[i] = movers[i]->ModelMatrix();
+		}
+
+		sm->Frame(camera, frame * frame_time, frame_time);
+
+		for (size_t i = 0; i < movers.size(); ++ i)
+		{
+			BOOST_CHECK(movers[i]->AbsModelMatrix() == models[i]);
+			BOOST_CHECK(movers[i]->ModelMatrix() != models[i]);
+		}
+
+		// Objects added by the update show up once it has joined
+		BOOST_CHECK_EQUAL(sm->NumSceneObjects(), num_objs + 1);
+
+		for (size_t i = 0; i < particles.size(); ++ i)
+		{
+			ParticleSystem& ps = *particles[i];
+			BOOST_CHECK(ps.NumActiveParticles() > 0);
+
+			AABBox const bound = ps.ParticlesBound();
+			for (uint32_t j = 0; j < ps.NumActiveParticles(); ++ j)
+			{
+				BOOST_CHECK(bound.VecInBound(ps.GetParticle(ps.GetActiveParticleIndex(j)).pos));
+			}
+		}
+	}
+
+	Context::Instance().SceneManagerInstance(SceneManagerPtr());
+}
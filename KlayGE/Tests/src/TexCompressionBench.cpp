@@ -0,0 +1,632 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/LZMACodec.hpp>
+#include <KlayGE/TexCompressionBC.hpp>
+#include <KlayGE/TexCompressionETC.hpp>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Every measurement is repeated until it has taken at least this long, and the average is reported
+	double const MIN_MEASURE_TIME = 0.5;
+
+	char const * LDR_CORPUS[] = { "Lenna.dds", "leaf_v3_green_tex.dds" };
+	char const * HDR_CORPUS[] = { "memorial.dds", "uffizi_probe.dds" };
+
+	struct Image
+	{
+		std::string name;
+		uint32_t width;
+		uint32_t height;
+		ElementFormat format;
+		std::vector<uint8_t> data;
+
+		uint32_t RowPitch() const
+		{
+			return width * NumFormatBytes(format);
+		}
+		uint32_t SlicePitch() const
+		{
+			return this->RowPitch() * height;
+		}
+	};
+
+	// A line of the results. Fields that don't apply are negative, and left empty in the CSV.
+	struct BenchResult
+	{
+		std::string benchmark;
+		std::string method;
+		std::string image;
+		uint32_t width;
+		uint32_t height;
+		double seconds;
+		double mb_per_sec;
+		double blocks_per_sec;
+		double psnr;
+		double ratio;
+	};
+
+	struct BaselineEntry
+	{
+		double ms;
+		double psnr;	// Negative if it doesn't apply
+	};
+
+	template <typename Func>
+	double Measure(Func const & func)
+	{
+		Timer timer;
+		uint32_t runs = 0;
+		do
+		{
+			func();
+			++ runs;
+		} while (timer.elapsed() < MIN_MEASURE_TIME);
+
+		return timer.elapsed() / runs;
+	}
+
+	bool LoadImage(Image& image, std::string const & name, ElementFormat format)
+	{
+		if (ResLoader::Instance().Locate(name).empty())
+		{
+			cout << "Couldn't locate " << name << ". Skipped." << endl;
+			return false;
+		}
+
+		Texture::TextureType type;
+		uint32_t depth, num_mipmaps, array_size;
+		ElementFormat in_format;
+		std::vector<ElementInitData> init_data;
+		std::vector<uint8_t> data_block;
+		LoadTexture(name, type, image.width, image.height, depth, num_mipmaps, array_size,
+			in_format, init_data, data_block);
+
+		image.name = name;
+		image.format = format;
+		if (IsCompressedFormat(format))
+		{
+			image.data.assign(static_cast<uint8_t const *>(init_data[0].data),
+				static_cast<uint8_t const *>(init_data[0].data) + init_data[0].slice_pitch);
+		}
+		else
+		{
+			image.data.resize(image.SlicePitch());
+			ResizeTexture(&image.data[0], image.RowPitch(), image.SlicePitch(), format,
+				image.width, image.height, 1,
+				init_data[0].data, init_data[0].row_pitch, init_data[0].slice_pitch, in_format,
+				image.width, image.height, 1,
+				false);
+		}
+
+		return true;
+	}
+
+	// Unorm formats peak at 1. Float formats are measured against the brightest channel of the reference.
+	double PSNR(Image const & ref, std::vector<uint8_t> const & data)
+	{
+		uint32_t const num = ref.width * ref.height;
+		std::vector<Color> ref_clrs(num);
+		std::vector<Color> clrs(num);
+		ConvertToABGR32F(ref.format, &ref.data[0], num, &ref_clrs[0]);
+		ConvertToABGR32F(ref.format, &data[0], num, &clrs[0]);
+
+		double peak = 1;
+		if (IsFloatFormat(ref.format))
+		{
+			peak = 0;
+			for (uint32_t i = 0; i < num; ++ i)
+			{
+				for (uint32_t ch = 0; ch < 4; ++ ch)
+				{
+					peak = std::max(peak, static_cast<double>(MathLib::abs(ref_clrs[i][ch])));
+				}
+			}
+		}
+
+		double mse = 0;
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			for (uint32_t ch = 0; ch < 4; ++ ch)
+			{
+				double const diff = ref_clrs[i][ch] - clrs[i][ch];
+				mse += diff * diff;
+			}
+		}
+		mse /= num * NumComponents(ref.format);
+
+		if (mse > 0)
+		{
+			return 10 * log10(peak * peak / mse);
+		}
+		else
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+	}
+
+	std::string MethodName(TexCompressionMethod method)
+	{
+		switch (method)
+		{
+		case TCM_Speed:
+			return "speed";
+
+		case TCM_Balanced:
+			return "balanced";
+
+		default:
+			return "quality";
+		}
+	}
+
+	BenchResult MakeResult(std::string const & benchmark, std::string const & method, Image const & image, double seconds)
+	{
+		BenchResult result;
+		result.benchmark = benchmark;
+		result.method = method;
+		result.image = image.name;
+		result.width = image.width;
+		result.height = image.height;
+		result.seconds = seconds;
+		result.mb_per_sec = image.SlicePitch() / seconds / (1024 * 1024);
+		result.blocks_per_sec = -1;
+		result.psnr = -1;
+		result.ratio = -1;
+		return result;
+	}
+
+	void AddResult(std::vector<BenchResult>& results, BenchResult const & result)
+	{
+		cout << left << setw(20) << result.benchmark << setw(10) << result.method << setw(24) << result.image
+			<< right << fixed << setprecision(3) << setw(12) << result.seconds * 1000 << " ms"
+			<< setprecision(2) << setw(10) << result.mb_per_sec << " MB/s";
+		if (result.blocks_per_sec >= 0)
+		{
+			cout << setprecision(0) << setw(12) << result.blocks_per_sec << " blocks/s";
+		}
+		if (result.psnr >= 0)
+		{
+			cout << setprecision(2) << setw(8) << result.psnr << " dB";
+		}
+		if (result.ratio >= 0)
+		{
+			cout << setprecision(2) << setw(8) << result.ratio << ":1";
+		}
+		cout << endl;
+
+		results.push_back(result);
+	}
+
+	std::string ResultKey(BenchResult const & result)
+	{
+		std::ostringstream ss;
+		ss << result.benchmark << ',' << result.method << ',' << result.image << ','
+			<< result.width << ',' << result.height;
+		return ss.str();
+	}
+
+	void SaveResults(std::vector<BenchResult> const & results, std::string const & file_name)
+	{
+		std::ofstream ofs(file_name.c_str());
+		ofs << "benchmark,method,image,width,height,ms,mb_per_sec,blocks_per_sec,psnr_db,ratio" << endl;
+		ofs << fixed << setprecision(4);
+		for (size_t i = 0; i < results.size(); ++ i)
+		{
+			BenchResult const & result = results[i];
+			ofs << ResultKey(result) << ','
+				<< result.seconds * 1000 << ',' << result.mb_per_sec << ',';
+			if (result.blocks_per_sec >= 0)
+			{
+				ofs << result.blocks_per_sec;
+			}
+			ofs << ',';
+			if (result.psnr >= 0)
+			{
+				ofs << result.psnr;
+			}
+			ofs << ',';
+			if (result.ratio >= 0)
+			{
+				ofs << result.ratio;
+			}
+			ofs << endl;
+		}
+	}
+
+	bool LoadBaseline(std::map<std::string, BaselineEntry>& baseline, std::string const & file_name)
+	{
+		std::ifstream ifs(file_name.c_str());
+		if (!ifs)
+		{
+			return false;
+		}
+
+		std::string line;
+		std::getline(ifs, line);
+		while (std::getline(ifs, line))
+		{
+			// Keeps the empty fields, so the columns stay where they are
+			std::vector<std::string> fields;
+			std::string::size_type begin = 0;
+			for (;;)
+			{
+				std::string::size_type const end = line.find(',', begin);
+				fields.push_back(line.substr(begin, end - begin));
+				if (std::string::npos == end)
+				{
+					break;
+				}
+				begin = end + 1;
+			}
+			if (fields.size() >= 9)
+			{
+				BaselineEntry entry;
+				entry.ms = std::atof(fields[5].c_str());
+				entry.psnr = fields[8].empty() ? -1 : std::atof(fields[8].c_str());
+				baseline[fields[0] + ',' + fields[1] + ',' + fields[2] + ',' + fields[3] + ',' + fields[4]] = entry;
+			}
+		}
+
+		return true;
+	}
+
+	// Returns the number of regressions. A benchmark regresses if it's slower than the baseline by more than
+	// the threshold, or if its PSNR drops by more than PSNR_TOLERANCE. Benchmarks missing from either side are only reported.
+	uint32_t CompareWithBaseline(std::vector<BenchResult> const & results,
+		std::map<std::string, BaselineEntry> const & baseline, double threshold)
+	{
+		double const PSNR_TOLERANCE = 0.01;
+
+		uint32_t num_regressions = 0;
+
+		cout << endl << "Compared with the baseline, threshold " << threshold * 100 << "%:" << endl;
+		for (size_t i = 0; i < results.size(); ++ i)
+		{
+			BenchResult const & result = results[i];
+			cout << left << setw(20) << result.benchmark << setw(10) << result.method << setw(24) << result.image << right;
+
+			KLAYGE_AUTO(iter, baseline.find(ResultKey(result)));
+			if (iter == baseline.end())
+			{
+				cout << "    not in the baseline" << endl;
+				continue;
+			}
+
+			double const ms = result.seconds * 1000;
+			double const change = (iter->second.ms > 0) ? (ms / iter->second.ms - 1) : 0;
+			bool const slower = change > threshold;
+			cout << showpos << fixed << setprecision(1) << setw(10) << change * 100 << "%" << noshowpos;
+
+			bool worse_quality = false;
+			if ((result.psnr >= 0) && (iter->second.psnr >= 0))
+			{
+				worse_quality = result.psnr < iter->second.psnr - PSNR_TOLERANCE;
+				cout << setprecision(2) << setw(10) << iter->second.psnr << " -> " << result.psnr << " dB";
+			}
+
+			if (slower || worse_quality)
+			{
+				cout << "    REGRESSION";
+				++ num_regressions;
+			}
+			cout << endl;
+		}
+
+		return num_regressions;
+	}
+
+	void BenchCodec(std::vector<BenchResult>& results, std::string const & name, TexCompression& codec,
+		Image const & image, TexCompressionMethod method)
+	{
+		uint32_t const blocks_x = (image.width + codec.BlockWidth() - 1) / codec.BlockWidth();
+		uint32_t const blocks_y = (image.height + codec.BlockHeight() - 1) / codec.BlockHeight();
+		uint32_t const block_row_pitch = blocks_x * codec.BlockBytes();
+		std::vector<uint8_t> blocks(block_row_pitch * blocks_y);
+		std::vector<uint8_t> decoded(image.SlicePitch());
+
+		double const encode_time = Measure(KlayGE::bind(&TexCompression::EncodeMem, &codec, image.width, image.height,
+			&blocks[0], block_row_pitch, static_cast<uint32_t>(blocks.size()),
+			&image.data[0], image.RowPitch(), image.SlicePitch(), method));
+		double const decode_time = Measure(KlayGE::bind(&TexCompression::DecodeMem, &codec, image.width, image.height,
+			&decoded[0], image.RowPitch(), image.SlicePitch(),
+			&blocks[0], block_row_pitch, static_cast<uint32_t>(blocks.size())));
+		double const psnr = PSNR(image, decoded);
+
+		BenchResult result = MakeResult(name + " encode", MethodName(method), image, encode_time);
+		result.blocks_per_sec = blocks_x * blocks_y / encode_time;
+		result.psnr = psnr;
+		AddResult(results, result);
+
+		result = MakeResult(name + " decode", MethodName(method), image, decode_time);
+		result.blocks_per_sec = blocks_x * blocks_y / decode_time;
+		result.psnr = psnr;
+		AddResult(results, result);
+	}
+
+	// For the codecs without an encoder. The blocks come from a file in the corpus.
+	void BenchDecoder(std::vector<BenchResult>& results, std::string const & name, TexCompression& codec,
+		Image const & image, Image const & compressed)
+	{
+		uint32_t const blocks_x = (image.width + codec.BlockWidth() - 1) / codec.BlockWidth();
+		uint32_t const blocks_y = (image.height + codec.BlockHeight() - 1) / codec.BlockHeight();
+		uint32_t const block_row_pitch = blocks_x * codec.BlockBytes();
+		std::vector<uint8_t> decoded(image.SlicePitch());
+
+		double const decode_time = Measure(KlayGE::bind(&TexCompression::DecodeMem, &codec, image.width, image.height,
+			&decoded[0], image.RowPitch(), image.SlicePitch(),
+			&compressed.data[0], block_row_pitch, static_cast<uint32_t>(compressed.data.size())));
+
+		BenchResult result = MakeResult(name + " decode", "", image, decode_time);
+		result.blocks_per_sec = blocks_x * blocks_y / decode_time;
+		result.psnr = PSNR(image, decoded);
+		AddResult(results, result);
+	}
+
+	void BenchResize(std::vector<BenchResult>& results, Image const & image, bool linear)
+	{
+		uint32_t const dst_width = std::max(image.width / 2, 1U);
+		uint32_t const dst_height = std::max(image.height / 2, 1U);
+		uint32_t const dst_row_pitch = dst_width * NumFormatBytes(image.format);
+		std::vector<uint8_t> resized(dst_row_pitch * dst_height);
+
+		double const time = Measure(KlayGE::bind(ResizeTexture, &resized[0], dst_row_pitch, static_cast<uint32_t>(resized.size()),
+			image.format, dst_width, dst_height, 1U,
+			&image.data[0], image.RowPitch(), image.SlicePitch(), image.format, image.width, image.height, 1U,
+			linear));
+
+		AddResult(results, MakeResult("ResizeTexture", linear ? "linear" : "point", image, time));
+	}
+
+	void BenchConvert(std::vector<BenchResult>& results, Image const & image)
+	{
+		uint32_t const num = image.width * image.height;
+		std::vector<Color> clrs(num);
+
+		double const time = Measure(KlayGE::bind(ConvertToABGR32F, image.format, &image.data[0], num, &clrs[0]));
+
+		AddResult(results, MakeResult("ConvertToABGR32F", "", image, time));
+	}
+
+	void LZMAEncode(std::vector<uint8_t>* output, std::vector<uint8_t> const * input)
+	{
+		LZMACodec lzma;
+		lzma.Encode(*output, &(*input)[0], input->size());
+	}
+
+	void LZMADecode(std::vector<uint8_t>* output, std::vector<uint8_t> const * input)
+	{
+		LZMACodec lzma;
+		lzma.Decode(&(*output)[0], &(*input)[0], input->size(), output->size());
+	}
+
+	void BenchLZMA(std::vector<BenchResult>& results, Image const & image)
+	{
+		std::vector<uint8_t> encoded;
+		std::vector<uint8_t> decoded(image.data.size());
+
+		double const encode_time = Measure(KlayGE::bind(LZMAEncode, &encoded, &image.data));
+		double const decode_time = Measure(KlayGE::bind(LZMADecode, &decoded, &encoded));
+		if (decoded != image.data)
+		{
+			cout << "LZMA round trip of " << image.name << " doesn't match." << endl;
+		}
+
+		double const ratio = static_cast<double>(image.data.size()) / encoded.size();
+
+		BenchResult result = MakeResult("LZMA encode", "", image, encode_time);
+		result.ratio = ratio;
+		AddResult(results, result);
+
+		result = MakeResult("LZMA decode", "", image, decode_time);
+		result.ratio = ratio;
+		AddResult(results, result);
+	}
+
+	bool Selected(std::string const & filter, std::string const & benchmark)
+	{
+		return filter.empty() || (benchmark.find(filter) != std::string::npos);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string out_file = "TexCompressionBench.csv";
+	std::string filter;
+	std::string baseline_file;
+	double threshold = 0.1;
+
+	// The output file and the filter are positional, the options can be anywhere
+	uint32_t num_positionals = 0;
+	for (int i = 1; i < argc; ++ i)
+	{
+		std::string const arg = argv[i];
+		bool valid = true;
+		if (("-b" == arg) && (i + 1 < argc))
+		{
+			baseline_file = argv[++ i];
+		}
+		else if (("-t" == arg) && (i + 1 < argc))
+		{
+			threshold = std::atof(argv[++ i]) / 100;
+		}
+		else if (!arg.empty() && ('-' == arg[0]))
+		{
+			valid = false;
+		}
+		else if (0 == num_positionals)
+		{
+			out_file = arg;
+			++ num_positionals;
+		}
+		else if (1 == num_positionals)
+		{
+			filter = arg;
+			++ num_positionals;
+		}
+		else
+		{
+			valid = false;
+		}
+
+		if (!valid)
+		{
+			cout << "Usage: TexCompressionBench [results.csv] [filter] [-b baseline.csv] [-t threshold%]" << endl;
+			cout << "\tRuns the benchmarks whose names contain the filter, and saves the results as CSV." << endl;
+			cout << "\tWith a baseline, returns non-zero if a benchmark is slower by more than the threshold, or loses PSNR." << endl;
+			return ("-h" == arg) || ("--help" == arg) ? 0 : 1;
+		}
+	}
+
+	ResLoader::Instance().AddPath("../../Tests/media");
+
+	std::vector<BenchResult> results;
+
+	{
+		struct CodecEntry
+		{
+			char const * name;
+			TexCompressionPtr codec;
+		};
+		CodecEntry const codecs[] =
+		{
+			{ "BC1", MakeSharedPtr<TexCompressionBC1>() },
+			{ "BC2", MakeSharedPtr<TexCompressionBC2>() },
+			{ "BC3", MakeSharedPtr<TexCompressionBC3>() },
+			{ "BC4", MakeSharedPtr<TexCompressionBC4>() },
+			{ "BC5", MakeSharedPtr<TexCompressionBC5>() },
+			{ "BC7", MakeSharedPtr<TexCompressionBC7>() },
+			{ "ETC1", MakeSharedPtr<TexCompressionETC1>() }
+		};
+
+		for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); ++ i)
+		{
+			if (!Selected(filter, codecs[i].name))
+			{
+				continue;
+			}
+
+			for (size_t j = 0; j < sizeof(LDR_CORPUS) / sizeof(LDR_CORPUS[0]); ++ j)
+			{
+				Image image;
+				if (LoadImage(image, LDR_CORPUS[j], codecs[i].codec->DecodedFormat()))
+				{
+					for (int method = TCM_Speed; method <= TCM_Quality; ++ method)
+					{
+						BenchCodec(results, codecs[i].name, *codecs[i].codec, image, static_cast<TexCompressionMethod>(method));
+					}
+				}
+			}
+		}
+	}
+
+	{
+		// BC6 has no encoder yet, so only its decoder is measured. ETC2 isn't covered, as it has neither an encoder nor blocks in the corpus.
+		struct DecoderEntry
+		{
+			char const * name;
+			TexCompressionPtr codec;
+			char const * image;
+			char const * compressed;
+		};
+		DecoderEntry const decoders[] =
+		{
+			{ "BC6U", MakeSharedPtr<TexCompressionBC6U>(), "memorial.dds", "memorial_bc6u.dds" },
+			{ "BC6S", MakeSharedPtr<TexCompressionBC6S>(), "uffizi_probe.dds", "uffizi_probe_bc6s.dds" }
+		};
+
+		for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); ++ i)
+		{
+			if (!Selected(filter, decoders[i].name))
+			{
+				continue;
+			}
+
+			Image image;
+			Image compressed;
+			if (LoadImage(image, decoders[i].image, decoders[i].codec->DecodedFormat())
+				&& LoadImage(compressed, decoders[i].compressed, EF_BC6))
+			{
+				BenchDecoder(results, decoders[i].name, *decoders[i].codec, image, compressed);
+			}
+		}
+	}
+
+	{
+		std::vector<Image> images;
+		for (size_t i = 0; i < sizeof(LDR_CORPUS) / sizeof(LDR_CORPUS[0]); ++ i)
+		{
+			images.push_back(Image());
+			if (!LoadImage(images.back(), LDR_CORPUS[i], EF_ARGB8))
+			{
+				images.pop_back();
+			}
+		}
+		for (size_t i = 0; i < sizeof(HDR_CORPUS) / sizeof(HDR_CORPUS[0]); ++ i)
+		{
+			images.push_back(Image());
+			if (!LoadImage(images.back(), HDR_CORPUS[i], EF_ABGR16F))
+			{
+				images.pop_back();
+			}
+		}
+
+		for (size_t i = 0; i < images.size(); ++ i)
+		{
+			if (Selected(filter, "ResizeTexture"))
+			{
+				BenchResize(results, images[i], false);
+				BenchResize(results, images[i], true);
+			}
+			if (Selected(filter, "ConvertToABGR32F"))
+			{
+				BenchConvert(results, images[i]);
+			}
+			if (Selected(filter, "LZMA"))
+			{
+				BenchLZMA(results, images[i]);
+			}
+		}
+	}
+
+	SaveResults(results, out_file);
+	cout << "Results are saved to " << out_file << endl;
+
+	int ret = 0;
+	if (!baseline_file.empty())
+	{
+		std::map<std::string, BaselineEntry> baseline;
+		if (LoadBaseline(baseline, baseline_file))
+		{
+			if (CompareWithBaseline(results, baseline, threshold) > 0)
+			{
+				ret = 1;
+			}
+		}
+		else
+		{
+			cout << "Couldn't open the baseline " << baseline_file << "." << endl;
+			ret = 1;
+		}
+	}
+
+	Context::Destroy();
+
+	return ret;
+}
@@ -0,0 +1,438 @@
+/**
+* @file TexTools.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KlayGE/TexCompressionBC.hpp>
+#include <KlayGE/TexCompressionETC.hpp>
+
+#include <vector>
+#include <cstring>
+
+#include "TexTools.hpp"
+
+namespace
+{
+	using namespace KlayGE;
+
+	void CompressNormalMapSubresource(uint32_t width, uint32_t height, std::vector<Color> const & in_color,
+		ElementFormat new_format, ElementInitData& new_data, std::vector<uint8_t>& new_data_block)
+	{
+		TexCompressionBC4 bc4_codec;
+
+		if (IsCompressedFormat(new_format))
+		{
+			new_data.row_pitch = (width + 3) / 4 * 16;
+			new_data.slice_pitch = new_data.row_pitch * ((height + 3) / 4);
+		}
+		else
+		{
+			new_data.row_pitch = width * 2;
+			new_data.slice_pitch = new_data.row_pitch * height;
+		}
+		new_data_block.resize(new_data.slice_pitch);
+		new_data.data = &new_data_block[0];
+
+		uint8_t* com_normals = &new_data_block[0];
+
+		uint32_t dest = 0;
+		for (uint32_t y_base = 0; y_base < height; y_base += 4)
+		{
+			for (uint32_t x_base = 0; x_base < width; x_base += 4)
+			{
+				uint8_t uncom_x[16];
+				uint8_t uncom_y[16];
+				for (uint32_t dy = 0; dy < 4; ++ dy)
+				{
+					uint32_t y = MathLib::clamp(y_base + dy, 0U, height - 1);
+					for (uint32_t dx = 0; dx < 4; ++ dx)
+					{
+						uint32_t x = MathLib::clamp(x_base + dx, 0U, width - 1);
+
+						float3 n;
+						n.x() = in_color[y * width + x].r() * 2 - 1;
+						n.y() = in_color[y * width + x].g() * 2 - 1;
+						n.z() = in_color[y * width + x].b() * 2 - 1;
+						n = MathLib::normalize(n);
+
+						uncom_x[dy * 4 + dx] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.x() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
+						uncom_y[dy * 4 + dx] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.y() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
+					}
+				}
+
+				if (IsCompressedFormat(new_format))
+				{
+					BC4Block x_bc4;
+					bc4_codec.EncodeBlock(&x_bc4, uncom_x, TCM_Quality);
+					BC4Block y_bc4;
+					bc4_codec.EncodeBlock(&y_bc4, uncom_y, TCM_Quality);
+
+					if (EF_BC5 == new_format)
+					{
+						BC5Block com_bc5;
+						com_bc5.red = x_bc4;
+						com_bc5.green = y_bc4;
+
+						std::memcpy(&com_normals[dest], &com_bc5, sizeof(com_bc5));
+						dest += sizeof(com_bc5);
+					}
+					else
+					{
+						BOOST_ASSERT(EF_BC3 == new_format);
+
+						BC3Block com_bc3;
+						com_bc3.alpha = x_bc4;
+
+						BC4ToBC1G(com_bc3.bc1, y_bc4);
+
+						std::memcpy(&com_normals[dest], &com_bc3, sizeof(com_bc3));
+						dest += sizeof(com_bc3);
+					}
+				}
+				else
+				{
+					BOOST_ASSERT(EF_GR8 == new_format);
+
+					for (uint32_t dy = 0; (dy < 4) && (y_base + dy < height); ++ dy)
+					{
+						for (uint32_t dx = 0; (dx < 4) && (x_base + dx < width); ++ dx)
+						{
+							com_normals[(y_base + dy) * new_data.row_pitch + (x_base + dx) * 2 + 0] = uncom_x[dy * 4 + dx];
+							com_normals[(y_base + dy) * new_data.row_pitch + (x_base + dx) * 2 + 1] = uncom_y[dy * 4 + dx];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+namespace KlayGE
+{
+	void LoadTexImage(std::string const & name, TexImage& tex)
+	{
+		LoadTexture(name, tex.type, tex.width, tex.height, tex.depth, tex.num_mipmaps, tex.array_size,
+			tex.format, tex.data, tex.data_block);
+		tex.sub_data_blocks.clear();
+	}
+
+	void LoadTexImage(ResIdentifierPtr const & res, TexImage& tex)
+	{
+		LoadTexture(res, tex.type, tex.width, tex.height, tex.depth, tex.num_mipmaps, tex.array_size,
+			tex.format, tex.data, tex.data_block);
+		tex.sub_data_blocks.clear();
+	}
+
+	void SaveTexImage(std::string const & name, TexImage const & tex)
+	{
+		SaveTexture(name, tex.type, tex.width, tex.height, tex.depth, tex.num_mipmaps, tex.array_size, tex.format, tex.data);
+	}
+
+	bool ForceTexSRGB(TexImage& tex)
+	{
+		if (IsSRGB(tex.format))
+		{
+			return false;
+		}
+
+		ElementFormat const new_format = MakeSRGB(tex.format);
+		if (new_format == tex.format)
+		{
+			return false;
+		}
+
+		tex.format = new_format;
+		return true;
+	}
+
+	void GenMipmap(TexImage& tex)
+	{
+		uint32_t const elem_size = NumFormatBytes(tex.format);
+
+		uint32_t num_full_mip_maps = 1;
+		uint32_t w = tex.width;
+		uint32_t h = tex.height;
+		while ((w != 1) || (h != 1))
+		{
+			++ num_full_mip_maps;
+
+			w = std::max<uint32_t>(1U, w / 2);
+			h = std::max<uint32_t>(1U, h / 2);
+		}
+
+		std::vector<ElementInitData> new_data(tex.array_size * num_full_mip_maps);
+		std::vector<std::vector<uint8_t> > new_data_block(new_data.size());
+
+		for (uint32_t sub_res = 0; sub_res < tex.array_size; ++ sub_res)
+		{
+			uint32_t the_width = tex.width;
+			uint32_t the_height = tex.height;
+
+			{
+				ElementInitData& dst_data = new_data[sub_res * num_full_mip_maps];
+
+				dst_data.row_pitch = the_width * elem_size;
+				dst_data.slice_pitch = dst_data.row_pitch * the_height;
+
+				new_data_block[sub_res * num_full_mip_maps].resize(dst_data.slice_pitch);
+
+				dst_data.data = &new_data_block[sub_res * num_full_mip_maps][0];
+
+				ElementInitData const & src_data = tex.data[sub_res * tex.num_mipmaps];
+
+				uint8_t const * src = static_cast<uint8_t const *>(src_data.data);
+				uint8_t* dst = &new_data_block[sub_res * num_full_mip_maps][0];
+				for (uint32_t y = 0; y < the_height; ++ y)
+				{
+					std::memcpy(dst, src, dst_data.row_pitch);
+
+					src += src_data.row_pitch;
+					dst += dst_data.row_pitch;
+				}
+			}
+
+			for (uint32_t mip = 0; mip < num_full_mip_maps - 1; ++ mip)
+			{
+				uint32_t new_width = std::max(the_width / 2, 1U);
+				uint32_t new_height = std::max(the_height / 2, 1U);
+
+				ElementInitData& src_data = new_data[sub_res * num_full_mip_maps + mip];
+				ElementInitData& dst_data = new_data[sub_res * num_full_mip_maps + mip + 1];
+
+				dst_data.row_pitch = new_width * elem_size;
+				dst_data.slice_pitch = dst_data.row_pitch * new_height;
+
+				new_data_block[sub_res * num_full_mip_maps + mip + 1].resize(dst_data.slice_pitch);
+
+				dst_data.data = &new_data_block[sub_res * num_full_mip_maps + mip + 1][0];
+
+				ResizeTexture(&new_data_block[sub_res * num_full_mip_maps + mip + 1][0],
+					dst_data.row_pitch, dst_data.slice_pitch,
+					tex.format, new_width, new_height, 1,
+					src_data.data, src_data.row_pitch, src_data.slice_pitch,
+					tex.format, the_width, the_height, 1,
+					true);
+
+				the_width = new_width;
+				the_height = new_height;
+			}
+		}
+
+		tex.num_mipmaps = num_full_mip_maps;
+		tex.data.swap(new_data);
+		tex.sub_data_blocks.swap(new_data_block);
+	}
+
+	bool CompressTex(TexImage& tex, ElementFormat fmt, TexCompressionMethod method)
+	{
+		if (IsCompressedFormat(tex.format))
+		{
+			return false;
+		}
+
+		uint32_t const out_width = (tex.width + 3) & ~3;
+		uint32_t const out_height = (tex.height + 3) & ~3;
+
+		if (IsSigned(tex.format))
+		{
+			fmt = MakeSigned(fmt);
+		}
+		if (IsSRGB(tex.format))
+		{
+			fmt = MakeSRGB(fmt);
+		}
+
+		std::vector<ElementInitData> new_data(tex.data.size());
+		std::vector<std::vector<uint8_t> > new_data_block(tex.data.size());
+
+		TexCompressionETC1 etc1_codec;
+		std::vector<uint8_t> argb_data;
+
+		for (size_t sub_res = 0; sub_res < tex.array_size; ++ sub_res)
+		{
+			uint32_t src_width = tex.width;
+			uint32_t src_height = tex.height;
+
+			uint32_t dst_width = out_width;
+			uint32_t dst_height = out_height;
+
+			for (uint32_t mip = 0; mip < tex.num_mipmaps; ++ mip)
+			{
+				ElementInitData const & src_data = tex.data[sub_res * tex.num_mipmaps + mip];
+				ElementInitData& dst_data = new_data[sub_res * tex.num_mipmaps + mip];
+
+				uint32_t const block_size = NumFormatBytes(fmt) * 4;
+
+				dst_data.row_pitch = ((dst_width + 3) / 4) * block_size;
+				dst_data.slice_pitch = dst_data.row_pitch * ((dst_height + 3) / 4);
+
+				new_data_block[sub_res * tex.num_mipmaps + mip].resize(dst_data.slice_pitch);
+
+				dst_data.data = &new_data_block[sub_res * tex.num_mipmaps + mip][0];
+
+				if (EF_ETC1 == fmt)
+				{
+					// ETC1 is encoded here, so the method can be chosen
+					uint32_t const argb_row_pitch = dst_width * NumFormatBytes(EF_ARGB8);
+					argb_data.resize(argb_row_pitch * dst_height);
+					ResizeTexture(&argb_data[0], argb_row_pitch, static_cast<uint32_t>(argb_data.size()),
+						EF_ARGB8, dst_width, dst_height, 1,
+						src_data.data, src_data.row_pitch, src_data.slice_pitch,
+						tex.format, src_width, src_height, 1,
+						false);
+
+					etc1_codec.EncodeMem(dst_width, dst_height,
+						&new_data_block[sub_res * tex.num_mipmaps + mip][0], dst_data.row_pitch, dst_data.slice_pitch,
+						&argb_data[0], argb_row_pitch, static_cast<uint32_t>(argb_data.size()),
+						method);
+				}
+				else
+				{
+					ResizeTexture(&new_data_block[sub_res * tex.num_mipmaps + mip][0],
+						dst_data.row_pitch, dst_data.slice_pitch,
+						fmt, dst_width, dst_height, 1,
+						src_data.data, src_data.row_pitch, src_data.slice_pitch,
+						tex.format, src_width, src_height, 1,
+						false);
+				}
+
+				src_width = std::max(src_width / 2, 1U);
+				src_height = std::max(src_height / 2, 1U);
+
+				dst_width = std::max(dst_width / 2, 1U);
+				dst_height = std::max(dst_height / 2, 1U);
+			}
+		}
+
+		tex.width = out_width;
+		tex.height = out_height;
+		tex.format = fmt;
+		tex.data.swap(new_data);
+		tex.sub_data_blocks.swap(new_data_block);
+		return true;
+	}
+
+	void Bump2NormalMap(TexImage& tex, float offset)
+	{
+		uint32_t const elem_size = NumFormatBytes(tex.format);
+
+		std::vector<ElementInitData> new_data(tex.data.size());
+		std::vector<std::vector<uint8_t> > new_data_block(tex.data.size());
+
+		std::vector<Color> in_color;
+		for (size_t sub_res = 0; sub_res < tex.data.size(); ++ sub_res)
+		{
+			uint32_t const the_width = tex.data[sub_res].row_pitch / elem_size;
+			uint32_t const the_height = tex.data[sub_res].slice_pitch / tex.data[sub_res].row_pitch;
+
+			in_color.resize(the_width * the_height);
+			uint8_t const * src = static_cast<uint8_t const *>(tex.data[sub_res].data);
+			for (uint32_t y = 0; y < the_height; ++ y)
+			{
+				ConvertToABGR32F(tex.format, src, the_width, &in_color[y * the_width]);
+				src += tex.data[sub_res].row_pitch;
+			}
+
+			ElementInitData& dst_data = new_data[sub_res];
+			dst_data.row_pitch = the_width * 4;
+			dst_data.slice_pitch = dst_data.row_pitch * the_height;
+			new_data_block[sub_res].resize(dst_data.slice_pitch);
+			dst_data.data = &new_data_block[sub_res][0];
+
+			uint8_t* normals = &new_data_block[sub_res][0];
+			for (uint32_t i = 0; i < the_width * the_height; ++ i)
+			{
+				float3 n;
+				n.x() = (in_color[i].r() * 2 - 1) * offset;
+				n.y() = (in_color[i].g() * 2 - 1) * offset;
+				n.z() = 1;
+				n = MathLib::normalize(n);
+
+				normals[i * 4 + 0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.x() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
+				normals[i * 4 + 1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.y() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
+				normals[i * 4 + 2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.z() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
+				normals[i * 4 + 3] = 255;
+			}
+		}
+
+		tex.format = EF_ABGR8;
+		tex.data.swap(new_data);
+		tex.sub_data_blocks.swap(new_data_block);
+	}
+
+	void CompressNormalMap(TexImage& tex, ElementFormat new_format)
+	{
+		uint32_t const out_width = (tex.width + 3) & ~3;
+		uint32_t const out_height = (tex.height + 3) & ~3;
+
+		std::vector<ElementInitData> new_data(tex.data.size());
+		std::vector<std::vector<uint8_t> > new_data_block(tex.data.size());
+
+		std::vector<Color> in_color;
+		for (size_t sub_res = 0; sub_res < tex.array_size; ++ sub_res)
+		{
+			uint32_t src_width = tex.width;
+			uint32_t src_height = tex.height;
+
+			uint32_t dst_width = out_width;
+			uint32_t dst_height = out_height;
+
+			for (uint32_t mip = 0; mip < tex.num_mipmaps; ++ mip)
+			{
+				ElementInitData const & src_data = tex.data[sub_res * tex.num_mipmaps + mip];
+
+				in_color.resize(dst_width * dst_height);
+				ResizeTexture(&in_color[0],
+					dst_width * sizeof(Color), dst_width * dst_height * sizeof(Color),
+					EF_ABGR32F, dst_width, dst_height, 1,
+					src_data.data, src_data.row_pitch, src_data.slice_pitch,
+					tex.format, src_width, src_height, 1,
+					true);
+
+				CompressNormalMapSubresource(dst_width, dst_height, in_color, new_format,
+					new_data[sub_res * tex.num_mipmaps + mip], new_data_block[sub_res * tex.num_mipmaps + mip]);
+
+				src_width = std::max(src_width / 2, 1U);
+				src_height = std::max(src_height / 2, 1U);
+
+				dst_width = std::max(dst_width / 2, 1U);
+				dst_height = std::max(dst_height / 2, 1U);
+			}
+		}
+
+		tex.width = out_width;
+		tex.height = out_height;
+		tex.format = new_format;
+		tex.data.swap(new_data);
+		tex.sub_data_blocks.swap(new_data_block);
+	}
+}
@@ -0,0 +1,76 @@
+/**
+* @file TexTools.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _TEXTOOLS_HPP
+#define _TEXTOOLS_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KlayGE/TexCompression.hpp>
+
+#include <vector>
+#include <string>
+
+namespace KlayGE
+{
+	// The texture conversion steps shared by the standalone texture tools and PlatformDeployer.
+	// A texture lives in memory between the steps, so a chain of them loads and saves the file only once.
+	struct TexImage
+	{
+		Texture::TextureType type;
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		uint32_t num_mipmaps;
+		uint32_t array_size;
+		ElementFormat format;
+		std::vector<ElementInitData> data;
+		std::vector<uint8_t> data_block;
+		std::vector<std::vector<uint8_t> > sub_data_blocks;
+	};
+
+	void LoadTexImage(std::string const & name, TexImage& tex);
+	void LoadTexImage(ResIdentifierPtr const & res, TexImage& tex);
+	void SaveTexImage(std::string const & name, TexImage const & tex);
+
+	// Returns false and leaves the texture untouched if it's already sRGB, or the format has no sRGB counterpart
+	bool ForceTexSRGB(TexImage& tex);
+	// Replaces the mipmaps with a full chain generated from the top level
+	void GenMipmap(TexImage& tex);
+	// Returns false and leaves the texture untouched if it's already compressed
+	bool CompressTex(TexImage& tex, ElementFormat fmt, TexCompressionMethod method);
+	void Bump2NormalMap(TexImage& tex, float offset);
+	// new_format can be EF_BC5, EF_BC3 or EF_GR8
+	void CompressNormalMap(TexImage& tex, ElementFormat new_format);
+}
+
+#endif		// _TEXTOOLS_HPP
@@ -9,6 +9,8 @@
 #include <fstream>
 #include <vector>
 
+#include "TexTools.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -16,38 +18,25 @@ namespace
 {
 	void ForceTexSRGB(std::string const & in_file, std::string const & out_file)
 	{
-		Texture::TextureType in_type;
-		uint32_t in_width, in_height, in_depth;
-		uint32_t in_num_mipmaps;
-		uint32_t in_array_size;
-		ElementFormat in_format;
-		std::vector<ElementInitData> in_data;
-		std::vector<uint8_t> in_data_block;
-		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
-
-		uint32_t num_sub_res = in_array_size;
-		if (Texture::TT_Cube == in_type)
-		{
-			num_sub_res *= 6;
-		}
+		TexImage tex;
+		LoadTexImage(in_file, tex);
 
-		if (IsSRGB(in_format))
+		if (IsSRGB(tex.format))
 		{
 			cout << "This texture is already in sRGB format." << endl;
 			if (in_file != out_file)
 			{
-				SaveTexture(out_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data);
+				SaveTexImage(out_file, tex);
 			}
 			return;
 		}
-		ElementFormat new_format = MakeSRGB(in_format);
-		if (new_format == in_format)
+		if (!ForceTexSRGB(tex))
 		{
 			cout << "This texture format don't have a sRGB counterpart." << endl;
 			return;
 		}
 
-		SaveTexture(out_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, new_format, in_data);
+		SaveTexImage(out_file, tex);
 	}
 }
 
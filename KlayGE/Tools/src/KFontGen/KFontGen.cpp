@@ -61,6 +61,136 @@ struct font_info
 	uint32_t dist_index;
 };
 
+// Bump when the distance field generation or the cache format changes, so all cached glyphs are regenerated
+uint32_t const GLYPH_CACHE_VERSION = 3;
+
+// A glyph from a previous run, keyed by its code point in glyph_cache. The distances are kept unquantized,
+// so a build from the cache quantizes the same values as a build from scratch, and writes the same .kfont.
+struct cached_glyph
+{
+	uint64_t hash;
+	font_info info;
+	std::vector<float> dist;	// Empty for glyphs without any pixel
+};
+
+typedef unordered_map<int32_t, cached_glyph> glyph_cache;
+
+// 64-bit FNV-1a
+uint64_t HashData(uint64_t seed, void const * data, size_t size)
+{
+	uint8_t const * p = static_cast<uint8_t const *>(data);
+	for (size_t i = 0; i < size; ++ i)
+	{
+		seed ^= p[i];
+		seed *= 0x100000001B3ULL;
+	}
+	return seed;
+}
+
+uint64_t HashData(void const * data, size_t size)
+{
+	return HashData(0xCBF29CE484222325ULL, data, size);
+}
+
+// Hashes everything that goes into the distance field of the glyph loaded in the slot: its outline and advance
+// at the internal size, and the sizes. Unlike a hash of the whole TTF, it stays the same when other glyphs change.
+uint64_t GlyphHash(FT_GlyphSlot slot, uint32_t internal_char_size, uint32_t char_size)
+{
+	uint64_t hash = HashData(&GLYPH_CACHE_VERSION, sizeof(GLYPH_CACHE_VERSION));
+	hash = HashData(hash, &internal_char_size, sizeof(internal_char_size));
+	hash = HashData(hash, &char_size, sizeof(char_size));
+	hash = HashData(hash, &slot->advance, sizeof(slot->advance));
+
+	FT_Outline const & outline = slot->outline;
+	hash = HashData(hash, &outline.n_points, sizeof(outline.n_points));
+	hash = HashData(hash, &outline.n_contours, sizeof(outline.n_contours));
+	hash = HashData(hash, &outline.flags, sizeof(outline.flags));
+	if (outline.n_points > 0)
+	{
+		hash = HashData(hash, outline.points, outline.n_points * sizeof(outline.points[0]));
+		hash = HashData(hash, outline.tags, outline.n_points * sizeof(outline.tags[0]));
+	}
+	if (outline.n_contours > 0)
+	{
+		hash = HashData(hash, outline.contours, outline.n_contours * sizeof(outline.contours[0]));
+	}
+	return hash;
+}
+
+bool LoadGlyphCache(std::string const & name, uint32_t char_size, glyph_cache& cache)
+{
+	std::ifstream ifs(name.c_str(), ios_base::binary);
+	if (!ifs)
+	{
+		return false;
+	}
+
+	uint32_t fourcc;
+	uint32_t version;
+	uint32_t cache_char_size;
+	uint32_t num_glyphs;
+	ifs.read(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
+	ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+	ifs.read(reinterpret_cast<char*>(&cache_char_size), sizeof(cache_char_size));
+	ifs.read(reinterpret_cast<char*>(&num_glyphs), sizeof(num_glyphs));
+	if (!ifs || (fourcc != MakeFourCC<'K', 'F', 'G', 'C'>::value) || (version != GLYPH_CACHE_VERSION)
+		|| (cache_char_size != char_size))
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < num_glyphs; ++ i)
+	{
+		int32_t ch;
+		cached_glyph glyph;
+		uint8_t non_empty;
+		ifs.read(reinterpret_cast<char*>(&ch), sizeof(ch));
+		ifs.read(reinterpret_cast<char*>(&glyph.hash), sizeof(glyph.hash));
+		ifs.read(reinterpret_cast<char*>(&glyph.info), sizeof(glyph.info));
+		ifs.read(reinterpret_cast<char*>(&non_empty), sizeof(non_empty));
+		if (non_empty)
+		{
+			glyph.dist.resize(char_size * char_size);
+			ifs.read(reinterpret_cast<char*>(&glyph.dist[0]), glyph.dist.size() * sizeof(glyph.dist[0]));
+		}
+		if (!ifs)
+		{
+			cache.clear();
+			return false;
+		}
+
+		cache.insert(std::make_pair(ch, glyph));
+	}
+
+	return true;
+}
+
+void SaveGlyphCache(std::string const & name, uint32_t char_size, glyph_cache const & cache)
+{
+	std::ofstream ofs(name.c_str(), ios_base::binary);
+
+	uint32_t const fourcc = MakeFourCC<'K', 'F', 'G', 'C'>::value;
+	uint32_t const num_glyphs = static_cast<uint32_t>(cache.size());
+	ofs.write(reinterpret_cast<char const *>(&fourcc), sizeof(fourcc));
+	ofs.write(reinterpret_cast<char const *>(&GLYPH_CACHE_VERSION), sizeof(GLYPH_CACHE_VERSION));
+	ofs.write(reinterpret_cast<char const *>(&char_size), sizeof(char_size));
+	ofs.write(reinterpret_cast<char const *>(&num_glyphs), sizeof(num_glyphs));
+
+	typedef KLAYGE_DECLTYPE(cache) CacheType;
+	KLAYGE_FOREACH(CacheType::const_reference glyph, cache)
+	{
+		uint8_t const non_empty = glyph.second.dist.empty() ? 0 : 1;
+		ofs.write(reinterpret_cast<char const *>(&glyph.first), sizeof(glyph.first));
+		ofs.write(reinterpret_cast<char const *>(&glyph.second.hash), sizeof(glyph.second.hash));
+		ofs.write(reinterpret_cast<char const *>(&glyph.second.info), sizeof(glyph.second.info));
+		ofs.write(reinterpret_cast<char const *>(&non_empty), sizeof(non_empty));
+		if (non_empty)
+		{
+			ofs.write(reinterpret_cast<char const *>(&glyph.second.dist[0]), glyph.second.dist.size() * sizeof(glyph.second.dist[0]));
+		}
+	}
+}
+
 float EdgeDistance(float2 const & grad, float val)
 {
 	float df;
@@ -303,20 +433,16 @@ public:
 	ttf_to_dist(FT_Library ft_lib, FT_Face ft_face, uint32_t internal_char_size, uint32_t char_size,
 		uint32_t const * validate_chars, font_info* char_info, float* char_dist_data,
 		int32_t& cur_num_char, atomic<int32_t>& cur_package, uint32_t num_chars,
-		float& min_value, float& max_value, uint32_t thread_id, uint32_t num_threads, uint32_t num_chars_per_package)
+		uint32_t thread_id, uint32_t num_threads, uint32_t num_chars_per_package)
 		: ft_lib_(ft_lib), ft_face_(ft_face), internal_char_size_(internal_char_size), char_size_(char_size),
 			validate_chars_(validate_chars), char_info_(char_info), char_dist_data_(char_dist_data),
 			cur_num_char_(&cur_num_char), cur_package_(&cur_package), num_chars_(num_chars),
-			thread_id_(thread_id), num_threads_(num_threads), num_chars_per_package_(num_chars_per_package),
-			min_value_(&min_value), max_value_(&max_value)
+			thread_id_(thread_id), num_threads_(num_threads), num_chars_per_package_(num_chars_per_package)
 	{
 	}
 
 	void operator()()
 	{
-		*max_value_ = -1;
-		*min_value_ = 1;
-
 		FT_GlyphSlot ft_slot = ft_face_->glyph;
 
 		float const scale = 1 / MathLib::sqrt(static_cast<float>(char_size_ * char_size_ + char_size_ * char_size_));
@@ -451,8 +577,6 @@ public:
 						float value = (inside[i] - outside[i]) * scale;
 
 						char_dist_data_[ci.dist_index + i] = value;
-						*min_value_ = std::min(*min_value_, value);
-						*max_value_ = std::max(*max_value_, value);
 					}
 				}
 				else
@@ -481,23 +605,88 @@ private:
 	uint32_t thread_id_;
 	uint32_t num_threads_;
 	uint32_t num_chars_per_package_;
+};
+
+struct hash_glyphs_param
+{
+	FT_Face ft_face;
+	int start_code;
+	int end_code;
+	uint32_t internal_char_size;
+	uint32_t char_size;
+	uint64_t* hashes;
+	uint8_t* mapped;
+	atomic<int32_t>* cur_package;
+};
+
+enum GlyphMapping
+{
+	GM_Unmapped = 0,
+	GM_Mapped,
+	GM_LoadFailed
+};
+
+// Hashes the glyphs of the code points in [start_code, end_code], a package of code points at a time
+void hash_glyphs(hash_glyphs_param const & param)
+{
+	int32_t const num_codes_per_package = 1024;
+	int32_t const num_packages = (param.end_code - param.start_code + num_codes_per_package) / num_codes_per_package;
+
+	int32_t working_package = (*param.cur_package) ++;
+	while (working_package < num_packages)
+	{
+		int const s = param.start_code + working_package * num_codes_per_package;
+		int const e = std::min(s + num_codes_per_package - 1, param.end_code);
+		for (int ch = s; ch <= e; ++ ch)
+		{
+			uint32_t mapping = FT_Get_Char_Index(param.ft_face, ch);
+			param.mapped[ch - param.start_code] = GM_Unmapped;
+			if (mapping > 0)
+			{
+				if (FT_Load_Glyph(param.ft_face, mapping, FT_LOAD_NO_BITMAP) != 0)
+				{
+					param.mapped[ch - param.start_code] = GM_LoadFailed;
+				}
+				else
+				{
+					param.mapped[ch - param.start_code] = GM_Mapped;
+					param.hashes[ch - param.start_code] = GlyphHash(param.ft_face->glyph, param.internal_char_size, param.char_size);
+				}
+			}
+		}
+
+		working_package = (*param.cur_package) ++;
+	}
+}
 
-	float* min_value_;
-	float* max_value_;
+struct copy_cached_glyphs_param
+{
+	glyph_cache const * cache;
+	uint32_t const * chars;
+	font_info const * char_info;
+	float* char_dist_data;
+	uint32_t char_size_sq;
+	uint32_t s;
+	uint32_t e;
 };
 
+void copy_cached_glyphs(copy_cached_glyphs_param const & param)
+{
+	for (uint32_t i = param.s; i < param.e; ++ i)
+	{
+		uint32_t const ch = param.chars[i];
+		cached_glyph const & glyph = param.cache->find(ch)->second;
+		std::copy(glyph.dist.begin(), glyph.dist.end(), &param.char_dist_data[param.char_info[ch].dist_index]);
+	}
+}
+
 void compute_distance(std::vector<font_info>& char_info, std::vector<float>& char_dist_data,
-						float& min_value, float& max_value,
+						glyph_cache& cache, std::string const & cache_name,
 						int num_threads, std::vector<uint8_t> const & ttf, int start_code, int end_code,
 						uint32_t internal_char_size, uint32_t char_size)
 {
-	thread_pool tp(1, num_threads);
-
-	std::vector<int32_t> cur_num_char(num_threads, 0);
-
 	std::vector<FT_Library> ft_libs(num_threads);
 	std::vector<FT_Face> ft_faces(num_threads);
-	std::vector<joiner<void> > joiners(num_threads);
 
 	for (int i = 0; i < num_threads; ++ i)
 	{
@@ -507,33 +696,134 @@ void compute_distance(std::vector<font_info>& char_info, std::vector<float>& cha
 		FT_Select_Charmap(ft_faces[i], FT_ENCODING_UNICODE);
 	}
 
+	thread_pool tp(1, num_threads + 1);
+
+	// The cache is read while the threads hash the glyphs, each one with its own face
+	std::vector<uint64_t> hashes(std::max(end_code - start_code + 1, 1));
+	std::vector<uint8_t> mapped(std::max(end_code - start_code + 1, 1), GM_Unmapped);
+	{
+		joiner<bool> cache_joiner = tp(KlayGE::bind(LoadGlyphCache, KlayGE::cref(cache_name), char_size, KlayGE::ref(cache)));
+
+		std::vector<joiner<void> > joiners(num_threads);
+		atomic<int32_t> cur_package(0);
+		for (int i = 0; i < num_threads; ++ i)
+		{
+			hash_glyphs_param param;
+			param.ft_face = ft_faces[i];
+			param.start_code = start_code;
+			param.end_code = end_code;
+			param.internal_char_size = internal_char_size;
+			param.char_size = char_size;
+			param.hashes = &hashes[0];
+			param.mapped = &mapped[0];
+			param.cur_package = &cur_package;
+			joiners[i] = tp(KlayGE::bind(hash_glyphs, param));
+		}
+
+		for (int i = 0; i < num_threads; ++ i)
+		{
+			joiners[i]();
+		}
+		cache_joiner();
+	}
+
+	// Glyphs FreeType can't load are left out, as if the font didn't map them
+	for (int i = start_code; i <= end_code; ++ i)
+	{
+		if (GM_LoadFailed == mapped[i - start_code])
+		{
+			cout << "Can't load the glyph of character " << i << ", skipped." << endl;
+		}
+	}
+
+	// Glyphs with the same hash as in the cache are copied from it. Only the rest go to the threads.
 	std::vector<uint32_t> validate_chars;
+	std::vector<uint64_t> validate_hashes;
+	std::vector<uint32_t> cached_chars;
+	uint32_t num_cached_chars = 0;
 	for (int i = start_code; i <= end_code; ++ i)
 	{
-		uint32_t mapping = FT_Get_Char_Index(ft_faces[0], i);
-		if (mapping > 0)
+		if (GM_Mapped == mapped[i - start_code])
 		{
-			validate_chars.push_back(i);
-			if (static_cast<uint32_t>(-1) == char_info[i].dist_index)
+			uint64_t const hash = hashes[i - start_code];
+
+			KLAYGE_AUTO(iter, cache.find(i));
+			bool const cached = (iter != cache.end()) && (iter->second.hash == hash);
+			if (!cached || !iter->second.dist.empty())
 			{
-				char_info[i].dist_index = static_cast<uint32_t>(char_dist_data.size());
-				char_dist_data.resize(char_dist_data.size() + char_size * char_size);
+				if (static_cast<uint32_t>(-1) == char_info[i].dist_index)
+				{
+					char_info[i].dist_index = static_cast<uint32_t>(char_dist_data.size());
+					char_dist_data.resize(char_dist_data.size() + char_size * char_size);
+				}
+			}
+
+			if (cached)
+			{
+				uint32_t const dist_index = char_info[i].dist_index;
+				char_info[i] = iter->second.info;
+				if (iter->second.dist.empty())
+				{
+					char_info[i].dist_index = static_cast<uint32_t>(-1);
+				}
+				else
+				{
+					char_info[i].dist_index = dist_index;
+					cached_chars.push_back(i);
+				}
+
+				++ num_cached_chars;
+			}
+			else
+			{
+				validate_chars.push_back(i);
+				validate_hashes.push_back(hash);
 			}
 		}
 	}
 
+	if (!cached_chars.empty())
+	{
+		int const num_copy_threads = std::min(num_threads, static_cast<int>(cached_chars.size()));
+		uint32_t const n = (static_cast<uint32_t>(cached_chars.size()) + num_copy_threads - 1) / num_copy_threads;
+		std::vector<joiner<void> > joiners(num_copy_threads);
+		for (int i = 0; i < num_copy_threads; ++ i)
+		{
+			copy_cached_glyphs_param param;
+			param.cache = &cache;
+			param.chars = &cached_chars[0];
+			param.char_info = &char_info[0];
+			param.char_dist_data = &char_dist_data[0];
+			param.char_size_sq = char_size * char_size;
+			param.s = i * n;
+			param.e = std::min(param.s + n, static_cast<uint32_t>(cached_chars.size()));
+			joiners[i] = tp(KlayGE::bind(copy_cached_glyphs, param));
+		}
+
+		for (int i = 0; i < num_copy_threads; ++ i)
+		{
+			joiners[i]();
+		}
+	}
+
+	cout << num_cached_chars << " characters are up to date, " << validate_chars.size() << " to generate." << endl;
+
 	if (!validate_chars.empty())
 	{
-		std::vector<float> max_values(num_threads);
-		std::vector<float> min_values(num_threads);
+		// Small packages, so that a few changed characters still spread over all threads
+		num_threads = std::min(num_threads, static_cast<int>(validate_chars.size()));
+		uint32_t const num_chars_per_package = MathLib::clamp(static_cast<uint32_t>(validate_chars.size()) / (num_threads * 8),
+			1U, 64U);
+
+		std::vector<joiner<void> > joiners(num_threads);
+		std::vector<int32_t> cur_num_char(num_threads, 0);
 		atomic<int32_t> cur_package(0);
 		for (int i = 0; i < num_threads; ++ i)
 		{
 			joiners[i] = tp(ttf_to_dist(ft_libs[i], ft_faces[i], internal_char_size, char_size,
 				&validate_chars[0], &char_info[0], &char_dist_data[0], cur_num_char[i],
 				cur_package, static_cast<uint32_t>(validate_chars.size()),
-				KlayGE::ref(min_values[i]), KlayGE::ref(max_values[i]),
-				i, num_threads, 64));
+				i, num_threads, num_chars_per_package));
 		}
 	
 		Timer timer;
@@ -567,26 +857,34 @@ void compute_distance(std::vector<font_info>& char_info, std::vector<float>& cha
 				}
 			}
 
-			KlayGE::Sleep(1000);
+			// Polls often, so small incremental builds don't wait for the display interval
+			KlayGE::Sleep(50);
 		}
 
-		max_value = -1;
-		min_value = 1;
 		for (int i = 0; i < num_threads; ++ i)
 		{
 			joiners[i]();
-
-			min_value = std::min(min_value, min_values[i]);
-			max_value = std::max(max_value, max_values[i]);
 		}
 
-		if (abs(max_value - min_value) < 2.0f / 65536)
+		for (size_t i = 0; i < validate_chars.size(); ++ i)
 		{
-			max_value = min_value + 2.0f / 65536;
+			int32_t const ch = validate_chars[i];
+			cached_glyph& glyph = cache[ch];
+			glyph.hash = validate_hashes[i];
+			glyph.info = char_info[ch];
+			if (char_info[ch].dist_index != static_cast<uint32_t>(-1))
+			{
+				float const * dist = &char_dist_data[char_info[ch].dist_index];
+				glyph.dist.assign(dist, dist + char_size * char_size);
+			}
+			else
+			{
+				glyph.dist.clear();
+			}
 		}
 	}
 
-	for (int i = 0; i < num_threads; ++ i)
+	for (size_t i = 0; i < ft_faces.size(); ++ i)
 	{
 		FT_Done_Face(ft_faces[i]);
 		FT_Done_FreeType(ft_libs[i]);
@@ -842,15 +1140,15 @@ int main(int argc, char* argv[])
 
 	uint32_t internal_char_size = header.char_size * 4;
 
-	float min_value;
-	float max_value;
+	std::string const cache_name = kfont_name + ".cache";
+	glyph_cache cache;
 
 	Timer timer_total;
 	Timer timer_stage;
 
 	timer_stage.restart();
 	cout << "Compute distance field..." << endl;
-	compute_distance(char_info, char_dist_data, min_value, max_value, 
+	compute_distance(char_info, char_dist_data, cache, cache_name,
 		num_threads, ttf, start_code, end_code, internal_char_size, header.char_size);
 	cout << "\rTime elapsed: " << timer_stage.elapsed() << " s                                        " << endl;
 
@@ -858,14 +1156,28 @@ int main(int argc, char* argv[])
 	cout << "Locate non-empty characters..." << endl;
 	char_index.clear();
 	header.non_empty_chars = 0;
+	// The range covers all characters, including the ones reused from the cache and the previous .kfont
+	float min_value = 1;
+	float max_value = -1;
 	for (size_t i = 0; i < char_info.size(); ++ i)
 	{
 		if (char_info[i].dist_index != static_cast<uint32_t>(-1))
 		{
 			char_index.push_back(std::make_pair(static_cast<int32_t>(i), header.non_empty_chars));
 			++ header.non_empty_chars;
+
+			float const * dist = &char_dist_data[char_info[i].dist_index];
+			for (uint32_t j = 0; j < header.char_size * header.char_size; ++ j)
+			{
+				min_value = std::min(min_value, dist[j]);
+				max_value = std::max(max_value, dist[j]);
+			}
 		}
 	}
+	if (abs(max_value - min_value) < 2.0f / 65536)
+	{
+		max_value = min_value + 2.0f / 65536;
+	}
 
 	std::vector<std::pair<int32_t, std::pair<uint16_t, uint16_t> > > advance;
 	header.validate_chars = 0;
@@ -971,4 +1283,6 @@ int main(int argc, char* argv[])
 
 		kfont_output.Save(kfont_name);
 	}
+
+	SaveGlyphCache(cache_name, header.char_size, cache);
 }
@@ -12,6 +12,7 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <algorithm>
 #include <cstring>
 
 #include <boost/algorithm/string/split.hpp>
@@ -1061,13 +1062,397 @@ namespace
 		}
 	}
 
+	// Size of the LRU cache modeled by the vertex cache optimizer
+	uint32_t const OPT_VERTEX_CACHE_SIZE = 32;
+	// Size of the FIFO post-transform cache used to measure ACMR and ATVR
+	uint32_t const SIM_VERTEX_CACHE_SIZE = 16;
+	// Overdraw ordering is only kept if it doesn't make ACMR worse than this ratio
+	float const OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+	// Average cache miss ratio (misses per triangle). ATVR is misses per vertex.
+	float ComputeACMR(std::vector<uint32_t> const & indices, uint32_t num_vertices, float& atvr)
+	{
+		std::vector<uint32_t> timestamps(num_vertices, 0);
+		uint32_t time = SIM_VERTEX_CACHE_SIZE + 1;
+		uint32_t misses = 0;
+		for (size_t i = 0; i < indices.size(); ++ i)
+		{
+			uint32_t const v = indices[i];
+			if (time - timestamps[v] > SIM_VERTEX_CACHE_SIZE)
+			{
+				timestamps[v] = time;
+				++ time;
+				++ misses;
+			}
+		}
+
+		atvr = (num_vertices > 0) ? static_cast<float>(misses) / num_vertices : 0;
+		return (indices.size() >= 3) ? static_cast<float>(misses) / (indices.size() / 3) : 0;
+	}
+
+	float VertexCacheScore(int cache_pos, uint32_t remaining_valence)
+	{
+		if (0 == remaining_valence)
+		{
+			return -1;
+		}
+
+		float score = 0;
+		if (cache_pos >= 0)
+		{
+			if (cache_pos < 3)
+			{
+				// The last triangle's vertices are penalized a bit, to avoid strips of slivers
+				score = 0.75f;
+			}
+			else
+			{
+				score = pow(1 - (cache_pos - 3) / static_cast<float>(OPT_VERTEX_CACHE_SIZE - 3), 1.5f);
+			}
+		}
+
+		// Vertices with fewer triangles left get higher priority, so that they can be retired
+		score += 2 / sqrt(static_cast<float>(remaining_valence));
+		return score;
+	}
+
+	// Tom Forsyth's linear-speed vertex cache optimization
+	void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t num_vertices)
+	{
+		uint32_t const num_tris = static_cast<uint32_t>(indices.size() / 3);
+		if (num_tris < 2)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> valence(num_vertices, 0);
+		for (size_t i = 0; i < indices.size(); ++ i)
+		{
+			++ valence[indices[i]];
+		}
+
+		std::vector<uint32_t> adj_offsets(num_vertices + 1, 0);
+		for (uint32_t v = 0; v < num_vertices; ++ v)
+		{
+			adj_offsets[v + 1] = adj_offsets[v] + valence[v];
+		}
+		std::vector<uint32_t> adj_tris(indices.size());
+		{
+			std::vector<uint32_t> fill(adj_offsets.begin(), adj_offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++ i)
+			{
+				adj_tris[fill[indices[i]] ++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<int> cache_pos(num_vertices, -1);
+		std::vector<float> vert_scores(num_vertices);
+		for (uint32_t v = 0; v < num_vertices; ++ v)
+		{
+			vert_scores[v] = VertexCacheScore(-1, valence[v]);
+		}
+
+		std::vector<float> tri_scores(num_tris);
+		int best_tri = -1;
+		float best_score = -1;
+		for (uint32_t t = 0; t < num_tris; ++ t)
+		{
+			tri_scores[t] = vert_scores[indices[t * 3 + 0]] + vert_scores[indices[t * 3 + 1]] + vert_scores[indices[t * 3 + 2]];
+			if (tri_scores[t] > best_score)
+			{
+				best_score = tri_scores[t];
+				best_tri = t;
+			}
+		}
+
+		std::vector<char> emitted(num_tris, false);
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> new_cache;
+		cache.reserve(OPT_VERTEX_CACHE_SIZE + 3);
+		new_cache.reserve(OPT_VERTEX_CACHE_SIZE + 3);
+		std::vector<uint32_t> new_indices;
+		new_indices.reserve(indices.size());
+		uint32_t input_cursor = 0;
+		for (uint32_t n = 0; n < num_tris; ++ n)
+		{
+			if (best_tri < 0)
+			{
+				// Dead end, continue with the next triangle in the input order
+				while (emitted[input_cursor])
+				{
+					++ input_cursor;
+				}
+				best_tri = input_cursor;
+			}
+
+			emitted[best_tri] = true;
+			uint32_t const tri[3] = { indices[best_tri * 3 + 0], indices[best_tri * 3 + 1], indices[best_tri * 3 + 2] };
+			new_indices.insert(new_indices.end(), tri, tri + 3);
+
+			new_cache.clear();
+			for (int i = 0; i < 3; ++ i)
+			{
+				uint32_t const v = tri[i];
+
+				uint32_t* adj_begin = &adj_tris[adj_offsets[v]];
+				uint32_t* adj_end = adj_begin + valence[v];
+				uint32_t* iter = std::find(adj_begin, adj_end, static_cast<uint32_t>(best_tri));
+				BOOST_ASSERT(iter != adj_end);
+				std::swap(*iter, *(adj_end - 1));
+				-- valence[v];
+
+				if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+				{
+					new_cache.push_back(v);
+				}
+			}
+			for (size_t i = 0; i < cache.size(); ++ i)
+			{
+				if (std::find(new_cache.begin(), new_cache.end(), cache[i]) == new_cache.end())
+				{
+					new_cache.push_back(cache[i]);
+				}
+			}
+
+			best_tri = -1;
+			best_score = -1;
+			for (size_t i = 0; i < new_cache.size(); ++ i)
+			{
+				uint32_t const v = new_cache[i];
+				cache_pos[v] = (i < OPT_VERTEX_CACHE_SIZE) ? static_cast<int>(i) : -1;
+
+				float const score = VertexCacheScore(cache_pos[v], valence[v]);
+				float const delta = score - vert_scores[v];
+				vert_scores[v] = score;
+
+				for (uint32_t j = adj_offsets[v]; j < adj_offsets[v] + valence[v]; ++ j)
+				{
+					uint32_t const t = adj_tris[j];
+					tri_scores[t] += delta;
+				}
+			}
+			for (size_t i = 0; i < std::min<size_t>(new_cache.size(), OPT_VERTEX_CACHE_SIZE); ++ i)
+			{
+				uint32_t const v = new_cache[i];
+				for (uint32_t j = adj_offsets[v]; j < adj_offsets[v] + valence[v]; ++ j)
+				{
+					uint32_t const t = adj_tris[j];
+					if (tri_scores[t] > best_score)
+					{
+						best_score = tri_scores[t];
+						best_tri = t;
+					}
+				}
+			}
+
+			if (new_cache.size() > OPT_VERTEX_CACHE_SIZE)
+			{
+				new_cache.resize(OPT_VERTEX_CACHE_SIZE);
+			}
+			cache.swap(new_cache);
+		}
+
+		indices.swap(new_indices);
+	}
+
+	// Splits the cache optimized triangles into clusters at the points where the cache is flushed,
+	// and draws the clusters facing outwards first, like Sander et al.'s "Fast Triangle Reordering".
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, std::vector<float3> const & positions)
+	{
+		uint32_t const num_vertices = static_cast<uint32_t>(positions.size());
+		uint32_t const num_tris = static_cast<uint32_t>(indices.size() / 3);
+		if (num_tris < 2)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> cluster_starts;
+		{
+			std::vector<uint32_t> timestamps(num_vertices, 0);
+			uint32_t time = SIM_VERTEX_CACHE_SIZE + 1;
+			for (uint32_t t = 0; t < num_tris; ++ t)
+			{
+				uint32_t tri_misses = 0;
+				for (int i = 0; i < 3; ++ i)
+				{
+					uint32_t const v = indices[t * 3 + i];
+					if (time - timestamps[v] > SIM_VERTEX_CACHE_SIZE)
+					{
+						timestamps[v] = time;
+						++ time;
+						++ tri_misses;
+					}
+				}
+				if ((0 == t) || (3 == tri_misses))
+				{
+					cluster_starts.push_back(t);
+				}
+			}
+			cluster_starts.push_back(num_tris);
+		}
+		if (cluster_starts.size() <= 2)
+		{
+			return;
+		}
+
+		float3 mesh_center(0, 0, 0);
+		float mesh_area = 0;
+		std::vector<float3> cluster_centers(cluster_starts.size() - 1);
+		std::vector<float3> cluster_normals(cluster_starts.size() - 1);
+		for (size_t c = 0; c < cluster_starts.size() - 1; ++ c)
+		{
+			float3 center(0, 0, 0);
+			float3 normal(0, 0, 0);
+			float area = 0;
+			for (uint32_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++ t)
+			{
+				float3 const & p0 = positions[indices[t * 3 + 0]];
+				float3 const & p1 = positions[indices[t * 3 + 1]];
+				float3 const & p2 = positions[indices[t * 3 + 2]];
+
+				float3 const n = MathLib::cross(p1 - p0, p2 - p0);
+				float const tri_area = MathLib::length(n);
+				center += (p0 + p1 + p2) * (tri_area / 3);
+				normal += n;
+				area += tri_area;
+			}
+
+			mesh_center += center;
+			mesh_area += area;
+			cluster_centers[c] = (area > 0) ? center / area : positions[indices[cluster_starts[c] * 3]];
+			float const normal_len = MathLib::length(normal);
+			cluster_normals[c] = (normal_len > 0) ? normal / normal_len : float3(0, 0, 0);
+		}
+		if (mesh_area > 0)
+		{
+			mesh_center /= mesh_area;
+		}
+
+		std::vector<std::pair<float, uint32_t> > cluster_order(cluster_centers.size());
+		for (size_t c = 0; c < cluster_centers.size(); ++ c)
+		{
+			cluster_order[c] = std::make_pair(-MathLib::dot(cluster_centers[c] - mesh_center, cluster_normals[c]),
+				static_cast<uint32_t>(c));
+		}
+		std::stable_sort(cluster_order.begin(), cluster_order.end());
+
+		std::vector<uint32_t> new_indices;
+		new_indices.reserve(indices.size());
+		for (size_t i = 0; i < cluster_order.size(); ++ i)
+		{
+			uint32_t const c = cluster_order[i].second;
+			new_indices.insert(new_indices.end(), indices.begin() + cluster_starts[c] * 3, indices.begin() + cluster_starts[c + 1] * 3);
+		}
+
+		float old_atvr, new_atvr;
+		float const old_acmr = ComputeACMR(indices, num_vertices, old_atvr);
+		float const new_acmr = ComputeACMR(new_indices, num_vertices, new_atvr);
+		if (new_acmr <= old_acmr * OVERDRAW_ACMR_THRESHOLD)
+		{
+			indices.swap(new_indices);
+		}
+	}
+
+	// Renumbers the vertices in the order they are first used. remap maps the old indices to the new ones.
+	void OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t num_vertices, std::vector<uint32_t>& remap)
+	{
+		uint32_t const UNUSED = 0xFFFFFFFF;
+
+		remap.assign(num_vertices, UNUSED);
+		uint32_t next_vertex = 0;
+		for (size_t i = 0; i < indices.size(); ++ i)
+		{
+			uint32_t& v = indices[i];
+			if (UNUSED == remap[v])
+			{
+				remap[v] = next_vertex;
+				++ next_vertex;
+			}
+			v = remap[v];
+		}
+
+		// Unreferenced vertices are kept at the end
+		for (uint32_t v = 0; v < num_vertices; ++ v)
+		{
+			if (UNUSED == remap[v])
+			{
+				remap[v] = next_vertex;
+				++ next_vertex;
+			}
+		}
+	}
+
+	void OptimizeMeshForGPU(std::string const & mesh_name, std::vector<int16_t> const & positions, AABBox const & pos_bb,
+		uint32_t num_vertices, uint32_t base_vertex, uint32_t num_indices, uint32_t start_index,
+		std::vector<vertex_element> const & merged_ves, std::vector<std::vector<uint8_t> >& merged_vertices,
+		std::vector<uint8_t>& merged_indices, bool quiet)
+	{
+		if ((0 == num_vertices) || (num_indices < 3) || (positions.size() != num_vertices * 4))
+		{
+			return;
+		}
+
+		std::vector<uint32_t> indices(num_indices);
+		std::memcpy(&indices[0], &merged_indices[start_index * sizeof(uint32_t)], num_indices * sizeof(uint32_t));
+		for (uint32_t i = 0; i < num_indices; ++ i)
+		{
+			if (indices[i] >= num_vertices)
+			{
+				return;
+			}
+		}
+
+		float old_atvr;
+		float const old_acmr = ComputeACMR(indices, num_vertices, old_atvr);
+
+		OptimizeVertexCache(indices, num_vertices);
+
+		{
+			float3 const pos_center = pos_bb.Center();
+			float3 const pos_extent = pos_bb.HalfSize();
+			std::vector<float3> mesh_positions(num_vertices);
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				float3 pos((positions[v * 4 + 0] + 32768) / 65535.0f, (positions[v * 4 + 1] + 32768) / 65535.0f,
+					(positions[v * 4 + 2] + 32768) / 65535.0f);
+				mesh_positions[v] = (pos - 0.5f) * 2 * pos_extent + pos_center;
+			}
+			OptimizeOverdraw(indices, mesh_positions);
+		}
+
+		std::vector<uint32_t> remap;
+		OptimizeVertexFetch(indices, num_vertices, remap);
+
+		std::memcpy(&merged_indices[start_index * sizeof(uint32_t)], &indices[0], num_indices * sizeof(uint32_t));
+
+		std::vector<uint8_t> old_vertices;
+		for (size_t i = 0; i < merged_vertices.size(); ++ i)
+		{
+			uint32_t const elem_size = merged_ves[i].element_size();
+			uint8_t* mesh_vertices = &merged_vertices[i][base_vertex * elem_size];
+			old_vertices.assign(mesh_vertices, mesh_vertices + num_vertices * elem_size);
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				std::memcpy(mesh_vertices + remap[v] * elem_size, &old_vertices[v * elem_size], elem_size);
+			}
+		}
+
+		if (!quiet)
+		{
+			float new_atvr;
+			float const new_acmr = ComputeACMR(indices, num_vertices, new_atvr);
+			cout << mesh_name << ": ACMR " << old_acmr << " -> " << new_acmr
+				<< ", ATVR " << old_atvr << " -> " << new_atvr << endl;
+		}
+	}
+
 	void CompileMeshesChunk(XMLNodePtr const & meshes_chunk,
 		std::vector<std::string>& mesh_names, std::vector<int32_t>& mtl_ids,
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs, 
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
 		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_start_indices,
 		std::vector<vertex_element>& merged_ves, std::vector<std::vector<uint8_t> >& merged_vertices,
-		std::vector<uint8_t>& merged_indices, char& is_index_16_bit)
+		std::vector<uint8_t>& merged_indices, char& is_index_16_bit, bool quiet)
 	{
 		mesh_names.clear();
 		mtl_ids.clear();
@@ -1139,6 +1524,14 @@ namespace
 				AppendMeshIndices(triangle_indices, is_index_16s,
 					mesh_num_indices, mesh_start_indices, merged_indices,
 					is_index_16_bit);
+
+				if (vertices_chunk)
+				{
+					OptimizeMeshForGPU(mesh_names.back(), positions, pos_bbs[mesh_index],
+						mesh_num_vertices.back(), mesh_base_vertices[mesh_base_vertices.size() - 2],
+						mesh_num_indices.back(), mesh_start_indices[mesh_start_indices.size() - 2],
+						merged_ves, merged_vertices, merged_indices, quiet);
+				}
 			}
 		}
 
@@ -1803,7 +2196,8 @@ namespace
 		}
 	}
 
-	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform)
+	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform,
+		bool quiet)
 	{
 		std::ostringstream ss;
 
@@ -1847,7 +2241,7 @@ namespace
 				mesh_num_vertices, mesh_base_vertices,
 				mesh_num_indices, mesh_start_indices,
 				merged_ves, merged_vertices, merged_indices,
-				is_index_16_bit);
+				is_index_16_bit, quiet);
 		}
 		{
 			uint32_t num_meshes = Native2LE(static_cast<uint32_t>(pos_bbs.size()));
@@ -2040,7 +2434,7 @@ int main(int argc, char* argv[])
 
 	std::string output_name = (target_folder / filesystem::path(file_name)).string() + JIT_EXT_NAME;
 
-	MeshMLJIT(meshml_name, output_name, platform);
+	MeshMLJIT(meshml_name, output_name, platform, quiet);
 
 	if (!quiet)
 	{
@@ -10,6 +10,8 @@
 #include <vector>
 #include <cstring>
 
+#include "TexTools.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -30,97 +32,6 @@ namespace
 		}
 	}
 
-	void CompressNormalMapSubresource(uint32_t width, uint32_t height, std::vector<Color>& in_data,
-		ElementFormat new_format, ElementInitData& new_data, std::vector<uint8_t>& new_data_block)
-	{
-		TexCompressionBC4 bc4_codec;
-
-		if (IsCompressedFormat(new_format))
-		{
-			new_data.row_pitch = (width + 3) / 4 * 16;
-			new_data.slice_pitch = new_data.row_pitch * (height + 3) / 4;
-		}
-		else
-		{
-			new_data.row_pitch = width * 2;
-			new_data.slice_pitch = new_data.row_pitch * height;
-		}
-		new_data_block.resize(new_data.slice_pitch);
-		new_data.data = &new_data_block[0];
-
-		uint8_t* com_normals = &new_data_block[0];
-
-		int dest = 0;
-		for (uint32_t y_base = 0; y_base < height; y_base += 4)
-		{
-			for (uint32_t x_base = 0; x_base < width; x_base += 4)
-			{
-				uint8_t uncom_x[16];
-				uint8_t uncom_y[16];
-				for (uint32_t dy = 0; dy < 4; ++ dy)
-				{
-					uint32_t y = MathLib::clamp(y_base + dy, 0U, height - 1);
-					for (uint32_t dx = 0; dx < 4; ++ dx)
-					{
-						uint32_t x = MathLib::clamp(x_base + dx, 0U, width - 1);
-
-						float3 n;
-						n.x() = in_data[y * width + x].r() * 2 - 1;
-						n.y() = in_data[y * width + x].g() * 2 - 1;
-						n.z() = in_data[y * width + x].b() * 2 - 1;
-						n = MathLib::normalize(n);
-
-						uncom_x[dy * 4 + dx] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.x() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
-						uncom_y[dy * 4 + dx] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.y() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
-					}
-				}
-
-				if (IsCompressedFormat(new_format))
-				{
-					BC4Block x_bc4;
-					bc4_codec.EncodeBlock(&x_bc4, uncom_x, TCM_Quality);
-					BC4Block y_bc4;
-					bc4_codec.EncodeBlock(&y_bc4, uncom_y, TCM_Quality);
-
-					if (EF_BC5 == new_format)
-					{
-						BC5Block com_bc5;
-						com_bc5.red = x_bc4;
-						com_bc5.green = y_bc4;
-
-						std::memcpy(&com_normals[dest], &com_bc5, sizeof(com_bc5));
-						dest += sizeof(com_bc5);
-					}
-					else
-					{
-						BOOST_ASSERT(EF_BC3 == new_format);
-
-						BC3Block com_bc3;
-						com_bc3.alpha = x_bc4;
-
-						BC4ToBC1G(com_bc3.bc1, y_bc4);
-
-						std::memcpy(&com_normals[dest], &com_bc3, sizeof(com_bc3));
-						dest += sizeof(com_bc3);
-					}
-				}
-				else
-				{
-					BOOST_ASSERT(EF_GR8 == new_format);
-
-					for (int y = 0; y < 4; ++ y)
-					{
-						for (int x = 0; x < 4; ++ x)
-						{
-							com_normals[(y_base + y) * new_data.row_pitch + (x_base + x) * 2 + 0] = uncom_x[y * 4 + x];
-							com_normals[(y_base + y) * new_data.row_pitch + (x_base + x) * 2 + 1] = uncom_y[y * 4 + x];
-						}
-					}
-				}
-			}
-		}
-	}
-
 	void DecompressNormalMapSubresource(uint32_t width, uint32_t height, ElementFormat restored_format, 
 		ElementInitData& restored_data, std::vector<uint8_t>& restored_data_block, ElementFormat com_format, ElementInitData const & com_data)
 	{
@@ -270,67 +181,21 @@ namespace
 
 	void CompressNormalMap(std::string const & in_file, std::string const & out_file, ElementFormat new_format)
 	{
-		Texture::TextureType in_type;
-		uint32_t in_width, in_height, in_depth;
-		uint32_t in_num_mipmaps;
-		uint32_t in_array_size;
-		ElementFormat in_format;
-		std::vector<ElementInitData> in_data;
-		std::vector<uint8_t> in_data_block;
-		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
-
-		uint32_t out_width = (in_width + 3) & ~3;
-		uint32_t out_height = (in_height + 3) & ~3;
-
-		std::vector<std::vector<Color> > in_color(in_data.size());
-		for (size_t sub_res = 0; sub_res < in_array_size; ++ sub_res)
-		{
-			uint32_t src_width = in_width;
-			uint32_t src_height = in_height;
-
-			uint32_t dst_width = out_width;
-			uint32_t dst_height = out_height;
-
-			for (uint32_t mip = 0; mip < in_num_mipmaps; ++ mip)
-			{
-				in_color[sub_res * in_num_mipmaps + mip].resize(dst_width * dst_height);
-
-				ResizeTexture(&in_color[sub_res * in_num_mipmaps + mip][0],
-					dst_width * sizeof(Color), dst_width * dst_height * sizeof(Color),
-					EF_ABGR32F, dst_width, dst_height, 1,
-					in_data[sub_res * in_num_mipmaps + mip].data,
-					in_data[sub_res * in_num_mipmaps + mip].row_pitch,
-					in_data[sub_res * in_num_mipmaps + mip].slice_pitch,
-					in_format, src_width, src_height, 1,
-					true);
-
-				src_width = std::max(src_width / 2, 1U);
-				src_height = std::max(src_height / 2, 1U);
-
-				dst_width = std::max(dst_width / 2, 1U);
-				dst_height = std::max(dst_height / 2, 1U);
-			}
-		}
-
-		std::vector<ElementInitData> new_data(in_data.size());
-		std::vector<std::vector<uint8_t> > new_data_block(in_data.size());
-
-		for (size_t sub_res = 0; sub_res < in_array_size; ++ sub_res)
-		{
-			uint32_t the_width = out_width;
-			uint32_t the_height = out_height;
-
-			for (uint32_t mip = 0; mip < in_num_mipmaps; ++ mip)
-			{
-				CompressNormalMapSubresource(the_width, the_height, in_color[sub_res * in_num_mipmaps + mip], new_format,
-					new_data[sub_res * in_num_mipmaps + mip], new_data_block[sub_res * in_num_mipmaps + mip]);
-
-				the_width = std::max(the_width / 2, 1U);
-				the_height = std::max(the_height / 2, 1U);
-			}
-		}
-
-		SaveTexture(out_file, in_type, out_width, out_height, in_depth, in_num_mipmaps, in_array_size, new_format, new_data);
+		TexImage in_tex;
+		LoadTexImage(in_file, in_tex);
+
+		// The copy shares the source data with in_tex, which is kept for measuring the error
+		TexImage new_tex = in_tex;
+		CompressNormalMap(new_tex, new_format);
+		SaveTexImage(out_file, new_tex);
+
+		uint32_t const in_width = in_tex.width;
+		uint32_t const in_height = in_tex.height;
+		uint32_t const in_num_mipmaps = in_tex.num_mipmaps;
+		uint32_t const in_array_size = in_tex.array_size;
+		ElementFormat const in_format = in_tex.format;
+		std::vector<ElementInitData> const & in_data = in_tex.data;
+		std::vector<ElementInitData> const & new_data = new_tex.data;
 
 		float mse = 0;
 		int n = 0;
@@ -1,13 +1,21 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/CpuInfo.hpp>
 #include <KlayGE/JudaTexture.hpp>
+#include <KlayGE/Texture.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/XMLDom.hpp>
 
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <set>
+#include <cstring>
 
 #include <boost/algorithm/string/case_conv.hpp>
 
@@ -59,6 +67,8 @@
 #pragma warning(pop)
 #endif
 
+#include "TexTools.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -187,85 +197,146 @@ OfflineRenderDeviceCaps LoadPlatformConfig(std::string const & platform)
 	return caps;
 }
 
-void Deploy(std::vector<std::string> const & res_names, std::string const & res_type, OfflineRenderDeviceCaps const & caps)
+std::string const MANIFEST_NAME = "PlatformDeployer.manifest";
+uint32_t const DEPLOYER_VERSION = 3;
+
+struct ManifestEntry
+{
+	uint64_t content_hash;
+	uint64_t settings_hash;
+};
+
+mutex output_mutex;
+
+void Report(std::string const & res_name, std::string const & msg)
+{
+	unique_lock<mutex> lock(output_mutex);
+	cout << res_name << ": " << msg << endl;
+}
+
+// 64-bit FNV-1a
+uint64_t HashData(uint64_t seed, void const * data, size_t size)
+{
+	uint8_t const * p = static_cast<uint8_t const *>(data);
+	for (size_t i = 0; i < size; ++ i)
+	{
+		seed ^= p[i];
+		seed *= 0x100000001B3ULL;
+	}
+	return seed;
+}
+
+uint64_t HashData(void const * data, size_t size)
+{
+	return HashData(0xCBF29CE484222325ULL, data, size);
+}
+
+bool ReadFileContent(std::string const & name, std::vector<uint8_t>& content)
+{
+	std::ifstream ifs(name.c_str(), std::ios_base::binary);
+	if (!ifs)
+	{
+		return false;
+	}
+
+	ifs.seekg(0, std::ios_base::end);
+	content.resize(static_cast<size_t>(ifs.tellg()));
+	ifs.seekg(0, std::ios_base::beg);
+	if (!content.empty())
+	{
+		ifs.read(reinterpret_cast<char*>(&content[0]), content.size());
+	}
+	return !ifs.fail();
+}
+
+void LoadManifest(std::map<std::string, ManifestEntry>& manifest)
+{
+	std::ifstream ifs(MANIFEST_NAME.c_str());
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		std::istringstream iss(line);
+		ManifestEntry entry;
+		iss >> std::hex >> entry.content_hash >> entry.settings_hash;
+		std::string name;
+		std::getline(iss >> std::ws, name);
+		if (iss && !name.empty())
+		{
+			manifest[name] = entry;
+		}
+	}
+}
+
+void SaveManifest(std::map<std::string, ManifestEntry> const & manifest)
+{
+	std::ofstream ofs(MANIFEST_NAME.c_str());
+	typedef KLAYGE_DECLTYPE(manifest) ManifestType;
+	KLAYGE_FOREACH(ManifestType::const_reference entry, manifest)
+	{
+		ofs << std::hex << std::setfill('0') << std::setw(16) << entry.second.content_hash << ' '
+			<< std::setw(16) << entry.second.settings_hash << ' ' << entry.first << std::endl;
+	}
+}
+
+// The conversion steps for a resource type on a platform. Also serves as the settings part of the manifest.
+struct DeployRecipe
+{
+	bool force_srgb;
+	bool bump_to_normal;
+	bool gen_mipmap;
+	ElementFormat tex_fmt;
+	ElementFormat normal_fmt;
+	std::string command;
+
+	std::string Settings(std::string const & res_type, OfflineRenderDeviceCaps const & caps) const
+	{
+		std::ostringstream ss;
+		ss << DEPLOYER_VERSION << ' ' << res_type << ' ' << caps.platform
+			<< ' ' << force_srgb << ' ' << bump_to_normal << ' ' << gen_mipmap
+			<< ' ' << tex_fmt << ' ' << normal_fmt << ' ' << command;
+		return ss.str();
+	}
+};
+
+DeployRecipe MakeRecipe(std::string const & res_type, OfflineRenderDeviceCaps const & caps)
 {
-	std::ofstream ofs("convert.bat");
+	DeployRecipe recipe;
+	recipe.force_srgb = false;
+	recipe.bump_to_normal = false;
+	recipe.gen_mipmap = false;
+	recipe.tex_fmt = EF_Unknown;
+	recipe.normal_fmt = EF_Unknown;
 
-	ofs << "@echo off" << std::endl << std::endl;
-	
 	if (("diffuse" == res_type)
 		|| ("specular" == res_type)
 		|| ("emit" == res_type))
 	{
-		for (size_t i = 0; i < res_names.size(); ++i)
+		recipe.force_srgb = caps.srgb_support;
+		recipe.gen_mipmap = true;
+		if (caps.bc7_support)
 		{
-			if (caps.srgb_support)
-			{
-				ofs << "ForceTexSRGB \"" << res_names[i] << "\" temp.dds" << std::endl;
-			}
-			else
-			{
-				ofs << "copy \"" << res_names[i] << "\" temp.dds" << std::endl;
-			}
-			ofs << "Mipmapper temp.dds" << std::endl;
-			if (caps.bc7_support)
-			{
-				ofs << "TexCompressor BC7 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else if (caps.bc1_support)
-			{
-				ofs << "TexCompressor BC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else if (caps.etc1_support)
-			{
-				ofs << "TexCompressor ETC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else
-			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			ofs << "del temp.dds" << std::endl;
+			recipe.tex_fmt = EF_BC7;
 		}
-	}
-	else if ("normal" == res_type)
-	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		else if (caps.bc1_support)
 		{
-			ofs << "Mipmapper \"" << res_names[i] << "\" temp.dds" << std::endl;
-			if (caps.bc5_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC5" << std::endl;
-			}
-			else if (caps.bc3_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC3" << std::endl;
-			}
-			else
-			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			ofs << "del temp.dds" << std::endl;
+			recipe.tex_fmt = EF_BC1;
+		}
+		else if (caps.etc1_support)
+		{
+			recipe.tex_fmt = EF_ETC1;
 		}
 	}
-	else if ("bump" == res_type)
+	else if (("normal" == res_type) || ("bump" == res_type))
 	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		recipe.bump_to_normal = ("bump" == res_type);
+		recipe.gen_mipmap = true;
+		if (caps.bc5_support)
 		{
-			ofs << "Bump2Normal \"" << res_names[i] << "\" temp.dds 0.4" << std::endl;
-			ofs << "Mipmapper temp.dds" << std::endl; 
-			if (caps.bc5_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC5" << std::endl;
-			}
-			else if (caps.bc3_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC3" << std::endl;
-			}
-			else
-			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			ofs << "del temp.dds" << std::endl;
+			recipe.normal_fmt = EF_BC5;
+		}
+		else if (caps.bc3_support)
+		{
+			recipe.normal_fmt = EF_BC3;
 		}
 	}
 	else if ("cubemap" == res_type)
@@ -289,34 +360,401 @@ void Deploy(std::vector<std::string> const & res_names, std::string const & res_
 			c_fmt = "BC3";
 		}
 
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		recipe.command = "HDRCompressor \"%s\" " + y_fmt + ' ' + c_fmt;
+	}
+	else if ("model" == res_type)
+	{
+		recipe.command = "MeshMLJIT -I \"%s\" -P " + caps.platform;
+	}
+	else if ("effect" == res_type)
+	{
+		recipe.command = "FXMLJIT " + caps.platform + " \"%s\"";
+	}
+
+	return recipe;
+}
+
+std::string ParentFolder(std::string const & name)
+{
+	std::string folder = filesystem::path(name).parent_path().string();
+	if (!folder.empty())
+	{
+		folder.push_back('/');
+	}
+	return folder;
+}
+
+// Looks next to the resource that refers to the file first, then in the ResLoader paths
+std::string LocateDependency(std::string const & name, std::string const & referrer)
+{
+	std::string const local_name = ParentFolder(referrer) + name;
+	if (filesystem::exists(filesystem::path(local_name)))
+	{
+		return local_name;
+	}
+	return ResLoader::Instance().Locate(name);
+}
+
+void CollectEffectDependencies(std::string const & fxml_name, std::set<std::string>& deps)
+{
+	try
+	{
+		KlayGE::XMLDocument doc;
+		XMLNodePtr root = doc.Parse(ResLoader::Instance().Open(fxml_name));
+		for (XMLNodePtr node = root->FirstNode("include"); node; node = node->NextSibling("include"))
 		{
-			
-			ofs << "HDRCompressor \"" << res_names[i] << "\" " << y_fmt << ' ' << c_fmt << std::endl;
+			XMLAttributePtr attr = node->Attrib("name");
+			if (attr)
+			{
+				std::string include_name = LocateDependency(attr->ValueString(), fxml_name);
+				if (include_name.empty())
+				{
+					// Still recorded, so the resource is deployed again once the include shows up
+					include_name = attr->ValueString();
+				}
+				if (deps.insert(include_name).second)
+				{
+					CollectEffectDependencies(include_name, deps);
+				}
+			}
 		}
 	}
+	catch (...)
+	{
+		// A broken or missing file has no dependencies. The deploy tool reports the error.
+	}
+}
+
+void CollectModelDependencies(std::string const & meshml_name, std::set<std::string>& deps)
+{
+	try
+	{
+		KlayGE::XMLDocument doc;
+		XMLNodePtr root = doc.Parse(ResLoader::Instance().Open(meshml_name));
+		XMLNodePtr materials_chunk = root->FirstNode("materials_chunk");
+		if (materials_chunk)
+		{
+			for (XMLNodePtr mtl_node = materials_chunk->FirstNode("material"); mtl_node; mtl_node = mtl_node->NextSibling("material"))
+			{
+				XMLNodePtr tex_node = mtl_node->FirstNode("texture");
+				if (!tex_node)
+				{
+					XMLNodePtr textures_chunk = mtl_node->FirstNode("textures_chunk");
+					if (textures_chunk)
+					{
+						tex_node = textures_chunk->FirstNode("texture");
+					}
+				}
+				for (; tex_node; tex_node = tex_node->NextSibling("texture"))
+				{
+					XMLAttributePtr attr = tex_node->Attrib("name");
+					if (attr)
+					{
+						std::string tex_name = LocateDependency(attr->ValueString(), meshml_name);
+						deps.insert(tex_name.empty() ? attr->ValueString() : tex_name);
+					}
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+	}
+}
+
+// Folds the names and contents of the files a resource pulls in into its hash,
+// so that editing an include or a texture deploys the resource again
+uint64_t HashDependencies(uint64_t seed, std::string const & res_name, std::string const & res_type)
+{
+	std::set<std::string> deps;
+	if ("effect" == res_type)
+	{
+		CollectEffectDependencies(res_name, deps);
+	}
 	else if ("model" == res_type)
 	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		CollectModelDependencies(res_name, deps);
+	}
+
+	std::vector<uint8_t> content;
+	typedef KLAYGE_DECLTYPE(deps) DepsType;
+	KLAYGE_FOREACH(DepsType::const_reference dep, deps)
+	{
+		seed = HashData(seed, dep.c_str(), dep.size() + 1);
+		if (ReadFileContent(dep, content))
+		{
+			seed = HashData(seed, content.empty() ? nullptr : &content[0], content.size());
+		}
+		else
+		{
+			uint8_t const missing = 0xFF;
+			seed = HashData(seed, &missing, sizeof(missing));
+		}
+	}
+	return seed;
+}
+
+// The files a deploy writes. Textures are converted in place, so they have none besides the resource itself.
+std::vector<std::string> DeployOutputs(std::string const & res_name, std::string const & res_type)
+{
+	std::vector<std::string> outputs;
+	filesystem::path res_path(res_name);
+#ifdef KLAYGE_TR2_LIBRARY_FILESYSTEM_V2_SUPPORT
+	std::string const file_name = res_path.filename();
+	std::string const stem = res_path.stem();
+	std::string const ext = res_path.extension();
+#else
+	std::string const file_name = res_path.filename().string();
+	std::string const stem = res_path.stem().string();
+	std::string const ext = res_path.extension().string();
+#endif
+	if ("cubemap" == res_type)
+	{
+		// HDRCompressor writes to the current folder
+		outputs.push_back(stem + "_y" + ext);
+		outputs.push_back(stem + "_c" + ext);
+	}
+	else if ("model" == res_type)
+	{
+		// MeshMLJIT appends the extension of its binary format to the whole file name.
+		// It's taken from the files on disk, so the deployer follows the converter when the format changes.
+		std::string const prefix = file_name + '.';
+		filesystem::path folder = res_path.parent_path();
+		if (folder.empty())
+		{
+			folder = ".";
+		}
+		if (filesystem::is_directory(folder))
+		{
+			filesystem::directory_iterator end_itr;
+			for (filesystem::directory_iterator i(folder); i != end_itr; ++ i)
+			{
+				if (filesystem::is_regular_file(i->status()))
+				{
+#ifdef KLAYGE_TR2_LIBRARY_FILESYSTEM_V2_SUPPORT
+					std::string const name = i->path().filename();
+#else
+					std::string const name = i->path().filename().string();
+#endif
+					if ((name.size() > prefix.size()) && (0 == name.compare(0, prefix.size(), prefix)))
+					{
+						outputs.push_back(ParentFolder(res_name) + name);
+					}
+				}
+			}
+		}
+		if (outputs.empty())
 		{
-			ofs << "MeshMLJIT -I \"" << res_names[i] << "\" -P " << caps.platform << std::endl;
+			// Nothing converted yet. An empty name never exists.
+			outputs.push_back(std::string());
 		}
 	}
 	else if ("effect" == res_type)
 	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		outputs.push_back(ParentFolder(res_name) + stem + ".kfx");
+	}
+	return outputs;
+}
+
+bool OutputsExist(std::vector<std::string> const & outputs)
+{
+	for (size_t i = 0; i < outputs.size(); ++ i)
+	{
+		if (!filesystem::exists(filesystem::path(outputs[i])))
 		{
-			ofs << "FXMLJIT " << caps.platform << " \"" << res_names[i] << "\"" << std::endl;
+			return false;
 		}
 	}
+	return true;
+}
 
-	ofs.close();
+bool DeployTexture(std::string const & res_name, std::vector<uint8_t> const & content, DeployRecipe const & recipe)
+{
+	TexImage tex;
+	{
+		shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
+		if (!content.empty())
+		{
+			ss->write(reinterpret_cast<char const *>(&content[0]), content.size());
+		}
+		LoadTexImage(MakeSharedPtr<ResIdentifier>(res_name, 0, ss), tex);
+	}
+	if (tex.data.empty())
+	{
+		Report(res_name, "Couldn't load the texture.");
+		return false;
+	}
 
-	if ((res_type != "cubemap") && (res_type != "model") && (res_type != "effect"))
+	if (recipe.bump_to_normal)
 	{
-		system("convert.bat");
-		system("del convert.bat");
+		Bump2NormalMap(tex, 0.4f);
 	}
+	if (recipe.force_srgb)
+	{
+		if (IsSRGB(tex.format))
+		{
+			Report(res_name, "This texture is already in sRGB format.");
+		}
+		else if (!ForceTexSRGB(tex))
+		{
+			Report(res_name, "This texture format don't have a sRGB counterpart.");
+		}
+	}
+	if (recipe.gen_mipmap)
+	{
+		GenMipmap(tex);
+	}
+	if (recipe.tex_fmt != EF_Unknown)
+	{
+		if (!CompressTex(tex, recipe.tex_fmt, TCM_Quality))
+		{
+			Report(res_name, "This texture is already in compressed format.");
+		}
+	}
+	if (recipe.normal_fmt != EF_Unknown)
+	{
+		CompressNormalMap(tex, recipe.normal_fmt);
+	}
+
+	SaveTexImage(res_name, tex);
+	return true;
+}
+
+bool DeployWithTool(std::string const & res_name, DeployRecipe const & recipe)
+{
+	std::string cmd = recipe.command;
+	cmd.replace(cmd.find("%s"), 2, res_name);
+	return 0 == system(cmd.c_str());
+}
+
+class deploy_worker
+{
+public:
+	deploy_worker(std::vector<std::string> const & res_names, std::string const & res_type, DeployRecipe const & recipe,
+		uint64_t settings_hash, bool force, std::map<std::string, ManifestEntry>& manifest, mutex& manifest_mutex,
+		atomic<int32_t>& cur_res, atomic<int32_t>& num_skipped, atomic<int32_t>& num_failed)
+		: res_names_(&res_names), res_type_(&res_type), recipe_(&recipe), settings_hash_(settings_hash), force_(force),
+			manifest_(&manifest), manifest_mutex_(&manifest_mutex), cur_res_(&cur_res),
+			num_skipped_(&num_skipped), num_failed_(&num_failed)
+	{
+	}
+
+	void operator()()
+	{
+		int32_t const num_res = static_cast<int32_t>(res_names_->size());
+		int32_t res_index;
+		while ((res_index = (*cur_res_) ++) < num_res)
+		{
+			std::string const & res_name = (*res_names_)[res_index];
+
+			std::vector<uint8_t> content;
+			if (!ReadFileContent(res_name, content))
+			{
+				Report(res_name, "Couldn't read the file.");
+				++ *num_failed_;
+				continue;
+			}
+			uint64_t content_hash = HashData(content.empty() ? nullptr : &content[0], content.size());
+			content_hash = HashDependencies(content_hash, res_name, *res_type_);
+
+			if (!force_ && OutputsExist(DeployOutputs(res_name, *res_type_)))
+			{
+				unique_lock<mutex> lock(*manifest_mutex_);
+				KLAYGE_AUTO(iter, manifest_->find(res_name));
+				if ((iter != manifest_->end()) && (iter->second.content_hash == content_hash)
+					&& (iter->second.settings_hash == settings_hash_))
+				{
+					++ *num_skipped_;
+					continue;
+				}
+			}
+
+			bool succeeded;
+			if (recipe_->command.empty())
+			{
+				succeeded = DeployTexture(res_name, content, *recipe_);
+				// The textures are converted in place, so the manifest remembers the deployed content
+				if (succeeded)
+				{
+					succeeded = ReadFileContent(res_name, content);
+					content_hash = HashData(content.empty() ? nullptr : &content[0], content.size());
+				}
+			}
+			else
+			{
+				// A tool can exit cleanly without writing anything, e.g. when it can't open the input
+				succeeded = DeployWithTool(res_name, *recipe_) && OutputsExist(DeployOutputs(res_name, *res_type_));
+			}
+
+			if (succeeded)
+			{
+				Report(res_name, "Deployed.");
+
+				ManifestEntry entry;
+				entry.content_hash = content_hash;
+				entry.settings_hash = settings_hash_;
+
+				unique_lock<mutex> lock(*manifest_mutex_);
+				(*manifest_)[res_name] = entry;
+			}
+			else
+			{
+				Report(res_name, "Failed.");
+				++ *num_failed_;
+			}
+		}
+	}
+
+private:
+	std::vector<std::string> const * res_names_;
+	std::string const * res_type_;
+	DeployRecipe const * recipe_;
+	uint64_t settings_hash_;
+	bool force_;
+	std::map<std::string, ManifestEntry>* manifest_;
+	mutex* manifest_mutex_;
+	atomic<int32_t>* cur_res_;
+	atomic<int32_t>* num_skipped_;
+	atomic<int32_t>* num_failed_;
+};
+
+int Deploy(std::vector<std::string> const & res_names, std::string const & res_type, OfflineRenderDeviceCaps const & caps,
+	int num_threads, bool force)
+{
+	DeployRecipe const recipe = MakeRecipe(res_type, caps);
+	std::string const settings = recipe.Settings(res_type, caps);
+	uint64_t const settings_hash = HashData(settings.c_str(), settings.size());
+
+	// Loaded even when forced, so that deploying one type doesn't lose the state of the others
+	std::map<std::string, ManifestEntry> manifest;
+	LoadManifest(manifest);
+	mutex manifest_mutex;
+
+	atomic<int32_t> cur_res(0);
+	atomic<int32_t> num_skipped(0);
+	atomic<int32_t> num_failed(0);
+
+	num_threads = std::max(1, std::min(num_threads, static_cast<int>(res_names.size())));
+	{
+		thread_pool tp(1, num_threads);
+		std::vector<joiner<void> > joiners(num_threads);
+		for (int i = 0; i < num_threads; ++ i)
+		{
+			joiners[i] = tp(deploy_worker(res_names, res_type, recipe, settings_hash, force, manifest, manifest_mutex,
+				cur_res, num_skipped, num_failed));
+		}
+		for (int i = 0; i < num_threads; ++ i)
+		{
+			joiners[i]();
+		}
+	}
+
+	SaveManifest(manifest);
+
+	cout << res_names.size() << " resources, " << static_cast<int32_t>(num_skipped) << " up to date, "
+		<< static_cast<int32_t>(num_failed) << " failed." << endl;
+
+	return (num_failed > 0) ? 1 : 0;
 }
 
 int main(int argc, char* argv[])
@@ -326,6 +764,9 @@ int main(int argc, char* argv[])
 	std::vector<std::string> res_names;
 	std::string res_type;
 	std::string platform;
+	int num_threads;
+
+	CPUInfo cpu;
 
 	boost::program_options::options_description desc("Allowed options");
 	desc.add_options()
@@ -333,6 +774,8 @@ int main(int argc, char* argv[])
 		("input-name,I", boost::program_options::value<std::string>(), "Input resource name.")
 		("type,T", boost::program_options::value<std::string>(), "Resource type.")
 		("platform,P", boost::program_options::value<std::string>(), "Platform name.")
+		("threads,N", boost::program_options::value<int>(&num_threads)->default_value(cpu.NumHWThreads()), "Number of Threads. Default is the number of CPU threads.")
+		("force,F", "Deploy all resources, even if they are up to date.")
 		("version,v", "Version.");
 
 	boost::program_options::variables_map vm;
@@ -346,7 +789,7 @@ int main(int argc, char* argv[])
 	}
 	if (vm.count("version") > 0)
 	{
-		cout << "KlayGE PlatformDeployer, Version 1.0.0" << endl;
+		cout << "KlayGE PlatformDeployer, Version 2.0.0" << endl;
 		return 1;
 	}
 	if (vm.count("input-name") > 0)
@@ -471,9 +914,9 @@ int main(int argc, char* argv[])
 	}
 
 	OfflineRenderDeviceCaps caps = LoadPlatformConfig(platform);
-	Deploy(res_names, res_type, caps);
+	int ret = Deploy(res_names, res_type, caps, num_threads, vm.count("force") > 0);
 
 	Context::Destroy();
 
-	return 0;
+	return ret;
 }
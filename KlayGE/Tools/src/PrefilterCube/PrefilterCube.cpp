@@ -2,6 +2,7 @@
 #include <KFL/Half.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/Timer.hpp>
+#include <KFL/CpuInfo.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KlayGE/RenderFactory.hpp>
@@ -78,70 +79,71 @@ namespace
 		return MathLib::normalize(dir);
 	}
 
-	void ToAddress(uint32_t& face, uint32_t& x, uint32_t& y, float3 const & dir, uint32_t size)
+	// The face dir points to, and the coordinates on it in [0, 1]
+	void ToFaceCoord(uint32_t& face, float& u, float& v, float3 const & dir)
 	{
-		float3 n_dir = MathLib::normalize(dir);
-		float3 abs_dir = MathLib::abs(n_dir);
+		float3 const abs_dir = MathLib::abs(dir);
 		if (abs_dir.x() > abs_dir.y())
 		{
 			if (abs_dir.x() > abs_dir.z())
 			{
-				face = n_dir.x() > 0 ? Texture::CF_Positive_X : Texture::CF_Negative_X;
+				face = dir.x() > 0 ? Texture::CF_Positive_X : Texture::CF_Negative_X;
 			}
 			else
 			{
-				face = n_dir.z() > 0 ? Texture::CF_Positive_Z : Texture::CF_Negative_Z;
+				face = dir.z() > 0 ? Texture::CF_Positive_Z : Texture::CF_Negative_Z;
 			}
 		}
 		else
 		{
 			if (abs_dir.y() > abs_dir.z())
 			{
-				face = n_dir.y() > 0 ? Texture::CF_Positive_Y : Texture::CF_Negative_Y;
+				face = dir.y() > 0 ? Texture::CF_Positive_Y : Texture::CF_Negative_Y;
 			}
 			else
 			{
-				face = n_dir.z() > 0 ? Texture::CF_Positive_Z : Texture::CF_Negative_Z;
+				face = dir.z() > 0 ? Texture::CF_Positive_Z : Texture::CF_Negative_Z;
 			}
 		}
 
+		float inv;
 		switch (face)
 		{
 		case Texture::CF_Positive_X:
-			n_dir /= abs_dir.x();
-			x = MathLib::clamp(static_cast<uint32_t>((-n_dir.z() * 0.5f + 0.5f) * size), 0U, size - 1);
-			y = MathLib::clamp(static_cast<uint32_t>((-n_dir.y() * 0.5f + 0.5f) * size), 0U, size - 1);
+			inv = 0.5f / abs_dir.x();
+			u = -dir.z() * inv + 0.5f;
+			v = -dir.y() * inv + 0.5f;
 			break;
 
 		case Texture::CF_Negative_X:
-			n_dir /= abs_dir.x();
-			x = MathLib::clamp(static_cast<uint32_t>((+n_dir.z() * 0.5f + 0.5f) * size), 0U, size - 1);
-			y = MathLib::clamp(static_cast<uint32_t>((-n_dir.y() * 0.5f + 0.5f) * size), 0U, size - 1);
+			inv = 0.5f / abs_dir.x();
+			u = +dir.z() * inv + 0.5f;
+			v = -dir.y() * inv + 0.5f;
 			break;
 
 		case Texture::CF_Positive_Y:
-			n_dir /= abs_dir.y();
-			x = MathLib::clamp(static_cast<uint32_t>((+n_dir.x() * 0.5f + 0.5f) * size), 0U, size - 1);
-			y = MathLib::clamp(static_cast<uint32_t>((+n_dir.z() * 0.5f + 0.5f) * size), 0U, size - 1);
+			inv = 0.5f / abs_dir.y();
+			u = +dir.x() * inv + 0.5f;
+			v = +dir.z() * inv + 0.5f;
 			break;
 
 		case Texture::CF_Negative_Y:
-			n_dir /= abs_dir.y();
-			x = MathLib::clamp(static_cast<uint32_t>((+n_dir.x() * 0.5f + 0.5f) * size), 0U, size - 1);
-			y = MathLib::clamp(static_cast<uint32_t>((-n_dir.z() * 0.5f + 0.5f) * size), 0U, size - 1);
+			inv = 0.5f / abs_dir.y();
+			u = +dir.x() * inv + 0.5f;
+			v = -dir.z() * inv + 0.5f;
 			break;
 
 		case Texture::CF_Positive_Z:
-			n_dir /= abs_dir.z();
-			x = MathLib::clamp(static_cast<uint32_t>((+n_dir.x() * 0.5f + 0.5f) * size), 0U, size - 1);
-			y = MathLib::clamp(static_cast<uint32_t>((-n_dir.y() * 0.5f + 0.5f) * size), 0U, size - 1);
+			inv = 0.5f / abs_dir.z();
+			u = +dir.x() * inv + 0.5f;
+			v = -dir.y() * inv + 0.5f;
 			break;
 
 		case Texture::CF_Negative_Z:
 		default:
-			n_dir /= abs_dir.z();
-			x = MathLib::clamp(static_cast<uint32_t>((-n_dir.x() * 0.5f + 0.5f) * size), 0U, size - 1);
-			y = MathLib::clamp(static_cast<uint32_t>((-n_dir.y() * 0.5f + 0.5f) * size), 0U, size - 1);
+			inv = 0.5f / abs_dir.z();
+			u = -dir.x() * inv + 0.5f;
+			v = -dir.y() * inv + 0.5f;
 			break;
 		}
 	}
@@ -174,16 +176,6 @@ namespace
 		return float3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
 	}
 
-	float3 ImportanceSampleLambert(float2 const & xi, float3 const & normal)
-	{
-		float3 h = ImportanceSampleLambert(xi);
-
-		float3 up_vec = abs(normal.z()) < 0.999f ? float3(0, 0, 1) : float3(1, 0, 0);
-		float3 tangent = MathLib::normalize(MathLib::cross(up_vec, normal));
-		float3 binormal = MathLib::cross(normal, tangent);
-		return tangent * h.x() + binormal * h.y() + normal * h.z();
-	}
-
 	float3 ImportanceSampleBP(float2 const & xi, float roughness)
 	{
 		float phi = 2 * PI * xi.x();
@@ -192,131 +184,195 @@ namespace
 		return float3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
 	}
 
-	float3 ImportanceSampleBP(float2 const & xi, float roughness, float3 const & normal)
+	// The input cube map with a box filtered mip chain down to 1x1, for filtered importance sampling
+	struct InputCube
 	{
-		float3 h = ImportanceSampleBP(xi, roughness);
+		std::vector<std::vector<Color> > levels;	// face * num_mipmaps + mip
+		uint32_t width;
+		uint32_t num_mipmaps;
 
-		float3 up_vec = abs(normal.z()) < 0.999f ? float3(0, 0, 1) : float3(1, 0, 0);
-		float3 tangent = MathLib::normalize(MathLib::cross(up_vec, normal));
-		float3 binormal = MathLib::cross(normal, tangent);
-		return tangent * h.x() + binormal * h.y() + normal * h.z();
-	}
+		void GenerateMipmaps()
+		{
+			for (uint32_t face = 0; face < 6; ++ face)
+			{
+				uint32_t src_w = width;
+				for (uint32_t mip = 1; mip < num_mipmaps; ++ mip)
+				{
+					uint32_t const w = std::max<uint32_t>(1U, src_w / 2);
+					std::vector<Color> const & src = levels[face * num_mipmaps + mip - 1];
+					std::vector<Color>& dst = levels[face * num_mipmaps + mip];
+					dst.resize(w * w);
+					for (uint32_t y = 0; y < w; ++ y)
+					{
+						uint32_t const y0 = y * 2;
+						uint32_t const y1 = std::min(y0 + 1, src_w - 1);
+						for (uint32_t x = 0; x < w; ++ x)
+						{
+							uint32_t const x0 = x * 2;
+							uint32_t const x1 = std::min(x0 + 1, src_w - 1);
+							dst[y * w + x] = (src[y0 * src_w + x0] + src[y0 * src_w + x1]
+								+ src[y1 * src_w + x0] + src[y1 * src_w + x1]) * 0.25f;
+						}
+					}
+
+					src_w = w;
+				}
+			}
+		}
+
+		Color Fetch(uint32_t face, float u, float v, uint32_t mip) const
+		{
+			uint32_t const size = std::max<uint32_t>(1U, width >> mip);
+			uint32_t const x = std::min(static_cast<uint32_t>(u * size), size - 1);
+			uint32_t const y = std::min(static_cast<uint32_t>(v * size), size - 1);
+			return levels[face * num_mipmaps + mip][y * size + x];
+		}
+	};
 
-	Color PrefilterEnvMapDiffuse(float3 const & normal, Color* env_map[6], uint32_t size)
+	uint32_t const NUM_SAMPLES = 1024;
+
+	// Importance samples of a lobe around +Z, generated once per output mip instead of once per texel.
+	// Each sample reads from the input mip whose texels cover about the solid angle of the sample,
+	// so the rough levels converge with far less noise than sampling the top level.
+	struct SampleTable
 	{
-		Color prefiltered_clr(0.0f, 0.0f, 0.0f, 0.0f);
+		std::vector<float3> dirs;
+		std::vector<float> weights;
+		std::vector<uint32_t> mips;
+		std::vector<float> mip_fracs;
+		float total_weight;
+
+		SampleTable()
+			: total_weight(0)
+		{
+		}
 
-		uint32_t const NUM_SAMPLES = 1024;
-		for (uint32_t i = 0; i < NUM_SAMPLES; ++ i)
+		void AddSample(float3 const & dir, float weight, float pdf, InputCube const & input)
 		{
-			float2 xi = Hammersley2D(i, NUM_SAMPLES);
-			float3 l = ImportanceSampleLambert(xi, normal);
-			uint32_t face, x, y;
-			ToAddress(face, x, y, l, size);
-			prefiltered_clr += env_map[face][y * size + x];
+			float const sample_solid_angle = 1 / (NUM_SAMPLES * pdf);
+			float const texel_solid_angle = 4 * PI / (6 * input.width * input.width);
+			float const lod = MathLib::clamp(0.5f * log(sample_solid_angle / texel_solid_angle) / log(2.0f) + 1,
+				0.0f, static_cast<float>(input.num_mipmaps - 1));
+			uint32_t const mip = std::min(static_cast<uint32_t>(lod), input.num_mipmaps - 1);
+
+			dirs.push_back(dir);
+			weights.push_back(weight);
+			mips.push_back(mip);
+			mip_fracs.push_back(lod - mip);
+			total_weight += weight;
 		}
+	};
 
-		return prefiltered_clr / static_cast<float>(NUM_SAMPLES);
+	SampleTable DiffuseSampleTable(InputCube const & input)
+	{
+		SampleTable table;
+		for (uint32_t i = 0; i < NUM_SAMPLES; ++ i)
+		{
+			float3 const l = ImportanceSampleLambert(Hammersley2D(i, NUM_SAMPLES));
+			table.AddSample(l, 1, std::max(l.z(), 1e-6f) / PI, input);
+		}
+		return table;
 	}
 
-	Color PrefilterEnvMapSpecular(float roughness, float3 const & r, Color* env_map[6], uint32_t size)
+	SampleTable SpecularSampleTable(float roughness, InputCube const & input)
 	{
-		float3 normal = r;
-		float3 view = r;
-		Color prefiltered_clr(0.0f, 0.0f, 0.0f, 0.0f);
-		float total_weight = 0;
-
-		uint32_t const NUM_SAMPLES = 1024;
+		// N = V = R = +Z, so the reflected direction and its weight only depend on the sample
+		SampleTable table;
 		for (uint32_t i = 0; i < NUM_SAMPLES; ++ i)
 		{
-			float2 xi = Hammersley2D(i, NUM_SAMPLES);
-			float3 h = ImportanceSampleBP(xi, roughness, normal);
-			float3 l = -MathLib::reflect(view, h);
-			float n_dot_l = MathLib::clamp(MathLib::dot(normal, l), 0.0f, 1.0f);
+			float3 const h = ImportanceSampleBP(Hammersley2D(i, NUM_SAMPLES), roughness);
+			float3 const l = h * (2 * h.z()) - float3(0, 0, 1);
+			float const n_dot_l = std::min(l.z(), 1.0f);
 			if (n_dot_l > 0)
 			{
-				uint32_t face, x, y;
-				ToAddress(face, x, y, l, size);
-				prefiltered_clr += env_map[face][y * size + x] * n_dot_l;
-				total_weight += n_dot_l;
+				// pdf(h) = (roughness + 2) / (2 * PI) * cos^roughness(theta_h), and pdf(l) = pdf(h) / (4 * dot(v, h))
+				float const pdf = (roughness + 2) / (8 * PI) * pow(h.z(), roughness - 1);
+				table.AddSample(l, n_dot_l, std::max(pdf, 1e-6f), input);
 			}
 		}
+		table.total_weight = std::max(1e-6f, table.total_weight);
+		return table;
+	}
+
+	Color PrefilterTexel(SampleTable const & table, float3 const & normal, InputCube const & input, std::vector<float3>& dirs)
+	{
+		float3 up_vec = abs(normal.z()) < 0.999f ? float3(0, 0, 1) : float3(1, 0, 0);
+		float3 tangent = MathLib::normalize(MathLib::cross(up_vec, normal));
+		float3 binormal = MathLib::cross(normal, tangent);
+		float4x4 const tangent_to_world(tangent.x(), tangent.y(), tangent.z(), 0,
+			binormal.x(), binormal.y(), binormal.z(), 0,
+			normal.x(), normal.y(), normal.z(), 0,
+			0, 0, 0, 1);
+
+		// All sample directions of the texel in one SIMD batch
+		dirs.resize(table.dirs.size());
+		MathLib::transform_normal(&dirs[0], &table.dirs[0], dirs.size(), tangent_to_world);
+
+		Color prefiltered_clr(0.0f, 0.0f, 0.0f, 0.0f);
+		for (size_t i = 0; i < dirs.size(); ++ i)
+		{
+			uint32_t face;
+			float u, v;
+			ToFaceCoord(face, u, v, dirs[i]);
 
-		return prefiltered_clr / max(1e-6f, total_weight);
+			uint32_t const mip = table.mips[i];
+			Color clr = input.Fetch(face, u, v, mip);
+			if (table.mip_fracs[i] > 0)
+			{
+				clr = MathLib::lerp(clr, input.Fetch(face, u, v, mip + 1), table.mip_fracs[i]);
+			}
+			prefiltered_clr += clr * table.weights[i];
+		}
+
+		return prefiltered_clr / table.total_weight;
 	}
 
-	struct PrefilterCubeFaceParam
+	// A band of rows in one face of one output mip
+	struct PrefilterJob
+	{
+		uint32_t face;
+		uint32_t mip;
+		uint32_t y_begin;
+		uint32_t y_end;
+	};
+
+	struct PrefilterParam
 	{
+		InputCube const * input;
+		std::vector<SampleTable> const * tables;
+		std::vector<PrefilterJob> const * jobs;
 		std::vector<std::vector<Color> >* prefilted_data;
-		std::vector<ElementInitData>* out_data;
-		std::vector<std::vector<half> >* out_data_block;
-		uint32_t width;
 		uint32_t num_mipmaps;
+		atomic<uint32_t>* cur_job;
 		atomic<uint32_t>* processed_texels;
 	};
 
-	void PrefilterCubeFace(PrefilterCubeFaceParam& param, uint32_t face)
+	void PrefilterWorker(PrefilterParam& param)
 	{
-		std::vector<std::vector<Color> >& prefilted_data = *param.prefilted_data;
-		std::vector<ElementInitData>& out_data = *param.out_data;
-		std::vector<std::vector<half> >& out_data_block = *param.out_data_block;
-		uint32_t width = param.width;
-		uint32_t num_mipmaps = param.num_mipmaps;
-		atomic<uint32_t>& processed_texels = *param.processed_texels;
-
-		Color* env_map[6];
-		for (uint32_t f = 0; f < 6; ++ f)
-		{
-			env_map[f] = &prefilted_data[f * num_mipmaps][0];
-		}
-
-		uint32_t w = std::max<uint32_t>(1U, width / 2);
+		std::vector<PrefilterJob> const & jobs = *param.jobs;
+		std::vector<float3> dirs;
 
-		for (uint32_t mip = 1; mip < num_mipmaps - 1; ++ mip)
+		for (;;)
 		{
-			prefilted_data[face * num_mipmaps + mip].resize(w * w);
-			float roughness = static_cast<float>(num_mipmaps - 2 - mip) / (num_mipmaps - 2);
-			roughness = pow(8192.0f, roughness);
-
-			for (uint32_t y = 0; y < w; ++ y)
+			uint32_t const job_index = (*param.cur_job) ++;
+			if (job_index >= jobs.size())
 			{
-				for (uint32_t x = 0; x < w; ++ x)
-				{
-					prefilted_data[face * num_mipmaps + mip][y * w + x]
-						= PrefilterEnvMapSpecular(roughness, ToDir(face, x, y, w), env_map, width);
-					++ processed_texels;
-				}
+				break;
 			}
 
-			w = std::max<uint32_t>(1U, w / 2);
-		}
-
-		{
-			prefilted_data[face * num_mipmaps + num_mipmaps - 1].resize(w * w);
-			for (uint32_t y = 0; y < w; ++ y)
+			PrefilterJob const & job = jobs[job_index];
+			SampleTable const & table = (*param.tables)[job.mip];
+			uint32_t const w = std::max<uint32_t>(1U, param.input->width >> job.mip);
+			std::vector<Color>& prefilted = (*param.prefilted_data)[job.face * param.num_mipmaps + job.mip];
+			for (uint32_t y = job.y_begin; y < job.y_end; ++ y)
 			{
 				for (uint32_t x = 0; x < w; ++ x)
 				{
-					prefilted_data[face * num_mipmaps + num_mipmaps - 1][y * w + x]
-						= PrefilterEnvMapDiffuse(ToDir(face, x, y, w), env_map, width);
-					++ processed_texels;
+					prefilted[y * w + x] = PrefilterTexel(table, ToDir(job.face, x, y, w), *param.input, dirs);
 				}
+				(*param.processed_texels) += w;
 			}
 		}
-
-		w = width;
-		for (uint32_t mip = 0; mip < num_mipmaps; ++ mip)
-		{
-			out_data_block[face * num_mipmaps + mip].resize(w * w * sizeof(half) * 4);
-			out_data[face * num_mipmaps + mip].data = &out_data_block[face * num_mipmaps + mip][0];
-			out_data[face * num_mipmaps + mip].row_pitch = w * sizeof(half) * 4;
-			out_data[face * num_mipmaps + mip].slice_pitch = w * out_data[face * num_mipmaps + mip].row_pitch;
-
-			ConvertFromABGR32F(EF_ABGR16F, &prefilted_data[face * num_mipmaps + mip][0], w * w,
-				&out_data_block[face * num_mipmaps + mip][0]);
-
-			w = std::max<uint32_t>(1U, w / 2);
-		}
 	}
 
 	void PrefilterCube(std::string const & in_file, std::string const & out_file)
@@ -343,40 +399,91 @@ namespace
 			}
 		}
 
-		uint32_t w = in_width;
-		std::vector<std::vector<Color> > prefilted_data(out_num_mipmaps * 6);
-		Color* env_map[6];
+		InputCube input;
+		input.width = in_width;
+		input.num_mipmaps = 1;
+		for (uint32_t w = in_width; w > 1; w /= 2)
+		{
+			++ input.num_mipmaps;
+		}
+		input.levels.resize(input.num_mipmaps * 6);
 		for (uint32_t face = 0; face < 6; ++ face)
 		{
-			prefilted_data[face * out_num_mipmaps].resize(w * w);
-			
+			std::vector<Color>& level = input.levels[face * input.num_mipmaps];
+			level.resize(in_width * in_width);
+
 			uint8_t const * src = static_cast<uint8_t const *>(in_data[face * in_num_mipmaps].data);
-			for (uint32_t y = 0; y < w; ++ y)
+			for (uint32_t y = 0; y < in_width; ++ y)
 			{
-				ConvertToABGR32F(in_format, src, w, &prefilted_data[face * out_num_mipmaps][y * w]);
+				ConvertToABGR32F(in_format, src, in_width, &level[y * in_width]);
 				src += in_data[face * in_num_mipmaps].row_pitch;
 			}
+		}
+		input.GenerateMipmaps();
 
-			env_map[face] = &prefilted_data[face * out_num_mipmaps][0];
+		std::vector<std::vector<Color> > prefilted_data(out_num_mipmaps * 6);
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			prefilted_data[face * out_num_mipmaps] = input.levels[face * input.num_mipmaps];
+			uint32_t w = in_width;
+			for (uint32_t mip = 1; mip < out_num_mipmaps; ++ mip)
+			{
+				w = std::max<uint32_t>(1U, w / 2);
+				prefilted_data[face * out_num_mipmaps + mip].resize(w * w);
+			}
 		}
 
-		std::vector<ElementInitData> out_data(out_num_mipmaps * 6);
-		std::vector<std::vector<half> > out_data_block(out_num_mipmaps * 6);
+		// Levels 1 to n - 2 are specular with decreasing glossiness, the last one is diffuse
+		std::vector<SampleTable> tables(out_num_mipmaps);
+		for (uint32_t mip = 1; mip < out_num_mipmaps - 1; ++ mip)
+		{
+			float roughness = static_cast<float>(out_num_mipmaps - 2 - mip) / (out_num_mipmaps - 2);
+			roughness = pow(8192.0f, roughness);
+			tables[mip] = SpecularSampleTable(roughness, input);
+		}
+		if (out_num_mipmaps > 1)
+		{
+			tables[out_num_mipmaps - 1] = DiffuseSampleTable(input);
+		}
 
+		// Small jobs over all faces and mips keep every core busy, not just one per face
+		std::vector<PrefilterJob> jobs;
+		{
+			uint32_t w = in_width;
+			for (uint32_t mip = 1; mip < out_num_mipmaps; ++ mip)
+			{
+				w = std::max<uint32_t>(1U, w / 2);
+				uint32_t const rows_per_job = std::max<uint32_t>(1U, 4096 / w);
+				for (uint32_t face = 0; face < 6; ++ face)
+				{
+					for (uint32_t y = 0; y < w; y += rows_per_job)
+					{
+						PrefilterJob job = { face, mip, y, std::min(y + rows_per_job, w) };
+						jobs.push_back(job);
+					}
+				}
+			}
+		}
+
+		atomic<uint32_t> cur_job(0);
 		atomic<uint32_t> processed_texels(0);
 
-		thread_pool tp(1, 6);
-		std::vector<joiner<void> > joiners(6);
-		PrefilterCubeFaceParam param;
+		CPUInfo cpu;
+		uint32_t const num_threads = std::max<uint32_t>(1U,
+			std::min(static_cast<uint32_t>(cpu.NumHWThreads()), static_cast<uint32_t>(jobs.size())));
+		thread_pool tp(1, num_threads);
+		std::vector<joiner<void> > joiners(num_threads);
+		PrefilterParam param;
+		param.input = &input;
+		param.tables = &tables;
+		param.jobs = &jobs;
 		param.prefilted_data = &prefilted_data;
-		param.out_data = &out_data;
-		param.out_data_block = &out_data_block;
-		param.width = in_width;
 		param.num_mipmaps = out_num_mipmaps;
+		param.cur_job = &cur_job;
 		param.processed_texels = &processed_texels;
-		for (size_t face = 0; face < joiners.size(); ++ face)
+		for (size_t i = 0; i < joiners.size(); ++ i)
 		{
-			joiners[face] = tp(KlayGE::bind(PrefilterCubeFace, KlayGE::ref(param), static_cast<uint32_t>(face)));
+			joiners[i] = tp(KlayGE::bind(PrefilterWorker, KlayGE::ref(param)));
 		}
 
 		for (;;)
@@ -393,9 +500,28 @@ namespace
 		}
 		cout << endl;
 
-		for (size_t face = 0; face < joiners.size(); ++ face)
+		for (size_t i = 0; i < joiners.size(); ++ i)
 		{
-			joiners[face]();
+			joiners[i]();
+		}
+
+		std::vector<ElementInitData> out_data(out_num_mipmaps * 6);
+		std::vector<std::vector<half> > out_data_block(out_num_mipmaps * 6);
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			uint32_t w = in_width;
+			for (uint32_t mip = 0; mip < out_num_mipmaps; ++ mip)
+			{
+				uint32_t const index = face * out_num_mipmaps + mip;
+				out_data_block[index].resize(w * w * 4);
+				out_data[index].data = &out_data_block[index][0];
+				out_data[index].row_pitch = w * sizeof(half) * 4;
+				out_data[index].slice_pitch = w * out_data[index].row_pitch;
+
+				ConvertFromABGR32F(EF_ABGR16F, &prefilted_data[index][0], w * w, &out_data_block[index][0]);
+
+				w = std::max<uint32_t>(1U, w / 2);
+			}
 		}
 
 		SaveTexture(out_file, in_type, in_width, in_height, in_depth, out_num_mipmaps, in_array_size, EF_ABGR16F, out_data);
@@ -419,10 +545,29 @@ namespace
 
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
+		// A full mip chain of the input, for the filtered importance sampling in the shaders. Same as InputCube of the CPU path.
+		uint32_t in_num_mipmaps = 1;
+		for (uint32_t w = in_width; w > 1; w /= 2)
+		{
+			++ in_num_mipmaps;
+		}
+		TexturePtr in_mip_tex = rf.MakeTextureCube(in_width, in_num_mipmaps, 1, EF_ABGR16F, 1, 0,
+			EAH_GPU_Read | EAH_GPU_Write | EAH_Generate_Mips, nullptr);
+		for (int face = 0; face < 6; ++ face)
+		{
+			in_tex->CopyToSubTextureCube(*in_mip_tex, 0, static_cast<Texture::CubeFaces>(face), 0, 0, 0, in_width, in_width,
+				0, static_cast<Texture::CubeFaces>(face), 0, 0, 0, in_width, in_width);
+		}
+		in_mip_tex->BuildMipSubLevels();
+
 		PostProcessPtr diff_pp = SyncLoadPostProcess("PrefilterCube.ppml", "PrefilterCubeDiffuse");
 		PostProcessPtr spec_pp = SyncLoadPostProcess("PrefilterCube.ppml", "PrefilterCubeSpecular");
-		diff_pp->InputPin(0, in_tex);
-		spec_pp->InputPin(0, in_tex);
+		diff_pp->InputPin(0, in_mip_tex);
+		spec_pp->InputPin(0, in_mip_tex);
+		diff_pp->SetParam(1, static_cast<float>(in_width));
+		diff_pp->SetParam(2, static_cast<float>(in_num_mipmaps - 1));
+		spec_pp->SetParam(2, static_cast<float>(in_width));
+		spec_pp->SetParam(3, static_cast<float>(in_num_mipmaps - 1));
 
 		TexturePtr out_tex = rf.MakeTextureCube(in_width, out_num_mipmaps, 1, EF_ABGR16F, 1, 0, EAH_GPU_Write, nullptr);
 
@@ -10,100 +10,51 @@
 #include <fstream>
 #include <vector>
 
+#include "TexTools.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
 namespace
 {
-	void CompressTex(std::string const & in_file, std::string const & out_file, ElementFormat fmt)
-	{
-		Texture::TextureType in_type;
-		uint32_t in_width, in_height, in_depth;
-		uint32_t in_num_mipmaps;
-		uint32_t in_array_size;
-		ElementFormat in_format;
-		std::vector<ElementInitData> in_data;
-		std::vector<uint8_t> in_data_block;
-		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
-
-		if (IsCompressedFormat(in_format))
+	void CompressTex(std::string const & in_file, std::string const & out_file, ElementFormat fmt, TexCompressionMethod method)
+	{
+		TexImage tex;
+		LoadTexImage(in_file, tex);
+
+		if (!CompressTex(tex, fmt, method))
 		{
 			cout << "This texture is already in compressed format." << endl;
 			if (in_file != out_file)
 			{
-				SaveTexture(out_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data);
+				SaveTexImage(out_file, tex);
 			}
 			return;
 		}
 
-		uint32_t out_width = (in_width + 3) & ~3;
-		uint32_t out_height = (in_height + 3) & ~3;
-
-		if (IsSigned(in_format))
-		{
-			fmt = MakeSigned(fmt);
-		}
-		if (IsSRGB(in_format))
-		{
-			fmt = MakeSRGB(fmt);
-		}
-
-		std::vector<ElementInitData> new_data(in_data.size());
-		std::vector<std::vector<uint8_t> > new_data_block(in_data.size());
-
-		for (size_t sub_res = 0; sub_res < in_array_size; ++ sub_res)
-		{
-			uint32_t src_width = in_width;
-			uint32_t src_height = in_height;
-
-			uint32_t dst_width = out_width;
-			uint32_t dst_height = out_height;
-
-			for (uint32_t mip = 0; mip < in_num_mipmaps; ++ mip)
-			{
-				ElementInitData& src_data = in_data[sub_res * in_num_mipmaps + mip];
-				ElementInitData& dst_data = new_data[sub_res * in_num_mipmaps + mip];
-
-				uint32_t const block_size = NumFormatBytes(fmt) * 4;
-
-				dst_data.row_pitch = ((dst_width + 3) / 4) * block_size;
-				dst_data.slice_pitch = dst_data.row_pitch * ((dst_height + 3) / 4);
-
-				new_data_block[sub_res * in_num_mipmaps + mip].resize(dst_data.slice_pitch);
-
-				dst_data.data = &new_data_block[sub_res * in_num_mipmaps + mip][0];
-
-				ResizeTexture(&new_data_block[sub_res * in_num_mipmaps + mip][0],
-					dst_data.row_pitch, dst_data.slice_pitch,
-					fmt, dst_width, dst_height, 1,
-					src_data.data, src_data.row_pitch, src_data.slice_pitch,
-					in_format, src_width, src_height, 1,
-					false);
-
-				src_width = std::max(src_width / 2, 1U);
-				src_height = std::max(src_height / 2, 1U);
-
-				dst_width = std::max(dst_width / 2, 1U);
-				dst_height = std::max(dst_height / 2, 1U);
-			}
-		}
-
-		SaveTexture(out_file, in_type, out_width, out_height, in_depth, in_num_mipmaps, in_array_size, fmt, new_data);
+		SaveTexImage(out_file, tex);
 	}
 
 	void PrintSupportedFormats()
 	{
 		cout << "Supported formats: bc1, bc2, bc3, bc4, bc5, bc7, etc1" << endl;
 	}
+
+	void PrintSupportedMethods()
+	{
+		cout << "Supported methods (etc1 only): speed, balanced, quality" << endl;
+	}
 }
 
 int main(int argc, char* argv[])
 {
 	if (argc < 3)
 	{
-		cout << "Usage: TexCompressor format xxx.dds [yyy.dds]" << endl;
+		cout << "Usage: TexCompressor format xxx.dds [yyy.dds] [method=quality]" << endl;
 		cout << "\t";
 		PrintSupportedFormats();
+		cout << "\t";
+		PrintSupportedMethods();
 		return 1;
 	}
 
@@ -165,7 +116,33 @@ int main(int argc, char* argv[])
 		out_file = argv[3];
 	}
 
-	CompressTex(in_file, out_file, fmt);
+	TexCompressionMethod method = TCM_Quality;
+	if (argc >= 5)
+	{
+		std::string method_str = argv[4];
+		boost::algorithm::to_lower(method_str);
+		size_t const method_hash = RT_HASH(method_str.c_str());
+		if (CT_HASH("speed") == method_hash)
+		{
+			method = TCM_Speed;
+		}
+		else if (CT_HASH("balanced") == method_hash)
+		{
+			method = TCM_Balanced;
+		}
+		else if (CT_HASH("quality") == method_hash)
+		{
+			method = TCM_Quality;
+		}
+		else
+		{
+			cout << "Unknown method. ";
+			PrintSupportedMethods();
+			return 1;
+		}
+	}
+
+	CompressTex(in_file, out_file, fmt, method);
 
 	cout << "Compressed texture is saved." << endl;
 
@@ -110,6 +110,8 @@ namespace KlayGE
 		font_info const & CharInfo(int32_t index) const;
 		void GetDistanceData(uint8_t* p, uint32_t pitch, int32_t index) const;
 		void GetLZMADistanceData(uint8_t* p, uint32_t& size, int32_t index) const;
+		// Decodes data from GetLZMADistanceData. Doesn't touch the font, so it can run on any thread.
+		void DecodeDistanceData(uint8_t* p, uint32_t pitch, uint8_t const * lzma_data, uint32_t size) const;
 
 		void CharSize(uint32_t size);
 		void DistBase(int16_t base);
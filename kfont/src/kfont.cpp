@@ -355,19 +355,24 @@ namespace KlayGE
 
 	void KFont::GetDistanceData(uint8_t* p, uint32_t pitch, int32_t index) const
 	{
-		std::vector<uint8_t> decoded(char_size_ * char_size_);
-
 		uint32_t size;
 		this->GetLZMADistanceData(nullptr, size, index);
 
 		std::vector<uint8_t> in_data(size);
 		this->GetLZMADistanceData(&in_data[0], size, index);
 
+		this->DecodeDistanceData(p, pitch, &in_data[0], size);
+	}
+
+	void KFont::DecodeDistanceData(uint8_t* p, uint32_t pitch, uint8_t const * lzma_data, uint32_t size) const
+	{
+		std::vector<uint8_t> decoded(char_size_ * char_size_);
+
 		SizeT s_out_len = static_cast<SizeT>(decoded.size());
 
-		SizeT s_src_len = static_cast<SizeT>(in_data.size() - LZMA_PROPS_SIZE);
-		LZMALoader::Instance().LzmaUncompress(static_cast<Byte*>(&decoded[0]), &s_out_len, &in_data[LZMA_PROPS_SIZE], &s_src_len,
-			&in_data[0], LZMA_PROPS_SIZE);
+		SizeT s_src_len = static_cast<SizeT>(size - LZMA_PROPS_SIZE);
+		LZMALoader::Instance().LzmaUncompress(static_cast<Byte*>(&decoded[0]), &s_out_len, lzma_data + LZMA_PROPS_SIZE, &s_src_len,
+			lzma_data, LZMA_PROPS_SIZE);
 
 		uint8_t const * char_data = &decoded[0];
 		for (uint32_t y = 0; y < char_size_; ++ y)